@@ -62,7 +62,8 @@ void all_logs_vtab::get_columns(std::vector<vtab_column> &cols) const
 
 void all_logs_vtab::extract(std::shared_ptr<logfile> lf, uint64_t line_number,
                             shared_buffer_ref &line,
-                            std::vector<logline_value> &values)
+                            std::vector<logline_value> &values,
+                            const value_projection &projection)
 {
     auto format = lf->get_format();
     values.emplace_back(this->alv_value_meta, format->get_name());
@@ -89,13 +90,10 @@ void all_logs_vtab::extract(std::shared_ptr<logfile> lf, uint64_t line_number,
 
     values.emplace_back(this->alv_msg_meta, tsb.tsb_ref);
 
-    this->alv_schema_manager.invalidate_refs();
     dp.dp_schema_id.to_string(this->alv_schema_buffer.data());
-    shared_buffer_ref schema_ref;
-    schema_ref.share(this->alv_schema_manager,
-                     this->alv_schema_buffer.data(),
-                     data_parser::schema_id_t::STRING_SIZE - 1);
-    values.emplace_back(this->alv_schema_meta, schema_ref);
+    tmp_shared_buffer schema_tsb(this->alv_schema_buffer.data(),
+                                 data_parser::schema_id_t::STRING_SIZE - 1);
+    values.emplace_back(this->alv_schema_meta, schema_tsb.tsb_ref);
 }
 
 bool all_logs_vtab::is_valid(log_cursor &lc, logfile_sub_source &lss)
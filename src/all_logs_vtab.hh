@@ -48,17 +48,21 @@ public:
     void extract(std::shared_ptr<logfile> lf,
                  uint64_t line_number,
                  shared_buffer_ref &line,
-                 std::vector<logline_value> &values) override;
+                 std::vector<logline_value> &values,
+                 const value_projection &projection) override;
 
     bool is_valid(log_cursor &lc, logfile_sub_source &lss) override;
 
     bool next(log_cursor &lc, logfile_sub_source &lss) override;
 
+    bool is_thread_safe() const override {
+        return true;
+    };
+
 private:
     logline_value_meta alv_value_meta;
     logline_value_meta alv_msg_meta;
     logline_value_meta alv_schema_meta;
-    shared_buffer alv_schema_manager;
     std::array<char, data_parser::schema_id_t::STRING_SIZE> alv_schema_buffer{};
 };
 
@@ -33,6 +33,10 @@
 
 #include <unistd.h>
 
+#include <condition_variable>
+#include <future>
+#include <mutex>
+
 #if HAVE_ARCHIVE_H
 #include "archive.h"
 #include "archive_entry.h"
@@ -243,43 +247,166 @@ copy_data(const std::string& filename,
     }
 }
 
-static walk_result_t extract(const std::string &filename, const extract_cb &cb)
+/**
+ * Check if a member was completely unpacked by a previous extraction that was
+ * interrupted before the whole archive could be processed.
+ */
+static bool is_member_unpacked(const fs::path &entry_path, la_int64_t size)
 {
-    static int FLAGS = ARCHIVE_EXTRACT_TIME
-                       | ARCHIVE_EXTRACT_PERM
-                       | ARCHIVE_EXTRACT_ACL
-                       | ARCHIVE_EXTRACT_FFLAGS;
+    std::error_code ec;
 
-    auto tmp_path = filename_to_tmp_path(filename);
-    auto arc_lock = archive_lock(tmp_path);
-    auto lock_guard = archive_lock::guard(arc_lock);
-    auto done_path = tmp_path;
+    if (size <= 0 || !fs::is_regular_file(entry_path, ec)) {
+        return false;
+    }
 
-    done_path += ".done";
+    auto file_size = fs::file_size(entry_path, ec);
 
-    if (fs::exists(done_path)) {
-        size_t file_count = 0;
-        if (fs::is_directory(tmp_path)) {
-            for (const auto& entry : fs::directory_iterator(tmp_path)) {
-                (void) entry;
-                file_count += 1;
+    return !ec && file_size == (uintmax_t) size;
+}
+
+/**
+ * Limits the number of threads that are unpacking archives at any one time.
+ * The thread driving the extraction of an archive always takes a slot.
+ * Additional workers for the members of an archive are only started when a
+ * slot is free, so an archive never waits on its own workers.
+ */
+class extract_slots {
+public:
+    class guard {
+    public:
+        explicit guard(bool acquired) : g_acquired(acquired) {}
+
+        guard(guard &&other) noexcept : g_acquired(other.g_acquired) {
+            other.g_acquired = false;
+        }
+
+        ~guard() {
+            if (this->g_acquired) {
+                extract_slots::release();
             }
         }
-        if (file_count > 0) {
-            fs::last_write_time(
-                done_path, std::chrono::system_clock::now());
-            log_info("%s: archive has already been extracted!", done_path.c_str());
-            return Ok();
-        } else {
-            log_warning("%s: archive cache has been damaged, re-extracting",
-                        done_path.c_str());
+
+        bool acquired() const {
+            return this->g_acquired;
         }
 
-        fs::remove(done_path);
+    private:
+        bool g_acquired;
+    };
+
+    static guard acquire() {
+        std::unique_lock<std::mutex> lk(mutex());
+
+        cond().wait(lk, []() { return in_use() < max_slots(); });
+        in_use() += 1;
+
+        return guard(true);
+    }
+
+    static guard try_acquire() {
+        std::lock_guard<std::mutex> lk(mutex());
+
+        if (in_use() >= max_slots()) {
+            return guard(false);
+        }
+        in_use() += 1;
+
+        return guard(true);
+    }
+
+private:
+    static void release() {
+        {
+            std::lock_guard<std::mutex> lk(mutex());
+
+            in_use() -= 1;
+        }
+        cond().notify_one();
+    }
+
+    static size_t max_slots() {
+        auto& cfg = injector::get<const config&>();
+
+        return std::max(cfg.amc_extract_workers, (int64_t) 1);
+    }
+
+    static std::mutex &mutex() {
+        static std::mutex retval;
+
+        return retval;
+    }
+
+    static std::condition_variable &cond() {
+        static std::condition_variable retval;
+
+        return retval;
+    }
+
+    static size_t &in_use() {
+        static size_t retval = 0;
+
+        return retval;
+    }
+};
+
+/**
+ * Determine how many workers can be used to unpack the members of the given
+ * archive.  Members can only be unpacked independently when skipping over
+ * the members handled by other workers is a seek and not a decompression
+ * pass, which is the case for uncompressed zip files.
+ */
+static size_t member_worker_count(const std::string &filename)
+{
+    auto& cfg = injector::get<const config&>();
+
+    if (cfg.amc_extract_workers <= 1) {
+        return 1;
     }
 
+    auto_mem<archive> arc(archive_free);
+
+    arc = archive_read_new();
+    enable_desired_archive_formats(arc);
+    archive_read_support_format_raw(arc);
+    archive_read_support_filter_all(arc);
+    if (archive_read_open_filename(arc, filename.c_str(), 10240) != ARCHIVE_OK) {
+        return 1;
+    }
+
+    struct archive_entry *entry;
+
+    if (archive_read_next_header(arc, &entry) != ARCHIVE_OK) {
+        return 1;
+    }
+
+    auto format = archive_format(arc) & ARCHIVE_FORMAT_BASE_MASK;
+
+    if (format != ARCHIVE_FORMAT_ZIP || archive_filter_count(arc) != 1) {
+        return 1;
+    }
+
+    return cfg.amc_extract_workers;
+}
+
+/**
+ * Unpack the members of an archive whose index modulo the worker count
+ * matches the given worker index.
+ */
+static walk_result_t extract_members(const std::string &filename,
+                                     const fs::path &tmp_path,
+                                     const extract_cb &cb,
+                                     const member_cb &mcb,
+                                     size_t worker_index,
+                                     size_t worker_count)
+{
+    static int FLAGS = ARCHIVE_EXTRACT_TIME
+                       | ARCHIVE_EXTRACT_PERM
+                       | ARCHIVE_EXTRACT_ACL
+                       | ARCHIVE_EXTRACT_FFLAGS;
+
     auto_mem<archive> arc(archive_free);
     auto_mem<archive> ext(archive_free);
+    size_t entry_index = 0;
 
     arc = archive_read_new();
     enable_desired_archive_formats(arc);
@@ -294,14 +421,11 @@ static walk_result_t extract(const std::string &filename, const extract_cb &cb)
                                archive_error_string(arc)));
     }
 
-    log_info("extracting %s to %s",
-             filename.c_str(),
-             tmp_path.c_str());
     while (true) {
         struct archive_entry *entry;
         auto r = archive_read_next_header(arc, &entry);
         if (r == ARCHIVE_EOF) {
-            log_info("all done");
+            log_info("all done (worker %d)", worker_index);
             break;
         }
         if (r != ARCHIVE_OK) {
@@ -310,6 +434,11 @@ static walk_result_t extract(const std::string &filename, const extract_cb &cb)
                                    archive_error_string(arc)));
         }
 
+        if ((entry_index++ % worker_count) != worker_index) {
+            archive_read_data_skip(arc);
+            continue;
+        }
+
         auto format_name = archive_format_name(arc);
         auto filter_count = archive_filter_count(arc);
 
@@ -320,12 +449,23 @@ static walk_result_t extract(const std::string &filename, const extract_cb &cb)
             desired_pathname = fs::path(filename).filename();
         }
         auto entry_path = tmp_path / desired_pathname;
-        auto prog = cb(entry_path,
-                       archive_entry_size_is_set(entry) ?
-                       archive_entry_size(entry) : -1);
-        archive_entry_copy_pathname(wentry, entry_path.c_str());
+        auto entry_size = archive_entry_size_is_set(entry) ?
+                          archive_entry_size(entry) : -1;
         auto entry_mode = archive_entry_mode(wentry);
 
+        if (S_ISREG(entry_mode) && is_member_unpacked(entry_path, entry_size)) {
+            log_info("%s: member was already unpacked, skipping",
+                     entry_path.c_str());
+            archive_read_data_skip(arc);
+            if (mcb) {
+                mcb(tmp_path, entry_path, entry_size);
+            }
+            continue;
+        }
+
+        auto prog = cb(entry_path, entry_size);
+        archive_entry_copy_pathname(wentry, entry_path.c_str());
+
         archive_entry_set_perm(
             wentry, S_IRUSR | (S_ISDIR(entry_mode) ? S_IXUSR|S_IWUSR : 0));
         r = archive_write_header(ext, wentry);
@@ -336,6 +476,9 @@ static walk_result_t extract(const std::string &filename, const extract_cb &cb)
         }
         else if (!archive_entry_size_is_set(entry) ||
                  archive_entry_size(entry) > 0) {
+            if (mcb && S_ISREG(entry_mode)) {
+                mcb(tmp_path, entry_path, entry_size);
+            }
             TRY(copy_data(filename, arc, entry, ext, entry_path, prog));
         }
         r = archive_write_finish_entry(ext);
@@ -348,6 +491,88 @@ static walk_result_t extract(const std::string &filename, const extract_cb &cb)
     archive_read_close(arc);
     archive_write_close(ext);
 
+    return Ok();
+}
+
+static walk_result_t extract(const std::string &filename,
+                             const extract_cb &cb,
+                             const member_cb &mcb)
+{
+    auto tmp_path = filename_to_tmp_path(filename);
+    auto arc_lock = archive_lock(tmp_path);
+    auto lock_guard = archive_lock::guard(arc_lock);
+    auto done_path = tmp_path;
+
+    done_path += ".done";
+
+    if (fs::exists(done_path)) {
+        size_t file_count = 0;
+        if (fs::is_directory(tmp_path)) {
+            for (const auto& entry : fs::directory_iterator(tmp_path)) {
+                (void) entry;
+                file_count += 1;
+            }
+        }
+        if (file_count > 0) {
+            fs::last_write_time(
+                done_path, std::chrono::system_clock::now());
+            log_info("%s: archive has already been extracted!", done_path.c_str());
+            return Ok();
+        } else {
+            log_warning("%s: archive cache has been damaged, re-extracting",
+                        done_path.c_str());
+        }
+
+        fs::remove(done_path);
+    }
+
+    auto slot = extract_slots::acquire();
+    auto worker_count = member_worker_count(filename);
+    std::vector<extract_slots::guard> worker_slots;
+    std::vector<std::future<walk_result_t>> workers;
+
+    while (worker_slots.size() + 1 < worker_count) {
+        auto worker_slot = extract_slots::try_acquire();
+
+        if (!worker_slot.acquired()) {
+            break;
+        }
+        worker_slots.emplace_back(std::move(worker_slot));
+    }
+    worker_count = worker_slots.size() + 1;
+
+    log_info("extracting %s to %s using %d worker(s)",
+             filename.c_str(),
+             tmp_path.c_str(),
+             worker_count);
+    for (size_t lpc = 1; lpc < worker_count; lpc++) {
+        workers.emplace_back(std::async(std::launch::async,
+                                        extract_members,
+                                        filename,
+                                        tmp_path,
+                                        cb,
+                                        mcb,
+                                        lpc,
+                                        worker_count));
+    }
+
+    auto res = extract_members(filename, tmp_path, cb, mcb, 0, worker_count);
+    nonstd::optional<std::string> error;
+
+    if (res.isErr()) {
+        error = res.unwrapErr();
+    }
+    for (auto& worker : workers) {
+        auto worker_res = worker.get();
+
+        if (!error && worker_res.isErr()) {
+            error = worker_res.unwrapErr();
+        }
+    }
+    if (error) {
+        return Err(error.value());
+    }
+
     auto_fd(open(done_path.c_str(), O_CREAT | O_WRONLY, 0600));
 
     return Ok();
@@ -359,12 +584,16 @@ walk_result_t walk_archive_files(
     const extract_cb &cb,
     const std::function<void(
         const fs::path&,
-        const fs::directory_entry &)>& callback)
+        const fs::directory_entry &)>& callback,
+    const member_cb &mcb)
 {
 #if HAVE_ARCHIVE_H
+    auto& cfg = injector::get<const config&>();
     auto tmp_path = filename_to_tmp_path(filename);
 
-    auto result = extract(filename, cb);
+    auto result = extract(filename,
+                          cb,
+                          cfg.amc_streaming ? mcb : member_cb());
     if (result.isErr()) {
         fs::remove_all(tmp_path);
         return result;
@@ -56,6 +56,19 @@ struct extract_progress {
 using extract_cb = std::function<extract_progress *(
     const ghc::filesystem::path &, ssize_t)>;
 
+/**
+ * Callback invoked when a regular file in an archive is available on disk.
+ * When streaming is enabled, this is called as soon as the member has been
+ * created in the cache directory and while its contents are still being
+ * unpacked, so the consumer should treat the file as one that is being
+ * appended to.
+ *
+ * The arguments are the root of the unpacked archive, the path to the
+ * member, and the member's size or -1 if the size is not known.
+ */
+using member_cb = std::function<void(
+    const ghc::filesystem::path &, const ghc::filesystem::path &, ssize_t)>;
+
 bool is_archive(const ghc::filesystem::path& filename);
 
 ghc::filesystem::path filename_to_tmp_path(const std::string &filename);
@@ -67,7 +80,8 @@ walk_result_t walk_archive_files(
     const extract_cb &cb,
     const std::function<void(
         const ghc::filesystem::path &,
-        const ghc::filesystem::directory_entry &)> &);
+        const ghc::filesystem::directory_entry &)> &,
+    const member_cb &mcb = member_cb());
 
 void cleanup_cache();
 
@@ -0,0 +1,773 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file arrow_ipc.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "base/date_time_scanner.hh"
+#include "base/intern_string.hh"
+#include "base/lnav_log.hh"
+#include "db_sub_source.hh"
+#include "arrow_ipc.hh"
+
+namespace lnav {
+namespace arrow_ipc {
+
+/*
+ * The metadata in the Arrow IPC format is encoded with FlatBuffers.  Only
+ * a handful of tables are needed to describe a schema and record batches,
+ * so, instead of depending on the flatbuffers library, a small encoder is
+ * implemented here.  The tables are built as a tree and then serialized
+ * with the parent tables first, since references in a flatbuffer are
+ * unsigned offsets that must point forward in the buffer.
+ *
+ * See: https://arrow.apache.org/docs/format/Columnar.html
+ */
+
+static const int16_t METADATA_V5 = 4;
+
+static const uint8_t HEADER_SCHEMA = 1;
+static const uint8_t HEADER_DICTIONARY_BATCH = 2;
+static const uint8_t HEADER_RECORD_BATCH = 3;
+
+static const uint8_t TYPE_INT = 2;
+static const uint8_t TYPE_FLOATING_POINT = 3;
+static const uint8_t TYPE_UTF8 = 5;
+static const uint8_t TYPE_TIMESTAMP = 10;
+
+static const int16_t PRECISION_DOUBLE = 2;
+static const int16_t TIME_UNIT_MILLISECOND = 1;
+
+static const size_t BATCH_ROWS = 64 * 1024;
+static const size_t MAX_DICTIONARY_SIZE = 1024;
+
+static const uint32_t CONTINUATION_MARKER = 0xffffffff;
+
+struct fb_table;
+
+struct fb_value {
+    enum class kind_t {
+        scalar,
+        string,
+        table,
+        table_vector,
+        struct_vector,
+    };
+
+    kind_t v_kind{kind_t::scalar};
+    std::string v_bytes;
+    size_t v_align{1};
+    size_t v_count{0};
+    std::shared_ptr<fb_table> v_table;
+    std::vector<std::shared_ptr<fb_table>> v_tables;
+
+    size_t size() const {
+        return this->v_kind == kind_t::scalar ? this->v_bytes.size() : 4;
+    }
+
+    size_t align() const {
+        return this->v_kind == kind_t::scalar ? this->v_align : 4;
+    }
+};
+
+struct fb_table {
+    std::vector<std::pair<uint16_t, fb_value>> t_fields;
+
+    template<typename T>
+    fb_table &scalar(uint16_t id, T value) {
+        fb_value fv;
+
+        fv.v_bytes.assign((const char *) &value, sizeof(value));
+        fv.v_align = sizeof(value);
+        this->t_fields.emplace_back(id, std::move(fv));
+        return *this;
+    }
+
+    fb_table &string(uint16_t id, const std::string &str) {
+        fb_value fv;
+
+        fv.v_kind = fb_value::kind_t::string;
+        fv.v_bytes = str;
+        this->t_fields.emplace_back(id, std::move(fv));
+        return *this;
+    }
+
+    fb_table &table(uint16_t id, std::shared_ptr<fb_table> child) {
+        fb_value fv;
+
+        fv.v_kind = fb_value::kind_t::table;
+        fv.v_table = std::move(child);
+        this->t_fields.emplace_back(id, std::move(fv));
+        return *this;
+    }
+
+    fb_table &tables(uint16_t id,
+                     std::vector<std::shared_ptr<fb_table>> children) {
+        fb_value fv;
+
+        fv.v_kind = fb_value::kind_t::table_vector;
+        fv.v_tables = std::move(children);
+        this->t_fields.emplace_back(id, std::move(fv));
+        return *this;
+    }
+
+    /**
+     * Add a vector of structs.  The only structs used in the metadata are
+     * FieldNode and Buffer, which are both a pair of 64-bit integers.
+     */
+    fb_table &structs(uint16_t id, const std::vector<int64_t> &pairs) {
+        fb_value fv;
+
+        fv.v_kind = fb_value::kind_t::struct_vector;
+        fv.v_bytes.assign((const char *) pairs.data(),
+                          pairs.size() * sizeof(int64_t));
+        fv.v_count = pairs.size() / 2;
+        this->t_fields.emplace_back(id, std::move(fv));
+        return *this;
+    }
+};
+
+class fb_encoder {
+public:
+    std::string encode(const fb_table &root) {
+        this->e_buf.assign(4, '\0');
+        this->patch(0, this->write_table(root));
+
+        return std::move(this->e_buf);
+    }
+
+private:
+    void pad_to(size_t align, size_t phase = 0) {
+        while ((this->e_buf.size() % align) != phase) {
+            this->e_buf.push_back('\0');
+        }
+    }
+
+    template<typename T>
+    void put(T value) {
+        this->e_buf.append((const char *) &value, sizeof(value));
+    }
+
+    void patch(size_t at, size_t target) {
+        uint32_t off = target - at;
+
+        memcpy(&this->e_buf[at], &off, sizeof(off));
+    }
+
+    size_t write_table(const fb_table &t) {
+        std::vector<const std::pair<uint16_t, fb_value> *> order;
+        uint16_t field_count = 0;
+
+        for (const auto &field : t.t_fields) {
+            order.push_back(&field);
+            field_count = std::max(field_count, (uint16_t) (field.first + 1));
+        }
+        std::stable_sort(order.begin(), order.end(), [](auto lhs, auto rhs) {
+            return lhs->second.align() > rhs->second.align();
+        });
+
+        // The table is placed so that its first field is 8-byte aligned.
+        std::vector<uint16_t> field_offsets(field_count, 0);
+        size_t table_size = 4;
+
+        for (const auto *field : order) {
+            while (((table_size + 4) % field->second.align()) != 0) {
+                table_size += 1;
+            }
+            field_offsets[field->first] = table_size;
+            table_size += field->second.size();
+        }
+
+        this->pad_to(2);
+        auto vtable_pos = this->e_buf.size();
+        this->put<uint16_t>(4 + 2 * field_count);
+        this->put<uint16_t>(table_size);
+        for (auto off : field_offsets) {
+            this->put<uint16_t>(off);
+        }
+
+        this->pad_to(8, 4);
+        auto table_pos = this->e_buf.size();
+        this->e_buf.resize(table_pos + table_size, '\0');
+        int32_t vtable_off = table_pos - vtable_pos;
+        memcpy(&this->e_buf[table_pos], &vtable_off, sizeof(vtable_off));
+
+        std::vector<std::pair<size_t, const fb_value *>> refs;
+        for (const auto *field : order) {
+            auto field_pos = table_pos + field_offsets[field->first];
+
+            if (field->second.v_kind == fb_value::kind_t::scalar) {
+                memcpy(&this->e_buf[field_pos],
+                       field->second.v_bytes.data(),
+                       field->second.v_bytes.size());
+            } else {
+                refs.emplace_back(field_pos, &field->second);
+            }
+        }
+        for (const auto &ref : refs) {
+            this->patch(ref.first, this->write_value(*ref.second));
+        }
+
+        return table_pos;
+    }
+
+    size_t write_value(const fb_value &fv) {
+        size_t retval;
+
+        switch (fv.v_kind) {
+            case fb_value::kind_t::string:
+                this->pad_to(4);
+                retval = this->e_buf.size();
+                this->put<uint32_t>(fv.v_bytes.size());
+                this->e_buf.append(fv.v_bytes);
+                this->e_buf.push_back('\0');
+                break;
+            case fb_value::kind_t::table:
+                retval = this->write_table(*fv.v_table);
+                break;
+            case fb_value::kind_t::table_vector: {
+                this->pad_to(4);
+                retval = this->e_buf.size();
+                this->put<uint32_t>(fv.v_tables.size());
+                this->e_buf.resize(retval + 4 + 4 * fv.v_tables.size(), '\0');
+                for (size_t lpc = 0; lpc < fv.v_tables.size(); lpc++) {
+                    this->patch(retval + 4 + 4 * lpc,
+                                this->write_table(*fv.v_tables[lpc]));
+                }
+                break;
+            }
+            case fb_value::kind_t::struct_vector:
+                this->pad_to(8, 4);
+                retval = this->e_buf.size();
+                this->put<uint32_t>(fv.v_count);
+                this->e_buf.append(fv.v_bytes);
+                break;
+            default:
+                ensure(false);
+                break;
+        }
+
+        return retval;
+    }
+
+    std::string e_buf;
+};
+
+enum class column_kind_t {
+    int64,
+    float64,
+    timestamp,
+    utf8,
+    dictionary,
+};
+
+struct sf_hash {
+    size_t operator()(const string_fragment &sf) const {
+        size_t retval = 14695981039346656037ULL;
+
+        for (int lpc = 0; lpc < sf.length(); lpc++) {
+            retval ^= (unsigned char) sf.data()[lpc];
+            retval *= 1099511628211ULL;
+        }
+
+        return retval;
+    }
+};
+
+struct column_plan {
+    column_kind_t cp_kind{column_kind_t::utf8};
+    std::vector<string_fragment> cp_dict_values;
+    std::unordered_map<string_fragment, int32_t, sf_hash> cp_dict_index;
+};
+
+/**
+ * Accumulates the buffers for a record batch and tracks their position in
+ * the message body.
+ */
+struct batch_body {
+    std::string bb_data;
+    std::vector<int64_t> bb_nodes;
+    std::vector<int64_t> bb_buffers;
+
+    void add_node(size_t length, size_t null_count) {
+        this->bb_nodes.push_back(length);
+        this->bb_nodes.push_back(null_count);
+    }
+
+    void add_buffer(const void *data, size_t len) {
+        this->bb_buffers.push_back(this->bb_data.size());
+        this->bb_buffers.push_back(len);
+        this->bb_data.append((const char *) data, len);
+        while ((this->bb_data.size() % 8) != 0) {
+            this->bb_data.push_back('\0');
+        }
+    }
+
+    void add_validity(const std::vector<uint8_t> &bits, size_t null_count) {
+        if (null_count == 0) {
+            this->add_buffer(nullptr, 0);
+        } else {
+            this->add_buffer(bits.data(), bits.size());
+        }
+    }
+};
+
+static bool is_null(const char *cell)
+{
+    return cell == db_label_source::NULL_STR;
+}
+
+static bool parse_int64(const char *cell, int64_t &value_out)
+{
+    char *end;
+
+    errno = 0;
+    value_out = strtoll(cell, &end, 10);
+
+    return errno == 0 && end != cell && *end == '\0';
+}
+
+static bool parse_float64(const char *cell, double &value_out)
+{
+    char *end;
+
+    value_out = strtod(cell, &end);
+
+    return end != cell && *end == '\0';
+}
+
+static bool parse_timestamp(date_time_scanner &dts,
+                            const char *cell,
+                            int64_t &value_out)
+{
+    struct exttm tm;
+    struct timeval tv;
+    auto len = strlen(cell);
+    auto *end = dts.scan(cell, len, nullptr, &tm, tv, false);
+
+    if (end == nullptr || end != cell + len) {
+        return false;
+    }
+
+    value_out = tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+    return true;
+}
+
+/**
+ * Check the values in a column to find the narrowest Arrow type that can
+ * hold all of them.
+ */
+static column_plan plan_column(const db_label_source &dls,
+                               size_t col,
+                               size_t row_count)
+{
+    const auto &hm = dls.dls_headers[col];
+    const auto &rows = dls.dls_rows;
+    column_plan retval;
+    bool all_int = hm.hm_column_type == SQLITE_INTEGER ||
+                   hm.hm_column_type == SQLITE_NULL;
+    bool all_float = all_int || hm.hm_column_type == SQLITE_FLOAT;
+    bool all_time = hm.hm_name == "log_time";
+    bool dictionary = hm.hm_column_type == SQLITE_TEXT &&
+                      hm.hm_sub_type == 0;
+    date_time_scanner dts;
+    size_t non_null = 0;
+
+    for (size_t row = 0; row < row_count; row++) {
+        const char *cell = rows.cell(row, col);
+
+        if (is_null(cell)) {
+            continue;
+        }
+
+        non_null += 1;
+        if (all_int) {
+            int64_t ival;
+
+            all_int = parse_int64(cell, ival);
+        }
+        if (all_float && !all_int) {
+            double dval;
+
+            all_float = parse_float64(cell, dval);
+        }
+        if (all_time) {
+            int64_t tval;
+
+            all_time = parse_timestamp(dts, cell, tval);
+        }
+        if (dictionary) {
+            string_fragment sf(cell, 0, strlen(cell));
+
+            if (retval.cp_dict_index.count(sf) == 0) {
+                if (retval.cp_dict_values.size() >= MAX_DICTIONARY_SIZE) {
+                    dictionary = false;
+                    retval.cp_dict_index.clear();
+                    retval.cp_dict_values.clear();
+                } else {
+                    retval.cp_dict_index[sf] = retval.cp_dict_values.size();
+                    retval.cp_dict_values.push_back(sf);
+                }
+            }
+        }
+    }
+
+    if (non_null == 0) {
+        // Nothing to check, so go with the type reported by SQLite.
+        all_time = false;
+        all_int = hm.hm_column_type == SQLITE_INTEGER;
+        all_float = hm.hm_column_type == SQLITE_FLOAT;
+        dictionary = false;
+    }
+
+    if (all_time) {
+        retval.cp_kind = column_kind_t::timestamp;
+    } else if (all_int) {
+        retval.cp_kind = column_kind_t::int64;
+    } else if (all_float) {
+        retval.cp_kind = column_kind_t::float64;
+    } else if (dictionary && retval.cp_dict_values.size() * 2 <= non_null) {
+        retval.cp_kind = column_kind_t::dictionary;
+    }
+    if (retval.cp_kind != column_kind_t::dictionary) {
+        retval.cp_dict_index.clear();
+        retval.cp_dict_values.clear();
+    }
+
+    return retval;
+}
+
+static std::shared_ptr<fb_table> int_type(int32_t bit_width)
+{
+    auto retval = std::make_shared<fb_table>();
+
+    retval->scalar<int32_t>(0, bit_width).scalar<uint8_t>(1, 1);
+
+    return retval;
+}
+
+static std::shared_ptr<fb_table> field_for(const std::string &name,
+                                           const column_plan &plan,
+                                           int64_t dict_id)
+{
+    auto retval = std::make_shared<fb_table>();
+    auto type = std::make_shared<fb_table>();
+    uint8_t type_type = TYPE_UTF8;
+
+    switch (plan.cp_kind) {
+        case column_kind_t::int64:
+            type = int_type(64);
+            type_type = TYPE_INT;
+            break;
+        case column_kind_t::float64:
+            type->scalar<int16_t>(0, PRECISION_DOUBLE);
+            type_type = TYPE_FLOATING_POINT;
+            break;
+        case column_kind_t::timestamp:
+            type->scalar<int16_t>(0, TIME_UNIT_MILLISECOND);
+            type_type = TYPE_TIMESTAMP;
+            break;
+        case column_kind_t::utf8:
+        case column_kind_t::dictionary:
+            break;
+    }
+
+    retval->string(0, name)
+        .scalar<uint8_t>(1, 1)
+        .scalar<uint8_t>(2, type_type)
+        .table(3, type)
+        .tables(5, {});
+    if (plan.cp_kind == column_kind_t::dictionary) {
+        auto encoding = std::make_shared<fb_table>();
+
+        encoding->scalar<int64_t>(0, dict_id).table(1, int_type(32));
+        retval->table(4, encoding);
+    }
+
+    return retval;
+}
+
+class stream_writer {
+public:
+    explicit stream_writer(FILE *out) : sw_out(out) {}
+
+    bool write_message(uint8_t header_type,
+                       std::shared_ptr<fb_table> header,
+                       const std::string &body) {
+        fb_table msg;
+
+        msg.scalar<int16_t>(0, METADATA_V5)
+            .scalar<uint8_t>(1, header_type)
+            .table(2, std::move(header))
+            .scalar<int64_t>(3, body.size());
+
+        auto meta = fb_encoder().encode(msg);
+        while (((meta.size() + 8) % 8) != 0) {
+            meta.push_back('\0');
+        }
+
+        int32_t meta_len = meta.size();
+
+        return this->write(&CONTINUATION_MARKER, sizeof(CONTINUATION_MARKER))
+               && this->write(&meta_len, sizeof(meta_len))
+               && this->write(meta.data(), meta.size())
+               && this->write(body.data(), body.size());
+    }
+
+    bool write_end() {
+        int32_t zero = 0;
+
+        return this->write(&CONTINUATION_MARKER, sizeof(CONTINUATION_MARKER))
+               && this->write(&zero, sizeof(zero));
+    }
+
+private:
+    bool write(const void *data, size_t len) {
+        return len == 0 || fwrite(data, 1, len, this->sw_out) == len;
+    }
+
+    FILE *sw_out;
+};
+
+static std::shared_ptr<fb_table> record_batch(size_t length,
+                                              const batch_body &bb)
+{
+    auto retval = std::make_shared<fb_table>();
+
+    retval->scalar<int64_t>(0, length)
+        .structs(1, bb.bb_nodes)
+        .structs(2, bb.bb_buffers);
+
+    return retval;
+}
+
+static void add_strings(batch_body &bb,
+                        const std::vector<string_fragment> &strs,
+                        const std::vector<uint8_t> &validity,
+                        size_t null_count)
+{
+    std::vector<int32_t> offsets;
+    size_t total = 0;
+
+    offsets.reserve(strs.size() + 1);
+    offsets.push_back(0);
+    for (const auto &sf : strs) {
+        total += sf.length();
+        offsets.push_back(total);
+    }
+
+    bb.add_node(strs.size(), null_count);
+    bb.add_validity(validity, null_count);
+    bb.add_buffer(offsets.data(), offsets.size() * sizeof(int32_t));
+    bb.bb_buffers.push_back(bb.bb_data.size());
+    bb.bb_buffers.push_back(total);
+    for (const auto &sf : strs) {
+        bb.bb_data.append(sf.data(), sf.length());
+    }
+    while ((bb.bb_data.size() % 8) != 0) {
+        bb.bb_data.push_back('\0');
+    }
+}
+
+static void add_column(batch_body &bb,
+                       const db_label_source &dls,
+                       size_t col,
+                       const column_plan &plan,
+                       size_t start,
+                       size_t end,
+                       date_time_scanner &dts)
+{
+    const auto &rows = dls.dls_rows;
+    size_t length = end - start;
+    std::vector<uint8_t> validity((length + 7) / 8, 0);
+    size_t null_count = 0;
+
+    for (size_t row = start; row < end; row++) {
+        if (is_null(rows.cell(row, col))) {
+            null_count += 1;
+        } else {
+            validity[(row - start) / 8] |= 1U << ((row - start) % 8);
+        }
+    }
+
+    switch (plan.cp_kind) {
+        case column_kind_t::int64:
+        case column_kind_t::timestamp: {
+            std::vector<int64_t> values(length, 0);
+
+            for (size_t row = start; row < end; row++) {
+                const char *cell = rows.cell(row, col);
+
+                if (is_null(cell)) {
+                    continue;
+                }
+                if (plan.cp_kind == column_kind_t::int64) {
+                    parse_int64(cell, values[row - start]);
+                } else {
+                    parse_timestamp(dts, cell, values[row - start]);
+                }
+            }
+            bb.add_node(length, null_count);
+            bb.add_validity(validity, null_count);
+            bb.add_buffer(values.data(), values.size() * sizeof(int64_t));
+            break;
+        }
+        case column_kind_t::float64: {
+            std::vector<double> values(length, 0.0);
+
+            for (size_t row = start; row < end; row++) {
+                const char *cell = rows.cell(row, col);
+
+                if (!is_null(cell)) {
+                    parse_float64(cell, values[row - start]);
+                }
+            }
+            bb.add_node(length, null_count);
+            bb.add_validity(validity, null_count);
+            bb.add_buffer(values.data(), values.size() * sizeof(double));
+            break;
+        }
+        case column_kind_t::dictionary: {
+            std::vector<int32_t> indexes(length, 0);
+
+            for (size_t row = start; row < end; row++) {
+                const char *cell = rows.cell(row, col);
+
+                if (!is_null(cell)) {
+                    string_fragment sf(cell, 0, strlen(cell));
+
+                    indexes[row - start] = plan.cp_dict_index.at(sf);
+                }
+            }
+            bb.add_node(length, null_count);
+            bb.add_validity(validity, null_count);
+            bb.add_buffer(indexes.data(), indexes.size() * sizeof(int32_t));
+            break;
+        }
+        case column_kind_t::utf8: {
+            std::vector<string_fragment> strs;
+
+            strs.reserve(length);
+            for (size_t row = start; row < end; row++) {
+                const char *cell = rows.cell(row, col);
+
+                if (is_null(cell)) {
+                    strs.emplace_back("", 0, 0);
+                } else {
+                    strs.emplace_back(cell, 0, strlen(cell));
+                }
+            }
+            add_strings(bb, strs, validity, null_count);
+            break;
+        }
+    }
+}
+
+Result<size_t, std::string> write_results(FILE *out,
+                                          const db_label_source &dls,
+                                          size_t max_rows)
+{
+    auto row_count = std::min(dls.dls_rows.size(), max_rows);
+    auto col_count = dls.dls_headers.size();
+    std::vector<column_plan> plans;
+    std::vector<std::shared_ptr<fb_table>> fields;
+    stream_writer sw(out);
+
+    for (size_t col = 0; col < col_count; col++) {
+        plans.emplace_back(plan_column(dls, col, row_count));
+        fields.emplace_back(
+            field_for(dls.dls_headers[col].hm_name, plans.back(), col));
+    }
+
+    uint16_t probe = 1;
+    auto schema = std::make_shared<fb_table>();
+
+    schema->scalar<int16_t>(0, *((uint8_t *) &probe) == 1 ? 0 : 1)
+        .tables(1, std::move(fields));
+    if (!sw.write_message(HEADER_SCHEMA, schema, "")) {
+        return Err(std::string(strerror(errno)));
+    }
+
+    for (size_t col = 0; col < col_count; col++) {
+        const auto &plan = plans[col];
+
+        if (plan.cp_kind != column_kind_t::dictionary) {
+            continue;
+        }
+
+        batch_body bb;
+        std::vector<uint8_t> validity;
+
+        add_strings(bb, plan.cp_dict_values, validity, 0);
+
+        auto dict_batch = std::make_shared<fb_table>();
+
+        dict_batch->scalar<int64_t>(0, col)
+            .table(1, record_batch(plan.cp_dict_values.size(), bb));
+        if (!sw.write_message(HEADER_DICTIONARY_BATCH, dict_batch,
+                              bb.bb_data)) {
+            return Err(std::string(strerror(errno)));
+        }
+    }
+
+    date_time_scanner dts;
+
+    for (size_t start = 0; start < row_count; start += BATCH_ROWS) {
+        auto end = std::min(start + BATCH_ROWS, row_count);
+        batch_body bb;
+
+        for (size_t col = 0; col < col_count; col++) {
+            add_column(bb, dls, col, plans[col], start, end, dts);
+        }
+        if (!sw.write_message(HEADER_RECORD_BATCH,
+                              record_batch(end - start, bb),
+                              bb.bb_data)) {
+            return Err(std::string(strerror(errno)));
+        }
+    }
+
+    if (!sw.write_end()) {
+        return Err(std::string(strerror(errno)));
+    }
+
+    return Ok(row_count);
+}
+
+}
+}
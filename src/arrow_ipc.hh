@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file arrow_ipc.hh
+ */
+
+#ifndef lnav_arrow_ipc_hh
+#define lnav_arrow_ipc_hh
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "base/result.h"
+
+class db_label_source;
+
+namespace lnav {
+namespace arrow_ipc {
+
+/**
+ * Write the results of a SQL query to a file using the Apache Arrow IPC
+ * streaming format.  The type of each column is picked from the SQLite
+ * type of its values: integers, reals, log timestamps, and text.  Text
+ * columns with only a few distinct values are dictionary-encoded.
+ *
+ * @param out The file to write to.
+ * @param dls The query results.
+ * @param max_rows The maximum number of rows to write.
+ * @return The number of rows written.
+ */
+Result<size_t, std::string> write_results(FILE *out,
+                                          const db_label_source &dls,
+                                          size_t max_rows = SIZE_MAX);
+
+}
+}
+
+#endif
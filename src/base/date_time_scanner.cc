@@ -32,6 +32,7 @@
 #include "config.h"
 
 #include "date_time_scanner.hh"
+#include "perf_counters.hh"
 #include "ptimec.hh"
 
 size_t date_time_scanner::ftime(char *dst, size_t len, const exttm &tm) const
@@ -70,6 +71,7 @@ const char *date_time_scanner::scan(const char *time_dest,
                                     struct timeval &tv_out,
                                     bool convert_local)
 {
+    lnav::perf::timer perf_timer(lnav::perf::phase_t::timestamp_parse);
     int  curr_time_fmt = -1;
     bool found         = false;
     const char *retval = nullptr;
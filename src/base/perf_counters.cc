@@ -0,0 +1,228 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "perf_counters.hh"
+
+namespace lnav {
+namespace perf {
+
+namespace {
+
+struct counter {
+    std::atomic<uint64_t> c_calls{0};
+    std::atomic<uint64_t> c_total_ns{0};
+    std::atomic<uint64_t> c_max_ns{0};
+    std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS> c_histogram{};
+
+    void add_to(summary &sum) const
+    {
+        sum.s_calls += this->c_calls.load(std::memory_order_relaxed);
+        sum.s_total_ns += this->c_total_ns.load(std::memory_order_relaxed);
+        sum.s_max_ns = std::max(
+            sum.s_max_ns, this->c_max_ns.load(std::memory_order_relaxed));
+        for (size_t lpc = 0; lpc < HISTOGRAM_BUCKETS; lpc++) {
+            sum.s_histogram[lpc] +=
+                this->c_histogram[lpc].load(std::memory_order_relaxed);
+        }
+    }
+
+    void clear()
+    {
+        this->c_calls.store(0, std::memory_order_relaxed);
+        this->c_total_ns.store(0, std::memory_order_relaxed);
+        this->c_max_ns.store(0, std::memory_order_relaxed);
+        for (auto &bucket : this->c_histogram) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+struct thread_counters;
+
+/**
+ * The counters for the threads that are still running and the totals for
+ * the threads that have exited.
+ */
+struct registry {
+    std::mutex r_mutex;
+    std::vector<thread_counters *> r_threads;
+    std::array<summary, PHASE_COUNT> r_retired;
+};
+
+registry &get_registry()
+{
+    // Leaked so that it is still around when threads exit during shutdown.
+    static auto *retval = new registry();
+
+    return *retval;
+}
+
+/**
+ * The counters are kept per-thread so that recording a call does not
+ * contend with other threads.  The atomics are only there so that the
+ * values can be read safely by collect().
+ */
+struct thread_counters {
+    std::array<counter, PHASE_COUNT> tc_counters;
+
+    thread_counters()
+    {
+        auto &reg = get_registry();
+        std::lock_guard<std::mutex> lg(reg.r_mutex);
+
+        reg.r_threads.push_back(this);
+    }
+
+    ~thread_counters()
+    {
+        auto &reg = get_registry();
+        std::lock_guard<std::mutex> lg(reg.r_mutex);
+
+        for (size_t lpc = 0; lpc < PHASE_COUNT; lpc++) {
+            this->tc_counters[lpc].add_to(reg.r_retired[lpc]);
+        }
+        reg.r_threads.erase(std::remove(reg.r_threads.begin(),
+                                        reg.r_threads.end(),
+                                        this),
+                            reg.r_threads.end());
+    }
+};
+
+thread_local thread_counters THREAD_COUNTERS;
+
+}
+
+const char *phase_name(phase_t phase)
+{
+    switch (phase) {
+        case phase_t::line_buffer_fill:
+            return "line_buffer_fill";
+        case phase_t::format_scan:
+            return "format_scan";
+        case phase_t::timestamp_parse:
+            return "timestamp_parse";
+        case phase_t::filter_eval:
+            return "filter_eval";
+        case phase_t::kmerge:
+            return "kmerge";
+        case phase_t::render:
+            return "render";
+        case phase_t::grep:
+            return "grep";
+        case phase_t::vtab_next:
+            return "vtab_next";
+        case phase_t::vtab_column:
+            return "vtab_column";
+        case phase_t::regex_cache_hit:
+            return "regex_cache_hit";
+        case phase_t::regex_cache_miss:
+            return "regex_cache_miss";
+        case phase_t::regex_cache_evict:
+            return "regex_cache_evict";
+    }
+
+    return "unknown";
+}
+
+uint64_t summary::percentile_ns(double fraction) const
+{
+    if (this->s_calls == 0) {
+        return 0;
+    }
+
+    auto target = (uint64_t) (fraction * this->s_calls);
+    uint64_t seen = 0;
+
+    if (target == 0) {
+        target = 1;
+    }
+    for (size_t lpc = 0; lpc < HISTOGRAM_BUCKETS; lpc++) {
+        seen += this->s_histogram[lpc];
+        if (seen >= target) {
+            return std::min(this->s_max_ns, (uint64_t) 2 << lpc);
+        }
+    }
+
+    return this->s_max_ns;
+}
+
+void record(phase_t phase, uint64_t duration_ns)
+{
+    auto &ctr = THREAD_COUNTERS.tc_counters[(size_t) phase];
+    size_t bucket = 0;
+
+    if (duration_ns > 0) {
+        bucket = std::min(HISTOGRAM_BUCKETS - 1,
+                          (size_t) (63 - __builtin_clzll(duration_ns)));
+    }
+
+    ctr.c_calls.fetch_add(1, std::memory_order_relaxed);
+    ctr.c_total_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+    if (duration_ns > ctr.c_max_ns.load(std::memory_order_relaxed)) {
+        ctr.c_max_ns.store(duration_ns, std::memory_order_relaxed);
+    }
+    ctr.c_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::array<summary, PHASE_COUNT> collect()
+{
+    auto &reg = get_registry();
+    std::lock_guard<std::mutex> lg(reg.r_mutex);
+    auto retval = reg.r_retired;
+
+    for (const auto *tc : reg.r_threads) {
+        for (size_t lpc = 0; lpc < PHASE_COUNT; lpc++) {
+            tc->tc_counters[lpc].add_to(retval[lpc]);
+        }
+    }
+
+    return retval;
+}
+
+void reset()
+{
+    auto &reg = get_registry();
+    std::lock_guard<std::mutex> lg(reg.r_mutex);
+
+    reg.r_retired = {};
+    for (auto *tc : reg.r_threads) {
+        for (auto &ctr : tc->tc_counters) {
+            ctr.clear();
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file perf_counters.hh
+ */
+
+#ifndef lnav_perf_counters_hh
+#define lnav_perf_counters_hh
+
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+namespace lnav {
+namespace perf {
+
+/**
+ * The phases of processing that are timed.  The timings are inclusive, so
+ * a phase that runs inside of another, like a timestamp parse during a
+ * format scan, is counted in both.  The regex cache phases count the
+ * lookups in the cache of regular expressions used by SQL functions, only
+ * a miss is timed since it includes compiling the pattern.
+ */
+enum class phase_t : uint8_t {
+    line_buffer_fill,
+    format_scan,
+    timestamp_parse,
+    filter_eval,
+    kmerge,
+    render,
+    grep,
+    vtab_next,
+    vtab_column,
+    regex_cache_hit,
+    regex_cache_miss,
+    regex_cache_evict,
+};
+
+constexpr size_t PHASE_COUNT = (size_t) phase_t::regex_cache_evict + 1;
+
+/**
+ * The number of buckets in the histogram of durations.  Bucket N counts
+ * the calls that took between 2^N and 2^(N+1) nanoseconds.
+ */
+constexpr size_t HISTOGRAM_BUCKETS = 40;
+
+const char *phase_name(phase_t phase);
+
+/**
+ * A totalled up copy of the counters for a phase.
+ */
+struct summary {
+    uint64_t s_calls{0};
+    uint64_t s_total_ns{0};
+    uint64_t s_max_ns{0};
+    std::array<uint64_t, HISTOGRAM_BUCKETS> s_histogram{};
+
+    /**
+     * @param fraction The percentile to compute, between 0.0 and 1.0.
+     * @return An estimate of the duration in nanoseconds, the upper bound
+     *   of the histogram bucket that contains the percentile.
+     */
+    uint64_t percentile_ns(double fraction) const;
+};
+
+/**
+ * Add the duration of a call to the counters of the current thread.
+ */
+void record(phase_t phase, uint64_t duration_ns);
+
+/**
+ * @return The counters for each phase summed over all of the threads.
+ */
+std::array<summary, PHASE_COUNT> collect();
+
+/**
+ * Zero out the counters for all of the threads.
+ */
+void reset();
+
+/**
+ * Records the time between construction and destruction as a call to the
+ * given phase.
+ */
+class timer {
+public:
+    explicit timer(phase_t phase)
+        : t_phase(phase), t_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    timer(const timer &) = delete;
+
+    timer &operator=(const timer &) = delete;
+
+    ~timer()
+    {
+        auto diff = std::chrono::steady_clock::now() - this->t_start;
+
+        record(this->t_phase,
+               std::chrono::duration_cast<std::chrono::nanoseconds>(diff)
+                   .count());
+    }
+
+private:
+    phase_t t_phase;
+    std::chrono::steady_clock::time_point t_start;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <string>
+#include <thread>
+
+#include "doctest/doctest.h"
+
+#include "perf_counters.hh"
+
+using namespace lnav::perf;
+
+TEST_CASE("perf counters")
+{
+    reset();
+
+    record(phase_t::format_scan, 100);
+    record(phase_t::format_scan, 1000);
+    record(phase_t::format_scan, 1000000);
+
+    std::thread other([]() {
+        record(phase_t::format_scan, 10);
+        record(phase_t::kmerge, 5);
+    });
+    other.join();
+
+    auto sums = collect();
+    const auto &scan = sums[(size_t) phase_t::format_scan];
+
+    CHECK(scan.s_calls == 4);
+    CHECK(scan.s_total_ns == 1001110);
+    CHECK(scan.s_max_ns == 1000000);
+    CHECK(scan.percentile_ns(0.25) == 16);
+    CHECK(scan.percentile_ns(0.5) == 128);
+    CHECK(scan.percentile_ns(1.0) == 1000000);
+    CHECK(sums[(size_t) phase_t::kmerge].s_calls == 1);
+    CHECK(sums[(size_t) phase_t::grep].s_calls == 0);
+    CHECK(sums[(size_t) phase_t::grep].percentile_ns(0.5) == 0);
+
+    {
+        timer t(phase_t::render);
+    }
+    CHECK(collect()[(size_t) phase_t::render].s_calls == 1);
+
+    CHECK(std::string(phase_name(phase_t::vtab_column)) == "vtab_column");
+
+    reset();
+    sums = collect();
+    CHECK(sums[(size_t) phase_t::format_scan].s_calls == 0);
+    CHECK(sums[(size_t) phase_t::kmerge].s_calls == 0);
+}
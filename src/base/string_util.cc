@@ -218,6 +218,35 @@ std::string center_str(const std::string &subject, size_t width)
     return retval;
 }
 
+bool csv_needs_quoting(const std::string &str)
+{
+    return (str.find_first_of(",\"\r\n") != std::string::npos);
+}
+
+std::string csv_quote_string(const std::string &str)
+{
+    static const std::regex csv_column_quoter("\"");
+
+    std::string retval = std::regex_replace(str, csv_column_quoter, "\"\"");
+
+    retval.insert(0, 1, '\"');
+    retval.append(1, '\"');
+
+    return retval;
+}
+
+void csv_write_string(FILE *outfile, const std::string &str)
+{
+    if (csv_needs_quoting(str)) {
+        std::string quoted_str = csv_quote_string(str);
+
+        fprintf(outfile, "%s", quoted_str.c_str());
+    }
+    else {
+        fprintf(outfile, "%s", str.c_str());
+    }
+}
+
 template<typename T>
 size_t strtonum(T &num_out, const char *string, size_t len)
 {
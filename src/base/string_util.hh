@@ -30,6 +30,7 @@
 #ifndef lnav_string_util_hh
 #define lnav_string_util_hh
 
+#include <stdio.h>
 #include <string.h>
 #include <string>
 #include <vector>
@@ -176,6 +177,12 @@ std::string repeat(const std::string& input, size_t num);
 
 std::string center_str(const std::string& subject, size_t width);
 
+bool csv_needs_quoting(const std::string &str);
+
+std::string csv_quote_string(const std::string &str);
+
+void csv_write_string(FILE *outfile, const std::string &str);
+
 template<typename T>
 size_t strtonum(T &num_out, const char *data, size_t len);
 
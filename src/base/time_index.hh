@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file time_index.hh
+ */
+
+#ifndef lnav_time_index_hh
+#define lnav_time_index_hh
+
+#include <sys/time.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "time_util.hh"
+
+/**
+ * A sparse index over a time-ordered sequence of rows.  The time of every
+ * STRIDE'th row is copied into a compact array so that a search for a
+ * time can be narrowed down to a single stride before the rows
+ * themselves are touched.  The owner is responsible for calling
+ * truncate() or clear() when rows are removed or their times change.
+ */
+class time_index {
+public:
+    static constexpr size_t STRIDE = 4096;
+
+    void clear()
+    {
+        this->ti_samples.clear();
+    }
+
+    /**
+     * Drop the samples for any rows at or after the given row.
+     */
+    void truncate(size_t rows)
+    {
+        auto keep = (rows + STRIDE - 1) / STRIDE;
+
+        if (keep < this->ti_samples.size()) {
+            this->ti_samples.resize(keep);
+        }
+    }
+
+    /**
+     * Add samples for the rows that have been appended since the last call.
+     *
+     * @param rows The current number of rows.
+     * @param time_for_row A function that returns the time of a row.
+     */
+    template<typename F>
+    void extend(size_t rows, F time_for_row)
+    {
+        for (auto row = this->ti_samples.size() * STRIDE;
+             row < rows;
+             row += STRIDE) {
+            this->ti_samples.emplace_back(time_for_row(row));
+        }
+    }
+
+    /**
+     * Find the range of rows that could contain the first row whose time is
+     * not less than the given time.  If all of the rows in the range are
+     * less than the time, the answer is the end of the range.
+     *
+     * @param tv The time to search for.
+     * @param rows The current number of rows, extend() must have been called
+     *   with this value.
+     * @return The half-open range of rows to search.
+     */
+    std::pair<size_t, size_t> narrow(const struct timeval &tv,
+                                     size_t rows) const
+    {
+        // Log lines only have millisecond precision, so the search time
+        // needs to be truncated to match the comparison done on them.
+        struct timeval tv_ms = {tv.tv_sec, (tv.tv_usec / 1000) * 1000};
+        auto iter = std::lower_bound(this->ti_samples.begin(),
+                                     this->ti_samples.end(),
+                                     tv_ms);
+        size_t index = std::distance(this->ti_samples.begin(), iter);
+
+        if (index == 0) {
+            return {0, 0};
+        }
+
+        size_t low = (index - 1) * STRIDE + 1;
+        size_t high = iter == this->ti_samples.end() ?
+            rows : index * STRIDE;
+
+        return {std::min(low, rows), std::min(high, rows)};
+    }
+
+    size_t size() const
+    {
+        return this->ti_samples.size();
+    }
+
+private:
+    std::vector<struct timeval> ti_samples;
+};
+
+#endif
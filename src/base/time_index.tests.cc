@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <vector>
+
+#include "doctest/doctest.h"
+
+#include "time_index.hh"
+
+TEST_CASE("time_index")
+{
+    std::vector<struct timeval> rows;
+
+    for (size_t lpc = 0; lpc < time_index::STRIDE * 3 + 10; lpc++) {
+        rows.push_back({(time_t) (1000 + lpc / 2), 0});
+    }
+
+    auto time_for_row = [&rows](size_t row) { return rows[row]; };
+    auto find = [&rows](const time_index &ti, const struct timeval &tv) {
+        auto range = ti.narrow(tv, rows.size());
+        auto iter = std::lower_bound(rows.begin() + range.first,
+                                     rows.begin() + range.second,
+                                     tv);
+
+        return std::distance(rows.begin(), iter);
+    };
+    auto expected = [&rows](const struct timeval &tv) {
+        return std::distance(rows.begin(),
+                             std::lower_bound(rows.begin(), rows.end(), tv));
+    };
+
+    time_index ti;
+
+    ti.extend(rows.size(), time_for_row);
+    CHECK(ti.size() == 4);
+
+    for (time_t sec = 990; sec < 1000 + (time_t) rows.size(); sec += 7) {
+        struct timeval tv = {sec, 0};
+
+        CHECK(find(ti, tv) == expected(tv));
+    }
+
+    struct timeval last = {(time_t) (1000 + rows.size()), 0};
+    CHECK(find(ti, last) == (ssize_t) rows.size());
+
+    rows.resize(time_index::STRIDE + 1);
+    ti.truncate(rows.size());
+    CHECK(ti.size() == 2);
+    ti.truncate(time_index::STRIDE);
+    CHECK(ti.size() == 1);
+    ti.extend(rows.size(), time_for_row);
+    CHECK(ti.size() == 2);
+
+    ti.clear();
+    CHECK(ti.size() == 0);
+}
@@ -35,6 +35,7 @@
 #include <sys/mman.h>
 
 #include "base/math_util.hh"
+#include "memory_budget.hh"
 
 template<typename T>
 struct big_array {
@@ -50,18 +51,31 @@ struct big_array {
         }
 
         if (this->ba_ptr) {
-            munmap(this->ba_ptr,
-                   roundup_size(this->ba_capacity * sizeof(T), getpagesize()));
+            auto old_size = roundup_size(this->ba_capacity * sizeof(T),
+                                         getpagesize());
+
+            if (!lnav::memory::unmap_spillable(this->ba_ptr, old_size)) {
+                munmap(this->ba_ptr, old_size);
+            }
         }
 
         this->ba_capacity = size + DEFAULT_INCREMENT;
-        void *result = mmap(nullptr,
-                            roundup_size(this->ba_capacity * sizeof(T),
-                                         getpagesize()),
-                            PROT_READ|PROT_WRITE,
-                            MAP_ANONYMOUS|MAP_PRIVATE,
-                            -1,
-                            0);
+
+        auto map_size = roundup_size(this->ba_capacity * sizeof(T),
+                                     getpagesize());
+        void *result = nullptr;
+
+        if (map_size >= lnav::memory::MIN_SPILL_SIZE) {
+            result = lnav::memory::map_spillable(map_size);
+        }
+        if (result == nullptr) {
+            result = mmap(nullptr,
+                          map_size,
+                          PROT_READ|PROT_WRITE,
+                          MAP_ANONYMOUS|MAP_PRIVATE,
+                          -1,
+                          0);
+        }
 
         ensure(result != MAP_FAILED);
 
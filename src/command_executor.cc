@@ -45,6 +45,7 @@
 
 #include "command_executor.hh"
 #include "db_sub_source.hh"
+#include "log_vtab_partition.hh"
 #include "papertrail_proc.hh"
 
 using namespace std;
@@ -128,6 +129,8 @@ Result<string, string> execute_command(exec_context &ec, const string &cmdline)
 Result<string, string> execute_sql(exec_context &ec, const string &sql, string &alt_msg)
 {
     db_label_source &dls = lnav_data.ld_db_row_source;
+    // The partial results have to outlive the statement that reads them.
+    std::unique_ptr<partitioned_query> partitioned;
     auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
     struct timeval start_tv, end_tv;
     string stmt_str = trim(sql);
@@ -189,6 +192,35 @@ Result<string, string> execute_sql(exec_context &ec, const string &sql, string &
         int param_count;
 
         param_count = sqlite3_bind_parameter_count(stmt.in());
+        if (param_count == 0 && !ec.ec_dry_run) {
+            partitioned = partitioned_query::analyze(
+                *lnav_data.ld_vtab_manager, stmt_str);
+        }
+        if (partitioned) {
+            auto run_res = partitioned->run(lnav_data.ld_db.in());
+
+            if (run_res.isOk()) {
+                auto merge_sql = run_res.unwrap();
+                auto_mem<sqlite3_stmt> merge_stmt(sqlite3_finalize);
+
+                retcode = sqlite3_prepare_v2(lnav_data.ld_db.in(),
+                                             merge_sql.c_str(),
+                                             -1,
+                                             merge_stmt.out(),
+                                             nullptr);
+                if (retcode == SQLITE_OK) {
+                    stmt = std::move(merge_stmt);
+                } else {
+                    log_error("unable to prepare merge statement: %s",
+                              sqlite3_errmsg(lnav_data.ld_db));
+                }
+            } else if (partitioned->is_interrupted()) {
+                return ec.make_error("{}", run_res.unwrapErr());
+            } else {
+                log_warning("partitioned query failed, running serially: %s",
+                            run_res.unwrapErr().c_str());
+            }
+        }
         for (int lpc = 0; lpc < param_count; lpc++) {
             map<string, string>::iterator ov_iter;
             const char *name;
@@ -352,7 +384,7 @@ Result<string, string> execute_sql(exec_context &ec, const string &sql, string &
                 alt_msg = "";
             }
             else if (dls.dls_rows.size() == 1) {
-                auto &row = dls.dls_rows[0];
+                auto row = dls.dls_rows[0];
 
                 if (dls.dls_headers.size() == 1) {
                     retval = row[0];
@@ -647,6 +679,82 @@ Result<string, string> execute_any(exec_context &ec, const string &cmdline_with_
     return Ok(retval);
 }
 
+/** The number of rows written by headless_csv_callback() for a query. */
+static size_t headless_csv_rows = 0;
+
+/**
+ * Write the rows of a query to the output as CSV as soon as they are
+ * produced, instead of collecting them in the DB view.  The output is the
+ * same as running ":write-csv-to -" after the query.
+ */
+static int headless_csv_callback(exec_context &ec, sqlite3_stmt *stmt)
+{
+    if (!sqlite3_stmt_busy(stmt)) {
+        lnav_data.ld_db_row_source.clear();
+        headless_csv_rows = 0;
+
+        return 0;
+    }
+
+    auto *outfile = ec.get_output().value_or(stdout);
+    int ncols = sqlite3_column_count(stmt);
+
+    if (headless_csv_rows == 0) {
+        for (int lpc = 0; lpc < ncols; lpc++) {
+            if (lpc > 0) {
+                fprintf(outfile, ",");
+            }
+            csv_write_string(outfile, sqlite3_column_name(stmt, lpc));
+        }
+        fprintf(outfile, "\n");
+        if (outfile == stdout) {
+            lnav_data.ld_stdout_used = true;
+        }
+    }
+
+    for (int lpc = 0; lpc < ncols; lpc++) {
+        const auto *value = (const char *) sqlite3_column_text(stmt, lpc);
+
+        if (lpc > 0) {
+            fprintf(outfile, ",");
+        }
+        csv_write_string(outfile,
+                         value == nullptr ? db_label_source::NULL_STR : value);
+    }
+    fprintf(outfile, "\n");
+    headless_csv_rows += 1;
+
+    return 0;
+}
+
+/**
+ * Find a query whose results can be streamed to the output in headless
+ * mode.  That is the case when the query is followed by ":write-csv-to -"
+ * as the last two commands, since nothing else can look at the results.
+ *
+ * @return The query command or nullptr if there is none.
+ */
+static const string *find_headless_csv_query()
+{
+    const auto &cmds = lnav_data.ld_commands;
+
+    if (!(lnav_data.ld_flags & LNF_HEADLESS) || cmds.size() < 2) {
+        return nullptr;
+    }
+
+    auto cmd_iter = cmds.rbegin();
+
+    if (trim(*cmd_iter) != ":write-csv-to -") {
+        return nullptr;
+    }
+    ++cmd_iter;
+    if (!startswith(*cmd_iter, ";")) {
+        return nullptr;
+    }
+
+    return &(*cmd_iter);
+}
+
 void execute_init_commands(exec_context &ec, vector<pair<Result<string, string>, string> > &msgs)
 {
     if (lnav_data.ld_cmd_init_done) {
@@ -655,6 +763,8 @@ void execute_init_commands(exec_context &ec, vector<pair<Result<string, string>,
 
     db_label_source &dls = lnav_data.ld_db_row_source;
     int option_index = 1;
+    const auto *csv_query = find_headless_csv_query();
+    bool csv_streamed = false;
 
     log_info("Executing initial commands");
     for (auto &cmd : lnav_data.ld_commands) {
@@ -665,7 +775,14 @@ void execute_init_commands(exec_context &ec, vector<pair<Result<string, string>,
         ec.ec_source.emplace("command-option", option_index++);
         switch (cmd.at(0)) {
         case ':':
-            msgs.emplace_back(execute_command(ec, cmd.substr(1)), alt_msg);
+            if (csv_streamed && &cmd == &lnav_data.ld_commands.back()) {
+                msgs.emplace_back(
+                    Ok("info: Wrote " + to_string(headless_csv_rows) +
+                       " rows to -"),
+                    alt_msg);
+            } else {
+                msgs.emplace_back(execute_command(ec, cmd.substr(1)), alt_msg);
+            }
             break;
         case '/':
             lnav_data.ld_view_stack.top() | [cmd] (auto tc) {
@@ -674,7 +791,25 @@ void execute_init_commands(exec_context &ec, vector<pair<Result<string, string>,
             break;
         case ';':
             setup_logline_table(ec);
-            msgs.emplace_back(execute_sql(ec, cmd.substr(1), alt_msg), alt_msg);
+            if (&cmd == csv_query) {
+                log_info("streaming the query results to the output");
+                auto old_callback = std::exchange(ec.ec_sql_callback,
+                                                  headless_csv_callback);
+                auto sql_res = execute_sql(ec, cmd.substr(1), alt_msg);
+
+                ec.ec_sql_callback = old_callback;
+                // Without any rows, the ":write-csv-to" is run as usual so
+                // that it reports the missing result.
+                csv_streamed = headless_csv_rows > 0;
+                if (csv_streamed && sql_res.isOk()) {
+                    msgs.emplace_back(Ok(string()), alt_msg);
+                } else {
+                    msgs.emplace_back(std::move(sql_res), alt_msg);
+                }
+            } else {
+                msgs.emplace_back(execute_sql(ec, cmd.substr(1), alt_msg),
+                                  alt_msg);
+            }
             break;
         case '|':
             msgs.emplace_back(execute_file(ec, cmd.substr(1)), alt_msg);
@@ -710,6 +845,39 @@ void execute_init_commands(exec_context &ec, vector<pair<Result<string, string>,
     lnav_data.ld_cmd_init_done = true;
 }
 
+/**
+ * Show the rows that have been fetched so far while an interactive query is
+ * still running instead of waiting for it to finish.
+ */
+static void sql_stream_rows(exec_context &ec)
+{
+    static sig_atomic_t stream_counter = 0;
+
+    auto &dls = lnav_data.ld_db_row_source;
+
+    if (lnav_data.ld_window == nullptr || !lnav_data.ld_looping ||
+        (lnav_data.ld_flags & LNF_HEADLESS) || ec.ec_dry_run ||
+        ec.ec_source.size() > 1 || dls.dls_rows.size() < 2) {
+        return;
+    }
+
+    if (!ui_periodic_timer::singleton().time_to_update(stream_counter)) {
+        return;
+    }
+
+    auto &db_tc = lnav_data.ld_views[LNV_DB];
+
+    // This runs from inside sqlite3_step(), so nothing here may go back into
+    // sqlite or change the row source.  The DB view has no delegate and its
+    // sources only read the rows already stored in dls, and the view-stack
+    // and scroll listeners triggered by ensure_view() and reload_data() only
+    // refresh the status bars, the same as sql_progress() does.
+    ensure_view(&db_tc);
+    db_tc.reload_data();
+    db_tc.do_update();
+    refresh();
+}
+
 int sql_callback(exec_context &ec, sqlite3_stmt *stmt)
 {
     auto &dls = lnav_data.ld_db_row_source;
@@ -723,11 +891,9 @@ int sql_callback(exec_context &ec, sqlite3_stmt *stmt)
     stacked_bar_chart<std::string> &chart = dls.dls_chart;
     view_colors &vc = view_colors::singleton();
     int ncols = sqlite3_column_count(stmt);
-    int row_number;
     int lpc, retval = 0;
 
-    row_number = dls.dls_rows.size();
-    dls.dls_rows.resize(row_number + 1);
+    dls.dls_rows.push_row();
     if (dls.dls_headers.empty()) {
         for (lpc = 0; lpc < ncols; lpc++) {
             int    type    = sqlite3_column_type(stmt, lpc);
@@ -764,6 +930,8 @@ int sql_callback(exec_context &ec, sqlite3_stmt *stmt)
         }
     }
 
+    sql_stream_rows(ec);
+
     return retval;
 }
 
@@ -790,7 +958,7 @@ future<string> pipe_callback(exec_context &ec, const string &cmdline, auto_fd &f
         });
     } else {
         auto pp = make_shared<piper_proc>(
-            fd, false, open_temp_file(ghc::filesystem::temp_directory_path() /
+            fd, open_temp_file(ghc::filesystem::temp_directory_path() /
             "lnav.out.XXXXXX")
                 .map([](auto pair) {
                     ghc::filesystem::remove(pair.first);
@@ -29,18 +29,216 @@
 
 #include "config.h"
 
+#include <cmath>
 #include <regex>
 
+#include <sys/mman.h>
+
 #include "base/date_time_scanner.hh"
+#include "base/injector.hh"
+#include "base/lnav_log.hh"
+#include "base/math_util.hh"
 #include "base/time_util.hh"
 
 #include "yajlpp/json_ptr.hh"
+#include "lnav_util.hh"
 #include "db_sub_source.hh"
+#include "db_sub_source.cfg.hh"
 
 const char *db_label_source::NULL_STR = "<NULL>";
 
 constexpr size_t MAX_COLUMN_WIDTH = 120;
 
+const size_t db_result_store::BLOCK_SIZE;
+const uint64_t db_result_store::NULL_CELL;
+
+void db_result_store::add_column(bool numeric)
+{
+    this->drs_columns.emplace_back();
+    this->drs_columns.back().c_numeric = numeric;
+}
+
+void db_result_store::push_row()
+{
+    this->drs_row_count += 1;
+    this->drs_pending_column = 0;
+}
+
+const char *db_result_store::push_cell(const char *value)
+{
+    auto &col = this->drs_columns[this->drs_pending_column];
+    const char *retval = db_label_source::NULL_STR;
+
+    this->drs_pending_column += 1;
+    if (value == nullptr) {
+        col.c_cells.push_back(NULL_CELL);
+    } else {
+        auto ref = this->store_text(value, strlen(value));
+        auto &blk = this->drs_blocks[ref >> 32];
+
+        retval = &blk.b_data[ref & 0xffffffff];
+        col.c_cells.push_back(ref);
+    }
+
+    if (col.c_numeric) {
+        double num_value = NAN;
+
+        if (value != nullptr) {
+            char *end;
+
+            num_value = strtod(value, &end);
+            if (end == value) {
+                num_value = NAN;
+            }
+        }
+        col.c_numbers.push_back(num_value);
+    }
+
+    return retval;
+}
+
+const char *db_result_store::cell(size_t row, size_t col) const
+{
+    const auto &cells = this->drs_columns[col].c_cells;
+
+    if (row >= cells.size() || cells[row] == NULL_CELL) {
+        return db_label_source::NULL_STR;
+    }
+
+    auto ref = cells[row];
+
+    return &this->drs_blocks[ref >> 32].b_data[ref & 0xffffffff];
+}
+
+double db_result_store::number(size_t row, size_t col) const
+{
+    const auto &numbers = this->drs_columns[col].c_numbers;
+
+    if (row >= numbers.size()) {
+        return NAN;
+    }
+
+    return numbers[row];
+}
+
+uint64_t db_result_store::store_text(const char *value, size_t len)
+{
+    if (this->drs_blocks.empty() ||
+        (this->drs_blocks.back().b_capacity -
+         this->drs_blocks.back().b_used) < (len + 1)) {
+        auto capacity = roundup_size(len + 1, BLOCK_SIZE);
+        // Blocks are mapped, instead of malloc'd, so that a spilled block
+        // can be remapped from the file at the same address.
+        void *data = mmap(nullptr,
+                          capacity,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS,
+                          -1,
+                          0);
+
+        if (data == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        this->drs_blocks.push_back(block{(char *) data, capacity, 0, false});
+        this->drs_resident_size += capacity;
+        this->spill_blocks();
+    }
+
+    auto &blk = this->drs_blocks.back();
+    uint64_t retval = ((uint64_t) (this->drs_blocks.size() - 1)) << 32 |
+                      blk.b_used;
+
+    memcpy(&blk.b_data[blk.b_used], value, len + 1);
+    blk.b_used += len + 1;
+
+    return retval;
+}
+
+void db_result_store::spill_blocks()
+{
+    auto &cfg = injector::get<const db_sub_source::config &>();
+
+    if (this->drs_spill_failed ||
+        this->drs_resident_size <= (size_t) cfg.dsc_max_resident_size) {
+        return;
+    }
+
+    if (this->drs_spill_fd == -1) {
+        auto open_res = open_temp_file(
+            ghc::filesystem::temp_directory_path() / "lnav.db.XXXXXX");
+
+        if (open_res.isErr()) {
+            log_error("unable to spill query results: %s",
+                      open_res.unwrapErr().c_str());
+            this->drs_spill_failed = true;
+            return;
+        }
+
+        auto tmp_pair = open_res.unwrap();
+
+        ghc::filesystem::remove(tmp_pair.first);
+        this->drs_spill_fd = tmp_pair.second;
+    }
+
+    // The last block is still being filled, so it always stays in memory.
+    while (this->drs_resident_size > (size_t) cfg.dsc_max_resident_size &&
+           this->drs_spill_index + 1 < this->drs_blocks.size()) {
+        auto &blk = this->drs_blocks[this->drs_spill_index];
+        size_t written = 0;
+
+        while (written < blk.b_used) {
+            auto rc = pwrite(this->drs_spill_fd,
+                             &blk.b_data[written],
+                             blk.b_used - written,
+                             this->drs_spill_offset + written);
+
+            if (rc <= 0) {
+                log_error("unable to write query results to spill file: %s",
+                          strerror(errno));
+                this->drs_spill_failed = true;
+                return;
+            }
+            written += rc;
+        }
+
+        // Replace the anonymous pages in place so that pointers handed out
+        // by push_cell() stay valid.
+        void *mapped = mmap(blk.b_data,
+                            blk.b_capacity,
+                            PROT_READ,
+                            MAP_SHARED | MAP_FIXED,
+                            this->drs_spill_fd,
+                            this->drs_spill_offset);
+        if (mapped == MAP_FAILED) {
+            log_error("unable to map query result spill file: %s",
+                      strerror(errno));
+            this->drs_spill_failed = true;
+            return;
+        }
+
+        blk.b_spilled = true;
+        this->drs_resident_size -= blk.b_capacity;
+        this->drs_spill_offset += blk.b_capacity;
+        this->drs_spill_index += 1;
+    }
+}
+
+void db_result_store::clear()
+{
+    for (auto &blk : this->drs_blocks) {
+        munmap(blk.b_data, blk.b_capacity);
+    }
+    this->drs_blocks.clear();
+    this->drs_columns.clear();
+    this->drs_row_count = 0;
+    this->drs_pending_column = 0;
+    this->drs_resident_size = 0;
+    this->drs_spill_index = 0;
+    this->drs_spill_offset = 0;
+    this->drs_spill_fd.reset();
+    this->drs_spill_failed = false;
+}
+
 void db_label_source::text_value_for_line(textview_curses &tc, int row,
                                           std::string &label_out,
                                           text_sub_source::line_flags_t flags)
@@ -123,9 +321,9 @@ void db_label_source::text_attrs_for_line(textview_curses &tc, int row,
         size_t row_len = strlen(row_value);
 
         if (this->dls_headers[lpc].hm_graphable) {
-            double num_value;
+            double num_value = this->dls_rows.number(row, lpc);
 
-            if (sscanf(row_value, "%lf", &num_value) == 1) {
+            if (!std::isnan(num_value)) {
                 this->dls_chart.chart_attrs_for_value(tc, left, this->dls_headers[lpc].hm_name, num_value, sa);
             }
         }
@@ -161,6 +359,7 @@ void db_label_source::push_header(const std::string &colstr, int type,
     hm.hm_column_size = utf8_string_length(colstr).unwrapOr(colstr.length());
     hm.hm_column_type = type;
     hm.hm_graphable = graphable;
+    this->dls_rows.add_column(graphable);
     if (colstr == "log_time") {
         this->dls_time_column_index = this->dls_headers.size() - 1;
     }
@@ -169,19 +368,11 @@ void db_label_source::push_header(const std::string &colstr, int type,
 void db_label_source::push_column(const char *colstr)
 {
     view_colors &vc = view_colors::singleton();
-    int index = this->dls_rows.back().size();
+    int index = this->dls_rows.pending_column();
     double num_value = 0.0;
     size_t value_len;
 
-    if (colstr == nullptr) {
-        colstr = NULL_STR;
-    }
-    else {
-        colstr = strdup(colstr);
-        if (colstr == nullptr) {
-            throw "out of memory";
-        }
-    }
+    colstr = this->dls_rows.push_cell(colstr);
     value_len = strlen(colstr);
 
     if (index == this->dls_time_column_index) {
@@ -201,13 +392,13 @@ void db_label_source::push_column(const char *colstr)
         }
     }
 
-    this->dls_rows.back().push_back(colstr);
     this->dls_headers[index].hm_column_size =
         std::max(this->dls_headers[index].hm_column_size,
                  utf8_string_length(colstr, value_len).unwrapOr(value_len));
 
-    if (colstr != nullptr && this->dls_headers[index].hm_graphable) {
-        if (sscanf(colstr, "%lf", &num_value) != 1) {
+    if (this->dls_headers[index].hm_graphable) {
+        num_value = this->dls_rows.number(this->dls_rows.size() - 1, index);
+        if (std::isnan(num_value)) {
             num_value = 0.0;
         }
         this->dls_chart.add_value(this->dls_headers[index].hm_name, num_value);
@@ -235,13 +426,6 @@ void db_label_source::clear()
 {
     this->dls_chart.clear();
     this->dls_headers.clear();
-    for (size_t row = 0; row < this->dls_rows.size(); row++) {
-        for (size_t col = 0; col < this->dls_rows[row].size(); col++) {
-            if (this->dls_rows[row][col] != NULL_STR) {
-                free((void *)this->dls_rows[row][col]);
-            }
-        }
-    }
     this->dls_rows.clear();
     this->dls_time_column.clear();
     this->dls_cell_width.clear();
@@ -286,7 +470,7 @@ size_t db_overlay_source::list_overlay_count(const listview_curses &lv)
 
     view_colors &vc = view_colors::singleton();
     vis_line_t top = lv.get_top();
-    const std::vector<const char *> &cols = this->dos_labels->dls_rows[top];
+    auto cols = this->dos_labels->dls_rows[top];
     unsigned long width;
     vis_line_t height;
 
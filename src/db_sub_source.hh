@@ -36,9 +36,134 @@
 
 #include <sqlite3.h>
 
+#include "auto_fd.hh"
 #include "textview_curses.hh"
 #include "hist_source.hh"
 
+/**
+ * Column-oriented storage for the rows of a query result.  The text of each
+ * cell is packed into large arena blocks instead of being allocated
+ * individually and columns that hold numbers also keep the parsed value so
+ * that it does not need to be scanned again when rendering.  Once the blocks
+ * held in memory grow past the configured limit, the older ones are written
+ * out to an unlinked temporary file and mapped back in read-only.
+ */
+class db_result_store {
+public:
+    static const size_t BLOCK_SIZE = 1024 * 1024;
+
+    class row_ref {
+    public:
+        const char *operator[](size_t col) const {
+            return this->rr_store->cell(this->rr_row, col);
+        };
+
+        size_t size() const {
+            return this->rr_store->column_count();
+        };
+
+    private:
+        friend class db_result_store;
+
+        row_ref(const db_result_store *store, size_t row)
+            : rr_store(store), rr_row(row) {
+        };
+
+        const db_result_store *rr_store;
+        size_t rr_row;
+    };
+
+    db_result_store() = default;
+
+    db_result_store(const db_result_store &) = delete;
+
+    db_result_store &operator=(const db_result_store &) = delete;
+
+    ~db_result_store() {
+        this->clear();
+    };
+
+    size_t size() const {
+        return this->drs_row_count;
+    };
+
+    bool empty() const {
+        return this->drs_row_count == 0;
+    };
+
+    row_ref operator[](size_t row) const {
+        return row_ref(this, row);
+    };
+
+    size_t column_count() const {
+        return this->drs_columns.size();
+    };
+
+    void add_column(bool numeric);
+
+    void push_row();
+
+    /**
+     * @return The index of the column that the next pushed cell belongs to.
+     */
+    size_t pending_column() const {
+        return this->drs_pending_column;
+    };
+
+    /**
+     * Append a cell to the row currently being filled.
+     *
+     * @param value The cell text or nullptr for a NULL value.
+     * @return The stored copy of the text, which stays valid until the store
+     *   is cleared.
+     */
+    const char *push_cell(const char *value);
+
+    const char *cell(size_t row, size_t col) const;
+
+    /**
+     * @return The numeric value of the cell or NaN if the column is not
+     *   numeric or the cell could not be parsed as a number.
+     */
+    double number(size_t row, size_t col) const;
+
+    size_t resident_size() const {
+        return this->drs_resident_size;
+    };
+
+    void clear();
+
+private:
+    struct block {
+        char *b_data;
+        size_t b_capacity;
+        size_t b_used;
+        bool b_spilled;
+    };
+
+    struct column {
+        std::vector<uint64_t> c_cells;
+        std::vector<double> c_numbers;
+        bool c_numeric{false};
+    };
+
+    static const uint64_t NULL_CELL = UINT64_MAX;
+
+    uint64_t store_text(const char *value, size_t len);
+
+    void spill_blocks();
+
+    std::vector<block> drs_blocks;
+    std::vector<column> drs_columns;
+    size_t drs_row_count{0};
+    size_t drs_pending_column{0};
+    size_t drs_resident_size{0};
+    size_t drs_spill_index{0};
+    off_t drs_spill_offset{0};
+    auto_fd drs_spill_fd;
+    bool drs_spill_failed{false};
+};
+
 class db_label_source : public text_sub_source, public text_time_translator {
 public:
     ~db_label_source() {
@@ -115,7 +240,7 @@ public:
 
     stacked_bar_chart<std::string> dls_chart;
     std::vector<header_meta> dls_headers;
-    std::vector<std::vector<const char *>> dls_rows;
+    db_result_store dls_rows;
     std::vector<struct timeval> dls_time_column;
     std::vector<size_t> dls_cell_width;
     int dls_time_column_index{-1};
@@ -33,6 +33,8 @@
 
 #include <glob.h>
 
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 #include "base/opt_util.hh"
@@ -43,6 +45,7 @@
 #include "pcrepp/pcrepp.hh"
 #include "tailer/tailer.looper.hh"
 #include "service_tags.hh"
+#include "lnav.hh"
 #include "lnav_util.hh"
 #include "pcap_manager.hh"
 
@@ -347,37 +350,61 @@ file_collection::watch_logfile(const std::string &filename,
                 }
 
                 case file_format_t::FF_ARCHIVE: {
-                    nonstd::optional<std::list<archive_manager::extract_progress>::iterator>
-                        prog_iter_opt;
+                    // Members can be unpacked by more than one worker, so
+                    // each worker thread gets its own progress entry.
+                    std::map<std::thread::id,
+                             std::list<archive_manager::extract_progress>::iterator>
+                        prog_iters;
+                    // The members that were handed to the main thread before
+                    // the extraction finished, they are closed again if the
+                    // extraction fails.
+                    std::mutex streamed_mutex;
+                    std::vector<std::pair<std::string, std::shared_ptr<logfile>>>
+                        streamed_files;
 
                     if (loo.loo_source == logfile_name_source::ARCHIVE) {
                         // Don't try to open nested archives
                         return retval;
                     }
 
+                    auto member_options = [&filename](
+                        const ghc::filesystem::path &tmp_path,
+                        const ghc::filesystem::path &member_path,
+                        bool is_visible) {
+                        auto arc_path = ghc::filesystem::relative(
+                            member_path, tmp_path);
+                        auto custom_name = filename / arc_path;
+
+                        return logfile_open_options()
+                            .with_filename(custom_name.string())
+                            .with_source(logfile_name_source::ARCHIVE)
+                            .with_visibility(is_visible)
+                            .with_non_utf_visibility(false)
+                            .with_visible_size_limit(256 * 1024);
+                    };
+
                     auto res = archive_manager::walk_archive_files(
                         filename,
-                        [prog, &prog_iter_opt](
+                        [prog, &prog_iters](
                             const auto &path,
                             const auto total) {
                             safe::WriteAccess<safe_scan_progress> sp(*prog);
+                            auto tid = std::this_thread::get_id();
+                            auto iter_iter = prog_iters.find(tid);
 
-                            prog_iter_opt | [&sp](auto prog_iter) {
-                                sp->sp_extractions.erase(prog_iter);
-                            };
+                            if (iter_iter != prog_iters.end()) {
+                                sp->sp_extractions.erase(iter_iter->second);
+                            }
                             auto prog_iter = sp->sp_extractions.emplace(
                                 sp->sp_extractions.begin(),
                                 path, total);
-                            prog_iter_opt = prog_iter;
+                            prog_iters[tid] = prog_iter;
 
                             return &(*prog_iter);
                         },
-                        [&filename, &retval](
+                        [&filename, &retval, &member_options](
                             const auto &tmp_path,
                             const auto &entry) {
-                            auto arc_path = ghc::filesystem::relative(
-                                entry.path(), tmp_path);
-                            auto custom_name = filename / arc_path;
                             bool is_visible = true;
 
                             if (entry.file_size() == 0) {
@@ -389,16 +416,88 @@ file_collection::watch_logfile(const std::string &filename,
                             log_info("adding file from archive: %s/%s",
                                      filename.c_str(),
                                      entry.path().c_str());
-                            retval.fc_file_names[entry.path().string()]
-                                .with_filename(custom_name.string())
-                                .with_source(logfile_name_source::ARCHIVE)
-                                .with_visibility(is_visible)
-                                .with_non_utf_visibility(false)
-                                .with_visible_size_limit(256 * 1024);
+                            retval.fc_file_names.emplace(
+                                entry.path().string(),
+                                member_options(tmp_path,
+                                               entry.path(),
+                                               is_visible));
+                        },
+                        [&member_options, &streamed_mutex, &streamed_files](
+                            const auto &tmp_path,
+                            const auto &member_path,
+                            const auto size) {
+                            auto path_str = member_path.string();
+                            auto loo = member_options(
+                                tmp_path, member_path, size != 0);
+                            auto open_loo = loo;
+                            auto open_res = logfile::open(path_str, open_loo);
+
+                            if (open_res.isErr()) {
+                                log_error("unable to open archive member: %s -- %s",
+                                          path_str.c_str(),
+                                          open_res.unwrapErr().c_str());
+                                return;
+                            }
+
+                            log_info("streaming file from archive: %s",
+                                     path_str.c_str());
+
+                            auto lf = open_res.unwrap();
+                            {
+                                std::lock_guard<std::mutex> lg(streamed_mutex);
+
+                                streamed_files.emplace_back(path_str, lf);
+                            }
+
+                            // The rescan that is unpacking this archive will
+                            // not complete until all of the members have been
+                            // written, so hand the file over to the main
+                            // thread now to start indexing it.  A pending
+                            // invalidation is for the rescan and is left
+                            // alone.
+                            isc::to<main_looper &, services::main_t>()
+                                .send([path_str, loo, lf](auto &mlooper) {
+                                    auto &active_fc = lnav_data.ld_active_files;
+
+                                    if (active_fc.fc_file_names.count(path_str) > 0) {
+                                        return;
+                                    }
+
+                                    file_collection fc;
+
+                                    fc.fc_file_names.emplace(path_str, loo);
+                                    fc.fc_files.push_back(lf);
+                                    merge_active_files(fc);
+                                });
                         });
                     if (res.isErr()) {
                         log_error("archive extraction failed: %s",
                                   res.unwrapErr().c_str());
+                        if (!streamed_files.empty()) {
+                            // The messages that opened these files were sent
+                            // first, so they have been merged by the time this
+                            // one is processed.
+                            isc::to<main_looper &, services::main_t>()
+                                .send([streamed_files](auto &mlooper) {
+                                    auto &active_fc = lnav_data.ld_active_files;
+
+                                    for (const auto &pair : streamed_files) {
+                                        auto file_iter = std::find(
+                                            active_fc.fc_files.begin(),
+                                            active_fc.fc_files.end(),
+                                            pair.second);
+
+                                        if (file_iter == active_fc.fc_files.end()) {
+                                            continue;
+                                        }
+
+                                        log_info("closing streamed archive member: %s",
+                                                 pair.first.c_str());
+                                        active_fc.fc_file_names.erase(pair.first);
+                                        pair.second->close();
+                                    }
+                                });
+                        }
                         retval.clear();
                         retval.fc_name_to_errors.emplace(
                             filename,
@@ -410,11 +509,11 @@ file_collection::watch_logfile(const std::string &filename,
                         retval.fc_other_files[filename] = ff;
                     }
                     {
-                        prog_iter_opt |
-                        [&prog](auto prog_iter) {
-                            prog->writeAccess()->sp_extractions.erase(
-                                prog_iter);
-                        };
+                        safe::WriteAccess<safe_scan_progress> sp(*prog);
+
+                        for (const auto& pair : prog_iters) {
+                            sp->sp_extractions.erase(pair.second);
+                        }
                     }
                     break;
                 }
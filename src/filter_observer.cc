@@ -29,10 +29,24 @@
 
 #include "config.h"
 
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <thread>
+
+#include "base/lnav_log.hh"
+#include "base/perf_counters.hh"
+#include "base/string_util.hh"
 #include "log_format.hh"
+#include "log_format_ext.hh"
 
 #include "filter_observer.hh"
 
+static const size_t FILTER_CHUNK_LINES = 128 * 1024;
+static const size_t MAX_FILTER_WORKERS = 8;
+
 void line_filter_observer::logline_new_lines(const logfile &lf,
                                              logfile::const_iterator ll_begin,
                                              logfile::const_iterator ll_end,
@@ -47,6 +61,7 @@ void line_filter_observer::logline_new_lines(const logfile &lf,
         return;
     }
 
+    lnav::perf::timer perf_timer(lnav::perf::phase_t::filter_eval);
     for (; ll_begin != ll_end; ++ll_begin) {
         if (lf.get_format() != nullptr) {
             lf.get_format()->get_subline(*ll_begin, sbr);
@@ -72,3 +87,192 @@ void line_filter_observer::logline_eof(const logfile &lf)
         iter->end_of_message(this->lfo_filter_state);
     }
 }
+
+/**
+ * Match a range of lines against the filters, using a separate line buffer
+ * so the file's own buffer is not touched.  The results are stored as one
+ * mask per line with a bit for each filter.
+ */
+static bool match_lines(const logfile &lf,
+                        size_t begin,
+                        size_t end,
+                        const std::vector<text_filter *> &filters,
+                        uint32_t *hits_out)
+{
+    try {
+        auto fd = auto_fd::dup_of(lf.get_fd());
+        line_buffer lb;
+
+        lb.set_fd(fd);
+        for (auto lpc = begin; lpc < end; lpc++) {
+            auto ll = lf.begin() + lpc;
+            auto next_ll = ll + 1;
+            file_range fr{ll->get_offset(),
+                          next_ll->get_offset() - ll->get_offset() - 1};
+            auto read_result = lb.read_range(fr);
+
+            if (read_result.isErr()) {
+                log_error("%s: unable to read line %d for filtering -- %s",
+                          lf.get_filename().c_str(),
+                          (int) lpc,
+                          read_result.unwrapErr().c_str());
+                return false;
+            }
+
+            auto sbr = read_result.unwrap();
+            uint32_t hits = 0;
+
+            sbr.rtrim(is_line_ending);
+            if (!ll->is_valid_utf()) {
+                scrub_to_utf8(sbr.get_writable_data(), sbr.length());
+            }
+            for (size_t filter_index = 0; filter_index < filters.size();
+                 filter_index++) {
+                if (filters[filter_index]->matches(lf, ll, sbr)) {
+                    hits |= (1U << filter_index);
+                }
+            }
+            hits_out[lpc - begin] = hits;
+        }
+    } catch (const std::exception &e) {
+        log_error("%s: unable to filter lines at %d -- %s",
+                  lf.get_filename().c_str(),
+                  (int) begin,
+                  e.what());
+        return false;
+    }
+
+    return true;
+}
+
+size_t line_filter_observer::evaluate_in_background(const logfile &lf)
+{
+    auto elf = std::dynamic_pointer_cast<external_log_format>(lf.get_format());
+
+    if (elf == nullptr || elf->elf_type != external_log_format::ELF_TYPE_TEXT ||
+        lf.is_compressed() || !S_ISREG(lf.get_stat().st_mode) ||
+        lf.size() < 2) {
+        return 0;
+    }
+
+    auto &lfs = this->lfo_filter_state;
+    std::vector<text_filter *> filters;
+    size_t start = lf.size();
+
+    require(&lf == lfs.tfs_logfile.get());
+
+    lfs.resize(lf.size());
+    for (auto &filter : this->lfo_filter_stack) {
+        if (filter->lf_deleted ||
+            lfs.tfs_filter_count[filter->get_index()] >= lf.size()) {
+            continue;
+        }
+        if (!filter->is_thread_safe()) {
+            // The serial pass has to read these lines anyway.
+            return 0;
+        }
+        filters.push_back(filter.get());
+        start = std::min(start, lfs.tfs_filter_count[filter->get_index()]);
+    }
+
+    // The last message is left for the serial pass since the file might
+    // still be growing.
+    auto end = lf.size() - 1;
+    while (end > start && !(lf.begin() + end)->is_message()) {
+        end -= 1;
+    }
+
+    if (filters.empty() || end <= start) {
+        return 0;
+    }
+
+    auto worker_count = std::min({(size_t) std::thread::hardware_concurrency(),
+                                  MAX_FILTER_WORKERS,
+                                  (end - start) / FILTER_CHUNK_LINES});
+
+    if (worker_count < 2) {
+        return 0;
+    }
+
+    lnav::perf::timer perf_timer(lnav::perf::phase_t::filter_eval);
+    std::vector<uint32_t> hits;
+    auto batch_start = start;
+
+    log_info("%s: filtering %d lines with %d workers",
+             lf.get_filename().c_str(),
+             (int) (end - start),
+             (int) worker_count);
+    while (batch_start < end) {
+        // Batches end on a message boundary so that the message state can
+        // be flushed if a later batch fails.
+        auto batch_end = std::min(end,
+                                  batch_start + worker_count * FILTER_CHUNK_LINES);
+        while (batch_end < end && !(lf.begin() + batch_end)->is_message()) {
+            batch_end += 1;
+        }
+
+        std::vector<std::future<bool>> workers;
+        bool complete = true;
+
+        hits.resize(batch_end - batch_start);
+        for (auto chunk_start = batch_start; chunk_start < batch_end;
+             chunk_start += FILTER_CHUNK_LINES) {
+            auto chunk_end = std::min(batch_end, chunk_start + FILTER_CHUNK_LINES);
+
+            workers.emplace_back(std::async(std::launch::async,
+                                            match_lines,
+                                            std::cref(lf),
+                                            chunk_start,
+                                            chunk_end,
+                                            std::cref(filters),
+                                            &hits[chunk_start - batch_start]));
+        }
+        for (auto &worker : workers) {
+            complete = worker.get() && complete;
+        }
+        if (!complete) {
+            break;
+        }
+
+        // Replay the results in order, the same as logline_new_lines().
+        for (auto lpc = batch_start; lpc < batch_end; lpc++) {
+            auto ll = lf.begin() + lpc;
+            auto line_hits = hits[lpc - batch_start];
+
+            for (size_t filter_index = 0; filter_index < filters.size();
+                 filter_index++) {
+                auto *filter = filters[filter_index];
+
+                if (lpc >= lfs.tfs_filter_count[filter->get_index()]) {
+                    filter->add_match(
+                        lfs, ll, line_hits & (1U << filter_index));
+                }
+            }
+        }
+        batch_start = batch_end;
+    }
+
+    for (auto *filter : filters) {
+        if (lfs.tfs_lines_for_message[filter->get_index()] > 0) {
+            filter->end_of_message(lfs);
+        }
+    }
+
+    return batch_start - start;
+}
+
+void line_filter_observer::get_passing_lines(uint32_t filter_in_mask,
+                                             uint32_t filter_out_mask,
+                                             std::vector<uint8_t> &lines_out) const
+{
+    const auto &mask = this->lfo_filter_state.tfs_mask;
+    auto count = mask.size();
+    uint8_t all_in = filter_in_mask == 0;
+
+    lines_out.resize(count);
+    // Branch-free, the same test as excluded(), so it can be vectorized.
+    for (size_t lpc = 0; lpc < count; lpc++) {
+        lines_out[lpc] = (all_in | ((mask[lpc] & filter_in_mask) != 0)) &
+                         ((mask[lpc] & filter_out_mask) == 0);
+    }
+}
@@ -32,6 +32,8 @@
 
 #include <sys/types.h>
 
+#include <vector>
+
 #include "logfile.hh"
 #include "textview_curses.hh"
 
@@ -46,6 +48,11 @@ public:
         for (auto &filter : this->lfo_filter_stack) {
             filter->revert_to_last(this->lfo_filter_state, rollback_size);
         }
+        // The lines that were rolled back are indexed again with their
+        // expr-mark flag cleared, so they need to be checked again.
+        if (this->lfo_expr_checked.size() > lf.size()) {
+            this->lfo_expr_checked.resize(lf.size());
+        }
     };
 
     void logline_new_lines(const logfile &lf,
@@ -55,6 +62,25 @@ public:
 
     void logline_eof(const logfile &lf);
 
+    /**
+     * Run the filters that have not seen all of the lines in the file on
+     * background threads.  Only thread-safe filters on plain-text logs are
+     * handled here, the last message and anything that could not be
+     * matched is left for logfile::reobserve_from().
+     *
+     * @param lf The file to evaluate the filters against.
+     * @return The number of lines that were matched.
+     */
+    size_t evaluate_in_background(const logfile &lf);
+
+    /**
+     * Compute which lines pass the given filters, one byte per line, so the
+     * filtered index can be rebuilt without checking each line's mask.
+     */
+    void get_passing_lines(uint32_t filter_in_mask,
+                           uint32_t filter_out_mask,
+                           std::vector<uint8_t> &lines_out) const;
+
     bool excluded(uint32_t filter_in_mask, uint32_t filter_out_mask,
             size_t offset) const {
         bool filtered_in = (filter_in_mask == 0) || (
@@ -92,6 +118,11 @@ public:
 
     filter_stack &lfo_filter_stack;
     logfile_filter_state lfo_filter_state;
+    /**
+     * The lines that have been checked against the mark expression, the
+     * result is kept in the logline's expr-mark flag.
+     */
+    std::vector<bool> lfo_expr_checked;
 };
 
 #endif
@@ -41,6 +41,7 @@
 
 #include "base/opt_util.hh"
 #include "base/lnav_log.hh"
+#include "base/perf_counters.hh"
 #include "base/string_util.hh"
 #include "lnav_util.hh"
 #include "grep_proc.hh"
@@ -49,12 +50,18 @@
 using namespace std;
 
 template<typename LineType>
-grep_proc<LineType>::grep_proc(pcre *code, grep_proc_source<LineType> &gps)
+grep_proc<LineType>::grep_proc(pcre *code,
+                               grep_proc_source<LineType> &gps,
+                               std::string pattern)
     : gp_pcre(code),
       gp_source(gps)
 {
     require(this->invariant());
 
+    if (!pattern.empty()) {
+        this->gp_pcre.set_pattern(std::move(pattern));
+    }
+
     gps.register_proc(this);
 }
 
@@ -180,15 +187,20 @@ void grep_proc<LineType>::child_loop()
             if (!done) {
                 pcre_context_static<128> pc;
                 pcre_input pi(line_value);
+                size_t limit = this->gp_source.grep_value_limit(line,
+                                                                line_value);
 
                 while (this->gp_pcre.match(pc, pi)) {
                     pcre_context::iterator   pc_iter;
                     pcre_context::capture_t *m;
 
+                    m = pc.all();
+                    if ((size_t) m->c_begin >= limit) {
+                        break;
+                    }
                     if (pi.pi_offset == 0) {
                         fprintf(stdout, "%d\n", (int) line);
                     }
-                    m = pc.all();
                     fprintf(stdout, "[%d:%d]\n", m->c_begin, m->c_end);
                     for (pc_iter = pc.begin(); pc_iter != pc.end();
                          pc_iter++) {
@@ -269,6 +281,7 @@ void grep_proc<LineType>::cleanup()
 template<typename LineType>
 void grep_proc<LineType>::dispatch_line(char *line)
 {
+    lnav::perf::timer perf_timer(lnav::perf::phase_t::grep);
     int start, end, capture_start;
 
     require(line != nullptr);
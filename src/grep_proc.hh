@@ -80,6 +80,16 @@ public:
      */
     virtual bool grep_value_for_line(LineType line, std::string &value_out) = 0;
 
+    /**
+     * @param line The line that was just retrieved.
+     * @param value The value from grep_value_for_line().
+     * @return The number of bytes at the start of the value that belong to
+     *   the line.  Matches that start after them are left for the next line.
+     */
+    virtual size_t grep_value_limit(LineType line, const std::string &value) {
+        return value.size();
+    };
+
     virtual LineType grep_initial_line(LineType start, LineType highest) {
         if (start == -1) {
             return highest;
@@ -182,8 +192,11 @@ public:
      *
      * @param code The pcre code to run over the lines of input.
      * @param gps The source of the data to match.
+     * @param pattern The text of the pattern that was compiled, if known.
      */
-    grep_proc(pcre *code, grep_proc_source<LineType> &gps);
+    grep_proc(pcre *code,
+              grep_proc_source<LineType> &gps,
+              std::string pattern = "");
 
     virtual ~grep_proc();
 
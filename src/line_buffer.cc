@@ -49,7 +49,9 @@
 
 #include "base/math_util.hh"
 #include "base/is_utf8.hh"
+#include "base/perf_counters.hh"
 #include "line_buffer.hh"
+#include "data_scanner.hh"
 #include "fmtlib/fmt/format.h"
 
 using namespace std;
@@ -312,9 +314,10 @@ line_buffer::~line_buffer()
 {
     auto empty_fd = auto_fd();
 
-    // Make sure any shared refs take ownership of the data.
-    this->lb_share_manager.invalidate_refs();
     this->set_fd(empty_fd);
+    // Any shared refs take ownership of the data.
+    this->lb_share_manager.hand_off(
+        std::shared_ptr<void>(this->lb_buffer.release(), free));
 }
 
 void line_buffer::set_fd(auto_fd &fd)
@@ -329,6 +332,8 @@ void line_buffer::set_fd(auto_fd &fd)
         this->lb_bz_file = false;
     }
 
+    this->lb_pipe_buffer.reset();
+
     if (fd != -1) {
         /* Sync the fd's offset with the object. */
         newoff = lseek(fd, 0, SEEK_CUR);
@@ -383,11 +388,21 @@ void line_buffer::set_fd(auto_fd &fd)
     }
     this->lb_file_offset = newoff;
     this->lb_buffer_size = 0;
+    this->lb_long_line = {-1, 0};
     this->lb_fd          = std::move(fd);
 
     ensure(this->invariant());
 }
 
+void line_buffer::set_pipe_buffer(std::shared_ptr<pipe_buffer> pb)
+{
+    require(!this->is_compressed());
+
+    this->lb_pipe_buffer = std::move(pb);
+    this->lb_seekable = false;
+    this->lb_file_size = -1;
+}
+
 void line_buffer::resize_buffer(size_t new_max)
 {
     require(this->lb_bz_file || this->lb_gz_file ||
@@ -396,9 +411,12 @@ void line_buffer::resize_buffer(size_t new_max)
     if (new_max > (size_t)this->lb_buffer_max) {
         char *tmp, *old;
 
+        if (this->detach_buffer(new_max, 0, this->lb_buffer_size)) {
+            return;
+        }
+
         /* Still need more space, try a realloc. */
         old = this->lb_buffer.release();
-        this->lb_share_manager.invalidate_refs();
         tmp = (char *) realloc(old, new_max);
         if (tmp != NULL) {
             this->lb_buffer = tmp;
@@ -411,6 +429,30 @@ void line_buffer::resize_buffer(size_t new_max)
     }
 }
 
+bool line_buffer::detach_buffer(size_t new_max,
+                                ssize_t keep_start,
+                                ssize_t keep_size)
+{
+    char *new_buffer;
+
+    if (!this->lb_share_manager.has_refs()) {
+        return false;
+    }
+
+    if ((new_buffer = (char *) malloc(new_max)) == nullptr) {
+        throw error(ENOMEM);
+    }
+    if (keep_size > 0) {
+        memcpy(new_buffer, &this->lb_buffer[keep_start], keep_size);
+    }
+    this->lb_share_manager.hand_off(
+        std::shared_ptr<void>(this->lb_buffer.release(), free));
+    this->lb_buffer = new_buffer;
+    this->lb_buffer_max = new_max;
+
+    return true;
+}
+
 void line_buffer::ensure_available(file_off_t start, ssize_t max_length)
 {
     ssize_t prefill, available;
@@ -433,7 +475,7 @@ void line_buffer::ensure_available(file_off_t start, ssize_t max_length)
          * The request is outside the cached range, need to reload the
          * whole thing.
          */
-        this->lb_share_manager.invalidate_refs();
+        this->detach_buffer(this->lb_buffer_max, 0, 0);
         prefill = 0;
         this->lb_buffer_size = 0;
         if ((this->lb_file_size != (ssize_t)-1) &&
@@ -467,13 +509,14 @@ void line_buffer::ensure_available(file_off_t start, ssize_t max_length)
          * Need more space, move any existing data to the front of the
          * buffer.
          */
-        this->lb_share_manager.invalidate_refs();
-
         this->lb_buffer_size -= prefill;
         this->lb_file_offset += prefill;
-        memmove(&this->lb_buffer[0],
-                &this->lb_buffer[prefill],
-                this->lb_buffer_size);
+        if (!this->detach_buffer(
+                this->lb_buffer_max, prefill, this->lb_buffer_size)) {
+            memmove(&this->lb_buffer[0],
+                    &this->lb_buffer[prefill],
+                    this->lb_buffer_size);
+        }
 
         available = this->lb_buffer_max - (start - this->lb_file_offset);
         if (max_length > available) {
@@ -494,6 +537,7 @@ bool line_buffer::fill_range(file_off_t start, ssize_t max_length)
         retval = true;
     }
     else if (this->lb_fd != -1) {
+        lnav::perf::timer perf_timer(lnav::perf::phase_t::line_buffer_fill);
         ssize_t rc;
 
         /* Make sure there is enough space, then */
@@ -576,6 +620,12 @@ bool line_buffer::fill_range(file_off_t start, ssize_t max_length)
             }
         }
 #endif
+        else if (this->lb_pipe_buffer != nullptr) {
+            rc = this->lb_pipe_buffer->read(
+                &this->lb_buffer[this->lb_buffer_size],
+                this->lb_file_offset + this->lb_buffer_size,
+                this->lb_buffer_max - this->lb_buffer_size);
+        }
         else if (this->lb_seekable) {
             rc = pread(this->lb_fd,
                        &this->lb_buffer[this->lb_buffer_size],
@@ -643,6 +693,54 @@ bool line_buffer::fill_range(file_off_t start, ssize_t max_length)
     return retval;
 }
 
+size_t line_buffer::segment_length(char *start)
+{
+    shared_buffer_ref sbr;
+    size_t retval = 0;
+
+    sbr.share(this->lb_share_manager, start, MAX_LINE_SEGMENT_SIZE);
+
+    data_scanner ds(sbr);
+    pcre_context_static<30> pc;
+    data_token_t dt;
+
+    while (ds.tokenize2(pc, dt)) {
+        size_t token_end = pc.all()->c_end;
+
+        if (token_end >= (size_t) ds.get_input().pi_length) {
+            // The last token might continue past the end of the segment.
+            break;
+        }
+        switch (dt) {
+            case DT_COMMA:
+            case DT_SEMI:
+            case DT_RCURLY:
+            case DT_RSQUARE:
+            case DT_RPAREN:
+            case DT_RANGLE:
+            case DT_XML_CLOSE_TAG:
+            case DT_XML_EMPTY_TAG:
+            case DT_WHITE:
+                retval = token_end;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (retval > MAX_LINE_SEGMENT_SIZE / 2) {
+        return retval;
+    }
+
+    // No boundary was found, just make sure a UTF-8 sequence is not split.
+    retval = MAX_LINE_SEGMENT_SIZE;
+    while (retval > 1 && (start[retval] & 0xc0) == 0x80) {
+        retval -= 1;
+    }
+
+    return retval;
+}
+
 Result<line_info, string> line_buffer::load_next_line(file_range prev_line)
 {
     ssize_t request_size = DEFAULT_INCREMENT;
@@ -653,6 +751,50 @@ Result<line_info, string> line_buffer::load_next_line(file_range prev_line)
 
     auto offset = prev_line.next_offset();
     retval.li_file_range.fr_offset = offset;
+
+    bool continuing = this->lb_long_line.fr_offset < offset &&
+                      offset <= this->lb_long_line.next_offset();
+
+    retval.li_continued = continuing;
+    if (this->lb_long_line.fr_offset <= offset &&
+        offset + MAX_LINE_SEGMENT_SIZE < this->lb_long_line.next_offset() &&
+        this->fill_range(offset, MAX_LINE_SEGMENT_SIZE + 1)) {
+        file_ssize_t avail;
+        char *line_start = this->get_range(offset, avail);
+
+        if (avail > MAX_LINE_SEGMENT_SIZE) {
+            /*
+             * We are in the middle of a long line and there are no line
+             * endings in this part of it, so the next segment can be
+             * returned without searching for the end of the line.
+             */
+            retval.li_file_range.fr_size = segment_length(line_start);
+#ifdef HAVE_X86INTRIN_H
+            ssize_t utf8_end = -1;
+
+            retval.li_valid_utf = validate_utf8_fast(
+                line_start, retval.li_file_range.fr_size, &utf8_end);
+#else
+            {
+                const char *msg;
+                int faulty_bytes;
+
+                is_utf8((unsigned char *) line_start,
+                        retval.li_file_range.fr_size,
+                        &msg,
+                        &faulty_bytes);
+                retval.li_valid_utf = (msg == nullptr);
+            }
+#endif
+            if (offset >= this->lb_last_line_offset) {
+                this->lb_last_line_offset =
+                    offset + retval.li_file_range.fr_size;
+            }
+
+            return Ok(retval);
+        }
+    }
+
     while (!done) {
         char *line_start, *lf;
 
@@ -688,15 +830,21 @@ Result<line_info, string> line_buffer::load_next_line(file_range prev_line)
 
         if (lf != nullptr ||
             (retval.li_file_range.fr_size >= MAX_LINE_BUFFER_SIZE) ||
+            (continuing &&
+             retval.li_file_range.fr_size > MAX_LINE_SEGMENT_SIZE) ||
             (request_size == MAX_LINE_BUFFER_SIZE) ||
             ((request_size > retval.li_file_range.fr_size) &&
              (retval.li_file_range.fr_size > 0) &&
              (!this->is_pipe() || request_size > DEFAULT_INCREMENT))) {
+            file_ssize_t no_eol_size = lf != nullptr ?
+                lf - line_start : retval.li_file_range.fr_size;
+
             if ((lf != nullptr) &&
                 ((size_t) (lf - line_start) >= MAX_LINE_BUFFER_SIZE - 1)) {
                 lf = nullptr;
             }
-            if (lf != nullptr) {
+            if (lf != nullptr &&
+                (!continuing || lf - line_start < MAX_LINE_SEGMENT_SIZE)) {
                 retval.li_partial = false;
                 retval.li_file_range.fr_size = lf - line_start;
                 // delim
@@ -706,10 +854,24 @@ Result<line_info, string> line_buffer::load_next_line(file_range prev_line)
                 }
             }
             else {
-                if (retval.li_file_range.fr_size >= MAX_LINE_BUFFER_SIZE) {
-                    log_warning("Line exceeded max size: offset=%d",
+                if (continuing &&
+                    retval.li_file_range.fr_size > MAX_LINE_SEGMENT_SIZE) {
+                    /*
+                     * The rest of a long line is still split into segments
+                     * after the range that is known to have no line endings.
+                     */
+                    this->lb_long_line.fr_size = std::max(
+                        this->lb_long_line.fr_size,
+                        offset + no_eol_size - this->lb_long_line.fr_offset);
+                    retval.li_file_range.fr_size = segment_length(line_start);
+                    retval.li_partial = false;
+                }
+                else if (retval.li_file_range.fr_size >= MAX_LINE_BUFFER_SIZE) {
+                    log_warning("Line exceeded max size, splitting into "
+                                "segments: offset=%d",
                                 offset);
-                    retval.li_file_range.fr_size = MAX_LINE_BUFFER_SIZE - 1;
+                    this->lb_long_line = {offset, no_eol_size};
+                    retval.li_file_range.fr_size = segment_length(line_start);
                     retval.li_partial = false;
                 }
                 else {
@@ -38,6 +38,7 @@
 #include <zlib.h>
 
 #include <exception>
+#include <memory>
 #include <vector>
 
 #include "base/lnav_log.hh"
@@ -45,12 +46,18 @@
 #include "base/result.h"
 #include "auto_fd.hh"
 #include "auto_mem.hh"
+#include "pipe_buffer.hh"
 #include "shared_buffer.hh"
 
 struct line_info {
     file_range li_file_range;
     bool li_partial{false};
     bool li_valid_utf{true};
+    /**
+     * True if this is a segment of a long line that continues the previous
+     * one, there is no line ending between them.
+     */
+    bool li_continued{false};
 };
 
 /**
@@ -66,6 +73,14 @@ class line_buffer {
 public:
     static const ssize_t DEFAULT_LINE_BUFFER_SIZE   = 256 * 1024;
     static const ssize_t MAX_LINE_BUFFER_SIZE       = 4 * 4 * DEFAULT_LINE_BUFFER_SIZE;
+    /**
+     * Lines that are longer than MAX_LINE_BUFFER_SIZE, like a minified JSON
+     * document, are returned as a series of segments of at most this size.
+     * A segment ends after a structural character, like a comma or closing
+     * bracket, when possible so that tokens are not split across segments.
+     * The segments after the first one are marked with li_continued.
+     */
+    static const ssize_t MAX_LINE_SEGMENT_SIZE      = DEFAULT_LINE_BUFFER_SIZE;
     class error
         : public std::exception {
 public:
@@ -173,6 +188,15 @@ public:
     /** @return The file descriptor that data should be pulled from. */
     int get_fd() const { return this->lb_fd; };
 
+    /**
+     * Read the data from a pipe_buffer instead of the file descriptor.  The
+     * descriptor is still used to get the size of the data, but it can have
+     * holes where the data is still in memory, so it is treated as a pipe.
+     *
+     * @param pb The buffer that data should be pulled from.
+     */
+    void set_pipe_buffer(std::shared_ptr<pipe_buffer> pb);
+
     time_t get_file_time() const { return this->lb_file_time; };
 
     /**
@@ -224,18 +248,22 @@ public:
 
     void clear()
     {
+        this->detach_buffer(this->lb_buffer_max, 0, 0);
         this->lb_buffer_size  = 0;
     };
 
     /** Release any resources held by this object. */
     void reset()
     {
+        this->detach_buffer(this->lb_buffer_max, 0, 0);
         this->lb_fd.reset();
+        this->lb_pipe_buffer.reset();
 
         this->lb_file_offset      = 0;
         this->lb_file_size        = (ssize_t)-1;
         this->lb_buffer_size      = 0;
         this->lb_last_line_offset = -1;
+        this->lb_long_line        = {-1, 0};
     };
 
     /** Check the invariants for this object. */
@@ -261,6 +289,29 @@ private:
 
     void resize_buffer(size_t new_max);
 
+    /**
+     * Make sure the contents of the buffer can be overwritten.  If there are
+     * refs to the buffer, it is handed off to them and a new buffer is
+     * allocated, so the data they point to never changes.
+     *
+     * @param new_max The size of the new buffer.
+     * @param keep_start The offset of the data in the old buffer that should
+     *   be copied to the start of the new buffer.
+     * @param keep_size The amount of data to copy to the new buffer.
+     * @return True if a new buffer was allocated.
+     */
+    bool detach_buffer(size_t new_max, ssize_t keep_start, ssize_t keep_size);
+
+    /**
+     * Find the end of the last token that ends in the second half of a
+     * segment, like a comma or closing bracket, using the data_scanner.
+     *
+     * @param start The start of a segment of a long line.
+     * @return The length of the segment, which is at most
+     *   MAX_LINE_SEGMENT_SIZE.
+     */
+    size_t segment_length(char *start);
+
     /**
      * Ensure there is enough room in the buffer to cache a range of data from
      * the file.  First, this method will check to see if there is enough room
@@ -314,6 +365,7 @@ private:
     auto_fd lb_fd;              /*< The file to read data from. */
     gz_indexed  lb_gz_file;     /*< File reader for gzipped files. */
     bool    lb_bz_file;         /*< Flag set for bzip2 compressed files. */
+    std::shared_ptr<pipe_buffer> lb_pipe_buffer; /*< Buffered pipe data. */
     file_off_t   lb_compressed_offset; /*< The offset into the compressed file. */
 
     auto_mem<char> lb_buffer;   /*< The internal buffer where data is cached */
@@ -333,5 +385,11 @@ private:
                                  *  buffer. */
     bool   lb_seekable;         /*< Flag set for seekable file descriptors. */
     file_off_t  lb_last_line_offset; /*< */
+    file_range  lb_long_line{-1, 0}; /*<
+                                      * A range of the file that is in the
+                                      * middle of a line longer than
+                                      * MAX_LINE_BUFFER_SIZE and has no line
+                                      * endings.
+                                      */
 };
 #endif
@@ -37,6 +37,7 @@
 #include <cmath>
 
 #include "base/lnav_log.hh"
+#include "base/perf_counters.hh"
 #include "listview_curses.hh"
 
 using namespace std;
@@ -190,6 +191,8 @@ void listview_curses::do_update()
         return;
     }
 
+    lnav::perf::timer perf_timer(lnav::perf::phase_t::render);
+
     if (this->vc_needs_update) {
         view_colors &vc = view_colors::singleton();
         vis_line_t        height, row;
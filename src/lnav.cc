@@ -126,6 +126,7 @@
 #include "regexp_vtab.hh"
 #include "fstat_vtab.hh"
 #include "xpath_vtab.hh"
+#include "pretty_text_source.hh"
 #include "textfile_highlighters.hh"
 #include "base/future_util.hh"
 #include "tailer/tailer.looper.hh"
@@ -913,14 +914,21 @@ static void clear_last_user_mark(listview_curses *lv)
 
 bool update_active_files(file_collection& new_files)
 {
-    static loading_observer obs;
-
     if (lnav_data.ld_active_files.fc_invalidate_merge) {
         lnav_data.ld_active_files.fc_invalidate_merge = false;
 
         return true;
     }
 
+    merge_active_files(new_files);
+
+    return true;
+}
+
+void merge_active_files(file_collection& new_files)
+{
+    static loading_observer obs;
+
     for (const auto& lf : new_files.fc_files) {
         lf->set_logfile_observer(&obs);
         lnav_data.ld_text_source.push_back(lf);
@@ -944,8 +952,6 @@ bool update_active_files(file_collection& new_files)
         lnav_data.ld_child_pollers.begin(),
         std::make_move_iterator(lnav_data.ld_active_files.fc_child_pollers.begin()),
         std::make_move_iterator(lnav_data.ld_active_files.fc_child_pollers.end()));
-
-    return true;
 }
 
 bool rescan_files(bool req)
@@ -1239,6 +1245,17 @@ static void gather_pipers()
         }
     }
 
+    for (auto iter = lnav_data.ld_pipe_buffers.begin();
+         iter != lnav_data.ld_pipe_buffers.end(); ) {
+        if ((*iter)->is_closed()) {
+            log_info("piped input has been read -- %lld bytes",
+                     (long long) (*iter)->get_size());
+            iter = lnav_data.ld_pipe_buffers.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
     for (auto iter = lnav_data.ld_child_pollers.begin();
          iter != lnav_data.ld_child_pollers.end();) {
         if (iter->poll(lnav_data.ld_active_files) == child_poll_result_t::FINISHED) {
@@ -1253,7 +1270,9 @@ static void wait_for_pipers()
 {
     for (;;) {
         gather_pipers();
-        if (lnav_data.ld_pipers.empty() && lnav_data.ld_child_pollers.empty()) {
+        if (lnav_data.ld_pipers.empty() &&
+            lnav_data.ld_pipe_buffers.empty() &&
+            lnav_data.ld_child_pollers.empty()) {
             log_debug("all pipers finished");
             break;
         }
@@ -1261,8 +1280,9 @@ static void wait_for_pipers()
             usleep(10000);
             rebuild_indexes();
         }
-        log_debug("%d pipers and %d children still active",
+        log_debug("%d pipers, %d pipe buffers, and %d children still active",
                 lnav_data.ld_pipers.size(),
+                lnav_data.ld_pipe_buffers.size(),
                 lnav_data.ld_child_pollers.size());
     }
 }
@@ -1565,6 +1585,7 @@ static void looper()
         auto next_rebuild_time = ui_clock::now();
         auto next_status_update_time = next_rebuild_time;
         auto next_rescan_time = next_rebuild_time;
+        auto next_evict_time = next_rebuild_time;
 
         while (lnav_data.ld_looping) {
             auto loop_deadline = ui_clock::now() +
@@ -1657,6 +1678,23 @@ static void looper()
                 lnav_data.ld_files_view.set_overlay_needs_update();
             }
 
+            if (ui_clock::now() >= next_evict_time) {
+                auto &log_view = lnav_data.ld_views[LNV_LOG];
+
+                lnav_data.ld_log_source.evict_cold_lines(
+                    log_view.get_top(), log_view.get_bottom());
+                next_evict_time = ui_clock::now() + 5s;
+            }
+
+            lnav_data.ld_view_stack.top() | [&changes, loop_deadline] (auto tc) {
+                auto *pts = dynamic_cast<pretty_text_source *>(
+                    tc->get_sub_source());
+
+                if (pts != nullptr && pts->layout_step(*tc, loop_deadline)) {
+                    changes += 1;
+                }
+            };
+
             lnav_data.ld_view_stack.do_update();
             lnav_data.ld_doc_view.do_update();
             lnav_data.ld_example_view.do_update();
@@ -2073,7 +2111,7 @@ int main(int argc, char *argv[])
     exec_context &ec = lnav_data.ld_exec_context;
     int lpc, c, retval = EXIT_SUCCESS;
 
-    shared_ptr<piper_proc> stdin_reader;
+    shared_ptr<pipe_buffer> stdin_reader;
     const char *stdin_out = nullptr;
     int stdin_out_fd = -1;
     bool exec_stdin = false, load_stdin = false;
@@ -2704,7 +2742,6 @@ SELECT tbl_name FROM sqlite_master WHERE sql LIKE 'CREATE VIRTUAL TABLE%'
             } else {
                 auto fifo_piper = make_shared<piper_proc>(
                     fifo_fd.release(),
-                    false,
                     open_temp_file(ghc::filesystem::temp_directory_path() /
                                    "lnav.fifo.XXXXXX")
                         .map([](auto pair) {
@@ -2830,12 +2867,18 @@ SELECT tbl_name FROM sqlite_master WHERE sql LIKE 'CREATE VIRTUAL TABLE%'
             }
         }
 
-        stdin_reader = make_shared<piper_proc>(
-            STDIN_FILENO, lnav_data.ld_flags & LNF_TIMESTAMP, stdin_out_fd);
+        // The piped data is kept in memory and the capture file is only
+        // written to when there is too much of it.  The reader is given its
+        // own descriptor for stdin since it gets replaced below.
+        stdin_reader = make_shared<pipe_buffer>(
+            auto_fd::dup_of(STDIN_FILENO),
+            lnav_data.ld_flags & LNF_TIMESTAMP,
+            auto_fd::dup_of(stdin_out_fd));
         lnav_data.ld_active_files.fc_file_names["stdin"]
             .with_fd(auto_fd(stdin_out_fd))
+            .with_pipe_buffer(stdin_reader)
             .with_include_in_session(false);
-        lnav_data.ld_pipers.push_back(stdin_reader);
+        lnav_data.ld_pipe_buffers.push_back(stdin_reader);
     }
 
     if (!isatty(STDIN_FILENO) && isatty(STDOUT_FILENO)) {
@@ -2990,9 +3033,13 @@ SELECT tbl_name FROM sqlite_master WHERE sql LIKE 'CREATE VIRTUAL TABLE%'
 
                     los = tc->get_overlay_source();
 
+                    // The pretty view is laid out as it is printed.
+                    auto *pts = dynamic_cast<pretty_text_source *>(
+                        tc->get_sub_source());
                     vis_line_t vl;
                     for (vl = tc->get_top();
-                         vl < tc->get_inner_height();
+                         pts != nullptr ? pts->layout_until(vl) :
+                                          vl < tc->get_inner_height();
                          ++vl, ++y) {
                         attr_line_t al;
                         string &line = al.get_string();
@@ -3057,6 +3104,18 @@ SELECT tbl_name FROM sqlite_master WHERE sql LIKE 'CREATE VIRTUAL TABLE%'
             fprintf(stderr, "error: %s\n", strerror(e.e_err));
         }
 
+        // The capture file only has the data that was spilled out of
+        // memory, so the rest needs to be written out if the file is kept.
+        if (stdin_reader != nullptr) {
+            stdin_reader->stop();
+            if (stdin_out != nullptr ||
+                (lnav_data.ld_flags & (LNF_QUIET|LNF_HEADLESS)) ||
+                stdin_reader->get_size() <=
+                (file_ssize_t) MAX_STDIN_CAPTURE_SIZE) {
+                stdin_reader->spill_all();
+            }
+        }
+
         // When reading from stdin, tell the user where the capture file is
         // stored so they can look at it later.
         if (stdin_out_fd != -1 &&
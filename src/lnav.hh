@@ -60,6 +60,7 @@
 #include "log_vtab_impl.hh"
 #include "readline_curses.hh"
 #include "piper_proc.hh"
+#include "pipe_buffer.hh"
 #include "relative_time.hh"
 #include "log_format_loader.hh"
 #include "spectro_source.hh"
@@ -270,7 +271,6 @@ struct lnav_data_t {
     db_overlay_source                       ld_db_overlay;
     std::vector<std::string>                ld_db_key_names;
 
-    vis_line_t                              ld_last_pretty_print_top;
 
     std::unique_ptr<log_vtab_manager>       ld_vtab_manager;
     auto_mem<sqlite3, sqlite_close_wrapper> ld_db;
@@ -279,6 +279,7 @@ struct lnav_data_t {
 
     std::list<pid_t>                        ld_children;
     std::list<std::shared_ptr<piper_proc>>  ld_pipers;
+    std::list<std::shared_ptr<pipe_buffer>> ld_pipe_buffers;
 
     input_state_tracker ld_input_state;
     input_dispatcher ld_input_dispatcher;
@@ -317,6 +318,13 @@ bool setup_logline_table(exec_context &ec);
 bool rescan_files(bool required = false);
 bool update_active_files(file_collection& new_files);
 
+/**
+ * Add files to the active set without checking for a pending invalidation,
+ * for files that were opened outside of a rescan, like archive members that
+ * are still being unpacked.
+ */
+void merge_active_files(file_collection& new_files);
+
 void wait_for_children();
 
 textview_curses *get_textview_for_mode(ln_mode_t mode);
@@ -34,6 +34,7 @@
 #include <fnmatch.h>
 #include <termios.h>
 
+#include <cmath>
 #include <regex>
 #include <string>
 #include <utility>
@@ -48,6 +49,7 @@
 #include "base/injector.hh"
 #include "base/isc.hh"
 #include "base/paths.hh"
+#include "base/perf_counters.hh"
 #include "base/string_util.hh"
 #include "curl_looper.hh"
 #include "lnav.hh"
@@ -70,6 +72,7 @@
 #include "sysclip.hh"
 #include "yajl/api/yajl_parse.h"
 #include "db_sub_source.hh"
+#include "arrow_ipc.hh"
 #include "papertrail_proc.hh"
 #include "yajlpp/json_op.hh"
 #include "yajlpp/yajlpp.hh"
@@ -677,35 +680,6 @@ static Result<string, string> com_goto_location(exec_context &ec, string cmdline
     return Ok(retval);
 }
 
-static bool csv_needs_quoting(const string &str)
-{
-    return (str.find_first_of(",\"\r\n") != string::npos);
-}
-
-static string csv_quote_string(const string &str)
-{
-    static const std::regex csv_column_quoter("\"");
-
-    string retval = std::regex_replace(str, csv_column_quoter, "\"\"");
-
-    retval.insert(0, 1, '\"');
-    retval.append(1, '\"');
-
-    return retval;
-}
-
-static void csv_write_string(FILE *outfile, const string &str)
-{
-    if (csv_needs_quoting(str)) {
-        string quoted_str = csv_quote_string(str);
-
-        fprintf(outfile, "%s", quoted_str.c_str());
-    }
-    else {
-        fprintf(outfile, "%s", str.c_str());
-    }
-}
-
 static void yajl_writer(void *context, const char *str, size_t len)
 {
     FILE *file = (FILE *)context;
@@ -883,6 +857,7 @@ static Result<string, string> com_save_to(exec_context &ec, string cmdline, vect
     bookmark_vector<vis_line_t> all_user_marks;
 
     if (args[0] == "write-csv-to" ||
+        args[0] == "write-arrow-to" ||
         args[0] == "write-json-to" ||
         args[0] == "write-jsonlines-to" ||
         args[0] == "write-cols-to" ||
@@ -948,8 +923,6 @@ static Result<string, string> com_save_to(exec_context &ec, string cmdline, vect
     int line_count = 0;
 
     if (args[0] == "write-csv-to") {
-        std::vector<std::vector<const char *> >::iterator row_iter;
-        std::vector<const char *>::iterator iter;
         std::vector<db_label_source::header_meta>::iterator hdr_iter;
         bool first = true;
 
@@ -964,22 +937,19 @@ static Result<string, string> com_save_to(exec_context &ec, string cmdline, vect
         }
         fprintf(outfile, "\n");
 
-        for (row_iter = dls.dls_rows.begin();
-             row_iter != dls.dls_rows.end();
-             ++row_iter) {
-            if (ec.ec_dry_run &&
-                distance(dls.dls_rows.begin(), row_iter) > 10) {
+        for (size_t row = 0; row < dls.dls_rows.size(); row++) {
+            if (ec.ec_dry_run && row > 10) {
                 break;
             }
 
+            auto cells = dls.dls_rows[row];
+
             first = true;
-            for (iter = row_iter->begin();
-                 iter != row_iter->end();
-                 ++iter) {
+            for (size_t col = 0; col < cells.size(); col++) {
                 if (!first) {
                     fprintf(outfile, ",");
                 }
-                csv_write_string(outfile, *iter);
+                csv_write_string(outfile, cells[col]);
                 first = false;
             }
             fprintf(outfile, "\n");
@@ -1086,6 +1056,19 @@ static Result<string, string> com_save_to(exec_context &ec, string cmdline, vect
             }
         }
     }
+    else if (args[0] == "write-arrow-to") {
+        auto write_res = lnav::arrow_ipc::write_results(
+            outfile, dls, ec.ec_dry_run ? 11 : SIZE_MAX);
+
+        if (write_res.isErr()) {
+            if (toclose != nullptr) {
+                closer(toclose);
+            }
+            return ec.make_error("unable to write Arrow stream -- {}",
+                                 write_res.unwrapErr());
+        }
+        line_count = write_res.unwrap();
+    }
     else if (args[0] == "write-jsonlines-to") {
         yajlpp_gen gen;
 
@@ -1125,21 +1108,15 @@ static Result<string, string> com_save_to(exec_context &ec, string cmdline, vect
     }
     else if (args[0] == "write-raw-to") {
         if (tc == &lnav_data.ld_views[LNV_DB]) {
-            std::vector<std::vector<const char *> >::iterator row_iter;
-            std::vector<const char *>::iterator iter;
-
-            for (row_iter = dls.dls_rows.begin();
-                 row_iter != dls.dls_rows.end();
-                 ++row_iter) {
-                if (ec.ec_dry_run &&
-                    distance(dls.dls_rows.begin(), row_iter) > 10) {
+            for (size_t row = 0; row < dls.dls_rows.size(); row++) {
+                if (ec.ec_dry_run && row > 10) {
                     break;
                 }
 
-                for (iter = row_iter->begin();
-                     iter != row_iter->end();
-                     ++iter) {
-                    fputs(*iter, outfile);
+                auto cells = dls.dls_rows[row];
+
+                for (size_t col = 0; col < cells.size(); col++) {
+                    fputs(cells[col], outfile);
                 }
                 fprintf(outfile, "\n");
 
@@ -1241,6 +1218,19 @@ static Result<string, string> com_save_to(exec_context &ec, string cmdline, vect
 
         attr_line_t al(string(buffer, rc));
 
+        if (args[0] == "write-arrow-to") {
+            // The output is binary, so describe it instead.
+            vector<string> names;
+
+            for (const auto &hdr : dls.dls_headers) {
+                names.emplace_back(hdr.hm_name);
+            }
+            al = attr_line_t(fmt::format(
+                "Apache Arrow stream with {} column(s): {}",
+                names.size(),
+                fmt::join(names, ", ")));
+        }
+
         lnav_data.ld_preview_source
                  .replace_with(al)
                  .set_text_format(detect_text_format(al.get_string()))
@@ -2293,7 +2283,6 @@ static Result<string, string> com_open(exec_context &ec, string cmdline, vector<
                 } else {
                     auto fifo_piper = make_shared<piper_proc>(
                         fifo_fd.release(),
-                        false,
                         open_temp_file(ghc::filesystem::temp_directory_path() /
                                        "lnav.fifo.XXXXXX")
                             .map([](auto pair) {
@@ -3782,6 +3771,29 @@ static Result<string, string> com_redraw(exec_context &ec, string cmdline, vecto
     return Ok(string());
 }
 
+static Result<string, string> com_perf(exec_context &ec, string cmdline, vector<string> &args)
+{
+    string retval;
+
+    if (args.empty()) {
+        return Ok(retval);
+    }
+    if (args.size() > 2 || (args.size() == 2 && args[1] != "reset")) {
+        return ec.make_error("expecting 'reset' or no arguments");
+    }
+    if (ec.ec_dry_run) {
+        return Ok(retval);
+    }
+    if (args.size() == 2) {
+        lnav::perf::reset();
+        return Ok(string("info: reset the performance counters"));
+    }
+
+    string alt_msg;
+
+    return execute_sql(ec, "SELECT * FROM lnav_perf", alt_msg);
+}
+
 static Result<string, string> com_echo(exec_context &ec, string cmdline, vector<string> &args)
 {
     string retval = "error: expecting a message";
@@ -4366,9 +4378,11 @@ public:
         auto end_row = dls.row_for_time({ sr.sr_end_time, 0 }).value_or(dls.dls_rows.size());
 
         for (auto lpc = begin_row; lpc < end_row; ++lpc) {
-            double value = 0.0;
+            double value = dls.dls_rows.number(lpc, this->dsvs_column_index);
 
-            sscanf(dls.dls_rows[lpc][this->dsvs_column_index], "%lf", &value);
+            if (std::isnan(value)) {
+                value = 0.0;
+            }
 
             row_out.add_value(sr, value, false);
         }
@@ -5186,6 +5200,19 @@ readline_context::command_t STD_COMMANDS[] = {
                 "/tmp/table.csv"
             })
     },
+    {
+        "write-arrow-to",
+        com_save_to,
+
+        help_text(":write-arrow-to")
+            .with_summary("Write SQL results to the given file in the Apache Arrow IPC streaming format")
+            .with_parameter(help_text("path", "The path to the file to write"))
+            .with_tags({"io", "scripting", "sql"})
+            .with_example({
+                "To write SQL results as an Arrow stream to /tmp/table.arrows",
+                "/tmp/table.arrows"
+            })
+    },
     {
         "write-json-to",
         com_save_to,
@@ -5678,6 +5705,20 @@ readline_context::command_t STD_COMMANDS[] = {
         help_text(":redraw")
             .with_summary("Do a full redraw of the screen")
     },
+    {
+        "perf",
+        com_perf,
+
+        help_text(":perf")
+            .with_summary("Display the time spent in each phase of lnav's "
+                          "processing, as recorded in the lnav_perf table")
+            .with_parameter(help_text("reset", "Reset the counters to zero")
+                                .optional())
+            .with_example({
+                "To reset the counters before reproducing a slowdown",
+                "reset"
+            })
+    },
     {
         "zoom-to",
         com_zoom_to,
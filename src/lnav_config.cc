@@ -81,6 +81,10 @@ static auto a = injector::bind<archive_manager::config>::to_instance(+[]() {
     return &lnav_config.lc_archive_manager;
 });
 
+static auto dsc = injector::bind<db_sub_source::config>::to_instance(+[]() {
+    return &lnav_config.lc_db_sub_source;
+});
+
 static auto fvc = injector::bind<file_vtab::config>::to_instance(+[]() {
     return &lnav_config.lc_file_vtab;
 });
@@ -887,6 +891,31 @@ static struct json_path_container archive_handlers = {
         .with_example("12h")
         .for_field(&_lnav_config::lc_archive_manager,
                    &archive_manager::config::amc_cache_ttl),
+    yajlpp::property_handler("streaming")
+        .with_synopsis("bool")
+        .with_description(
+            "Start indexing the files in an archive while the archive is "
+            "still being unpacked")
+        .for_field(&_lnav_config::lc_archive_manager,
+                   &archive_manager::config::amc_streaming),
+    yajlpp::property_handler("extract-workers")
+        .with_synopsis("<count>")
+        .with_description(
+            "The maximum number of threads to use when unpacking archives")
+        .with_min_value(1)
+        .for_field(&_lnav_config::lc_archive_manager,
+                   &archive_manager::config::amc_extract_workers),
+};
+
+static struct json_path_container db_view_handlers = {
+    yajlpp::property_handler("max-resident-size")
+        .with_synopsis("<bytes>")
+        .with_description(
+            "The amount of query result data to keep in memory before "
+            "moving older rows to a temporary file")
+        .with_min_value(0)
+        .for_field(&_lnav_config::lc_db_sub_source,
+                   &db_sub_source::config::dsc_max_resident_size),
 };
 
 static struct json_path_container file_vtab_handlers = {
@@ -907,6 +936,27 @@ static struct json_path_container logfile_handlers = {
         .with_min_value(1)
         .for_field(&_lnav_config::lc_logfile,
                    &lnav::logfile::config::lc_max_unrecognized_lines),
+    yajlpp::property_handler("capture-cache-size")
+        .with_synopsis("<bytes>")
+        .with_description(
+            "The maximum number of bytes to use for each file to remember the positions of the values captured by a log format's pattern")
+        .with_min_value(0)
+        .for_field(&_lnav_config::lc_logfile,
+                   &lnav::logfile::config::lc_capture_cache_size),
+    yajlpp::property_handler("index-chunk-size")
+        .with_synopsis("<bytes>")
+        .with_description(
+            "The size of the chunks of a large log file that are indexed in parallel, zero disables parallel indexing")
+        .with_min_value(0)
+        .for_field(&_lnav_config::lc_logfile,
+                   &lnav::logfile::config::lc_index_chunk_size),
+    yajlpp::property_handler("rss-budget")
+        .with_synopsis("<bytes>")
+        .with_description(
+            "The resident memory size that lnav tries to stay under by paging out the parts of the log indexes that are not in view to swap, zero means no limit.  This has no effect when there is no swap space")
+        .with_min_value(0)
+        .for_field(&_lnav_config::lc_logfile,
+                   &lnav::logfile::config::lc_rss_budget),
 };
 
 static struct json_path_container ssh_config_handlers = {
@@ -1040,6 +1090,9 @@ static struct json_path_container tuning_handlers = {
     yajlpp::property_handler("archive-manager")
         .with_description("Settings related to opening archive files")
         .with_children(archive_handlers),
+    yajlpp::property_handler("db-view")
+        .with_description("Settings related to the SQL query results view")
+        .with_children(db_view_handlers),
     yajlpp::property_handler("file-vtab")
         .with_description("Settings related to the lnav_file virtual-table")
         .with_children(file_vtab_handlers),
@@ -47,6 +47,7 @@
 
 #include "lnav_config_fwd.hh"
 #include "archive_manager.cfg.hh"
+#include "db_sub_source.cfg.hh"
 #include "file_vtab.cfg.hh"
 #include "logfile.cfg.hh"
 #include "tailer/tailer.looper.cfg.hh"
@@ -97,6 +98,7 @@ struct _lnav_config {
     key_map lc_active_keymap;
 
     archive_manager::config lc_archive_manager;
+    db_sub_source::config lc_db_sub_source;
     file_vtab::config lc_file_vtab;
     lnav::logfile::config lc_logfile;
     tailer::config lc_tailer;
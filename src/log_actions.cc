@@ -122,7 +122,6 @@ static string execute_action(log_data_helper &ldh,
             if (out_pipe.read_end() != -1) {
                 auto pp = make_shared<piper_proc>(
                     out_pipe.read_end(),
-                    false,
                     open_temp_file(ghc::filesystem::temp_directory_path() /
                                    "lnav.action.XXXXXX")
                         .map([](auto pair) {
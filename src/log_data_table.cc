@@ -176,11 +176,13 @@ bool log_data_table::next(log_cursor &lc, logfile_sub_source &lss)
 
 void log_data_table::extract(std::shared_ptr<logfile> lf, uint64_t line_number,
                              shared_buffer_ref &line,
-                             std::vector<logline_value> &values)
+                             std::vector<logline_value> &values,
+                             const value_projection &projection)
 {
     auto meta_iter = this->ldt_value_metas.begin();
 
-    this->ldt_format_impl->extract(lf, line_number, line, values);
+    this->ldt_format_impl->extract(lf, line_number, line, values,
+                                   value_projection());
     values.emplace_back(*meta_iter, this->ldt_instance);
     ++meta_iter;
     for (auto &ldt_pair : this->ldt_pairs) {
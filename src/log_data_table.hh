@@ -66,7 +66,8 @@ public:
     void extract(std::shared_ptr<logfile> lf,
                  uint64_t line_number,
                  shared_buffer_ref &line,
-                 std::vector<logline_value> &values) override;
+                 std::vector<logline_value> &values,
+                 const value_projection &projection) override;
 
 private:
     logfile_sub_source &ldt_log_source;
@@ -33,8 +33,11 @@
 #include <stdarg.h>
 #include <string.h>
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 
+#include "base/injector.hh"
 #include "base/string_util.hh"
 #include "fmt/format.h"
 #include "yajlpp/yajlpp.hh"
@@ -46,6 +49,7 @@
 #include "log_search_table.hh"
 #include "command_executor.hh"
 #include "lnav_util.hh"
+#include "logfile.cfg.hh"
 
 using namespace std;
 
@@ -230,6 +234,83 @@ vector<std::shared_ptr<log_format>> &log_format::get_root_formats()
     return lf_root_formats;
 }
 
+/**
+ * Guards the state that is shared between the threads that scan files:
+ * the MODULE_FORMATS map and the root formats, which are changed by
+ * specialized().
+ */
+static std::mutex ROOT_FORMATS_MUTEX;
+
+/**
+ * Bumped under ROOT_FORMATS_MUTEX when the root formats change, so the
+ * threads can check if their copies are current without taking the lock.
+ */
+static std::atomic<uint64_t> ROOT_FORMATS_GENERATION{1};
+
+/**
+ * Bumped under ROOT_FORMATS_MUTEX when a module is added to
+ * MODULE_FORMATS.
+ */
+static std::atomic<uint64_t> MODULE_FORMATS_GENERATION{1};
+
+void log_format::root_formats_changed()
+{
+    std::lock_guard<std::mutex> lg(ROOT_FORMATS_MUTEX);
+
+    ROOT_FORMATS_GENERATION += 1;
+}
+
+vector<std::shared_ptr<log_format>> &log_format::get_detection_formats()
+{
+    thread_local struct {
+        uint64_t df_generation{0};
+        std::vector<std::shared_ptr<log_format>> df_copies;
+    } detection;
+
+    if (detection.df_generation != ROOT_FORMATS_GENERATION.load()) {
+        std::lock_guard<std::mutex> lg(ROOT_FORMATS_MUTEX);
+        auto &roots = get_root_formats();
+
+        detection.df_generation = ROOT_FORMATS_GENERATION.load();
+        detection.df_copies.clear();
+        for (auto &root : roots) {
+            auto copy = root->specialized();
+
+            copy->lf_specialized = false;
+            detection.df_copies.emplace_back(std::move(copy));
+        }
+    }
+
+    return detection.df_copies;
+}
+
+/**
+ * Look up a module in a copy of MODULE_FORMATS that is kept by each thread.
+ * The lock is only taken when a module was added since the last lookup.
+ */
+static module_format find_module_format(
+    const intern_string_t &mod_name)
+{
+    thread_local struct {
+        uint64_t ms_generation{0};
+        external_log_format::mod_map_t ms_formats;
+    } snapshot;
+
+    if (snapshot.ms_generation != MODULE_FORMATS_GENERATION.load()) {
+        std::lock_guard<std::mutex> lg(ROOT_FORMATS_MUTEX);
+
+        snapshot.ms_generation = MODULE_FORMATS_GENERATION.load();
+        snapshot.ms_formats = external_log_format::MODULE_FORMATS;
+    }
+
+    auto iter = snapshot.ms_formats.find(mod_name);
+    if (iter == snapshot.ms_formats.end()) {
+        return {};
+    }
+
+    return iter->second;
+}
+
 static bool next_format(const std::vector<std::shared_ptr<external_log_format::pattern>> &patterns,
                         int &index,
                         int &locked_index)
@@ -332,7 +413,7 @@ const char *log_format::log_scanf(uint32_t line_number,
     return retval;
 }
 
-void log_format::check_for_new_year(std::vector<logline> &dst, exttm etm,
+void log_format::check_for_new_year(logline_vector &dst, exttm etm,
                                     struct timeval log_tv)
 {
     if (dst.empty()) {
@@ -340,20 +421,20 @@ void log_format::check_for_new_year(std::vector<logline> &dst, exttm etm,
     }
 
     time_t diff = dst.back().get_time() - log_tv.tv_sec;
-    int off_year = 0, off_month = 0, off_day = 0, off_hour = 0;
+    time_rollover tr;
     bool do_change = true;
 
     if (diff <= 0) {
         return;
     }
     if ((etm.et_flags & ETF_MONTH_SET) && diff >= (24 * 60 * 60)) {
-        off_year = 1;
+        tr.tr_off_year = 1;
     } else if (diff >= (24 * 60 * 60)) {
-        off_month = 1;
+        tr.tr_off_month = 1;
     } else if (!(etm.et_flags & ETF_DAY_SET) && (diff >= (60 * 60))) {
-        off_day = 1;
+        tr.tr_off_day = 1;
     } else if (!(etm.et_flags & ETF_DAY_SET)) {
-        off_hour = 1;
+        tr.tr_off_hour = 1;
     } else {
         do_change = false;
     }
@@ -362,21 +443,32 @@ void log_format::check_for_new_year(std::vector<logline> &dst, exttm etm,
         return;
     }
     log_debug("%d:detected time rollover; offsets=%d %d %d %d", dst.size(),
-              off_year, off_month, off_day, off_hour);
-    for (auto &ll : dst) {
-        time_t     ot = ll.get_time();
+              tr.tr_off_year, tr.tr_off_month, tr.tr_off_day,
+              tr.tr_off_hour);
+    apply_time_rollover(dst.begin(), dst.end(), tr);
+    if (this->lf_record_rollovers) {
+        this->lf_time_rollovers.emplace_back(tr);
+    }
+}
+
+void log_format::apply_time_rollover(logline_vector::iterator begin,
+                                     logline_vector::iterator end,
+                                     const time_rollover &tr)
+{
+    for (; begin != end; ++begin) {
+        time_t     ot = begin->get_time();
         struct tm otm;
 
         gmtime_r(&ot, &otm);
-        otm.tm_year -= off_year;
-        otm.tm_mon  -= off_month;
-        otm.tm_mday -= off_day;
-        otm.tm_hour -= off_hour;
+        otm.tm_year -= tr.tr_off_year;
+        otm.tm_mon  -= tr.tr_off_month;
+        otm.tm_mday -= tr.tr_off_day;
+        otm.tm_hour -= tr.tr_off_hour;
         auto new_time = tm2sec(&otm);
         if (new_time == -1) {
             continue;
         }
-        ll.set_time(new_time);
+        begin->set_time(new_time);
     }
 }
 
@@ -622,7 +714,7 @@ bool external_log_format::scan_for_partial(shared_buffer_ref &sbr, size_t &len_o
 }
 
 log_format::scan_result_t external_log_format::scan(logfile &lf,
-                                                    std::vector<logline> &dst,
+                                                    logline_vector &dst,
                                                     const line_info &li,
                                                     shared_buffer_ref &sbr)
 {
@@ -674,6 +766,10 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
             }
 
             jlu.jlu_sub_line_count += this->jlf_line_format_init_count;
+            if (jlu.jlu_sub_line_count > logline::MAX_SUB_OFFSET + 1) {
+                // The rest of the message is not shown.
+                jlu.jlu_sub_line_count = logline::MAX_SUB_OFFSET + 1;
+            }
             for (int lpc = 0; lpc < jlu.jlu_sub_line_count; lpc++) {
                 ll.set_sub_offset(lpc);
                 if (lpc > 0) {
@@ -691,6 +787,7 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
             if (msg != nullptr) {
                 log_debug("Unable to parse line at offset %d: %s", li.li_file_range.fr_offset, msg);
                 line_count = count(msg, msg + strlen((char *) msg), '\n') + 1;
+                line_count = std::min(line_count, logline::MAX_SUB_OFFSET + 1);
                 yajl_free_error(handle, msg);
             }
             if (!this->lf_specialized) {
@@ -717,6 +814,10 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
     int curr_fmt = -1, orig_lock = this->last_pattern_index();
     int pat_index = orig_lock;
 
+    if (dst.size() < this->elf_capture_entries.size()) {
+        this->truncate_captures(dst.size());
+    }
+
     while (::next_format(this->elf_pattern_order, curr_fmt, pat_index)) {
         auto fpat = this->elf_pattern_order[curr_fmt];
         auto& pat = fpat->p_pcre;
@@ -759,6 +860,12 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
             }
         }
 
+        if (this->lf_specialized) {
+            // Record the captures before the module handling below trims
+            // the body.
+            this->record_captures(dst.size(), curr_fmt, pc, sbr.length());
+        }
+
         log_level_t level = this->convert_level(pi, level_cap);
 
         this->lf_timestamp_flags = log_time_tm.et_flags;
@@ -776,19 +883,25 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
         if (mod_cap != nullptr) {
             intern_string_t mod_name = intern_string::lookup(
                     pi.get_substr_start(mod_cap), mod_cap->length());
-            auto mod_iter = MODULE_FORMATS.find(mod_name);
+            std::shared_ptr<log_format> mod_format;
 
-            if (mod_iter == MODULE_FORMATS.end()) {
-                mod_index = module_scan(pi, body_cap, mod_name);
-                mod_iter = MODULE_FORMATS.find(mod_name);
-            }
-            else if (mod_iter->second.mf_mod_format) {
-                mod_index = mod_iter->second.mf_mod_format->lf_mod_index;
+            {
+                std::lock_guard<std::mutex> lg(ROOT_FORMATS_MUTEX);
+                auto mod_iter = MODULE_FORMATS.find(mod_name);
+
+                if (mod_iter == MODULE_FORMATS.end()) {
+                    mod_index = module_scan(pi, body_cap, mod_name);
+                    mod_iter = MODULE_FORMATS.find(mod_name);
+                }
+                else if (mod_iter->second.mf_mod_format) {
+                    mod_index = mod_iter->second.mf_mod_format->lf_mod_index;
+                }
+                mod_format = mod_iter->second.mf_mod_format;
             }
 
             if (mod_index && level_cap && body_cap) {
                 auto mod_elf = dynamic_pointer_cast<external_log_format>(
-                    mod_iter->second.mf_mod_format);
+                    mod_format);
 
                 if (mod_elf) {
                     pcre_context_static<128> mod_pc;
@@ -913,18 +1026,21 @@ uint8_t external_log_format::module_scan(const pcre_input &pi,
             mod_index = elf->lf_mod_index;
             mf.mf_mod_format = elf->specialized(curr_fmt);
             MODULE_FORMATS[mod_name] = mf;
+            MODULE_FORMATS_GENERATION += 1;
 
             return mod_index;
         }
     }
 
     MODULE_FORMATS[mod_name] = mf;
+    MODULE_FORMATS_GENERATION += 1;
 
     return 0;
 }
 
 void external_log_format::annotate(uint64_t line_number, shared_buffer_ref &line, string_attrs_t &sa,
-                                   std::vector<logline_value> &values, bool annotate_module) const
+                                   std::vector<logline_value> &values, bool annotate_module,
+                                   const value_projection &projection) const
 {
     pcre_context_static<128> pc;
     pcre_input pi(line.get_data(), 0, line.length());
@@ -932,7 +1048,18 @@ void external_log_format::annotate(uint64_t line_number, shared_buffer_ref &line
     pcre_context::capture_t *cap, *body_cap, *module_cap = nullptr;
 
     if (this->elf_type != ELF_TYPE_TEXT) {
-        values = this->jlf_line_values;
+        if (projection.vp_columns == value_projection::ALL_COLUMNS) {
+            values = this->jlf_line_values;
+        } else {
+            values.reserve(this->jlf_line_values.size());
+            for (const auto &lv : this->jlf_line_values) {
+                if (projection.contains(lv.lv_meta.lvm_column)) {
+                    values.emplace_back(lv);
+                } else {
+                    values.emplace_back(lv.lv_meta);
+                }
+            }
+        }
         sa = this->jlf_line_attrs;
         return;
     }
@@ -944,7 +1071,8 @@ void external_log_format::annotate(uint64_t line_number, shared_buffer_ref &line
     int pat_index = this->pattern_index_for_line(line_number);
     pattern &pat = *this->elf_pattern_order[pat_index];
 
-    if (!pat.p_pcre->match(pc, pi, PCRE_NO_UTF8_CHECK)) {
+    if (!this->cached_captures(line_number, pat_index, line.length(), pc) &&
+        !pat.p_pcre->match(pc, pi, PCRE_NO_UTF8_CHECK)) {
         // A continued line still needs a body.
         lr.lr_start = 0;
         lr.lr_end = line.length();
@@ -991,6 +1119,14 @@ void external_log_format::annotate(uint64_t line_number, shared_buffer_ref &line
         pcre_context::capture_t *cap = pc[ivd.ivd_index];
         const value_def &vd = *ivd.ivd_value_def;
 
+        if (!projection.contains(vd.vd_meta.lvm_column)) {
+            values.emplace_back(vd.vd_meta);
+            if (pat.p_module_format) {
+                values.back().lv_meta.lvm_from_module = true;
+            }
+            continue;
+        }
+
         if (ivd.ivd_unit_field_index >= 0) {
             pcre_context::iterator unit_cap = pc[ivd.ivd_unit_field_index];
 
@@ -1024,11 +1160,9 @@ void external_log_format::annotate(uint64_t line_number, shared_buffer_ref &line
             body_cap->is_valid()) {
         intern_string_t mod_name = intern_string::lookup(
                 pi.get_substr_start(module_cap), module_cap->length());
-        auto mod_iter = MODULE_FORMATS.find(mod_name);
+        auto mod_format = find_module_format(mod_name).mf_mod_format;
 
-        if (mod_iter != MODULE_FORMATS.end() &&
-            mod_iter->second.mf_mod_format != nullptr) {
-            module_format &mf = mod_iter->second;
+        if (mod_format != nullptr) {
             shared_buffer_ref body_ref;
 
             body_cap->ltrim(line.get_data());
@@ -1036,7 +1170,7 @@ void external_log_format::annotate(uint64_t line_number, shared_buffer_ref &line
 
             auto pre_mod_values_size = values.size();
             auto pre_mod_sa_size = sa.size();
-            mf.mf_mod_format->annotate(line_number, body_ref, sa, values, false);
+            mod_format->annotate(line_number, body_ref, sa, values, false);
             for (size_t lpc = pre_mod_values_size; lpc < values.size(); lpc++) {
                 values[lpc].lv_origin.shift(0, body_cap->c_begin);
             }
@@ -1059,6 +1193,98 @@ void external_log_format::annotate(uint64_t line_number, shared_buffer_ref &line
     }
 }
 
+void external_log_format::truncate_captures(size_t line_count)
+{
+    if (line_count >= this->elf_capture_entries.size()) {
+        return;
+    }
+
+    this->elf_capture_pool.resize(
+        this->elf_capture_entries[line_count].ce_pool_offset);
+    this->elf_capture_entries.resize(line_count);
+}
+
+void external_log_format::record_captures(size_t line_number,
+                                          int pat_index,
+                                          const pcre_context &pc,
+                                          size_t line_length)
+{
+    if (line_length >= INVALID_CAPTURE) {
+        return;
+    }
+
+    auto capture_count = std::min(
+        this->elf_pattern_order[pat_index]->p_pcre->get_capture_count() + 1,
+        pc.get_max_count());
+    auto used = this->elf_capture_entries.size() * sizeof(capture_entry) +
+                this->elf_capture_pool.size() * sizeof(cached_capture);
+
+    if (used >= (size_t) injector::get<const lnav::logfile::config &>()
+                    .lc_capture_cache_size) {
+        return;
+    }
+
+    this->truncate_captures(line_number);
+    // Lines that were not recorded, like continuation lines, get an entry
+    // that will never match a pattern.
+    while (this->elf_capture_entries.size() < line_number) {
+        this->elf_capture_entries.emplace_back(capture_entry{
+            (uint32_t) this->elf_capture_pool.size(), 0, -1});
+    }
+    this->elf_capture_entries.emplace_back(capture_entry{
+        (uint32_t) this->elf_capture_pool.size(),
+        (uint16_t) line_length,
+        (int16_t) pat_index});
+    for (int lpc = 0; lpc < capture_count; lpc++) {
+        const auto &cap = pc.all()[lpc];
+
+        if (cap.is_valid() && lpc < pc.get_count()) {
+            this->elf_capture_pool.emplace_back(cached_capture{
+                (uint16_t) cap.c_begin, (uint16_t) cap.c_end});
+        } else {
+            this->elf_capture_pool.emplace_back(cached_capture{
+                INVALID_CAPTURE, INVALID_CAPTURE});
+        }
+    }
+}
+
+bool external_log_format::cached_captures(uint64_t line_number,
+                                          int pat_index,
+                                          size_t line_length,
+                                          pcre_context &pc) const
+{
+    if (line_number >= this->elf_capture_entries.size()) {
+        return false;
+    }
+
+    const auto &ce = this->elf_capture_entries[line_number];
+
+    if (ce.ce_pattern_index != pat_index ||
+        ce.ce_line_length != line_length) {
+        return false;
+    }
+
+    const auto &pat = *this->elf_pattern_order[pat_index];
+    auto capture_count = std::min(pat.p_pcre->get_capture_count() + 1,
+                                  pc.get_max_count());
+
+    for (int lpc = 0; lpc < capture_count; lpc++) {
+        const auto &cc = this->elf_capture_pool[ce.ce_pool_offset + lpc];
+        auto &cap = pc.all()[lpc];
+
+        if (cc.cc_begin == INVALID_CAPTURE) {
+            cap.c_begin = cap.c_end = -1;
+        } else {
+            cap.c_begin = cc.cc_begin;
+            cap.c_end = cc.cc_end;
+        }
+    }
+    pc.set_count(capture_count);
+    pc.set_pcrepp(pat.p_pcre.get());
+
+    return true;
+}
+
 void external_log_format::rewrite(exec_context &ec,
                                   shared_buffer_ref &line,
                                   string_attrs_t &sa,
@@ -1215,6 +1441,19 @@ static int rewrite_json_field(yajlpp_parse_context *ypc, const unsigned char *st
     return 1;
 }
 
+void external_log_format::release_cached_line()
+{
+    if (!this->jlf_share_manager.has_refs()) {
+        return;
+    }
+
+    // The refs to the cached line keep it and a new one is started.
+    this->jlf_share_manager.hand_off(std::make_shared<std::vector<char>>(
+        std::move(this->jlf_cached_line)));
+    this->jlf_cached_line = std::vector<char>();
+    this->jlf_cached_line.reserve(16 * 1024);
+}
+
 void external_log_format::get_subline(const logline &ll, shared_buffer_ref &sbr, bool full_message)
 {
     if (this->elf_type == ELF_TYPE_TEXT) {
@@ -1227,7 +1466,7 @@ void external_log_format::get_subline(const logline &ll, shared_buffer_ref &sbr,
         yajl_handle handle = this->jlf_yajl_handle.get();
         json_log_userdata jlu(sbr);
 
-        this->jlf_share_manager.invalidate_refs();
+        this->release_cached_line();
         this->jlf_cached_line.clear();
         this->jlf_line_values.clear();
         this->jlf_line_offsets.clear();
@@ -1506,7 +1745,8 @@ void external_log_format::get_subline(const logline &ll, shared_buffer_ref &sbr,
     }
 }
 
-void external_log_format::build(std::vector<std::string> &errors) {
+void external_log_format::build(std::vector<std::string> &errors,
+                                bool check_samples) {
     if (!this->lf_timestamp_field.empty()) {
         auto &vd = this->elf_value_defs[this->lf_timestamp_field];
         if (vd.get() == nullptr) {
@@ -1742,6 +1982,10 @@ void external_log_format::build(std::vector<std::string> &errors) {
     }
 
     for (auto &elf_sample : this->elf_samples) {
+        if (!check_samples) {
+            break;
+        }
+
         pcre_context_static<128> pc;
         pcre_input pi(elf_sample.s_line);
         bool found = false;
@@ -2140,7 +2384,9 @@ public:
             return false;
         }
 
-        this->elt_module_format.mf_mod_format = nullptr;
+        if (this->elt_module_format.mf_mod_format != nullptr) {
+            this->elt_module_format.mf_mod_format = nullptr;
+        }
         if (lf->get_format_name() == this->lfvi_format.get_name()) {
             return true;
         } else if (mod_id && mod_id == this->lfvi_format.lf_mod_index) {
@@ -2171,7 +2417,7 @@ public:
                     &line.get_data()[mod_name_range.lr_start],
                     mod_name_range.length());
                 this->vi_attrs.clear();
-                this->elt_module_format = external_log_format::MODULE_FORMATS[mod_name];
+                this->elt_module_format = find_module_format(mod_name);
                 if (!this->elt_module_format.mf_mod_format) {
                     return false;
                 }
@@ -2183,10 +2429,16 @@ public:
         return false;
     };
 
+    bool is_thread_safe() const override {
+        // Messages from a module have to be read to find their format.
+        return this->lfvi_format.lf_mod_index == 0;
+    };
+
     virtual void extract(shared_ptr<logfile> lf,
                          uint64_t line_number,
                          shared_buffer_ref &line,
-                         std::vector<logline_value> &values)
+                         std::vector<logline_value> &values,
+                         const value_projection &projection)
     {
         auto format = lf->get_format();
 
@@ -2201,11 +2453,13 @@ public:
                                                             body_ref,
                                                             this->vi_attrs,
                                                             values,
-                                                            false);
+                                                            false,
+                                                            projection);
         }
         else {
             this->vi_attrs.clear();
-            format->annotate(line_number, line, this->vi_attrs, values, false);
+            format->annotate(line_number, line, this->vi_attrs, values, false,
+                             projection);
         }
     };
 
@@ -2246,6 +2500,91 @@ std::shared_ptr<log_format> external_log_format::specialized(int fmt_lock)
     return retval;
 }
 
+std::shared_ptr<external_log_format> external_log_format::chunk_copy()
+{
+    std::vector<capture_entry> capture_entries;
+    std::vector<cached_capture> capture_pool;
+    std::vector<pattern_for_lines> pattern_locks;
+
+    // The per-line state can be large, so move it out of the way instead
+    // of copying it.
+    capture_entries.swap(this->elf_capture_entries);
+    capture_pool.swap(this->elf_capture_pool);
+    pattern_locks.swap(this->lf_pattern_locks);
+
+    auto retval = std::make_shared<external_log_format>(*this);
+
+    capture_entries.swap(this->elf_capture_entries);
+    capture_pool.swap(this->elf_capture_pool);
+    pattern_locks.swap(this->lf_pattern_locks);
+
+    if (!this->lf_pattern_locks.empty()) {
+        retval->lf_pattern_locks.emplace_back(0, this->last_pattern_index());
+    }
+    for (auto &lvs : retval->lf_value_stats) {
+        lvs.clear();
+    }
+    retval->lf_time_rollovers.clear();
+    retval->lf_record_rollovers = true;
+
+    return retval;
+}
+
+void external_log_format::merge_chunk(const external_log_format &chunk,
+                                      size_t line_offset)
+{
+    for (const auto &pfl : chunk.lf_pattern_locks) {
+        if (pfl.pfl_line == 0) {
+            // The lock that the copy started with.
+            continue;
+        }
+        this->lf_pattern_locks.emplace_back(line_offset + pfl.pfl_line,
+                                            pfl.pfl_pat_index);
+    }
+
+    if (chunk.elf_capture_entries.size() > 1) {
+        this->truncate_captures(line_offset + 1);
+
+        auto used = (this->elf_capture_entries.size() +
+                     chunk.elf_capture_entries.size()) *
+                        sizeof(capture_entry) +
+                    (this->elf_capture_pool.size() +
+                     chunk.elf_capture_pool.size()) *
+                        sizeof(cached_capture);
+
+        if (used < (size_t) injector::get<const lnav::logfile::config &>()
+                       .lc_capture_cache_size) {
+            auto pool_base = (uint32_t) this->elf_capture_pool.size();
+
+            while (this->elf_capture_entries.size() < line_offset + 1) {
+                this->elf_capture_entries.emplace_back(
+                    capture_entry{pool_base, 0, -1});
+            }
+            // The first entry is for the line before the chunk.
+            for (size_t lpc = 1; lpc < chunk.elf_capture_entries.size();
+                 lpc++) {
+                auto ce = chunk.elf_capture_entries[lpc];
+
+                ce.ce_pool_offset += pool_base;
+                this->elf_capture_entries.emplace_back(ce);
+            }
+            this->elf_capture_pool.insert(this->elf_capture_pool.end(),
+                                          chunk.elf_capture_pool.begin(),
+                                          chunk.elf_capture_pool.end());
+        }
+    }
+
+    for (size_t lpc = 0; lpc < this->lf_value_stats.size() &&
+                         lpc < chunk.lf_value_stats.size();
+         lpc++) {
+        this->lf_value_stats[lpc].merge(chunk.lf_value_stats[lpc]);
+    }
+
+    this->lf_date_time.dts_fmt_lock = chunk.lf_date_time.dts_fmt_lock;
+    this->lf_date_time.dts_fmt_len = chunk.lf_date_time.dts_fmt_len;
+    this->lf_timestamp_flags = chunk.lf_timestamp_flags;
+}
+
 bool external_log_format::match_name(const string &filename)
 {
     if (this->elf_file_pattern.empty()) {
@@ -39,6 +39,7 @@
 #include <inttypes.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <memory>
 #include <set>
 #include <list>
@@ -294,6 +295,25 @@ struct logline_value_cmp {
     int lvc_column;
 };
 
+/**
+ * The value columns that a caller of annotate() needs, where bit N is set
+ * for logline_value_meta::lvm_column N and the last bit covers every
+ * column after it.  The values for the other columns can be left as NULL.
+ */
+struct value_projection {
+    static constexpr uint64_t ALL_COLUMNS = UINT64_MAX;
+
+    bool contains(int column) const {
+        if (column < 0) {
+            return true;
+        }
+
+        return this->vp_columns & (1ULL << std::min(column, 63));
+    };
+
+    uint64_t vp_columns{ALL_COLUMNS};
+};
+
 class log_vtab_impl;
 
 /**
@@ -303,10 +323,25 @@ class log_format {
 public:
 
     /**
-     * @return The collection of builtin log formats.
+     * @return The collection of builtin log formats.  After the collection
+     *   is changed, root_formats_changed() needs to be called.
      */
     static std::vector<std::shared_ptr<log_format>> &get_root_formats();
 
+    /**
+     * Signal that the root formats have changed, so the copies returned
+     * by get_detection_formats() are made again.
+     */
+    static void root_formats_changed();
+
+    /**
+     * @return Copies of the root formats that the calling thread can use to
+     *   detect the format of a file.  Scanning changes the state of a
+     *   format, so the root formats, which are shared by every thread, are
+     *   not scanned directly.
+     */
+    static std::vector<std::shared_ptr<log_format>> &get_detection_formats();
+
     static std::shared_ptr<log_format> find_root_format(const char *name) {
         auto& fmts = get_root_formats();
         for (auto& lf : fmts) {
@@ -370,7 +405,7 @@ public:
      * @param len The length of the prefix string.
      */
     virtual scan_result_t scan(logfile &lf,
-                               std::vector<logline> &dst,
+                               logline_vector &dst,
                                const line_info &li,
                                shared_buffer_ref &sbr) = 0;
 
@@ -378,6 +413,14 @@ public:
         return false;
     };
 
+    /**
+     * @return True if scan() reads lines back through the logfile, which
+     *   can only be done by the thread that is indexing the file.
+     */
+    virtual bool scan_reads_logfile() const {
+        return false;
+    };
+
     /**
      * Remove redundant data from the log line string.
      *
@@ -390,7 +433,8 @@ public:
 
     virtual void
     annotate(uint64_t line_number, shared_buffer_ref &sbr, string_attrs_t &sa,
-                 std::vector<logline_value> &values, bool annotate_module = true) const
+                 std::vector<logline_value> &values, bool annotate_module = true,
+                 const value_projection &projection = value_projection()) const
     { };
 
     virtual void rewrite(exec_context &ec,
@@ -437,9 +481,27 @@ public:
         return &this->lf_timestamp_format[0];
     };
 
-    void check_for_new_year(std::vector<logline> &dst, exttm log_tv,
+    void check_for_new_year(logline_vector &dst, exttm log_tv,
                             timeval timeval1);
 
+    /**
+     * The amount that the times of earlier lines were moved back when a
+     * rollover was detected by check_for_new_year().
+     */
+    struct time_rollover {
+        int tr_off_year{0};
+        int tr_off_month{0};
+        int tr_off_day{0};
+        int tr_off_hour{0};
+    };
+
+    /**
+     * Move the times of the given lines back by the given rollover.
+     */
+    static void apply_time_rollover(logline_vector::iterator begin,
+                                    logline_vector::iterator end,
+                                    const time_rollover &tr);
+
     virtual std::string get_pattern_name(uint64_t line_number) const;
 
     virtual std::string get_pattern_regex(uint64_t line_number) const {
@@ -476,6 +538,13 @@ public:
     bool lf_is_self_describing{false};
     bool lf_time_ordered{true};
     bool lf_specialized{false};
+    /**
+     * If true, check_for_new_year() appends the rollovers it applies to
+     * lf_time_rollovers so they can be applied to lines that were scanned
+     * separately.
+     */
+    bool lf_record_rollovers{false};
+    std::vector<time_rollover> lf_time_rollovers;
 protected:
     static std::vector<std::shared_ptr<log_format>> lf_root_formats;
 
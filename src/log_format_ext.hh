@@ -127,6 +127,10 @@ public:
         this->jlf_line_offsets.reserve(128);
     };
 
+    ~external_log_format() override {
+        this->release_cached_line();
+    };
+
     const intern_string_t get_name() const {
         return this->elf_name;
     };
@@ -136,21 +140,30 @@ public:
     bool match_mime_type(const file_format_t ff) const;
 
     scan_result_t scan(logfile &lf,
-                       std::vector<logline> &dst,
+                       logline_vector &dst,
                        const line_info &offset,
                        shared_buffer_ref &sbr);
 
     bool scan_for_partial(shared_buffer_ref &sbr, size_t &len_out) const;
 
     void annotate(uint64_t line_number, shared_buffer_ref &line, string_attrs_t &sa,
-                  std::vector<logline_value> &values, bool annotate_module = true) const;
+                  std::vector<logline_value> &values, bool annotate_module = true,
+                  const value_projection &projection = value_projection()) const;
 
     void rewrite(exec_context &ec,
                  shared_buffer_ref &line,
                  string_attrs_t &sa,
                  std::string &value_out);
 
-    void build(std::vector<std::string> &errors);
+    /**
+     * Compile the patterns and finish setting up the format.
+     *
+     * @param errors Receives any problems found with the definition.
+     * @param check_samples If false, the samples are not matched against
+     *   the patterns.  This is only safe when they have already been
+     *   checked for this exact definition.
+     */
+    void build(std::vector<std::string> &errors, bool check_samples = true);
 
     void register_vtabs(log_vtab_manager *vtab_manager,
                         std::vector<std::string> &errors);
@@ -170,6 +183,23 @@ public:
 
     std::shared_ptr<log_format> specialized(int fmt_lock);
 
+    /**
+     * Make a copy of this specialized format that can scan a chunk of a file
+     * on another thread.  The copy keeps the current pattern and timestamp
+     * locks, but none of the per-line state, like the captures.
+     */
+    std::shared_ptr<external_log_format> chunk_copy();
+
+    /**
+     * Add the per-line state from a copy made by chunk_copy() to this
+     * format.
+     *
+     * @param chunk The copy that scanned the chunk.
+     * @param line_offset The amount to add to the copy's line numbers to
+     *   get the line numbers in the file.
+     */
+    void merge_chunk(const external_log_format &chunk, size_t line_offset);
+
     const logline_value_stats *stats_for_value(const intern_string_t &name) const {
         const logline_value_stats *retval = nullptr;
 
@@ -187,6 +217,11 @@ public:
 
     void get_subline(const logline &ll, shared_buffer_ref &sbr, bool full_message);
 
+    /**
+     * Give the cached JSON line to any refs that still point into it.
+     */
+    void release_cached_line();
+
     std::shared_ptr<log_vtab_impl> get_vtab_impl() const;
 
     const std::vector<std::string> *get_actions(const logline_value &lv) const {
@@ -431,6 +466,40 @@ public:
         return lvm;
     }
 
+    /**
+     * The position of the captures from a pattern match in scan() that are
+     * kept so that annotate() does not need to run the regex again.  The
+     * offsets are stored as 16-bit values, so only lines that are shorter
+     * than that are recorded.
+     */
+    struct capture_entry {
+        uint32_t ce_pool_offset;
+        uint16_t ce_line_length;
+        int16_t ce_pattern_index;
+    };
+
+    struct cached_capture {
+        uint16_t cc_begin;
+        uint16_t cc_end;
+    };
+
+    static constexpr uint16_t INVALID_CAPTURE = UINT16_MAX;
+
+    void truncate_captures(size_t line_count);
+
+    void record_captures(size_t line_number,
+                         int pat_index,
+                         const pcre_context &pc,
+                         size_t line_length);
+
+    bool cached_captures(uint64_t line_number,
+                         int pat_index,
+                         size_t line_length,
+                         pcre_context &pc) const;
+
+    std::vector<capture_entry> elf_capture_entries;
+    std::vector<cached_capture> elf_capture_pool;
+
     bool jlf_hide_extra;
     std::vector<json_format_element> jlf_line_format;
     int jlf_line_format_init_count{0};
@@ -447,6 +516,10 @@ public:
 private:
     const intern_string_t elf_name;
 
+    /**
+     * Find the format of a module and add it to MODULE_FORMATS.  The caller
+     * must hold the lock that guards MODULE_FORMATS.
+     */
     static uint8_t module_scan(const pcre_input &pi,
                                pcre_context::capture_t *body_cap,
                                const intern_string_t &mod_name);
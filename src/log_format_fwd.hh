@@ -34,10 +34,13 @@
 
 #include <sys/types.h>
 
+#include <vector>
+
 #include "ptimec.hh"
 #include "byte_array.hh"
 #include "log_level.hh"
 #include "attr_line.hh"
+#include "memory_budget.hh"
 
 class log_format;
 
@@ -74,6 +77,7 @@ public:
           ll_opid(opid),
           ll_sub_offset(0),
           ll_valid_utf(1),
+          ll_segment(0),
           ll_level(l),
           ll_module_id(mod),
           ll_expr_mark(0)
@@ -90,6 +94,7 @@ public:
           ll_opid(opid),
           ll_sub_offset(0),
           ll_valid_utf(1),
+          ll_segment(0),
           ll_level(l),
           ll_module_id(mod),
           ll_expr_mark(0)
@@ -101,9 +106,16 @@ public:
     /** @return The offset of the line in the file. */
     file_off_t get_offset() const { return this->ll_offset; };
 
+    /** The largest sub-offset that fits in ll_sub_offset. */
+    static constexpr uint16_t MAX_SUB_OFFSET = (1U << 14) - 1;
+
     uint16_t get_sub_offset() const { return this->ll_sub_offset; };
 
-    void set_sub_offset(uint16_t suboff) { this->ll_sub_offset = suboff; };
+    void set_sub_offset(uint16_t suboff) {
+        require(suboff <= MAX_SUB_OFFSET);
+
+        this->ll_sub_offset = suboff;
+    };
 
     /** @return The timestamp for the line. */
     time_t get_time() const { return this->ll_time; };
@@ -184,6 +196,18 @@ public:
         return this->ll_valid_utf;
     }
 
+    /**
+     * @param v True if this line is a segment of a long line that continues
+     *   the previous line without a line ending between them.
+     */
+    void set_segment(bool v) {
+        this->ll_segment = v;
+    }
+
+    bool is_segment() const {
+        return this->ll_segment;
+    }
+
     /** @param l The logging level. */
     void set_level(log_level_t l) { this->ll_level = l; };
 
@@ -295,12 +319,20 @@ private:
     time_t ll_time;
     unsigned int ll_millis : 10;
     unsigned int ll_opid : 6;
-    unsigned int ll_sub_offset : 15;
+    unsigned int ll_sub_offset : 14;
     unsigned int ll_valid_utf : 1;
+    unsigned int ll_segment : 1;
     uint8_t  ll_level;
     uint8_t  ll_module_id : 7;
     uint8_t  ll_expr_mark : 1;
     char     ll_schema[2];
 };
 
+/**
+ * The lines in a log file.  Large indexes can be moved out of memory when
+ * lnav is over its RSS budget, see memory_budget.hh.
+ */
+using logline_vector =
+    std::vector<logline, lnav::memory::spill_allocator<logline>>;
+
 #endif
@@ -145,7 +145,7 @@ class generic_log_format : public log_format {
     };
 
     scan_result_t scan(logfile &lf,
-                       vector<logline> &dst,
+                       logline_vector &dst,
                        const line_info &li,
                        shared_buffer_ref &sbr)
     {
@@ -182,7 +182,8 @@ class generic_log_format : public log_format {
     };
 
     void annotate(uint64_t line_number, shared_buffer_ref &line, string_attrs_t &sa,
-                      std::vector<logline_value> &values, bool annotate_module) const
+                      std::vector<logline_value> &values, bool annotate_module,
+                      const value_projection &projection) const
     {
         int pat_index = this->pattern_index_for_line(line_number);
         pcre_format &fmt = get_pcre_log_formats()[pat_index];
@@ -402,7 +403,7 @@ public:
         this->blf_field_defs.clear();
     };
 
-    scan_result_t scan_int(std::vector<logline> &dst,
+    scan_result_t scan_int(logline_vector &dst,
                            const line_info &li,
                            shared_buffer_ref &sbr) {
         static const intern_string_t STATUS_CODE = intern_string::lookup("bro_status_code");
@@ -479,8 +480,13 @@ public:
         }
     }
 
+    bool scan_reads_logfile() const override {
+        // The header lines are read back to find the fields.
+        return true;
+    };
+
     scan_result_t scan(logfile &lf,
-                       std::vector<logline> &dst,
+                       logline_vector &dst,
                        const line_info &li,
                        shared_buffer_ref &sbr) {
         static pcrepp SEP_RE(R"(^#separator\s+(.+))");
@@ -626,7 +632,8 @@ public:
     };
 
     void annotate(uint64_t line_number, shared_buffer_ref &sbr, string_attrs_t &sa,
-                      std::vector<logline_value> &values, bool annotate_module) const {
+                      std::vector<logline_value> &values, bool annotate_module,
+                      const value_projection &projection) const {
         static const intern_string_t TS = intern_string::lookup("bro_ts");
         static const intern_string_t UID = intern_string::lookup("bro_uid");
 
@@ -920,7 +927,7 @@ public:
         this->wlf_field_defs.clear();
     };
 
-    scan_result_t scan_int(std::vector<logline> &dst,
+    scan_result_t scan_int(logline_vector &dst,
                            const line_info &li,
                            shared_buffer_ref &sbr) {
         static const intern_string_t F_DATE = intern_string::lookup("date");
@@ -1034,8 +1041,13 @@ public:
         }
     }
 
+    bool scan_reads_logfile() const override {
+        // The header lines are read back to find the fields.
+        return true;
+    };
+
     scan_result_t scan(logfile &lf,
-                       std::vector<logline> &dst,
+                       logline_vector &dst,
                        const line_info &li,
                        shared_buffer_ref &sbr) override {
         static auto W3C_LOG_NAME = intern_string::lookup("w3c_log");
@@ -1166,7 +1178,8 @@ public:
     };
 
     void annotate(uint64_t line_number, shared_buffer_ref &sbr, string_attrs_t &sa,
-                  std::vector<logline_value> &values, bool annotate_module) const override {
+                  std::vector<logline_value> &values, bool annotate_module,
+                  const value_projection &projection) const override {
         ws_separated_string ss(sbr.get_data(), sbr.length());
 
         for (auto iter = ss.begin(); iter != ss.end(); ++iter) {
@@ -1464,7 +1477,7 @@ public:
         return retval;
     }
 
-    scan_result_t scan(logfile &lf, vector<logline> &dst, const line_info &li,
+    scan_result_t scan(logfile &lf, logline_vector &dst, const line_info &li,
                        shared_buffer_ref &sbr) override
     {
         auto p = logfmt::parser(string_fragment{sbr.get_data(), 0, (int) sbr.length()});
@@ -1543,7 +1556,8 @@ public:
 
     void
     annotate(uint64_t line_number, shared_buffer_ref &sbr, string_attrs_t &sa,
-             vector<logline_value> &values, bool annotate_module) const override
+             vector<logline_value> &values, bool annotate_module,
+             const value_projection &projection) const override
     {
         static const auto FIELDS_NAME = intern_string::lookup("fields");
 
@@ -38,6 +38,7 @@
 #include <sys/stat.h>
 
 #include <map>
+#include <sstream>
 #include <string>
 
 #include "fmt/format.h"
@@ -922,7 +923,9 @@ load_format_file(const ghc::filesystem::path &filename,
     return retval;
 }
 
-static void load_from_path(const ghc::filesystem::path &path, std::vector<string> &errors)
+static void load_from_path(const ghc::filesystem::path &path,
+                           std::vector<string> &errors,
+                           hasher &format_hash)
 {
     auto format_path = path / "formats/*/*.json";
     static_root_mem<glob_t, globfree> gl;
@@ -940,6 +943,14 @@ static void load_from_path(const ghc::filesystem::path &path, std::vector<string
             vector<intern_string_t> format_list;
 
             format_list = load_format_file(filename, errors);
+
+            struct stat st;
+
+            format_hash.update(filename);
+            if (statp(filename, &st) == 0) {
+                format_hash.update(st.st_size)
+                    .update(st.st_mtime);
+            }
             if (format_list.empty()) {
                 log_warning("Empty format file: %s", filename.c_str());
             }
@@ -954,6 +965,247 @@ static void load_from_path(const ghc::filesystem::path &path, std::vector<string
     }
 }
 
+/**
+ * The results of checking the formats against each other that were saved by
+ * an earlier run.  They are reused as long as the format definitions and lnav
+ * version are the same, since matching every sample against every format is
+ * a large part of the startup time when there are many formats.
+ */
+struct format_cache {
+    std::vector<intern_string_t> fc_order;
+    std::map<std::pair<intern_string_t, std::string>, int> fc_timestamp_ends;
+};
+
+static ghc::filesystem::path format_cache_path()
+{
+    return lnav::paths::dotlnav() / "format-order.cache";
+}
+
+static nonstd::optional<format_cache>
+read_format_cache(const std::string &fingerprint)
+{
+    auto read_res = read_file(format_cache_path());
+
+    if (read_res.isErr()) {
+        return nonstd::nullopt;
+    }
+
+    std::istringstream content(read_res.unwrap());
+    std::string line;
+    format_cache retval;
+
+    if (!std::getline(content, line) || line != fingerprint) {
+        log_info("format cache is out-of-date");
+        return nonstd::nullopt;
+    }
+
+    while (std::getline(content, line)) {
+        std::istringstream line_stream(line);
+        std::vector<std::string> fields;
+        std::string field;
+
+        while (std::getline(line_stream, field, '\t')) {
+            fields.emplace_back(field);
+        }
+        if (fields.size() == 2 && fields[0] == "order") {
+            retval.fc_order.emplace_back(intern_string::lookup(fields[1]));
+        } else if (fields.size() == 4 && fields[0] == "timestamp-end") {
+            retval.fc_timestamp_ends[{
+                intern_string::lookup(fields[1]), fields[2]}] =
+                (int) strtol(fields[3].c_str(), nullptr, 10);
+        }
+    }
+
+    for (const auto& name : retval.fc_order) {
+        if (LOG_FORMATS.count(name) == 0) {
+            return nonstd::nullopt;
+        }
+    }
+    if (retval.fc_order.size() != LOG_FORMATS.size()) {
+        return nonstd::nullopt;
+    }
+
+    return retval;
+}
+
+static void write_format_cache(
+    const std::string &fingerprint,
+    const std::vector<std::shared_ptr<external_log_format>> &ordered_formats)
+{
+    auto cache_path = format_cache_path();
+    auto tmp_path = cache_path;
+    std::string content = fingerprint + "\n";
+    auto_fd cache_fd;
+
+    tmp_path += ".tmp";
+    for (const auto& elf : ordered_formats) {
+        content.append(fmt::format("order\t{}\n", elf->get_name().get()));
+        for (const auto& pat_pair : elf->elf_patterns) {
+            if (pat_pair.second->p_timestamp_end == -1) {
+                continue;
+            }
+
+            content.append(fmt::format("timestamp-end\t{}\t{}\t{}\n",
+                                       elf->get_name().get(),
+                                       pat_pair.first,
+                                       pat_pair.second->p_timestamp_end));
+        }
+    }
+
+    if ((cache_fd = openp(tmp_path, O_WRONLY | O_TRUNC | O_CREAT, 0644)) == -1 ||
+        write(cache_fd.get(), content.data(), content.length()) == -1) {
+        log_warning("unable to write format cache: %s -- %s",
+                    tmp_path.c_str(),
+                    strerror(errno));
+        return;
+    }
+    cache_fd.reset();
+
+    std::error_code ec;
+
+    ghc::filesystem::rename(tmp_path, cache_path, ec);
+    if (ec) {
+        log_warning("unable to rename format cache: %s -- %s",
+                    cache_path.c_str(),
+                    ec.message().c_str());
+    }
+}
+
+static const size_t MAX_UNRECOGNIZED_ENTRIES = 10 * 1000;
+
+/**
+ * The files that did not match any format, keyed by the hash of their
+ * first few kilobytes.  The cache is only valid for the formats with the
+ * fingerprint on the first line of the file.
+ */
+static struct {
+    std::string uc_fingerprint;
+    bool uc_loaded{false};
+    bool uc_needs_rewrite{false};
+    std::map<std::string, unrecognized_content> uc_entries;
+} UNRECOGNIZED_CACHE;
+
+static ghc::filesystem::path unrecognized_cache_path()
+{
+    return lnav::paths::dotlnav() / "unrecognized-content.cache";
+}
+
+static void load_unrecognized_cache()
+{
+    auto &uc = UNRECOGNIZED_CACHE;
+
+    uc.uc_loaded = true;
+    uc.uc_needs_rewrite = true;
+    uc.uc_entries.clear();
+
+    auto read_res = read_file(unrecognized_cache_path());
+
+    if (read_res.isErr()) {
+        return;
+    }
+
+    std::istringstream content(read_res.unwrap());
+    std::string line;
+
+    if (!std::getline(content, line) || line != uc.uc_fingerprint) {
+        return;
+    }
+
+    while (std::getline(content, line)) {
+        std::istringstream line_stream(line);
+        std::string head_key, length, key;
+
+        if (!std::getline(line_stream, head_key, '\t') ||
+            !std::getline(line_stream, length, '\t') ||
+            !std::getline(line_stream, key, '\t')) {
+            continue;
+        }
+
+        auto &entry = uc.uc_entries[head_key];
+
+        entry.uc_length = strtoll(length.c_str(), nullptr, 10);
+        entry.uc_key = key;
+    }
+
+    if (uc.uc_entries.size() > MAX_UNRECOGNIZED_ENTRIES) {
+        uc.uc_entries.clear();
+    } else {
+        uc.uc_needs_rewrite = false;
+    }
+}
+
+nonstd::optional<unrecognized_content>
+find_unrecognized_content(const std::string &head_key)
+{
+    auto &uc = UNRECOGNIZED_CACHE;
+
+    if (uc.uc_fingerprint.empty()) {
+        return nonstd::nullopt;
+    }
+    if (!uc.uc_loaded) {
+        load_unrecognized_cache();
+    }
+
+    auto iter = uc.uc_entries.find(head_key);
+
+    if (iter == uc.uc_entries.end()) {
+        return nonstd::nullopt;
+    }
+
+    return iter->second;
+}
+
+void add_unrecognized_content(const std::string &head_key,
+                              const unrecognized_content &entry)
+{
+    auto &uc = UNRECOGNIZED_CACHE;
+
+    if (uc.uc_fingerprint.empty()) {
+        return;
+    }
+    if (!uc.uc_loaded) {
+        load_unrecognized_cache();
+    }
+    if (uc.uc_entries.size() >= MAX_UNRECOGNIZED_ENTRIES) {
+        uc.uc_entries.clear();
+        uc.uc_needs_rewrite = true;
+    }
+
+    uc.uc_entries[head_key] = entry;
+
+    auto cache_path = unrecognized_cache_path();
+    std::string content;
+    int flags = O_WRONLY | O_CREAT;
+
+    if (uc.uc_needs_rewrite) {
+        content = uc.uc_fingerprint + "\n";
+        for (const auto &pair : uc.uc_entries) {
+            content.append(fmt::format("{}\t{}\t{}\n",
+                                       pair.first,
+                                       pair.second.uc_length,
+                                       pair.second.uc_key));
+        }
+        flags |= O_TRUNC;
+    } else {
+        content = fmt::format("{}\t{}\t{}\n",
+                              head_key,
+                              entry.uc_length,
+                              entry.uc_key);
+        flags |= O_APPEND;
+    }
+
+    auto_fd cache_fd;
+
+    if ((cache_fd = openp(cache_path, flags, 0644)) == -1 ||
+        write(cache_fd.get(), content.data(), content.length()) == -1) {
+        log_warning("unable to write unrecognized content cache: %s -- %s",
+                    cache_path.c_str(),
+                    strerror(errno));
+        return;
+    }
+    uc.uc_needs_rewrite = false;
+}
+
 void load_formats(const std::vector<ghc::filesystem::path> &extra_paths,
                   std::vector<std::string> &errors)
 {
@@ -962,6 +1214,9 @@ void load_formats(const std::vector<ghc::filesystem::path> &extra_paths,
     std::vector<intern_string_t> retval;
     struct userdata ud;
     yajl_handle handle;
+    hasher format_hash;
+
+    format_hash.update(std::string(VCS_PACKAGE_STRING));
 
     write_sample_file();
 
@@ -977,6 +1232,7 @@ void load_formats(const std::vector<ghc::filesystem::path> &extra_paths,
             .ypc_userdata = &ud;
         yajl_config(handle, yajl_allow_comments, 1);
         auto sf = bsf.to_string_fragment();
+        format_hash.update(sf);
         if (ypc_builtin.parse(sf) != yajl_status_ok) {
             unsigned char *msg = yajl_get_error(handle, 1,
                                                 (const unsigned char *) sf.data(),
@@ -991,21 +1247,41 @@ void load_formats(const std::vector<ghc::filesystem::path> &extra_paths,
     }
 
     for (const auto & extra_path : extra_paths) {
-        load_from_path(extra_path, errors);
+        load_from_path(extra_path, errors, format_hash);
     }
 
+    auto fingerprint = format_hash.to_string();
+    UNRECOGNIZED_CACHE.uc_fingerprint = fingerprint;
+    UNRECOGNIZED_CACHE.uc_loaded = false;
+    auto cache = errors.empty() ? read_format_cache(fingerprint)
+                                : nonstd::nullopt;
     uint8_t mod_counter = 0;
 
     vector<std::shared_ptr<external_log_format>> alpha_ordered_formats;
     for (auto iter = LOG_FORMATS.begin(); iter != LOG_FORMATS.end(); ++iter) {
         auto& elf = iter->second;
-        elf->build(errors);
+        elf->build(errors, !cache);
 
         if (elf->elf_has_module_format) {
             mod_counter += 1;
             elf->lf_mod_index = mod_counter;
         }
 
+        if (cache) {
+            for (auto& pat_pair : elf->elf_patterns) {
+                auto ts_iter = cache->fc_timestamp_ends.find(
+                    {elf->get_name(), pat_pair.first});
+
+                if (ts_iter != cache->fc_timestamp_ends.end()) {
+                    pat_pair.second->p_timestamp_end = ts_iter->second;
+                }
+            }
+            if (errors.empty()) {
+                alpha_ordered_formats.push_back(elf);
+            }
+            continue;
+        }
+
         for (auto & check_iter : LOG_FORMATS) {
             if (iter->first == check_iter.first) {
                 continue;
@@ -1031,6 +1307,14 @@ void load_formats(const std::vector<ghc::filesystem::path> &extra_paths,
 
     auto& graph_ordered_formats = external_log_format::GRAPH_ORDERED_FORMATS;
 
+    if (cache) {
+        log_info("using cached format order");
+        for (const auto& name : cache->fc_order) {
+            graph_ordered_formats.push_back(LOG_FORMATS[name]);
+        }
+        alpha_ordered_formats.clear();
+    }
+
     while (!alpha_ordered_formats.empty()) {
         vector<intern_string_t> popped_formats;
 
@@ -1080,11 +1364,16 @@ void load_formats(const std::vector<ghc::filesystem::path> &extra_paths,
         log_info("  %s", graph_ordered_format->get_name().get());
     }
 
+    if (!cache) {
+        write_format_cache(fingerprint, graph_ordered_formats);
+    }
+
     auto &roots = log_format::get_root_formats();
     auto iter = std::find_if(roots.begin(), roots.end(), [](const auto& elem) {
         return elem->get_name() == "generic_log";
     });
     roots.insert(iter, graph_ordered_formats.begin(), graph_ordered_formats.end());
+    log_format::root_formats_changed();
 }
 
 static void exec_sql_in_path(sqlite3 *db, const ghc::filesystem::path &path, std::vector<string> &errors)
@@ -37,7 +37,9 @@
 #include <vector>
 #include <string>
 
+#include "base/file_range.hh"
 #include "ghc/filesystem.hpp"
+#include "optional.hpp"
 
 class log_vtab_manager;
 
@@ -55,6 +57,28 @@ void load_format_extra(sqlite3 *db,
                        const std::vector<ghc::filesystem::path> &extra_paths,
                        std::vector<std::string> &errors);
 
+/**
+ * A range at the start of a file that did not match any log format.  The
+ * key is a hash of the file name and the contents of the range.
+ */
+struct unrecognized_content {
+    file_off_t uc_length{0};
+    std::string uc_key;
+};
+
+/**
+ * Look up a file that did not match any of the current log formats in an
+ * earlier run.
+ *
+ * @param head_key The hash of the file name and the first few kilobytes
+ *   of the file.
+ */
+nonstd::optional<unrecognized_content>
+find_unrecognized_content(const std::string &head_key);
+
+void add_unrecognized_content(const std::string &head_key,
+                              const unrecognized_content &uc);
+
 struct script_metadata {
     ghc::filesystem::path sm_path;
     std::string sm_name;
@@ -140,7 +140,8 @@ bool log_search_table::next(log_cursor &lc, logfile_sub_source &lss)
 void
 log_search_table::extract(std::shared_ptr<logfile> lf, uint64_t line_number,
                           shared_buffer_ref &line,
-                          std::vector<logline_value> &values)
+                          std::vector<logline_value> &values,
+                          const value_projection &projection)
 {
     values.emplace_back(instance_meta, this->lst_instance);
     for (int lpc = 0; lpc < this->lst_regex.get_capture_count(); lpc++) {
@@ -60,7 +60,8 @@ public:
     void extract(std::shared_ptr<logfile> lf,
                  uint64_t line_number,
                  shared_buffer_ref &line,
-                 std::vector<logline_value> &values) override;
+                 std::vector<logline_value> &values,
+                 const value_projection &projection) override;
 
     pcrepp lst_regex;
     shared_buffer_ref lst_current_line;
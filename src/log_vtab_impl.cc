@@ -30,6 +30,7 @@
 #include "config.h"
 
 #include "base/lnav_log.hh"
+#include "base/perf_counters.hh"
 #include "base/string_util.hh"
 #include "sql_util.hh"
 #include "log_vtab_impl.hh"
@@ -172,6 +173,11 @@ struct vtab {
     textview_curses *tc{nullptr};
     logfile_sub_source *lss{nullptr};
     std::shared_ptr<log_vtab_impl> vi;
+    /**
+     * True if this table is in a database other than the main one and is
+     * being scanned from another thread.
+     */
+    bool partition{false};
 };
 
 struct vtab_cursor {
@@ -179,6 +185,36 @@ struct vtab_cursor {
     struct log_cursor          log_cursor;
     shared_buffer_ref          log_msg;
     std::vector<logline_value> line_values;
+    /** The value columns used by the query, from vt_best_index(). */
+    value_projection           projection;
+
+    /**
+     * The file and line for the current row.  They are looked up when the
+     * first column of a row is requested and reused for the other columns.
+     */
+    vis_line_t                   row_vline{-1_vl};
+    logfile_sub_source::iterator row_data;
+    uint64_t                     row_line_number{0};
+    shared_ptr<logfile>          row_file;
+    logfile::iterator            row_line;
+
+    void resolve_row(logfile_sub_source &lss) {
+        if (this->row_vline == this->log_cursor.lc_curr_line) {
+            return;
+        }
+
+        content_line_t cl(lss.at(this->log_cursor.lc_curr_line));
+
+        this->row_data = lss.find_data(cl, this->row_line_number);
+        this->row_file = (*this->row_data)->get_file();
+        this->row_line = this->row_file->begin() + this->row_line_number;
+        this->row_vline = this->log_cursor.lc_curr_line;
+    };
+
+    void invalidate_row() {
+        this->row_vline = -1_vl;
+        this->row_file.reset();
+    };
 };
 
 static int vt_destructor(sqlite3_vtab *p_svt);
@@ -203,6 +239,7 @@ static int vt_create(sqlite3 *db,
     }
     p_vt->tc = vm->get_view();
     p_vt->lss = vm->get_source();
+    p_vt->partition = db != vm->get_db();
     rc = sqlite3_declare_vtab(db, p_vt->vi->get_table_statement().c_str());
 
     /* Success. Set *pp_vt and return */
@@ -280,17 +317,20 @@ static int vt_eof(sqlite3_vtab_cursor *cur)
 
 static int vt_next(sqlite3_vtab_cursor *cur)
 {
+    lnav::perf::timer perf_timer(lnav::perf::phase_t::vtab_next);
     vtab_cursor *vc   = (vtab_cursor *)cur;
     vtab *       vt   = (vtab *)cur->pVtab;
     bool         done = false;
 
     vc->line_values.clear();
     do {
-        log_cursor_latest = vc->log_cursor;
-        if (((log_cursor_latest.lc_curr_line % 1024) == 0) &&
-            (log_vtab_data.lvd_progress != NULL &&
-             log_vtab_data.lvd_progress(log_cursor_latest))) {
-            break;
+        if (!vt->partition) {
+            log_cursor_latest = vc->log_cursor;
+            if (((log_cursor_latest.lc_curr_line % 1024) == 0) &&
+                (log_vtab_data.lvd_progress != NULL &&
+                 log_vtab_data.lvd_progress(log_cursor_latest))) {
+                break;
+            }
         }
         done = vt->vi->next(vc->log_cursor, *vt->lss);
     } while (!done);
@@ -300,14 +340,16 @@ static int vt_next(sqlite3_vtab_cursor *cur)
 
 static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
 {
+    lnav::perf::timer perf_timer(lnav::perf::phase_t::vtab_column);
     vtab_cursor *vc = (vtab_cursor *)cur;
     vtab *       vt = (vtab *)cur->pVtab;
 
-    content_line_t    cl(vt->lss->at(vc->log_cursor.lc_curr_line));
-    uint64_t line_number;
-    auto ld = vt->lss->find_data(cl, line_number);
-    shared_ptr<logfile> lf = (*ld)->get_file();
-    auto ll = lf->begin() + line_number;
+    vc->resolve_row(*vt->lss);
+
+    uint64_t line_number = vc->row_line_number;
+    auto ld = vc->row_data;
+    const shared_ptr<logfile> &lf = vc->row_file;
+    auto ll = vc->row_line;
 
     require(col >= 0);
 
@@ -369,7 +411,8 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
             if (ll->is_time_skewed()) {
                 if (vc->line_values.empty()) {
                     lf->read_full_message(ll, vc->log_msg);
-                    vt->vi->extract(lf, line_number, vc->log_msg, vc->line_values);
+                    vt->vi->extract(lf, line_number, vc->log_msg,
+                                    vc->line_values, vc->projection);
                 }
 
                 struct line_range time_range;
@@ -548,7 +591,8 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
                 case 3: {
                     if (vc->line_values.empty()) {
                         lf->read_full_message(ll, vc->log_msg);
-                        vt->vi->extract(lf, line_number, vc->log_msg, vc->line_values);
+                        vt->vi->extract(lf, line_number, vc->log_msg,
+                                    vc->line_values, vc->projection);
                     }
 
                     struct line_range body_range;
@@ -589,7 +633,8 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
         else {
             if (vc->line_values.empty()) {
                 lf->read_full_message(ll, vc->log_msg);
-                vt->vi->extract(lf, line_number, vc->log_msg, vc->line_values);
+                vt->vi->extract(lf, line_number, vc->log_msg,
+                                vc->line_values, vc->projection);
             }
 
             size_t sub_col = col - VT_COL_MAX;
@@ -785,16 +830,57 @@ void log_cursor::update(unsigned char op, vis_line_t vl, bool exact)
     }
 }
 
+/**
+ * The plan from vt_best_index() that is passed to vt_filter() in idxStr.
+ * It is followed by the constraints that were picked and idxNum gives
+ * their number.
+ */
+struct vtab_index_plan {
+    uint64_t vip_columns_used;
+};
+
+/**
+ * Convert the columns used by a query, as given in
+ * sqlite3_index_info::colUsed, into the value columns to extract.
+ */
+static value_projection projection_for(uint64_t col_used)
+{
+    static const int LAST_BIT = 63;
+    value_projection retval;
+
+    if (col_used == value_projection::ALL_COLUMNS) {
+        return retval;
+    }
+
+    retval.vp_columns = col_used >> VT_COL_MAX;
+    if (col_used & (1ULL << LAST_BIT)) {
+        // The last bit of colUsed covers all of the columns after it.
+        retval.vp_columns |= ~((1ULL << (LAST_BIT - VT_COL_MAX)) - 1);
+    }
+
+    return retval;
+}
+
 static int vt_filter(sqlite3_vtab_cursor *p_vtc,
                      int idxNum, const char *idxStr,
                      int argc, sqlite3_value **argv)
 {
     vtab_cursor *p_cur = (vtab_cursor *)p_vtc;
     vtab *       vt = (vtab *)p_vtc->pVtab;
-    sqlite3_index_info::sqlite3_index_constraint *index = (
-        sqlite3_index_info::sqlite3_index_constraint *)idxStr;
+    sqlite3_index_info::sqlite3_index_constraint *index = nullptr;
+
+    if (idxStr != nullptr) {
+        auto *plan = (const vtab_index_plan *) idxStr;
+
+        p_cur->projection = projection_for(plan->vip_columns_used);
+        index = (sqlite3_index_info::sqlite3_index_constraint *)
+            (idxStr + sizeof(vtab_index_plan));
+    } else {
+        p_cur->projection = value_projection();
+    }
 
     log_info("(%p) filter called: %d", vt, idxNum);
+    p_cur->invalidate_row();
     p_cur->log_cursor.lc_curr_line = -1_vl;
     p_cur->log_cursor.lc_end_line = vis_line_t(vt->lss->text_line_count());
     vt_next(p_vtc);
@@ -880,21 +966,31 @@ static int vt_best_index(sqlite3_vtab *tab, sqlite3_index_info *p_info)
         }
     }
 
-    if (argvInUse) {
-        sqlite3_index_info::sqlite3_index_constraint *index_copy;
-        size_t len = indexes.size() * sizeof(*index_copy);
+    vtab_index_plan plan{value_projection::ALL_COLUMNS};
+    size_t index_len = indexes.size() * sizeof(indexes[0]);
+    char *plan_copy;
 
+#if SQLITE_VERSION_NUMBER >= 3010000
+    if (sqlite3_libversion_number() >= 3010000) {
+        plan.vip_columns_used = p_info->colUsed;
+    }
+#endif
+
+    plan_copy = (char *) sqlite3_malloc(sizeof(plan) + index_len);
+    if (!plan_copy) {
+        return SQLITE_NOMEM;
+    }
+    memcpy(plan_copy, &plan, sizeof(plan));
+    if (!indexes.empty()) {
+        memcpy(plan_copy + sizeof(plan), indexes.data(), index_len);
+    }
+    p_info->idxNum = argvInUse;
+    p_info->idxStr = plan_copy;
+    p_info->needToFreeIdxStr = 1;
+
+    if (argvInUse) {
         log_info("found index, passing %d args", argvInUse);
 
-        index_copy = (sqlite3_index_info::sqlite3_index_constraint *)
-            sqlite3_malloc(len);
-        if (!index_copy) {
-            return SQLITE_NOMEM;
-        }
-        memcpy(index_copy, &indexes[0], len);
-        p_info->idxNum = argvInUse;
-        p_info->idxStr = (char *) index_copy;
-        p_info->needToFreeIdxStr = 1;
         p_info->estimatedCost = 10.0;
     }
 
@@ -1098,6 +1194,32 @@ string log_vtab_manager::register_vtab(std::shared_ptr<log_vtab_impl> vi)
     return retval;
 }
 
+string log_vtab_manager::attach_vtab(sqlite3 *db, intern_string_t name)
+{
+    string retval;
+
+    if (this->vm_impls.find(name) == this->vm_impls.end()) {
+        retval = fmt::format("unknown log line table -- {}", name);
+    }
+    else {
+        auto_mem<char, sqlite3_free> errmsg;
+        auto_mem<char, sqlite3_free> sql;
+        int rc;
+
+        sqlite3_create_module(db, "log_vtab_impl", &generic_vtab_module, this);
+        sql = sqlite3_mprintf("CREATE VIRTUAL TABLE %s "
+                              "USING log_vtab_impl(%s)",
+                              name.get(),
+                              name.get());
+        rc = sqlite3_exec(db, sql, nullptr, nullptr, errmsg.out());
+        if (rc != SQLITE_OK) {
+            retval = errmsg;
+        }
+    }
+
+    return retval;
+}
+
 string log_vtab_manager::unregister_vtab(intern_string_t name)
 {
     string retval;
@@ -133,6 +133,15 @@ public:
 
     virtual bool next(log_cursor &lc, logfile_sub_source &lss) = 0;
 
+    /**
+     * @return True if is_valid() and next() only look at the index and do
+     *   not change this object, so the table can be scanned by several
+     *   threads at once.
+     */
+    virtual bool is_thread_safe() const {
+        return false;
+    };
+
     virtual void get_columns(std::vector<vtab_column> &cols) const { };
 
     virtual void get_foreign_keys(std::vector<std::string> &keys_inout) const
@@ -143,15 +152,23 @@ public:
         keys_inout.emplace_back("log_time_msecs");
     };
 
+    /**
+     * Extract the values for the columns of this table from a log message.
+     *
+     * @param projection The value columns used by the query, the others
+     *   can be left as NULL.
+     */
     virtual void extract(std::shared_ptr<logfile> lf,
                          uint64_t line_number,
                          shared_buffer_ref &line,
-                         std::vector<logline_value> &values)
+                         std::vector<logline_value> &values,
+                         const value_projection &projection)
     {
         auto format = lf->get_format();
 
         this->vi_attrs.clear();
-        format->annotate(line_number, line, this->vi_attrs, values, false);
+        format->annotate(line_number, line, this->vi_attrs, values, false,
+                         projection);
     };
 
     bool vi_supports_indexes;
@@ -179,7 +196,7 @@ public:
         }
 
         auto cl = content_line_t(lss.at(lc.lc_curr_line));
-        auto lf = lss.find(cl);
+        auto lf = lss.find_file_ptr(cl);
         auto lf_iter = lf->begin() + cl;
         uint8_t mod_id = lf_iter->get_module_id();
 
@@ -187,8 +204,7 @@ public:
             return false;
         }
 
-        auto format = lf->get_format();
-        if (format->get_name() == this->lfvi_format.get_name()) {
+        if (lf->get_format_name() == this->lfvi_format.get_name()) {
             return true;
         } else if (mod_id && mod_id == this->lfvi_format.lf_mod_index) {
             // XXX
@@ -198,6 +214,10 @@ public:
         return false;
     };
 
+    bool is_thread_safe() const override {
+        return true;
+    };
+
 protected:
     const log_format &lfvi_format;
 
@@ -245,6 +265,8 @@ public:
                      logfile_sub_source &lss);
     ~log_vtab_manager();
 
+    sqlite3 *get_db() const { return this->vm_db; };
+
     textview_curses *get_view() const { return &this->vm_textview; };
 
     logfile_sub_source *get_source() { return &this->vm_source; };
@@ -252,6 +274,15 @@ public:
     std::string register_vtab(std::shared_ptr<log_vtab_impl> vi);
     std::string unregister_vtab(intern_string_t name);
 
+    /**
+     * Create a registered table in another database so that it can be
+     * scanned from another thread.  The tables in other databases do not
+     * report progress, that is left to the caller.
+     *
+     * @return An error message or an empty string on success.
+     */
+    std::string attach_vtab(sqlite3 *db, intern_string_t name);
+
     std::shared_ptr<log_vtab_impl> lookup_impl(intern_string_t name) const
     {
         auto iter = this->vm_impls.find(name);
@@ -0,0 +1,1175 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file log_vtab_partition.cc
+ */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include "base/lnav_log.hh"
+#include "auto_mem.hh"
+#include "log_vtab_impl.hh"
+#include "sqlite-extension-func.hh"
+#include "log_vtab_partition.hh"
+
+int register_collation_functions(sqlite3 *db);
+
+const size_t partitioned_query::MIN_PARTITION_LINES = 16 * 1024;
+const size_t partitioned_query::MAX_PARTITIONS = 8;
+
+namespace {
+
+enum class token_kind_t {
+    ident,
+    literal,
+    punct,
+};
+
+struct sql_token {
+    token_kind_t st_kind;
+    size_t st_start;
+    size_t st_end;
+    /** The unquoted name for identifiers, the text for everything else. */
+    std::string st_name;
+    /** The lower-case version of st_name, for comparisons. */
+    std::string st_value;
+    bool st_quoted{false};
+
+    bool is_keyword(const char *kw) const {
+        return this->st_kind == token_kind_t::ident && !this->st_quoted &&
+               this->st_value == kw;
+    };
+
+    bool is_punct(const char *text) const {
+        return this->st_kind == token_kind_t::punct && this->st_value == text;
+    };
+};
+
+using token_range = std::pair<size_t, size_t>;
+
+const size_t NOT_FOUND = (size_t) -1;
+
+/**
+ * The columns that are computed from the index and file metadata and do
+ * not need the content of the log message, so they can be read by several
+ * threads at once.  The collation is the one declared in LOG_COLUMNS.
+ */
+const struct {
+    const char *ic_name;
+    const char *ic_collation;
+} INDEX_COLUMNS[] = {
+    {"log_line", ""},
+    {"log_time", ""},
+    {"log_idle_msecs", ""},
+    {"log_level", "loglevel"},
+    {"log_mark", ""},
+    {"log_comment", ""},
+    {"log_tags", ""},
+    {"log_filters", ""},
+    {"log_time_msecs", ""},
+    {"log_path", "naturalnocase"},
+};
+
+const char *KEYWORDS[] = {
+    "select", "from", "where", "group", "order", "by", "limit", "offset",
+    "as", "asc", "desc", "and", "or", "not", "in", "is", "isnull",
+    "notnull", "null", "true", "false", "like", "glob", "escape", "between",
+    "case", "when", "then", "else", "end", "cast", "integer", "int", "real",
+    "text", "numeric",
+};
+
+/**
+ * The scalar functions that give the same result on any connection and do
+ * not touch any lnav state.
+ */
+const char *SCALAR_FUNCTIONS[] = {
+    "abs", "coalesce", "ifnull", "iif", "instr", "length", "lower", "ltrim",
+    "max", "min", "nullif", "replace", "round", "rtrim", "substr", "trim",
+    "typeof", "upper", "hex", "date", "time", "datetime", "julianday",
+    "strftime", "timeslice",
+};
+
+template<size_t N>
+bool contains(const char *(&names)[N], const std::string &name)
+{
+    return std::any_of(std::begin(names), std::end(names),
+                       [&name](const char *elem) { return name == elem; });
+}
+
+const char *index_column_collation(const std::string &name)
+{
+    for (const auto &ic : INDEX_COLUMNS) {
+        if (name == ic.ic_name) {
+            return ic.ic_collation;
+        }
+    }
+
+    return nullptr;
+}
+
+std::string to_lower(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(),
+                   [](unsigned char ch) { return tolower(ch); });
+    return str;
+}
+
+std::string quote_name(const std::string &name)
+{
+    std::string retval = "\"";
+
+    for (auto ch : name) {
+        if (ch == '"') {
+            retval.push_back('"');
+        }
+        retval.push_back(ch);
+    }
+    retval.push_back('"');
+
+    return retval;
+}
+
+/**
+ * Split a statement into tokens.  Only the subset of SQL that could be run
+ * in partitions is understood, anything else, like comments or parameters,
+ * is rejected.
+ */
+bool tokenize(const std::string &sql, std::vector<sql_token> &tokens_out)
+{
+    static const char *OPERATORS[] = {
+        "||", "<=", ">=", "<>", "!=", "==", "<<", ">>",
+    };
+
+    size_t index = 0;
+
+    while (index < sql.size()) {
+        auto ch = (unsigned char) sql[index];
+
+        if (isspace(ch)) {
+            index += 1;
+            continue;
+        }
+
+        sql_token tok;
+
+        tok.st_start = index;
+        if (isalpha(ch) || ch == '_') {
+            while (index < sql.size() &&
+                   (isalnum((unsigned char) sql[index]) || sql[index] == '_')) {
+                index += 1;
+            }
+            tok.st_kind = token_kind_t::ident;
+            tok.st_name = sql.substr(tok.st_start, index - tok.st_start);
+        } else if (ch == '"' || ch == '`' || ch == '[') {
+            char close = ch == '[' ? ']' : ch;
+
+            index += 1;
+            while (true) {
+                if (index >= sql.size()) {
+                    return false;
+                }
+                if (sql[index] == close) {
+                    if (close != ']' && index + 1 < sql.size() &&
+                        sql[index + 1] == close) {
+                        tok.st_name.push_back(close);
+                        index += 2;
+                        continue;
+                    }
+                    index += 1;
+                    break;
+                }
+                tok.st_name.push_back(sql[index]);
+                index += 1;
+            }
+            tok.st_kind = token_kind_t::ident;
+            tok.st_quoted = true;
+        } else if (ch == '\'') {
+            index += 1;
+            while (true) {
+                if (index >= sql.size()) {
+                    return false;
+                }
+                if (sql[index] == '\'') {
+                    if (index + 1 < sql.size() && sql[index + 1] == '\'') {
+                        index += 2;
+                        continue;
+                    }
+                    index += 1;
+                    break;
+                }
+                index += 1;
+            }
+            tok.st_kind = token_kind_t::literal;
+            tok.st_name = sql.substr(tok.st_start, index - tok.st_start);
+        } else if (isdigit(ch) ||
+                   (ch == '.' && index + 1 < sql.size() &&
+                    isdigit((unsigned char) sql[index + 1]))) {
+            while (index < sql.size()) {
+                auto nch = (unsigned char) sql[index];
+
+                if (isalnum(nch) || nch == '.') {
+                    index += 1;
+                } else if ((nch == '+' || nch == '-') &&
+                           (sql[index - 1] == 'e' || sql[index - 1] == 'E')) {
+                    index += 1;
+                } else {
+                    break;
+                }
+            }
+            tok.st_kind = token_kind_t::literal;
+            tok.st_name = sql.substr(tok.st_start, index - tok.st_start);
+        } else if (sql.compare(index, 2, "--") == 0 ||
+                   sql.compare(index, 2, "/*") == 0) {
+            return false;
+        } else {
+            tok.st_kind = token_kind_t::punct;
+            for (const auto *op : OPERATORS) {
+                if (sql.compare(index, 2, op) == 0) {
+                    tok.st_name = op;
+                    break;
+                }
+            }
+            if (tok.st_name.empty()) {
+                if (strchr("(),.;+-*/%<>=&|~", ch) == nullptr) {
+                    return false;
+                }
+                tok.st_name = std::string(1, ch);
+            }
+            index += tok.st_name.size();
+        }
+        tok.st_end = index;
+        tok.st_value = tok.st_kind == token_kind_t::ident ?
+                       to_lower(tok.st_name) : tok.st_name;
+        tokens_out.emplace_back(std::move(tok));
+    }
+
+    return true;
+}
+
+/**
+ * @return The index of the parenthesis that closes the one at the given
+ *   index or NOT_FOUND.
+ */
+size_t match_paren(const std::vector<sql_token> &tokens, size_t index, size_t end)
+{
+    int depth = 0;
+
+    for (; index < end; index++) {
+        if (tokens[index].is_punct("(")) {
+            depth += 1;
+        } else if (tokens[index].is_punct(")")) {
+            depth -= 1;
+            if (depth == 0) {
+                return index;
+            }
+        }
+    }
+
+    return NOT_FOUND;
+}
+
+/**
+ * Split a range of tokens on the commas that are not inside parentheses.
+ */
+bool split_list(const std::vector<sql_token> &tokens,
+                token_range range,
+                std::vector<token_range> &ranges_out)
+{
+    auto start = range.first;
+    int depth = 0;
+
+    for (auto lpc = range.first; lpc < range.second; lpc++) {
+        if (tokens[lpc].is_punct("(")) {
+            depth += 1;
+        } else if (tokens[lpc].is_punct(")")) {
+            depth -= 1;
+        } else if (depth == 0 && tokens[lpc].is_punct(",")) {
+            if (start == lpc) {
+                return false;
+            }
+            ranges_out.emplace_back(start, lpc);
+            start = lpc + 1;
+        }
+    }
+    if (start == range.second) {
+        return false;
+    }
+    ranges_out.emplace_back(start, range.second);
+
+    return true;
+}
+
+std::string range_text(const std::string &sql,
+                       const std::vector<sql_token> &tokens,
+                       token_range range)
+{
+    auto start = tokens[range.first].st_start;
+
+    return sql.substr(start, tokens[range.second - 1].st_end - start);
+}
+
+/**
+ * @return The text of a range of tokens without the differences in case
+ *   and spacing, so that two expressions can be compared.
+ */
+std::string range_key(const std::vector<sql_token> &tokens, token_range range)
+{
+    std::string retval;
+
+    for (auto lpc = range.first; lpc < range.second; lpc++) {
+        if (!retval.empty()) {
+            retval.push_back(' ');
+        }
+        retval.append(tokens[lpc].st_value);
+    }
+
+    return retval;
+}
+
+}
+
+/**
+ * @return The aggregate function that is called at the given index, if any.
+ *   The index of the closing parenthesis is stored in close_out.
+ */
+static partitioned_query::aggregate_t
+aggregate_at(const std::vector<sql_token> &tokens,
+             size_t index,
+             size_t end,
+             size_t &close_out)
+{
+    using aggregate_t = partitioned_query::aggregate_t;
+
+    const auto &tok = tokens[index];
+
+    if (tok.st_kind != token_kind_t::ident || tok.st_quoted ||
+        index + 1 >= end || !tokens[index + 1].is_punct("(")) {
+        return aggregate_t::none;
+    }
+
+    close_out = match_paren(tokens, index + 1, end);
+    if (close_out == NOT_FOUND) {
+        return aggregate_t::none;
+    }
+
+    if (tok.st_value == "count") {
+        return aggregate_t::count;
+    }
+    if (tok.st_value == "sum") {
+        return aggregate_t::sum;
+    }
+    if (tok.st_value == "total") {
+        return aggregate_t::total;
+    }
+    if (tok.st_value == "avg") {
+        return aggregate_t::avg;
+    }
+    if (tok.st_value == "min" || tok.st_value == "max") {
+        std::vector<token_range> args;
+
+        // With more than one argument, these are scalar functions.
+        if (close_out > index + 2 &&
+            split_list(tokens, {index + 2, close_out}, args) &&
+            args.size() > 1) {
+            return aggregate_t::none;
+        }
+        return tok.st_value == "min" ? aggregate_t::min : aggregate_t::max;
+    }
+
+    return aggregate_t::none;
+}
+
+static bool contains_aggregate(const std::vector<sql_token> &tokens,
+                               token_range range)
+{
+    for (auto lpc = range.first; lpc < range.second; lpc++) {
+        size_t close;
+
+        if (aggregate_at(tokens, lpc, range.second, close) !=
+            partitioned_query::aggregate_t::none) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @return The name of the index column if the range is just a reference to
+ *   it, optionally qualified by the table name.
+ */
+static const char *column_ref(const std::vector<sql_token> &tokens,
+                              token_range range,
+                              const std::string &table_name)
+{
+    const sql_token *col_tok = nullptr;
+
+    if (range.second - range.first == 1) {
+        col_tok = &tokens[range.first];
+    } else if (range.second - range.first == 3 &&
+               tokens[range.first].st_kind == token_kind_t::ident &&
+               tokens[range.first].st_value == table_name &&
+               tokens[range.first + 1].is_punct(".")) {
+        col_tok = &tokens[range.first + 2];
+    }
+
+    if (col_tok == nullptr || col_tok->st_kind != token_kind_t::ident) {
+        return nullptr;
+    }
+
+    for (const auto &ic : INDEX_COLUMNS) {
+        if (col_tok->st_value == ic.ic_name) {
+            return ic.ic_name;
+        }
+    }
+
+    return nullptr;
+}
+
+std::unique_ptr<partitioned_query>
+partitioned_query::analyze(log_vtab_manager &vm, const std::string &sql)
+{
+    static const char *CLAUSES[] = {
+        "from", "where", "group", "order", "limit",
+    };
+
+    auto line_count = vm.get_source()->text_line_count();
+    auto partition_count = std::min({(size_t) std::thread::hardware_concurrency(),
+                                     MAX_PARTITIONS,
+                                     line_count / MIN_PARTITION_LINES});
+
+    if (partition_count < 2) {
+        return nullptr;
+    }
+
+    std::vector<sql_token> tokens;
+
+    if (!tokenize(sql, tokens)) {
+        return nullptr;
+    }
+    while (!tokens.empty() && tokens.back().is_punct(";")) {
+        tokens.pop_back();
+    }
+    if (tokens.empty() || !tokens[0].is_keyword("select")) {
+        return nullptr;
+    }
+
+    // Find the clauses, they have to be at the top level and in order.
+    size_t clause_start[5] = {
+        NOT_FOUND, NOT_FOUND, NOT_FOUND, NOT_FOUND, NOT_FOUND,
+    };
+    std::vector<bool> structural(tokens.size());
+    size_t last_clause = 0;
+    int depth = 0;
+
+    structural[0] = true;
+    for (size_t lpc = 1; lpc < tokens.size(); lpc++) {
+        const auto &tok = tokens[lpc];
+
+        if (tok.is_punct("(")) {
+            depth += 1;
+        } else if (tok.is_punct(")")) {
+            depth -= 1;
+            if (depth < 0) {
+                return nullptr;
+            }
+        } else if (tok.is_punct(";") || tok.is_keyword("select")) {
+            return nullptr;
+        }
+
+        for (size_t clause = 0; clause < 5; clause++) {
+            if (!tok.is_keyword(CLAUSES[clause])) {
+                continue;
+            }
+            if (depth > 0 || clause_start[clause] != NOT_FOUND ||
+                (clause > 0 && clause_start[0] == NOT_FOUND) ||
+                clause < last_clause) {
+                return nullptr;
+            }
+            structural[lpc] = true;
+            if (clause == 2 || clause == 3) {
+                if (lpc + 1 >= tokens.size() ||
+                    !tokens[lpc + 1].is_keyword("by")) {
+                    return nullptr;
+                }
+                structural[lpc + 1] = true;
+                lpc += 1;
+            }
+            clause_start[clause] = lpc + 1;
+            last_clause = clause;
+        }
+    }
+    if (depth != 0 || clause_start[0] == NOT_FOUND) {
+        return nullptr;
+    }
+
+    auto clause_range = [&](size_t clause) {
+        auto end = tokens.size();
+
+        for (auto next = clause + 1; next < 5; next++) {
+            if (clause_start[next] != NOT_FOUND) {
+                end = clause_start[next] - (next == 2 || next == 3 ? 2 : 1);
+                break;
+            }
+        }
+        return token_range{clause_start[clause], end};
+    };
+
+    // The FROM clause has to be a single log table that can be scanned
+    // from several threads.
+    auto from_range = clause_range(0);
+    if (from_range.second - from_range.first != 1 ||
+        tokens[from_range.first].st_kind != token_kind_t::ident) {
+        return nullptr;
+    }
+
+    structural[from_range.first] = true;
+
+    const auto &table_name = tokens[from_range.first].st_value;
+    auto vi = vm.lookup_impl(intern_string::lookup(table_name));
+
+    if (vi == nullptr || !vi->is_thread_safe()) {
+        return nullptr;
+    }
+
+    std::vector<log_vtab_impl::vtab_column> cols;
+    std::vector<std::string> column_names = {
+        "log_part", "log_actual_time", "log_text", "log_body", "log_raw_text",
+    };
+
+    vi->get_columns(cols);
+    for (const auto &col : cols) {
+        column_names.emplace_back(to_lower(col.vc_name));
+    }
+    for (const auto &ic : INDEX_COLUMNS) {
+        column_names.emplace_back(ic.ic_name);
+    }
+
+    std::unique_ptr<partitioned_query> retval(new partitioned_query(vm));
+    std::vector<token_range> items, item_exprs;
+    std::vector<std::string> aliases;
+
+    retval->pq_table = vi->get_name();
+    retval->pq_line_count = line_count;
+    retval->pq_partition_count = partition_count;
+    if (!split_list(tokens, {1, from_range.first - 1}, items)) {
+        return nullptr;
+    }
+    for (const auto &item : items) {
+        auto expr = item;
+        std::string alias;
+
+        if (expr.second - expr.first >= 3 &&
+            tokens[expr.second - 2].is_keyword("as") &&
+            tokens[expr.second - 1].st_kind == token_kind_t::ident) {
+            const auto &alias_tok = tokens[expr.second - 1];
+
+            // An alias that hides a column would change how the GROUP BY
+            // and WHERE clauses are resolved.
+            if (std::find(column_names.begin(), column_names.end(),
+                          alias_tok.st_value) != column_names.end() ||
+                alias_tok.st_value == table_name) {
+                return nullptr;
+            }
+            alias = alias_tok.st_name;
+            aliases.emplace_back(alias_tok.st_value);
+            expr.second -= 2;
+        }
+        item_exprs.emplace_back(expr);
+
+        result_column rc;
+
+        if (!alias.empty()) {
+            rc.rc_name = alias;
+        } else if (column_ref(tokens, expr, table_name) != nullptr) {
+            rc.rc_name = column_ref(tokens, expr, table_name);
+        } else {
+            rc.rc_name = range_text(sql, tokens, expr);
+        }
+        retval->pq_columns.emplace_back(rc);
+    }
+
+    // Every identifier has to be something that is known to be safe to
+    // evaluate on another connection.
+    for (size_t lpc = 0; lpc < tokens.size(); lpc++) {
+        const auto &tok = tokens[lpc];
+        bool operand = tok.st_kind == token_kind_t::literal ||
+                       tok.is_punct(")");
+
+        if (tok.st_kind == token_kind_t::ident && !structural[lpc]) {
+            bool keyword = !tok.st_quoted && contains(KEYWORDS, tok.st_value);
+            bool call = lpc + 1 < tokens.size() && tokens[lpc + 1].is_punct("(");
+            bool qualifier = tok.st_value == table_name &&
+                             lpc + 1 < tokens.size() &&
+                             tokens[lpc + 1].is_punct(".");
+
+            if (keyword || qualifier) {
+                // Nothing to check.
+            } else if (call) {
+                size_t close;
+
+                if (tok.st_quoted ||
+                    (!contains(SCALAR_FUNCTIONS, tok.st_value) &&
+                     aggregate_at(tokens, lpc, tokens.size(), close) ==
+                     aggregate_t::none)) {
+                    return nullptr;
+                }
+            } else if (index_column_collation(tok.st_value) != nullptr ||
+                       std::find(aliases.begin(), aliases.end(),
+                                 tok.st_value) != aliases.end()) {
+                operand = true;
+            } else {
+                return nullptr;
+            }
+        }
+        // Two operands in a row would be an alias without AS or something
+        // else that is not understood here.
+        if (operand && lpc + 1 < tokens.size()) {
+            const auto &next = tokens[lpc + 1];
+
+            if (next.st_kind == token_kind_t::literal ||
+                (next.st_kind == token_kind_t::ident &&
+                 (next.st_quoted || !contains(KEYWORDS, next.st_value)) &&
+                 !(lpc + 2 < tokens.size() && tokens[lpc + 2].is_punct("(")))) {
+                return nullptr;
+            }
+        }
+    }
+
+    // Sort the select list into aggregates and the values they are grouped
+    // by and build the partial query.
+    std::string partial_sql = "SELECT ";
+    std::vector<std::string> extra_columns;
+
+    for (size_t lpc = 0; lpc < items.size(); lpc++) {
+        const auto &expr = item_exprs[lpc];
+        auto &rc = retval->pq_columns[lpc];
+        size_t close = NOT_FOUND;
+        auto agg = aggregate_at(tokens, expr.first, expr.second, close);
+        const char *collation = nullptr;
+
+        if (lpc > 0) {
+            partial_sql.append(", ");
+        }
+        if (agg != aggregate_t::none && close == expr.second - 1) {
+            token_range args{expr.first + 2, close};
+
+            if (args.first == args.second ||
+                contains_aggregate(tokens, args)) {
+                return nullptr;
+            }
+
+            auto args_text = range_text(sql, tokens, args);
+
+            rc.rc_aggregate = agg;
+            switch (agg) {
+                case aggregate_t::avg:
+                    partial_sql.append("total(" + args_text + ")");
+                    rc.rc_count_column = items.size() + extra_columns.size();
+                    extra_columns.emplace_back("count(" + args_text + ")");
+                    break;
+                case aggregate_t::min:
+                case aggregate_t::max: {
+                    auto col_name = column_ref(tokens, args, table_name);
+
+                    if (col_name != nullptr) {
+                        collation = index_column_collation(col_name);
+                    }
+                    partial_sql.append(range_text(sql, tokens, expr));
+                    break;
+                }
+                default:
+                    partial_sql.append(range_text(sql, tokens, expr));
+                    break;
+            }
+        } else if (contains_aggregate(tokens, expr)) {
+            return nullptr;
+        } else {
+            auto col_name = column_ref(tokens, expr, table_name);
+
+            if (col_name != nullptr) {
+                collation = index_column_collation(col_name);
+            }
+            partial_sql.append(range_text(sql, tokens, items[lpc]));
+        }
+        retval->pq_partial_collations.emplace_back(
+            collation == nullptr ? "" : collation);
+    }
+    for (const auto &extra : extra_columns) {
+        partial_sql.append(", ").append(extra);
+        retval->pq_partial_collations.emplace_back("");
+    }
+    partial_sql.append(" FROM ").append(range_text(sql, tokens, from_range));
+    partial_sql.append(" WHERE ");
+    if (clause_start[1] != NOT_FOUND) {
+        auto where_range = clause_range(1);
+
+        if (where_range.first == where_range.second ||
+            contains_aggregate(tokens, where_range)) {
+            return nullptr;
+        }
+        partial_sql.append("(")
+                   .append(range_text(sql, tokens, where_range))
+                   .append(") AND ");
+    }
+    partial_sql.append("log_line >= ? AND log_line < ?");
+
+    // Find the select item that a GROUP BY or ORDER BY term refers to.
+    auto find_item = [&](token_range term) -> size_t {
+        if (term.second - term.first == 1) {
+            const auto &tok = tokens[term.first];
+
+            if (tok.st_kind == token_kind_t::literal &&
+                isdigit((unsigned char) tok.st_value[0])) {
+                auto pos = strtoul(tok.st_value.c_str(), nullptr, 10);
+
+                if (pos < 1 || pos > items.size()) {
+                    return NOT_FOUND;
+                }
+                return pos - 1;
+            }
+            if (tok.st_kind == token_kind_t::ident) {
+                for (size_t lpc = 0; lpc < items.size(); lpc++) {
+                    if (items[lpc] != item_exprs[lpc] &&
+                        tokens[items[lpc].second - 1].st_value == tok.st_value) {
+                        return lpc;
+                    }
+                }
+            }
+        }
+
+        auto key = range_key(tokens, term);
+        for (size_t lpc = 0; lpc < items.size(); lpc++) {
+            if (range_key(tokens, item_exprs[lpc]) == key) {
+                return lpc;
+            }
+        }
+        return NOT_FOUND;
+    };
+
+    if (clause_start[2] != NOT_FOUND) {
+        auto group_range = clause_range(2);
+        std::vector<token_range> terms;
+
+        if (!split_list(tokens, group_range, terms)) {
+            return nullptr;
+        }
+        for (const auto &term : terms) {
+            auto index = find_item(term);
+
+            if (index == NOT_FOUND ||
+                retval->pq_columns[index].rc_aggregate != aggregate_t::none) {
+                return nullptr;
+            }
+            retval->pq_group_by.emplace_back(index);
+        }
+        partial_sql.append(" GROUP BY ")
+                   .append(range_text(sql, tokens, group_range));
+    }
+    for (size_t lpc = 0; lpc < items.size(); lpc++) {
+        if (retval->pq_columns[lpc].rc_aggregate == aggregate_t::none &&
+            std::find(retval->pq_group_by.begin(), retval->pq_group_by.end(),
+                      lpc) == retval->pq_group_by.end()) {
+            return nullptr;
+        }
+    }
+
+    if (clause_start[3] != NOT_FOUND) {
+        std::vector<token_range> terms;
+
+        if (!split_list(tokens, clause_range(3), terms)) {
+            return nullptr;
+        }
+        for (auto term : terms) {
+            const char *direction = "";
+
+            if (term.second - term.first > 1) {
+                if (tokens[term.second - 1].is_keyword("asc")) {
+                    direction = " ASC";
+                    term.second -= 1;
+                } else if (tokens[term.second - 1].is_keyword("desc")) {
+                    direction = " DESC";
+                    term.second -= 1;
+                }
+            }
+
+            auto index = find_item(term);
+
+            if (index == NOT_FOUND) {
+                return nullptr;
+            }
+            if (!retval->pq_order_by.empty()) {
+                retval->pq_order_by.append(", ");
+            }
+            retval->pq_order_by.append(std::to_string(index + 1))
+                               .append(direction);
+        }
+    }
+
+    if (clause_start[4] != NOT_FOUND) {
+        auto limit_range = clause_range(4);
+
+        if (limit_range.first == limit_range.second) {
+            return nullptr;
+        }
+        for (auto lpc = limit_range.first; lpc < limit_range.second; lpc++) {
+            const auto &tok = tokens[lpc];
+
+            if (!(tok.st_kind == token_kind_t::literal &&
+                  isdigit((unsigned char) tok.st_value[0])) &&
+                !tok.is_punct(",") && !tok.is_keyword("offset")) {
+                return nullptr;
+            }
+        }
+        retval->pq_limit = range_text(sql, tokens, limit_range);
+    }
+
+    retval->pq_partial_sql = partial_sql;
+
+    return retval;
+}
+
+namespace {
+
+/** A copy of a value from a partial result. */
+struct partial_value {
+    int pv_type{SQLITE_NULL};
+    int64_t pv_integer{0};
+    double pv_float{0.0};
+    std::string pv_text;
+};
+
+struct partition {
+    vis_line_t p_start;
+    vis_line_t p_end;
+    auto_mem<sqlite3> p_db{sqlite3_close};
+    auto_mem<sqlite3_stmt> p_stmt{sqlite3_finalize};
+    std::vector<std::vector<partial_value>> p_rows;
+    std::string p_error;
+};
+
+/**
+ * Register the lnav functions that are allowed in a partial query.  The
+ * help for them was already added when the main database was set up.
+ */
+void register_partition_funcs(sqlite3 *db)
+{
+    struct FuncDef *basic_funcs = nullptr;
+    struct FuncDefAgg *agg_funcs = nullptr;
+
+    time_extension_functions(&basic_funcs, &agg_funcs);
+    for (int lpc = 0; basic_funcs && basic_funcs[lpc].zName; lpc++) {
+        struct FuncDef &fd = basic_funcs[lpc];
+
+        sqlite3_create_function(db,
+                                fd.zName,
+                                fd.nArg,
+                                fd.eTextRep,
+                                (void *) &fd,
+                                fd.xFunc,
+                                nullptr,
+                                nullptr);
+    }
+}
+
+bool run_partition(partition *part)
+{
+    auto *stmt = part->p_stmt.in();
+    auto column_count = sqlite3_column_count(stmt);
+
+    while (true) {
+        auto rc = sqlite3_step(stmt);
+
+        if (rc == SQLITE_DONE) {
+            return true;
+        }
+        if (rc != SQLITE_ROW) {
+            part->p_error = sqlite3_errmsg(part->p_db.in());
+            return false;
+        }
+
+        std::vector<partial_value> row(column_count);
+
+        for (int col = 0; col < column_count; col++) {
+            auto &pv = row[col];
+
+            pv.pv_type = sqlite3_column_type(stmt, col);
+            switch (pv.pv_type) {
+                case SQLITE_INTEGER:
+                    pv.pv_integer = sqlite3_column_int64(stmt, col);
+                    break;
+                case SQLITE_FLOAT:
+                    pv.pv_float = sqlite3_column_double(stmt, col);
+                    break;
+                case SQLITE_TEXT:
+                    pv.pv_text.assign(
+                        (const char *) sqlite3_column_text(stmt, col),
+                        sqlite3_column_bytes(stmt, col));
+                    break;
+                case SQLITE_BLOB:
+                    pv.pv_text.assign(
+                        (const char *) sqlite3_column_blob(stmt, col),
+                        sqlite3_column_bytes(stmt, col));
+                    break;
+            }
+        }
+        part->p_rows.emplace_back(std::move(row));
+    }
+}
+
+}
+
+partitioned_query::~partitioned_query()
+{
+    if (!this->pq_temp_table.empty()) {
+        auto sql = fmt::format("DROP TABLE IF EXISTS temp.{}",
+                               this->pq_temp_table);
+
+        sqlite3_exec(this->pq_db, sql.c_str(), nullptr, nullptr, nullptr);
+    }
+}
+
+Result<std::string, std::string> partitioned_query::run(sqlite3 *db)
+{
+    static int TEMP_TABLE_COUNTER = 0;
+
+    std::vector<partition> partitions(this->pq_partition_count);
+    std::vector<std::future<bool>> workers;
+
+    this->pq_interrupted = false;
+    log_info("%s: running the query on %d partitions",
+             this->pq_table.get(),
+             (int) this->pq_partition_count);
+    for (size_t lpc = 0; lpc < partitions.size(); lpc++) {
+        auto &part = partitions[lpc];
+
+        part.p_start = vis_line_t(this->pq_line_count * lpc /
+                                  partitions.size());
+        part.p_end = vis_line_t(this->pq_line_count * (lpc + 1) /
+                                partitions.size());
+        if (sqlite3_open(":memory:", part.p_db.out()) != SQLITE_OK) {
+            return Err(std::string("unable to open a partition database"));
+        }
+        register_partition_funcs(part.p_db.in());
+        register_collation_functions(part.p_db.in());
+
+        auto attach_res = this->pq_manager.attach_vtab(part.p_db.in(),
+                                                       this->pq_table);
+        if (!attach_res.empty()) {
+            return Err(attach_res);
+        }
+        if (sqlite3_prepare_v2(part.p_db.in(),
+                               this->pq_partial_sql.c_str(),
+                               -1,
+                               part.p_stmt.out(),
+                               nullptr) != SQLITE_OK) {
+            return Err(std::string(sqlite3_errmsg(part.p_db.in())));
+        }
+        sqlite3_bind_int64(part.p_stmt.in(), 1, part.p_start);
+        sqlite3_bind_int64(part.p_stmt.in(), 2, part.p_end);
+    }
+
+    for (auto &part : partitions) {
+        workers.emplace_back(std::async(std::launch::async,
+                                        run_partition,
+                                        &part));
+    }
+
+    // Report the progress as the partitions finish and interrupt the
+    // workers if the callback asks for it.
+    log_cursor lc;
+    bool complete = true;
+
+    lc.lc_curr_line = 0_vl;
+    lc.lc_sub_index = 0;
+    lc.lc_end_line = vis_line_t(this->pq_line_count);
+    for (size_t lpc = 0; lpc < workers.size(); lpc++) {
+        auto &worker = workers[lpc];
+
+        while (worker.wait_for(std::chrono::milliseconds(100)) !=
+               std::future_status::ready) {
+            if (!this->pq_interrupted &&
+                log_vtab_data.lvd_progress != nullptr &&
+                log_vtab_data.lvd_progress(lc)) {
+                this->pq_interrupted = true;
+                for (auto &part : partitions) {
+                    sqlite3_interrupt(part.p_db.in());
+                }
+            }
+        }
+        complete = worker.get() && complete;
+        lc.lc_curr_line = partitions[lpc].p_end;
+    }
+
+    if (this->pq_interrupted) {
+        return Err(std::string("interrupted"));
+    }
+    if (!complete) {
+        for (const auto &part : partitions) {
+            if (!part.p_error.empty()) {
+                return Err(part.p_error);
+            }
+        }
+    }
+
+    // Collect the partial results in a temporary table in the main database.
+    auto column_count = this->pq_partial_collations.size();
+    auto temp_table = fmt::format("lnav_partial_results_{}",
+                                  TEMP_TABLE_COUNTER++);
+    std::string create_sql = "CREATE TEMP TABLE " + temp_table + " (";
+    std::string insert_sql = "INSERT INTO temp." + temp_table + " VALUES (";
+
+    for (size_t col = 0; col < column_count; col++) {
+        if (col > 0) {
+            create_sql.append(", ");
+            insert_sql.append(", ");
+        }
+        create_sql.append(fmt::format("c{}", col));
+        if (!this->pq_partial_collations[col].empty()) {
+            create_sql.append(" COLLATE ")
+                      .append(this->pq_partial_collations[col]);
+        }
+        insert_sql.append("?");
+    }
+    create_sql.append(")");
+    insert_sql.append(")");
+
+    auto_mem<char, sqlite3_free> errmsg;
+
+    if (sqlite3_exec(db, create_sql.c_str(), nullptr, nullptr,
+                     errmsg.out()) != SQLITE_OK) {
+        return Err(std::string(errmsg.in()));
+    }
+    this->pq_db = db;
+    this->pq_temp_table = temp_table;
+
+    auto_mem<sqlite3_stmt> insert_stmt(sqlite3_finalize);
+
+    if (sqlite3_prepare_v2(db, insert_sql.c_str(), -1, insert_stmt.out(),
+                           nullptr) != SQLITE_OK) {
+        return Err(std::string(sqlite3_errmsg(db)));
+    }
+    for (const auto &part : partitions) {
+        for (const auto &row : part.p_rows) {
+            for (size_t col = 0; col < row.size(); col++) {
+                const auto &pv = row[col];
+
+                switch (pv.pv_type) {
+                    case SQLITE_INTEGER:
+                        sqlite3_bind_int64(insert_stmt.in(), col + 1,
+                                           pv.pv_integer);
+                        break;
+                    case SQLITE_FLOAT:
+                        sqlite3_bind_double(insert_stmt.in(), col + 1,
+                                            pv.pv_float);
+                        break;
+                    case SQLITE_TEXT:
+                        sqlite3_bind_text(insert_stmt.in(), col + 1,
+                                          pv.pv_text.c_str(),
+                                          pv.pv_text.size(),
+                                          SQLITE_STATIC);
+                        break;
+                    case SQLITE_BLOB:
+                        sqlite3_bind_blob(insert_stmt.in(), col + 1,
+                                          pv.pv_text.c_str(),
+                                          pv.pv_text.size(),
+                                          SQLITE_STATIC);
+                        break;
+                    default:
+                        sqlite3_bind_null(insert_stmt.in(), col + 1);
+                        break;
+                }
+            }
+            if (sqlite3_step(insert_stmt.in()) != SQLITE_DONE) {
+                return Err(std::string(sqlite3_errmsg(db)));
+            }
+            sqlite3_reset(insert_stmt.in());
+        }
+    }
+
+    // The statement that merges the partial aggregates.
+    std::string retval = "SELECT ";
+
+    for (size_t col = 0; col < this->pq_columns.size(); col++) {
+        const auto &rc = this->pq_columns[col];
+
+        if (col > 0) {
+            retval.append(", ");
+        }
+        switch (rc.rc_aggregate) {
+            case aggregate_t::none:
+                retval.append(fmt::format("c{}", col));
+                break;
+            case aggregate_t::count:
+            case aggregate_t::sum:
+                retval.append(fmt::format("sum(c{})", col));
+                break;
+            case aggregate_t::total:
+                retval.append(fmt::format("total(c{})", col));
+                break;
+            case aggregate_t::min:
+                retval.append(fmt::format("min(c{})", col));
+                break;
+            case aggregate_t::max:
+                retval.append(fmt::format("max(c{})", col));
+                break;
+            case aggregate_t::avg:
+                retval.append(fmt::format("total(c{}) / sum(c{})",
+                                          col, rc.rc_count_column));
+                break;
+        }
+        retval.append(" AS ").append(quote_name(rc.rc_name));
+    }
+    retval.append(" FROM temp.").append(temp_table);
+    if (!this->pq_group_by.empty()) {
+        retval.append(" GROUP BY ");
+        for (size_t lpc = 0; lpc < this->pq_group_by.size(); lpc++) {
+            if (lpc > 0) {
+                retval.append(", ");
+            }
+            retval.append(fmt::format("c{}", this->pq_group_by[lpc]));
+        }
+    }
+    if (!this->pq_order_by.empty()) {
+        retval.append(" ORDER BY ").append(this->pq_order_by);
+    }
+    if (!this->pq_limit.empty()) {
+        retval.append(" LIMIT ").append(this->pq_limit);
+    }
+
+    return Ok(retval);
+}
@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file log_vtab_partition.hh
+ */
+
+#ifndef lnav_log_vtab_partition_hh
+#define lnav_log_vtab_partition_hh
+
+#include <sqlite3.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/intern_string.hh"
+#include "base/result.h"
+
+class log_vtab_manager;
+
+/**
+ * An aggregate query over a single log table that can be split into ranges
+ * of log lines so that each range is scanned on its own thread.  Each
+ * thread runs a partial query with its own SQLite connection and the
+ * partial results are collected into a temporary table in the main
+ * database.  A final statement then merges them into the same result as
+ * the original query.
+ *
+ * Only simple queries are handled: count(), sum(), total(), min(), max()
+ * and avg() over the columns that can be read from the index without
+ * touching the log file contents, with optional WHERE, GROUP BY, ORDER BY
+ * and LIMIT clauses.  Anything else is run serially as usual.
+ */
+class partitioned_query {
+public:
+    /** The aggregate functions that can be merged from partial results. */
+    enum class aggregate_t {
+        none,
+        count,
+        sum,
+        total,
+        min,
+        max,
+        avg,
+    };
+
+    /** Ranges with fewer lines than this are not worth a thread. */
+    static const size_t MIN_PARTITION_LINES;
+
+    /** The maximum number of ranges to split a query into. */
+    static const size_t MAX_PARTITIONS;
+
+    /**
+     * Check if a statement can be run in partitions.
+     *
+     * @param vm The manager for the log tables.
+     * @param sql The statement to check.
+     * @return The query to run or nullptr if the statement should be run
+     *   serially.
+     */
+    static std::unique_ptr<partitioned_query> analyze(log_vtab_manager &vm,
+                                                      const std::string &sql);
+
+    ~partitioned_query();
+
+    /**
+     * Run the partial queries and store their results in a temporary table.
+     * The progress callback in log_vtab_data is called while waiting and
+     * the query is interrupted if it returns non-zero.
+     *
+     * @param db The database to store the partial results in.
+     * @return The statement that merges the partial results or an error.
+     */
+    Result<std::string, std::string> run(sqlite3 *db);
+
+    /** @return True if the last run() was interrupted. */
+    bool is_interrupted() const {
+        return this->pq_interrupted;
+    };
+
+private:
+    struct result_column {
+        /** The name of the column in the original query. */
+        std::string rc_name;
+        aggregate_t rc_aggregate{aggregate_t::none};
+        /** For avg(), the column with the count of values. */
+        size_t rc_count_column{0};
+    };
+
+    partitioned_query(log_vtab_manager &vm) : pq_manager(vm) {};
+
+    log_vtab_manager &pq_manager;
+    intern_string_t pq_table;
+    size_t pq_line_count{0};
+    size_t pq_partition_count{0};
+    /** The columns in the original query. */
+    std::vector<result_column> pq_columns;
+    /** The collations for the columns returned by the partial query. */
+    std::vector<std::string> pq_partial_collations;
+    /** The partial query, with parameters for the range of lines. */
+    std::string pq_partial_sql;
+    /** The indexes of the columns in the GROUP BY clause. */
+    std::vector<size_t> pq_group_by;
+    std::string pq_order_by;
+    std::string pq_limit;
+    sqlite3 *pq_db{nullptr};
+    std::string pq_temp_table;
+    bool pq_interrupted{false};
+};
+
+#endif
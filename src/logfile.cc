@@ -42,13 +42,18 @@
 
 #include <time.h>
 
+#include <future>
+#include <thread>
 #include <utility>
 
 #include "base/string_util.hh"
 #include "base/injector.hh"
+#include "base/perf_counters.hh"
 #include "logfile.hh"
 #include "logfile.cfg.hh"
 #include "log_format.hh"
+#include "log_format_ext.hh"
+#include "log_format_loader.hh"
 #include "lnav_util.hh"
 
 using namespace std;
@@ -57,6 +62,10 @@ static auto intern_lifetime = intern_string::get_table_lifetime();
 
 static const size_t INDEX_RESERVE_INCREMENT = 1024;
 
+static const size_t MAX_INDEX_WORKERS = 8;
+
+static const size_t INDEX_SEGMENT_LINES = 64 * 1024;
+
 Result<std::shared_ptr<logfile>, std::string> logfile::open(
     std::string filename, logfile_open_options &loo)
 {
@@ -113,6 +122,9 @@ Result<std::shared_ptr<logfile>, std::string> logfile::open(
 
     lf->lf_content_id = hasher().update(lf->lf_filename).to_string();
     lf->lf_line_buffer.set_fd(lf->lf_options.loo_fd);
+    if (lf->lf_options.loo_pipe_buffer != nullptr) {
+        lf->lf_line_buffer.set_pipe_buffer(lf->lf_options.loo_pipe_buffer);
+    }
     lf->lf_index.reserve(INDEX_RESERVE_INCREMENT);
 
     lf->lf_indexing = lf->lf_options.loo_is_visible;
@@ -172,14 +184,56 @@ void logfile::set_format_base_time(log_format *lf)
     lf->lf_date_time.set_base_time(file_time);
 }
 
+/**
+ * Check the lines added by a scan against the line before them.  If the
+ * format is supposed to be ordered by time, lines that go back in time are
+ * moved forward to the time of the previous line.
+ *
+ * @return True if the index needs to be sorted.
+ */
+static bool check_time_order(const log_format &format,
+                             logline_vector &index,
+                             size_t prescan_size,
+                             uint32_t &out_of_time_order_count)
+{
+    if (prescan_size == 0 || prescan_size >= index.size()) {
+        return false;
+    }
+
+    logline &second_to_last = index[prescan_size - 1];
+    logline &latest = index[prescan_size];
+
+    if (second_to_last.is_ignored() || !(latest < second_to_last)) {
+        return false;
+    }
+    if (!format.lf_time_ordered) {
+        return true;
+    }
+
+    out_of_time_order_count += 1;
+    for (size_t lpc = prescan_size; lpc < index.size(); lpc++) {
+        logline &line_to_update = index[lpc];
+
+        line_to_update.set_time_skew(true);
+        line_to_update.set_time(second_to_last.get_time());
+        line_to_update.set_millis(second_to_last.get_millis());
+    }
+
+    return false;
+}
+
 bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
 {
+    lnav::perf::timer perf_timer(lnav::perf::phase_t::format_scan);
     log_format::scan_result_t found = log_format::SCAN_NO_MATCH;
     size_t prescan_size = this->lf_index.size();
     time_t prescan_time = 0;
     bool retval = false;
 
-    if (this->lf_format.get() != nullptr) {
+    if (li.li_continued && !this->lf_index.empty()) {
+        // A segment of a long line is always part of the line before it.
+    }
+    else if (this->lf_format.get() != nullptr) {
         if (!this->lf_index.empty()) {
             prescan_time = this->lf_index[prescan_size - 1].get_time();
         }
@@ -187,9 +241,15 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
         found = this->lf_format->scan(*this, this->lf_index, li, sbr);
     }
     else if (this->lf_options.loo_detect_format &&
-             this->lf_index.size() <
-             injector::get<const lnav::logfile::config &>().lc_max_unrecognized_lines) {
-        auto &root_formats = log_format::get_root_formats();
+             li.li_file_range.fr_offset < this->lf_skip_detection_until) {
+        // A previous run found that this line does not match any format.
+    }
+    else if (this->lf_options.loo_detect_format &&
+             (this->lf_index.size() <
+              (size_t) injector::get<const lnav::logfile::config &>()
+                  .lc_max_unrecognized_lines ||
+              !this->lf_sampled_format.empty())) {
+        auto &root_formats = log_format::get_detection_formats();
         vector<std::shared_ptr<log_format>>::iterator iter;
 
         /*
@@ -199,6 +259,10 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
         for (iter = root_formats.begin();
              iter != root_formats.end() && (found != log_format::SCAN_MATCH);
              ++iter) {
+            if (!this->lf_sampled_format.empty() &&
+                (*iter)->get_name() != this->lf_sampled_format) {
+                continue;
+            }
             if (!(*iter)->match_name(this->lf_filename)) {
                 log_debug("(%s) does not match file name: %s",
                           (*iter)->get_name().get(),
@@ -228,6 +292,7 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
 
                 this->lf_text_format = text_format_t::TF_LOG;
                 this->lf_format = (*iter)->specialized();
+                this->lf_sampled_format.clear();
                 this->set_format_base_time(this->lf_format.get());
                 this->lf_content_id = hasher()
                     .update(sbr.get_data(), sbr.length())
@@ -238,6 +303,7 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
                  * written out at the same time as the last one, so we need to
                  * go back and update everything.
                  */
+                this->lf_time_index.clear();
                 logline &last_line = this->lf_index[this->lf_index.size() - 1];
 
                 for (size_t lpc = 0; lpc < this->lf_index.size() - 1; lpc++) {
@@ -253,6 +319,17 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
         }
     }
 
+    if (this->lf_format == nullptr && found == log_format::SCAN_NO_MATCH &&
+        !li.li_partial &&
+        this->lf_unrecognized_size == li.li_file_range.fr_offset &&
+        this->lf_sampled_format.empty() &&
+        (li.li_file_range.fr_offset < this->lf_skip_detection_until ||
+         this->lf_index.size() <
+         (size_t) injector::get<const lnav::logfile::config &>()
+             .lc_max_unrecognized_lines)) {
+        this->lf_unrecognized_size = li.li_file_range.next_offset();
+    }
+
     switch (found) {
         case log_format::SCAN_MATCH:
             if (!this->lf_index.empty()) {
@@ -261,28 +338,16 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
             if (prescan_size > 0 &&
                 this->lf_index.size() >= prescan_size &&
                 prescan_time != this->lf_index[prescan_size - 1].get_time()) {
+                // The times of earlier lines were rewritten, for example,
+                // when a year rollover was detected.
+                this->lf_time_index.clear();
                 retval = true;
             }
-            if (prescan_size > 0 && prescan_size < this->lf_index.size()) {
-                logline &second_to_last = this->lf_index[prescan_size - 1];
-                logline &latest = this->lf_index[prescan_size];
-
-                if (!second_to_last.is_ignored() && latest < second_to_last) {
-                    if (this->lf_format->lf_time_ordered) {
-                        this->lf_out_of_time_order_count += 1;
-                        for (size_t lpc = prescan_size;
-                             lpc < this->lf_index.size(); lpc++) {
-                            logline &line_to_update = this->lf_index[lpc];
-
-                            line_to_update.set_time_skew(true);
-                            line_to_update.set_time(second_to_last.get_time());
-                            line_to_update.set_millis(
-                                second_to_last.get_millis());
-                        }
-                    } else {
-                        retval = true;
-                    }
-                }
+            if (check_time_order(*this->lf_format,
+                                 this->lf_index,
+                                 prescan_size,
+                                 this->lf_out_of_time_order_count)) {
+                retval = true;
             }
             break;
         case log_format::SCAN_NO_MATCH: {
@@ -300,7 +365,7 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
                  */
                 last_time = ll.get_time();
                 last_millis = ll.get_millis();
-                if (this->lf_format.get() != nullptr) {
+                if (this->lf_format.get() != nullptr || li.li_continued) {
                     last_level = (log_level_t)(ll.get_level_and_flags() |
                         LEVEL_CONTINUED);
                 }
@@ -314,6 +379,7 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
                                         last_mod,
                                         last_opid);
             this->lf_index.back().set_valid_utf(li.li_valid_utf);
+            this->lf_index.back().set_segment(li.li_continued);
             break;
         }
         case log_format::SCAN_INCOMPLETE:
@@ -323,8 +389,589 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
     return retval;
 }
 
+struct logfile::index_chunk {
+    file_off_t ic_begin{0};
+    file_off_t ic_end{0};
+    std::shared_ptr<external_log_format> ic_format;
+    int ic_seed_pattern{-1};
+    int ic_seed_fmt_lock{-1};
+    int ic_seed_fmt_len{-1};
+    /**
+     * The lines in the chunk, the first entry is a placeholder for the line
+     * before the chunk since the scanners expect a previous line.
+     */
+    logline_vector ic_lines;
+    /** The index of the first line with its own timestamp, zero if none. */
+    size_t ic_first_stamped{0};
+    /** The time of that line before any rollovers were applied. */
+    struct timeval ic_first_time{0, 0};
+    size_t ic_longest_line{0};
+    uint32_t ic_out_of_time_order_count{0};
+    bool ic_sort_needed{false};
+    bool ic_complete{false};
+};
+
+/**
+ * Find the start of the first line that begins after the given offset.
+ */
+static nonstd::optional<file_off_t> next_line_start(int fd, file_off_t off)
+{
+    char buffer[16 * 1024];
+    file_off_t scan_off = off - 1;
+
+    while (scan_off < off + 1024 * 1024) {
+        auto rc = pread(fd, buffer, sizeof(buffer), scan_off);
+
+        if (rc <= 0) {
+            return nonstd::nullopt;
+        }
+
+        const auto *nl = (const char *) memchr(buffer, '\n', rc);
+
+        if (nl != nullptr) {
+            return scan_off + (nl - buffer) + 1;
+        }
+        scan_off += rc;
+    }
+
+    return nonstd::nullopt;
+}
+
+void logfile::scan_chunk(index_chunk &ic)
+{
+    try {
+        auto fd = auto_fd::dup_of(this->lf_line_buffer.get_fd());
+        line_buffer lb;
+        auto prev_range = file_range{ic.ic_begin};
+
+        lb.set_fd(fd);
+        ic.ic_lines.reserve(INDEX_RESERVE_INCREMENT);
+        ic.ic_lines.emplace_back(ic.ic_begin, 0, 0, LEVEL_UNKNOWN);
+        while (true) {
+            auto load_result = lb.load_next_line(prev_range);
+
+            if (load_result.isErr()) {
+                log_error("%s: unable to load chunk line -- %s",
+                          this->lf_filename.c_str(),
+                          load_result.unwrapErr().c_str());
+                return;
+            }
+
+            auto li = load_result.unwrap();
+
+            if (li.li_file_range.empty() ||
+                li.li_file_range.fr_offset >= ic.ic_end) {
+                break;
+            }
+            prev_range = li.li_file_range;
+
+            if (!this->lf_options.loo_non_utf_is_visible && !li.li_valid_utf) {
+                // Leave it to the serial scan to hide the file.
+                return;
+            }
+
+            auto read_result = lb.read_range(li.li_file_range);
+
+            if (read_result.isErr()) {
+                log_error("%s: unable to read chunk line -- %s",
+                          this->lf_filename.c_str(),
+                          read_result.unwrapErr().c_str());
+                return;
+            }
+
+            auto sbr = read_result.unwrap().rtrim(is_line_ending);
+            auto prescan_size = ic.ic_lines.size();
+
+            ic.ic_longest_line = std::max(ic.ic_longest_line, sbr.length());
+            auto found = li.li_continued ?
+                log_format::SCAN_NO_MATCH :
+                ic.ic_format->scan(*this, ic.ic_lines, li, sbr);
+            switch (found) {
+                case log_format::SCAN_MATCH:
+                    ic.ic_lines.back().set_valid_utf(li.li_valid_utf);
+                    if (ic.ic_first_stamped == 0) {
+                        // The lines before this one are continuations of a
+                        // message in the previous chunk and get fixed up
+                        // when the chunks are stitched together.
+                        if (prescan_size < ic.ic_lines.size() &&
+                            ic.ic_lines[prescan_size].get_time() != 0) {
+                            ic.ic_first_stamped = prescan_size;
+                            ic.ic_first_time =
+                                ic.ic_lines[prescan_size].get_timeval();
+                        }
+                    } else if (check_time_order(
+                                   *ic.ic_format,
+                                   ic.ic_lines,
+                                   prescan_size,
+                                   ic.ic_out_of_time_order_count)) {
+                        ic.ic_sort_needed = true;
+                    }
+                    break;
+                case log_format::SCAN_NO_MATCH: {
+                    auto last_line = ic.ic_lines.back();
+
+                    ic.ic_lines.emplace_back(
+                        li.li_file_range.fr_offset,
+                        last_line.get_time(),
+                        last_line.get_millis(),
+                        (log_level_t) (last_line.get_level_and_flags() |
+                                       LEVEL_CONTINUED),
+                        last_line.get_module_id(),
+                        last_line.get_opid());
+                    ic.ic_lines.back().set_valid_utf(li.li_valid_utf);
+                    ic.ic_lines.back().set_segment(li.li_continued);
+                    break;
+                }
+                case log_format::SCAN_INCOMPLETE:
+                    break;
+            }
+        }
+        ic.ic_complete = true;
+    } catch (const std::exception &e) {
+        log_error("%s: unable to scan chunk at %lld -- %s",
+                  this->lf_filename.c_str(),
+                  (long long) ic.ic_begin,
+                  e.what());
+    }
+}
+
+file_off_t logfile::index_chunks(file_off_t off,
+                                 file_off_t file_size,
+                                 size_t &limit,
+                                 bool &sort_needed)
+{
+    auto chunk_size = injector::get<const lnav::logfile::config &>()
+                          .lc_index_chunk_size;
+    auto elf = std::dynamic_pointer_cast<external_log_format>(
+        this->lf_format);
+
+    if (chunk_size <= 0 || elf == nullptr ||
+        elf->elf_type != external_log_format::ELF_TYPE_TEXT ||
+        elf->last_pattern_index() == -1 || this->lf_index.empty() ||
+        !S_ISREG(this->lf_stat.st_mode) ||
+        this->lf_line_buffer.is_compressed() ||
+        this->lf_line_buffer.is_pipe()) {
+        return off;
+    }
+
+    // The end of the file is left to the serial scan since it might still
+    // be written to.
+    size_t max_chunks = (file_size - off) / chunk_size;
+
+    if (limit != SIZE_MAX) {
+        // Do not scan many more bytes than the lines the caller asked for,
+        // based on the average length of the lines indexed so far.
+        auto avg_line_size = std::max(
+            this->lf_index_size / (file_off_t) this->lf_index.size(),
+            (file_off_t) 1);
+        auto max_bytes = (file_off_t) limit * avg_line_size;
+
+        max_chunks = std::min(max_chunks, (size_t) (max_bytes / chunk_size));
+    }
+    auto worker_count = std::min(
+        {(size_t) std::thread::hardware_concurrency(),
+         MAX_INDEX_WORKERS,
+         max_chunks > 0 ? max_chunks - 1 : 0});
+
+    if (worker_count < 2) {
+        return off;
+    }
+
+    std::vector<index_chunk> chunks;
+    auto chunk_begin = off;
+
+    chunks.reserve(worker_count);
+    for (size_t lpc = 0; lpc < worker_count; lpc++) {
+        auto chunk_end = next_line_start(this->lf_line_buffer.get_fd(),
+                                         off + (lpc + 1) * chunk_size);
+
+        if (!chunk_end || chunk_end.value() <= chunk_begin ||
+            chunk_end.value() >= file_size) {
+            break;
+        }
+
+        chunks.emplace_back();
+
+        auto &ic = chunks.back();
+
+        ic.ic_begin = chunk_begin;
+        ic.ic_end = chunk_end.value();
+        ic.ic_format = elf->chunk_copy();
+        ic.ic_seed_pattern = elf->last_pattern_index();
+        ic.ic_seed_fmt_lock = elf->lf_date_time.dts_fmt_lock;
+        ic.ic_seed_fmt_len = elf->lf_date_time.dts_fmt_len;
+        chunk_begin = ic.ic_end;
+    }
+
+    if (chunks.size() < 2) {
+        return off;
+    }
+
+    log_info("%s: indexing %lld bytes in %d chunks",
+             this->lf_filename.c_str(),
+             (long long) (chunk_begin - off),
+             (int) chunks.size());
+
+    std::vector<std::future<void>> workers;
+
+    for (size_t lpc = 1; lpc < chunks.size(); lpc++) {
+        auto &ic = chunks[lpc];
+
+        workers.emplace_back(std::async(
+            std::launch::async, [this, &ic]() { this->scan_chunk(ic); }));
+    }
+    this->scan_chunk(chunks[0]);
+    for (auto &worker : workers) {
+        worker.get();
+    }
+
+    auto retval = off;
+
+    for (auto &ic : chunks) {
+        // The chunks after the first were scanned with the pattern and
+        // timestamp locks from before the scan, so they are only used if
+        // the previous chunk ended up in the same state.  The first line
+        // is also checked against the previous chunk since a line that
+        // goes back in time would change the times of other lines.
+        if (!ic.ic_complete || ic.ic_first_stamped == 0 ||
+            ic.ic_seed_pattern != elf->last_pattern_index() ||
+            ic.ic_seed_fmt_lock != elf->lf_date_time.dts_fmt_lock ||
+            ic.ic_seed_fmt_len != elf->lf_date_time.dts_fmt_len ||
+            !(this->lf_index.back() <= ic.ic_first_time)) {
+            log_info("%s: continuing with a serial scan at %lld",
+                     this->lf_filename.c_str(),
+                     (long long) ic.ic_begin);
+            break;
+        }
+
+        auto begin_size = this->lf_index.size();
+        auto line_offset = begin_size - 1;
+
+        // Continuation lines at the start of the chunk belong to the last
+        // message in the previous chunk.
+        for (size_t lpc = 1; lpc < ic.ic_first_stamped; lpc++) {
+            const auto &cont_line = ic.ic_lines[lpc];
+            auto last_line = this->lf_index.back();
+
+            if (elf->lf_multiline) {
+                this->lf_index.emplace_back(
+                    cont_line.get_offset(),
+                    last_line.get_time(),
+                    last_line.get_millis(),
+                    (log_level_t) (last_line.get_level_and_flags() |
+                                   LEVEL_CONTINUED),
+                    last_line.get_module_id(),
+                    last_line.get_opid());
+            } else {
+                this->lf_index.emplace_back(cont_line.get_offset(),
+                                            last_line.get_timeval(),
+                                            LEVEL_INVALID);
+            }
+            this->lf_index.back().set_valid_utf(cont_line.is_valid_utf());
+        }
+
+        // Rollovers found in the chunk also apply to the earlier chunks.
+        for (const auto &tr : ic.ic_format->lf_time_rollovers) {
+            log_format::apply_time_rollover(
+                this->lf_index.begin(), this->lf_index.end(), tr);
+        }
+        if (!ic.ic_format->lf_time_rollovers.empty()) {
+            this->lf_time_index.clear();
+            sort_needed = true;
+        }
+
+        elf->merge_chunk(*ic.ic_format, line_offset);
+        this->lf_index.insert(this->lf_index.end(),
+                              ic.ic_lines.begin() + ic.ic_first_stamped,
+                              ic.ic_lines.end());
+        ic.ic_lines.clear();
+        ic.ic_lines.shrink_to_fit();
+        this->lf_out_of_time_order_count += ic.ic_out_of_time_order_count;
+        sort_needed = sort_needed || ic.ic_sort_needed;
+        this->lf_longest_line = std::max(this->lf_longest_line,
+                                         ic.ic_longest_line);
+        this->lf_partial_line = false;
+        this->lf_index_size = ic.ic_end;
+        retval = ic.ic_end;
+
+        auto lines_added = this->lf_index.size() - begin_size;
+
+        limit -= std::min(limit, lines_added);
+        if (this->lf_logline_observer != nullptr) {
+            for (auto iter = this->begin() + begin_size; iter != this->end();
+                 ++iter) {
+                this->observe_message(iter);
+            }
+        }
+        if (this->lf_logfile_observer != nullptr) {
+            auto indexing_res = this->lf_logfile_observer->logfile_indexing(
+                this->shared_from_this(),
+                this->lf_line_buffer.get_read_offset(retval),
+                file_size);
+
+            if (indexing_res == logfile_observer::indexing_result::BREAK) {
+                limit = 0;
+            }
+        }
+        if (limit == 0) {
+            break;
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * Compute the key used to remember that a range at the start of this file
+ * did not match any format.  Compressed files and pipes are not cached
+ * since their contents cannot be read again cheaply.
+ */
+nonstd::optional<std::string> logfile::unrecognized_key(file_off_t len) const
+{
+    if (this->lf_line_buffer.is_compressed() ||
+        this->lf_line_buffer.is_pipe()) {
+        return nonstd::nullopt;
+    }
+
+    char buffer[64 * 1024];
+    hasher retval;
+    file_off_t off = 0;
+
+    retval.update(this->lf_filename)
+        .update((int) this->lf_options.loo_file_format)
+        .update((int64_t) len);
+    while (off < len) {
+        auto rc = pread(this->lf_line_buffer.get_fd(),
+                        buffer,
+                        std::min((file_off_t) sizeof(buffer), len - off),
+                        off);
+
+        if (rc <= 0) {
+            return nonstd::nullopt;
+        }
+        retval.update(buffer, rc);
+        off += rc;
+    }
+
+    return retval.to_string();
+}
+
+static const file_off_t UNRECOGNIZED_HEAD_SIZE = 4 * 1024;
+
+void logfile::check_unrecognized_cache(file_off_t file_size)
+{
+    this->lf_unrecognized_checked = true;
+
+    auto head_key = this->unrecognized_key(
+        std::min(UNRECOGNIZED_HEAD_SIZE, file_size));
+    if (!head_key) {
+        return;
+    }
+
+    auto entry = find_unrecognized_content(head_key.value());
+    if (!entry || entry->uc_length > file_size) {
+        return;
+    }
+
+    auto key = this->unrecognized_key(entry->uc_length);
+    if (key && key.value() == entry->uc_key) {
+        log_info("%s: skipping format detection for the first %lld bytes",
+                 this->lf_filename.c_str(),
+                 (long long) entry->uc_length);
+        this->lf_skip_detection_until = entry->uc_length;
+        this->lf_unrecognized_recorded = entry->uc_length;
+    }
+}
+
+void logfile::record_unrecognized_content()
+{
+    auto len = this->lf_unrecognized_size;
+
+    this->lf_unrecognized_recorded = len;
+
+    auto head_key = this->unrecognized_key(
+        std::min(UNRECOGNIZED_HEAD_SIZE, len));
+    auto key = this->unrecognized_key(len);
+
+    if (head_key && key) {
+        unrecognized_content uc;
+
+        uc.uc_length = len;
+        uc.uc_key = key.value();
+        add_unrecognized_content(head_key.value(), uc);
+    }
+}
+
+static const size_t FORMAT_SAMPLE_POINTS = 8;
+
+static const size_t FORMAT_SAMPLE_LINES = 32;
+
+nonstd::optional<intern_string_t> logfile::sample_formats(auto_fd fd,
+                                                          file_off_t begin,
+                                                          file_off_t end,
+                                                          std::string filename,
+                                                          time_t file_time)
+{
+    try {
+        auto &root_formats = log_format::get_detection_formats();
+        auto span = (end - begin) / FORMAT_SAMPLE_POINTS;
+        line_buffer lb;
+
+        lb.set_fd(fd);
+        for (size_t point = 0; point < FORMAT_SAMPLE_POINTS; point++) {
+            auto start = begin;
+
+            if (point > 0) {
+                auto line_start = next_line_start(lb.get_fd(),
+                                                  begin + point * span);
+
+                if (!line_start) {
+                    continue;
+                }
+                start = line_start.value();
+            }
+
+            auto prev_range = file_range{start};
+
+            for (size_t line = 0; line < FORMAT_SAMPLE_LINES; line++) {
+                auto load_result = lb.load_next_line(prev_range);
+
+                if (load_result.isErr()) {
+                    return nonstd::nullopt;
+                }
+
+                auto li = load_result.unwrap();
+
+                if (li.li_file_range.empty() || li.li_partial) {
+                    break;
+                }
+                prev_range = li.li_file_range;
+
+                auto read_result = lb.read_range(li.li_file_range);
+
+                if (read_result.isErr()) {
+                    return nonstd::nullopt;
+                }
+
+                auto sbr = read_result.unwrap().rtrim(is_line_ending);
+
+                for (auto &format : root_formats) {
+                    // Each line is checked on its own since the formats
+                    // that need the previous lines, like the ones with a
+                    // header, can only be found at the start of the file.
+                    // Those formats also read the lines back through the
+                    // logfile, which is being indexed on another thread,
+                    // so they are not sampled at all.
+                    logline_vector scratch;
+
+                    if (format->scan_reads_logfile() ||
+                        !format->match_name(filename) ||
+                        !format->match_mime_type(
+                            this->lf_options.loo_file_format)) {
+                        continue;
+                    }
+
+                    format->clear();
+                    format->lf_date_time.set_base_time(file_time);
+                    if (format->scan(*this, scratch, li, sbr) ==
+                        log_format::SCAN_MATCH) {
+                        log_info("%s:%lld: sampled line matched format -- %s",
+                                 filename.c_str(),
+                                 (long long) li.li_file_range.fr_offset,
+                                 format->get_name().get());
+                        return format->get_name();
+                    }
+                }
+            }
+        }
+    } catch (const std::exception &e) {
+        log_error("%s: unable to sample file for formats -- %s",
+                  filename.c_str(),
+                  e.what());
+    }
+
+    return nonstd::nullopt;
+}
+
+void logfile::start_format_sampling(file_off_t file_size, bool wait)
+{
+    if (this->lf_line_buffer.is_compressed() ||
+        this->lf_line_buffer.is_pipe() ||
+        !S_ISREG(this->lf_stat.st_mode)) {
+        return;
+    }
+
+    auto file_time = this->lf_line_buffer.get_file_time();
+
+    if (file_time == 0) {
+        file_time = this->lf_stat.st_mtime;
+    }
+
+    log_info("%s: sampling %lld bytes for a log format",
+             this->lf_filename.c_str(),
+             (long long) (file_size - this->lf_unrecognized_size));
+    this->lf_sampling_started = true;
+    this->lf_sample_future = std::async(
+        std::launch::async,
+        [this,
+         fd = auto_fd::dup_of(this->lf_line_buffer.get_fd()),
+         begin = this->lf_unrecognized_size,
+         file_size,
+         filename = this->lf_filename,
+         file_time]() mutable {
+            return this->sample_formats(
+                std::move(fd), begin, file_size, filename, file_time);
+        });
+    if (wait) {
+        // The result is picked up by the next call to rebuild_index().
+        this->lf_sample_future.wait();
+    }
+}
+
+void logfile::use_sampled_format(intern_string_t format_name)
+{
+    auto keep_end = std::lower_bound(
+        this->lf_index.begin(),
+        this->lf_index.end(),
+        this->lf_unrecognized_size,
+        [](const logline &ll, file_off_t off) {
+            return ll.get_offset() < off;
+        });
+    size_t keep = std::distance(this->lf_index.begin(), keep_end);
+    size_t rollback_size = this->lf_index.size() - keep;
+
+    log_info("%s: indexing again from %lld with sampled format -- %s",
+             this->lf_filename.c_str(),
+             (long long) this->lf_unrecognized_size,
+             format_name.get());
+    this->lf_sampled_format = format_name;
+    this->lf_index.erase(keep_end, this->lf_index.end());
+    this->lf_time_index.truncate(this->lf_index.size());
+    this->lf_index_size = this->lf_unrecognized_size;
+    this->lf_partial_line = false;
+    if (!this->lf_indexing && this->lf_options.loo_is_visible) {
+        // Indexing is turned off for large files with no format, turn it
+        // back on now that there is one.
+        this->lf_indexing = true;
+        this->lf_notes.writeAccess()->erase(note_type::indexing_disabled);
+    }
+    if (this->lf_logline_observer != nullptr && rollback_size > 0) {
+        this->lf_logline_observer->logline_restart(*this, rollback_size);
+    }
+}
+
 logfile::rebuild_result_t logfile::rebuild_index(nonstd::optional<ui_clock::time_point> deadline)
 {
+    if (this->lf_sample_future.valid() &&
+        this->lf_sample_future.wait_for(std::chrono::seconds(0)) ==
+            std::future_status::ready) {
+        auto sampled_format = this->lf_sample_future.get();
+
+        if (sampled_format && this->lf_format == nullptr) {
+            this->use_sampled_format(sampled_format.value());
+        }
+    }
+
     if (!this->lf_indexing) {
         if (this->lf_sort_needed) {
             this->lf_sort_needed = false;
@@ -368,6 +1015,9 @@ logfile::rebuild_result_t logfile::rebuild_index(nonstd::optional<ui_clock::time
         // We haven't reached the end of the file.  Note that we use the
         // line buffer's notion of the file size since it may be compressed.
         bool has_format = this->lf_format.get() != nullptr;
+        // Only the sampled format is checked, so there is no need to limit
+        // the lines scanned as much as for a full detection.
+        bool detecting = !has_format && this->lf_sampled_format.empty();
         struct rusage begin_rusage;
         file_off_t off;
         size_t begin_size = this->lf_index.size();
@@ -396,6 +1046,7 @@ logfile::rebuild_result_t logfile::rebuild_index(nonstd::optional<ui_clock::time
             }
             this->lf_index.pop_back();
             rollback_size += 1;
+            this->lf_time_index.truncate(this->lf_index.size());
 
             this->lf_line_buffer.clear();
             if (!this->lf_index.empty()) {
@@ -430,14 +1081,14 @@ logfile::rebuild_result_t logfile::rebuild_index(nonstd::optional<ui_clock::time
 
         if (deadline) {
             if (ui_clock::now() > deadline.value()) {
-                if (has_format) {
+                if (!detecting) {
                     log_warning("with format ran past deadline! -- %s",
                                 this->lf_filename.c_str());
                     limit = 1000;
                 } else {
                     limit = 100;
                 }
-            } else if (!has_format) {
+            } else if (detecting) {
                 limit = 1000;
             } else {
                 limit = 1000 * 1000;
@@ -447,7 +1098,20 @@ logfile::rebuild_result_t logfile::rebuild_index(nonstd::optional<ui_clock::time
             log_debug("loading file... %s:%d", this->lf_filename.c_str(),
                       begin_size);
         }
+        if (!has_format && !this->lf_unrecognized_checked &&
+            this->lf_options.loo_detect_format) {
+            this->check_unrecognized_cache(st.st_size);
+        }
         auto prev_range = file_range{off};
+        if (has_format &&
+            (!deadline || ui_clock::now() < deadline.value())) {
+            auto chunks_end = this->index_chunks(
+                off, st.st_size, limit, sort_needed);
+
+            if (chunks_end > off) {
+                prev_range = file_range{chunks_end};
+            }
+        }
         while (limit > 0) {
             auto load_result = this->lf_line_buffer.load_next_line(prev_range);
 
@@ -511,6 +1175,7 @@ logfile::rebuild_result_t logfile::rebuild_index(nonstd::optional<ui_clock::time
 
             if (old_size > this->lf_index.size()) {
                 old_size = 0;
+                this->lf_time_index.clear();
             }
 
             // Update this early so that line_length() works
@@ -535,7 +1200,7 @@ logfile::rebuild_result_t logfile::rebuild_index(nonstd::optional<ui_clock::time
             if (!has_format && this->lf_format != nullptr) {
                 break;
             }
-            if (begin_size == 0 && !has_format &&
+            if (begin_size == 0 && detecting &&
                 li.li_file_range.fr_offset > 16 * 1024) {
                 break;
             }
@@ -559,6 +1224,46 @@ logfile::rebuild_result_t logfile::rebuild_index(nonstd::optional<ui_clock::time
             }
         }
 
+        /*
+         * Remember the files that did not match any format once detection
+         * has given up or the whole file was checked, so that the next run
+         * does not have to try every format again.
+         */
+        if (this->lf_format == nullptr && this->lf_options.loo_detect_format &&
+            this->lf_unrecognized_size > this->lf_unrecognized_recorded &&
+            (this->lf_index.size() >=
+             (size_t) injector::get<const lnav::logfile::config &>()
+                 .lc_max_unrecognized_lines ||
+             !this->lf_line_buffer.is_data_available(prev_range.next_offset(),
+                                                     st.st_size))) {
+            this->record_unrecognized_content();
+        }
+
+        if (this->lf_format == nullptr && !this->lf_sampled_format.empty() &&
+            !this->lf_line_buffer.is_data_available(prev_range.next_offset(),
+                                                    st.st_size)) {
+            log_info("%s: sampled format did not match while indexing -- %s",
+                     this->lf_filename.c_str(),
+                     this->lf_sampled_format.get());
+            this->lf_sampled_format.clear();
+        }
+
+        /*
+         * Detection only looks at the start of the file, so check lines
+         * from the rest of it in the background in case the format shows
+         * up later, like after a long preamble.  Without a deadline, the
+         * caller is not interactive and waits for the result instead.
+         */
+        if (this->lf_format == nullptr && this->lf_options.loo_detect_format &&
+            this->lf_options.loo_is_visible && !this->lf_sampling_started &&
+            this->lf_unrecognized_size < st.st_size &&
+            (!this->lf_indexing ||
+             this->lf_index.size() >=
+             (size_t) injector::get<const lnav::logfile::config &>()
+                 .lc_max_unrecognized_lines)) {
+            this->start_format_sampling(st.st_size, !deadline);
+        }
+
         if (this->lf_logline_observer != nullptr) {
             this->lf_logline_observer->logline_eof(*this);
         }
@@ -679,15 +1384,7 @@ void logfile::reobserve_from(iterator iter)
             }
         }
 
-        this->read_line(iter).then([this, iter](auto sbr) {
-            auto iter_end = iter + 1;
-
-            while (iter_end != this->end() && iter_end->get_sub_offset() != 0) {
-                ++iter_end;
-            }
-            this->lf_logline_observer->logline_new_lines(
-                *this, iter, iter_end, sbr);
-        });
+        this->observe_message(iter);
     }
     if (this->lf_logfile_observer != nullptr) {
         this->lf_logfile_observer->logfile_indexing(
@@ -696,6 +1393,39 @@ void logfile::reobserve_from(iterator iter)
     }
 }
 
+size_t logfile::evict_cold_lines(const std::vector<size_t> &hot_lines)
+{
+    if (this->lf_index.size() <= INDEX_SEGMENT_LINES) {
+        return 0;
+    }
+
+    return lnav::memory::evict_segments(
+        this->lf_index.data(),
+        this->lf_index.size() - INDEX_SEGMENT_LINES,
+        INDEX_SEGMENT_LINES,
+        hot_lines);
+}
+
+/**
+ * Pass the message that starts at the given line to the logline observer.
+ */
+void logfile::observe_message(iterator iter)
+{
+    if (iter->get_sub_offset() > 0) {
+        return;
+    }
+
+    this->read_line(iter).then([this, iter](auto sbr) {
+        auto iter_end = iter + 1;
+
+        while (iter_end != this->end() && iter_end->get_sub_offset() != 0) {
+            ++iter_end;
+        }
+        this->lf_logline_observer->logline_new_lines(
+            *this, iter, iter_end, sbr);
+    });
+}
+
 ghc::filesystem::path logfile::get_path() const
 {
     return this->lf_filename;
@@ -728,7 +1458,14 @@ size_t logfile::line_length(logfile::const_iterator ll, bool include_continues)
         }
     }
     else {
-        retval = next_line->get_offset() - ll->get_offset() - 1;
+        retval = next_line->get_offset() - ll->get_offset();
+        if (!next_line->is_segment()) {
+            // Skip the line ending, segments of a long line do not have one.
+            retval -= 1;
+        }
+        if (retval > line_buffer::MAX_LINE_BUFFER_SIZE) {
+            retval = line_buffer::MAX_LINE_BUFFER_SIZE;
+        }
         if (!include_continues) {
             this->lf_next_line_cache = nonstd::make_optional(
                 std::make_pair(ll->get_offset(), retval));
@@ -746,6 +1483,51 @@ logfile::read_raw_message(logfile::const_iterator ll)
     return this->lf_line_buffer.read_range(this->get_file_range(ll));
 }
 
+file_range logfile::get_segments_range(logfile::const_iterator ll,
+                                       logfile::const_iterator &end_out)
+{
+    auto retval = this->get_file_range(ll, false);
+
+    for (end_out = ll + 1;
+         end_out != this->end() && end_out->is_segment();
+         ++end_out) {
+        auto next_range = this->get_file_range(end_out, false);
+        auto block_size = next_range.next_offset() - retval.fr_offset;
+
+        if (block_size > (file_ssize_t) line_buffer::MAX_LINE_BUFFER_SIZE) {
+            break;
+        }
+        retval.fr_size = block_size;
+    }
+
+    return retval;
+}
+
+Result<shared_buffer_ref, std::string>
+logfile::read_segments(logfile::const_iterator ll,
+                       logfile::const_iterator &end_out)
+{
+    auto fr = this->get_segments_range(ll, end_out);
+    auto valid_utf = std::all_of(ll, end_out, [](const auto &seg) {
+        return seg.is_valid_utf();
+    });
+
+    try {
+        return this->lf_line_buffer.read_range(fr)
+            .map([valid_utf](auto sbr) {
+                sbr.rtrim(is_line_ending);
+                if (!valid_utf) {
+                    scrub_to_utf8(sbr.get_writable_data(), sbr.length());
+                }
+
+                return sbr;
+            });
+    }
+    catch (line_buffer::error & e) {
+        return Err(string(strerror(e.e_err)));
+    }
+}
+
 intern_string_t logfile::get_format_name() const
 {
     if (this->lf_format) {
@@ -758,9 +1540,15 @@ intern_string_t logfile::get_format_name() const
 nonstd::optional<logfile::const_iterator>
 logfile::find_from_time(const timeval &tv) const
 {
-    auto retval = std::lower_bound(this->lf_index.begin(),
-                                   this->lf_index.end(),
+    this->lf_time_index.extend(
+        this->lf_index.size(),
+        [this](size_t row) { return this->lf_index[row].get_timeval(); });
+
+    auto range = this->lf_time_index.narrow(tv, this->lf_index.size());
+    auto retval = std::lower_bound(this->lf_index.begin() + range.first,
+                                   this->lf_index.begin() + range.second,
                                    tv);
+
     if (retval == this->lf_index.end()) {
         return nonstd::nullopt;
     }
@@ -37,6 +37,9 @@ namespace logfile {
 
 struct config {
     int64_t lc_max_unrecognized_lines{15000};
+    int64_t lc_capture_cache_size{32 * 1024 * 1024};
+    int64_t lc_index_chunk_size{32 * 1024 * 1024};
+    int64_t lc_rss_budget{0};
 };
 
 }
@@ -38,12 +38,14 @@
 #include <sys/types.h>
 #include <sys/resource.h>
 
+#include <future>
 #include <string>
 #include <vector>
 #include <utility>
 
 #include "base/lnav_log.hh"
 #include "base/result.h"
+#include "base/time_index.hh"
 #include "byte_array.hh"
 #include "line_buffer.hh"
 #include "unique_path.hh"
@@ -92,8 +94,8 @@ class logfile :
     public unique_path_source,
     public std::enable_shared_from_this<logfile> {
 public:
-    typedef std::vector<logline>::iterator       iterator;
-    typedef std::vector<logline>::const_iterator const_iterator;
+    typedef logline_vector::iterator       iterator;
+    typedef logline_vector::const_iterator const_iterator;
 
     /**
      * Construct a logfile with the given arguments.
@@ -201,6 +203,7 @@ public:
             timeradd(&diff, &this->lf_time_offset, &new_time);
             iter.set_time(new_time);
         }
+        this->lf_time_index.clear();
         this->lf_sort_needed = true;
     };
 
@@ -307,6 +310,18 @@ public:
 
     Result<shared_buffer_ref, std::string> read_raw_message(const_iterator ll);
 
+    /**
+     * Get the range of the segments of a long line, starting at the given
+     * one, that fit in the line buffer.
+     *
+     * @param ll The first segment in the range.
+     * @param end_out Set to the line after the last segment in the range.
+     */
+    file_range get_segments_range(const_iterator ll, const_iterator &end_out);
+
+    Result<shared_buffer_ref, std::string> read_segments(
+        const_iterator ll, const_iterator &end_out);
+
     enum class rebuild_result_t {
         INVALID,
         NO_NEW_LINES,
@@ -325,6 +340,16 @@ public:
 
     void reobserve_from(iterator iter);
 
+    /**
+     * Page out the segments of the line index that do not contain any of
+     * the given lines, if the index is in spillable memory.  The last
+     * segment is always kept since new lines are added to it.
+     *
+     * @param hot_lines The sorted line numbers that are still in use.
+     * @return The number of bytes that were evicted.
+     */
+    size_t evict_cold_lines(const std::vector<size_t> &hot_lines);
+
     void set_logfile_observer(logfile_observer *lo) {
         this->lf_logfile_observer = lo;
     };
@@ -389,8 +414,67 @@ protected:
      */
     bool process_prefix(shared_buffer_ref &sbr, const line_info &li);
 
+    struct index_chunk;
+
+    /**
+     * Index a large part of the file by splitting it into chunks at line
+     * boundaries and scanning each chunk on its own thread.  The results
+     * are stitched together in order until a chunk is found that might
+     * have been scanned differently by the serial scan.
+     *
+     * @param off The offset of the first line to index.
+     * @param file_size The current size of the file.
+     * @param limit The number of lines that can still be indexed, this is
+     *   reduced by the number of lines that were added and set to zero if
+     *   the logfile observer asked to stop.
+     * @param sort_needed Set to true if the index needs to be sorted.
+     * @return The offset where the serial scan should continue.
+     */
+    file_off_t index_chunks(file_off_t off,
+                            file_off_t file_size,
+                            size_t &limit,
+                            bool &sort_needed);
+
+    void scan_chunk(index_chunk &ic);
+
+    void observe_message(iterator iter);
+
     void set_format_base_time(log_format *lf);
 
+    nonstd::optional<std::string> unrecognized_key(file_off_t len) const;
+
+    void check_unrecognized_cache(file_off_t file_size);
+
+    void record_unrecognized_content();
+
+    /**
+     * Check lines taken from several places in the file against the log
+     * formats.  This is run after detection has given up on the start of
+     * the file, usually on a background thread.
+     *
+     * @param fd A descriptor for the file that is not shared with the line
+     *   buffer.
+     * @param begin The offset to start sampling from.
+     * @param end The size of the file.
+     * @param filename The name used to check the formats' file patterns.
+     * @param file_time The base time for timestamps without a date.
+     * @return The name of the format that matched a sampled line.
+     */
+    nonstd::optional<intern_string_t> sample_formats(auto_fd fd,
+                                                     file_off_t begin,
+                                                     file_off_t end,
+                                                     std::string filename,
+                                                     time_t file_time);
+
+    void start_format_sampling(file_off_t file_size, bool wait);
+
+    /**
+     * Drop the lines after the range that detection has already checked so
+     * they are indexed again and checked against the format that was found
+     * by sampling.
+     */
+    void use_sampled_format(intern_string_t format_name);
+
 private:
     logfile(std::string filename, logfile_open_options &loo);
 
@@ -404,7 +488,14 @@ private:
     std::string lf_content_id;
     struct stat lf_stat{};
     std::shared_ptr<log_format> lf_format;
-    std::vector<logline>      lf_index;
+    logline_vector lf_index;
+    /**
+     * A sample of the times in lf_index that is used to speed up
+     * find_from_time().  It is filled in lazily and must be truncated when
+     * lines are removed from the index or the times of existing lines are
+     * changed.
+     */
+    mutable time_index lf_time_index;
     time_t      lf_index_time{0};
     file_off_t  lf_index_size{0};
     bool lf_sort_needed{false};
@@ -421,7 +512,24 @@ private:
     uint32_t lf_out_of_time_order_count{0};
     safe_notes lf_notes;
 
+    /**
+     * The lines before this offset are known to not match any format, so
+     * format detection is skipped for them.
+     */
+    file_off_t lf_skip_detection_until{0};
+    /** The lines before this offset did not match any format. */
+    file_off_t lf_unrecognized_size{0};
+    file_off_t lf_unrecognized_recorded{0};
+    bool lf_unrecognized_checked{false};
+    /** A format found by sampling that is tried on every line. */
+    intern_string_t lf_sampled_format;
+    bool lf_sampling_started{false};
+
     nonstd::optional<std::pair<file_off_t, size_t>> lf_next_line_cache;
+
+    // Destroyed first, so that a sampling thread that is still running is
+    // waited on before the rest of this object goes away.
+    std::future<nonstd::optional<intern_string_t>> lf_sample_future;
 };
 
 class logline_observer {
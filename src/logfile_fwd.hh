@@ -33,6 +33,7 @@
 #define lnav_logfile_fwd_hh
 
 #include <chrono>
+#include <memory>
 #include <string>
 
 #include "auto_fd.hh"
@@ -42,6 +43,7 @@ using ui_clock = std::chrono::steady_clock;
 
 class logfile;
 class logline_observer;
+class pipe_buffer;
 
 enum class logfile_name_source {
     USER,
@@ -62,6 +64,12 @@ struct logfile_open_options {
         return *this;
     };
 
+    logfile_open_options &with_pipe_buffer(std::shared_ptr<pipe_buffer> pb) {
+        this->loo_pipe_buffer = std::move(pb);
+
+        return *this;
+    };
+
     logfile_open_options &with_source(logfile_name_source src) {
         this->loo_source = src;
 
@@ -112,6 +120,7 @@ struct logfile_open_options {
 
     std::string loo_filename;
     auto_fd loo_fd;
+    std::shared_ptr<pipe_buffer> loo_pipe_buffer;
     logfile_name_source loo_source{logfile_name_source::USER};
     bool loo_detect_format{true};
     bool loo_include_in_session{true};
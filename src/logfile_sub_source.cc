@@ -31,15 +31,20 @@
 
 #include <future>
 #include <algorithm>
+#include <set>
 #include <sqlite3.h>
 
 #include "base/humanize.time.hh"
+#include "base/injector.hh"
+#include "base/perf_counters.hh"
 #include "base/string_util.hh"
 #include "k_merge_tree.h"
 #include "lnav_util.hh"
 #include "log_accel.hh"
 #include "relative_time.hh"
 #include "logfile_sub_source.hh"
+#include "logfile.cfg.hh"
+#include "memory_budget.hh"
 #include "command_executor.hh"
 #include "ansi_scrubber.hh"
 #include "sql_util.hh"
@@ -51,6 +56,12 @@ bookmark_type_t logfile_sub_source::BM_ERRORS("error");
 bookmark_type_t logfile_sub_source::BM_WARNINGS("warning");
 bookmark_type_t logfile_sub_source::BM_FILES("");
 
+/**
+ * The number of entries in a segment of lss_index that is evicted when
+ * over the RSS budget.
+ */
+static const size_t INDEX_SEGMENT_SIZE = 256 * 1024;
+
 static int pretty_sql_callback(exec_context &ec, sqlite3_stmt *stmt)
 {
     if (!sqlite3_stmt_busy(stmt)) {
@@ -137,12 +148,30 @@ shared_ptr<logfile> logfile_sub_source::find(const char *fn,
     return retval;
 }
 
+std::vector<uint32_t>::const_iterator
+logfile_sub_source::filtered_lower_bound(const struct timeval &tv) const
+{
+    this->lss_filtered_time_index.extend(
+        this->lss_filtered_index.size(),
+        [this](size_t row) {
+            auto cl = (content_line_t) this->lss_index[
+                this->lss_filtered_index[row]];
+
+            return this->find_line(cl)->get_timeval();
+        });
+
+    auto range = this->lss_filtered_time_index.narrow(
+        tv, this->lss_filtered_index.size());
+
+    return lower_bound(this->lss_filtered_index.begin() + range.first,
+                       this->lss_filtered_index.begin() + range.second,
+                       tv,
+                       filtered_logline_cmp(*this));
+}
+
 nonstd::optional<vis_line_t> logfile_sub_source::find_from_time(const struct timeval &start) const
 {
-    auto lb = lower_bound(this->lss_filtered_index.begin(),
-                          this->lss_filtered_index.end(),
-                          start,
-                          filtered_logline_cmp(*this));
+    auto lb = this->filtered_lower_bound(start);
     if (lb != this->lss_filtered_index.end()) {
         return vis_line_t(lb - this->lss_filtered_index.begin());
     }
@@ -180,18 +209,16 @@ void logfile_sub_source::text_value_for_line(textview_curses &tc,
 
     this->lss_token_attrs.clear();
     this->lss_token_values.clear();
-    this->lss_share_manager.invalidate_refs();
-    if (flags & text_sub_source::RF_FULL) {
-        shared_buffer_ref sbr;
 
+    shared_buffer_ref sbr;
+
+    if (flags & text_sub_source::RF_FULL) {
         this->lss_token_file->read_full_message(this->lss_token_line, sbr);
-        this->lss_token_value = to_string(sbr);
     } else {
-        this->lss_token_value =
-            this->lss_token_file->read_line(this->lss_token_line).map([](auto sbr) {
-                return to_string(sbr);
-            }).unwrapOr({});
+        sbr = this->lss_token_file->read_line(this->lss_token_line)
+            .unwrapOr(shared_buffer_ref());
     }
+    this->lss_token_value = to_string(sbr);
     this->lss_token_shift_start = 0;
     this->lss_token_shift_size = 0;
 
@@ -202,10 +229,6 @@ void logfile_sub_source::text_value_for_line(textview_curses &tc,
         format->scrub(value_out);
     }
 
-    shared_buffer_ref sbr;
-
-    sbr.share(this->lss_share_manager,
-              (char *)this->lss_token_value.c_str(), this->lss_token_value.size());
     if (this->lss_token_line->is_continued()) {
         this->lss_token_attrs.emplace_back(
             line_range{0, (int) this->lss_token_value.length()},
@@ -725,10 +748,12 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index(nonstd::opt
 
         this->lss_index.clear();
         this->lss_filtered_index.clear();
+        this->lss_filtered_time_index.clear();
         this->lss_longest_line = 0;
         this->lss_basename_width = 0;
         this->lss_filename_width = 0;
         vis_bm[&textview_curses::BM_USER_EXPR].clear();
+        this->invalidate_expr_marks();
     } else if (retval == rebuild_result::rr_partial_rebuild) {
         size_t remaining = 0;
 
@@ -768,12 +793,11 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index(nonstd::opt
                   this->lss_index.ba_size,
                   this->lss_index.ba_capacity,
                   remaining);
-        auto filt_row_iter = lower_bound(this->lss_filtered_index.begin(),
-                                    this->lss_filtered_index.end(),
-                                    *lowest_tv,
-                                    filtered_logline_cmp(*this));
+        auto filt_row_iter = this->filtered_lower_bound(*lowest_tv);
         this->lss_filtered_index.resize(std::distance(
-            this->lss_filtered_index.begin(), filt_row_iter));
+            this->lss_filtered_index.cbegin(), filt_row_iter));
+        this->lss_filtered_time_index.truncate(
+            this->lss_filtered_index.size());
         search_start = vis_line_t(this->lss_filtered_index.size());
 
         auto bm_range = vis_bm[&textview_curses::BM_USER_EXPR].equal_range(
@@ -816,6 +840,8 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index(nonstd::opt
         }
 
         if (full_sort) {
+            lnav::perf::timer perf_timer(lnav::perf::phase_t::kmerge);
+
             for (auto& ld : this->lss_files) {
                 auto lf = ld->get_file_ptr();
 
@@ -846,6 +872,7 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index(nonstd::opt
                                            this->lss_index.size());
             }
         } else {
+            lnav::perf::timer perf_timer(lnav::perf::phase_t::kmerge);
             kmerge_tree_c<logline, logfile_data, logfile::iterator> merge(
                 file_count);
 
@@ -941,21 +968,9 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index(nonstd::opt
                 (!(*ld)->ld_filter_state.excluded(filter_in_mask, filter_out_mask,
                                                   line_number) &&
                  this->check_extra_filters(ld, line_iter))) {
-                auto eval_res = this->eval_sql_filter(this->lss_marker_stmt.in(),
-                                                      ld, line_iter);
-                if (eval_res.isErr()) {
-                    line_iter->set_expr_mark(false);
-                } else {
-                    auto matched = eval_res.unwrap();
-
-                    if (matched) {
-                        line_iter->set_expr_mark(true);
-                        vis_bm[&textview_curses::BM_USER_EXPR]
-                            .insert_once(vis_line_t(this->lss_filtered_index.size()));
-                    }
-                    else {
-                        line_iter->set_expr_mark(false);
-                    }
+                if (this->update_expr_mark(ld, line_number, line_iter, false)) {
+                    vis_bm[&textview_curses::BM_USER_EXPR]
+                        .insert_once(vis_line_t(this->lss_filtered_index.size()));
                 }
                 this->lss_filtered_index.push_back(index_index);
                 if (this->lss_index_delegate != nullptr) {
@@ -989,6 +1004,76 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index(nonstd::opt
     return retval;
 }
 
+size_t logfile_sub_source::evict_cold_lines(vis_line_t top, vis_line_t bottom)
+{
+    auto budget = injector::get<const lnav::logfile::config &>().lc_rss_budget;
+
+    if (budget <= 0 || !lnav::memory::can_page_out()) {
+        return 0;
+    }
+
+    auto rss = lnav::memory::resident_size();
+
+    if (rss <= (size_t) budget) {
+        return 0;
+    }
+
+    // Keep a screenful of lines above and below the viewport.
+    int64_t height = bottom - top + 1;
+    int64_t hot_begin = std::max((int64_t) 0, (int64_t) top - height);
+    int64_t hot_end = std::min((int64_t) this->lss_filtered_index.size(),
+                               (int64_t) bottom + height + 1);
+    std::map<logfile *, std::vector<size_t>> hot_lines;
+    std::vector<size_t> hot_index;
+
+    for (auto row = hot_begin; row < hot_end; row++) {
+        auto index_row = this->lss_filtered_index[row];
+        content_line_t cl = this->lss_index[index_row];
+        auto *lf = this->find_file_ptr(cl);
+
+        hot_index.push_back(index_row);
+        hot_lines[lf].push_back(cl);
+    }
+    for (const auto &bm_pair : this->lss_user_marks) {
+        for (auto cl : bm_pair.second) {
+            auto *lf = this->find_file_ptr(cl);
+
+            hot_lines[lf].push_back(cl);
+        }
+    }
+
+    size_t retval = 0;
+
+    for (auto &ld : this->lss_files) {
+        auto *lf = ld->get_file_ptr();
+
+        if (lf == nullptr) {
+            continue;
+        }
+
+        auto &lines = hot_lines[lf];
+
+        std::sort(lines.begin(), lines.end());
+        retval += lf->evict_cold_lines(lines);
+    }
+
+    std::sort(hot_index.begin(), hot_index.end());
+    if (this->lss_index.size() > INDEX_SEGMENT_SIZE) {
+        retval += lnav::memory::evict_segments(
+            this->lss_index.ba_ptr,
+            this->lss_index.size() - INDEX_SEGMENT_SIZE,
+            INDEX_SEGMENT_SIZE,
+            hot_index);
+    }
+
+    log_info("RSS of %zu is over the budget of %lld, evicted %zu bytes",
+             rss,
+             (long long) budget,
+             retval);
+
+    return retval;
+}
+
 void logfile_sub_source::text_update_marks(vis_bookmarks &bm)
 {
     shared_ptr<logfile> last_file = nullptr;
@@ -1076,6 +1161,7 @@ void logfile_sub_source::text_filters_changed()
 {
     if (this->lss_line_meta_changed) {
         this->invalidate_sql_filter();
+        this->invalidate_expr_marks();
         this->lss_line_meta_changed = false;
     }
 
@@ -1084,6 +1170,7 @@ void logfile_sub_source::text_filters_changed()
 
         if (lf != nullptr) {
             ld->ld_filter_state.clear_deleted_filter_state();
+            ld->ld_filter_state.evaluate_in_background(*lf);
             lf->reobserve_from(lf->begin() + ld->ld_filter_state.get_min_count(lf->size()));
         }
     }
@@ -1098,7 +1185,27 @@ void logfile_sub_source::text_filters_changed()
     }
     vis_bm[&textview_curses::BM_USER_EXPR].clear();
 
+    // Work out which lines pass the filters a file at a time, so the walk
+    // over the index below only has to look up a byte for each line.
+    std::vector<std::vector<uint8_t>> passing_lines(this->lss_files.size());
+
+    if (this->tss_apply_filters) {
+        for (size_t file_index = 0; file_index < this->lss_files.size();
+             file_index++) {
+            auto& ld = this->lss_files[file_index];
+
+            if (ld->get_file_ptr() != nullptr && ld->is_visible()) {
+                ld->ld_filter_state.get_passing_lines(
+                    filtered_in_mask, filtered_out_mask,
+                    passing_lines[file_index]);
+            }
+        }
+    }
+
+    auto use_cached_marks = this->lss_marker_cacheable;
+
     this->lss_filtered_index.clear();
+    this->lss_filtered_time_index.clear();
     for (size_t index_index = 0; index_index < this->lss_index.size(); index_index++) {
         content_line_t cl = (content_line_t) this->lss_index[index_index];
         uint64_t line_number;
@@ -1112,24 +1219,13 @@ void logfile_sub_source::text_filters_changed()
         auto line_iter = lf->begin() + line_number;
 
         if (!this->tss_apply_filters ||
-            (!(*ld)->ld_filter_state.excluded(filtered_in_mask, filtered_out_mask,
-                                              line_number) &&
+            (passing_lines[std::distance(this->lss_files.begin(), ld)]
+                          [line_number] &&
              this->check_extra_filters(ld, line_iter))) {
-            auto eval_res = this->eval_sql_filter(this->lss_marker_stmt.in(),
-                                                  ld, line_iter);
-            if (eval_res.isErr()) {
-                line_iter->set_expr_mark(false);
-            } else {
-                auto matched = eval_res.unwrap();
-
-                if (matched) {
-                    line_iter->set_expr_mark(true);
-                    vis_bm[&textview_curses::BM_USER_EXPR]
-                        .insert_once(vis_line_t(this->lss_filtered_index.size()));
-                }
-                else {
-                    line_iter->set_expr_mark(false);
-                }
+            if (this->update_expr_mark(ld, line_number, line_iter,
+                                       use_cached_marks)) {
+                vis_bm[&textview_curses::BM_USER_EXPR]
+                    .insert_once(vis_line_t(this->lss_filtered_index.size()));
             }
             this->lss_filtered_index.push_back(index_index);
             if (this->lss_index_delegate != nullptr) {
@@ -1246,6 +1342,87 @@ Result<void, std::string> logfile_sub_source::set_sql_filter(std::string stmt_st
     return Ok();
 }
 
+/**
+ * Check if the result of a mark expression only depends on the values that
+ * are bound for a line.  The statement's program is checked for table reads
+ * and calls to functions that depend on the clock or the session, since
+ * those results can change without the line or the filters changing.
+ */
+static bool sql_marker_is_cacheable(sqlite3_stmt *stmt)
+{
+    static const std::set<std::string> STATEFUL_OPCODES = {
+        "OpenDup",
+        "OpenRead",
+        "OpenWrite",
+        "ReopenIdx",
+        "Transaction",
+        "VOpen",
+    };
+    static const std::set<std::string> STATEFUL_FUNCS = {
+        "changes",
+        "current_date",
+        "current_time",
+        "current_timestamp",
+        "date",
+        "datetime",
+        "gethostbyaddr",
+        "gethostbyname",
+        "julianday",
+        "last_insert_rowid",
+        "lnav_top_file",
+        "log_top_datetime",
+        "log_top_line",
+        "random",
+        "randomblob",
+        "readlink",
+        "realpath",
+        "strftime",
+        "time",
+        "timediff",
+        "total_changes",
+        "unixepoch",
+    };
+
+    auto count = sqlite3_bind_parameter_count(stmt);
+    for (int lpc = 0; lpc < count; lpc++) {
+        auto *name = sqlite3_bind_parameter_name(stmt, lpc + 1);
+
+        // Environment variables and marks can change at any time.
+        if (name[0] == '$' || strcmp(name, ":log_mark") == 0) {
+            return false;
+        }
+    }
+
+    auto explain_sql = fmt::format("EXPLAIN {}", sqlite3_sql(stmt));
+    auto_mem<sqlite3_stmt> explain_stmt(sqlite3_finalize);
+
+    if (sqlite3_prepare_v2(sqlite3_db_handle(stmt),
+                           explain_sql.c_str(),
+                           -1,
+                           explain_stmt.out(),
+                           nullptr) != SQLITE_OK) {
+        return false;
+    }
+
+    int rc;
+    while ((rc = sqlite3_step(explain_stmt.in())) == SQLITE_ROW) {
+        auto opcode = (const char *) sqlite3_column_text(explain_stmt.in(), 1);
+        auto p4 = (const char *) sqlite3_column_text(explain_stmt.in(), 5);
+
+        if (opcode == nullptr || STATEFUL_OPCODES.count(opcode) > 0) {
+            return false;
+        }
+        // The name of the function is in P4, e.g. "upper(1)".
+        if ((startswith(opcode, "Function") || startswith(opcode, "PureFunc")) &&
+            p4 != nullptr &&
+            STATEFUL_FUNCS.count(std::string(p4, strcspn(p4, "("))) > 0) {
+            return false;
+        }
+    }
+
+    return rc == SQLITE_DONE;
+}
+
 Result<void, std::string>
 logfile_sub_source::set_sql_marker(std::string stmt_str, sqlite3_stmt *stmt)
 {
@@ -1266,6 +1443,8 @@ logfile_sub_source::set_sql_marker(std::string stmt_str, sqlite3_stmt *stmt)
     expr_marks_bv.clear();
     this->lss_marker_stmt_text = std::move(stmt_str);
     this->lss_marker_stmt = stmt;
+    this->lss_marker_cacheable = stmt != nullptr && sql_marker_is_cacheable(stmt);
+    this->invalidate_expr_marks();
     if (this->lss_index_delegate) {
         this->lss_index_delegate->index_start(*this);
     }
@@ -1273,19 +1452,9 @@ logfile_sub_source::set_sql_marker(std::string stmt_str, sqlite3_stmt *stmt)
         auto cl = this->at(row);
         auto ld = this->find_data(cl);
         auto ll = (*ld)->get_file()->begin() + cl;
-        auto eval_res = this->eval_sql_filter(this->lss_marker_stmt.in(), ld, ll);
-
-        if (eval_res.isErr()) {
-            ll->set_expr_mark(false);
-        } else {
-            auto matched = eval_res.unwrap();
 
-            if (matched) {
-                ll->set_expr_mark(true);
-                expr_marks_bv.insert_once(row);
-            } else {
-                ll->set_expr_mark(false);
-            }
+        if (this->update_expr_mark(ld, cl, ll, false)) {
+            expr_marks_bv.insert_once(row);
         }
         if (this->lss_index_delegate) {
             this->lss_index_delegate->index_line(*this, (*ld)->get_file_ptr(), ll);
@@ -1324,6 +1493,8 @@ logfile_sub_source::eval_sql_filter(sqlite3_stmt *stmt, iterator ld, logfile::co
         return Ok(false);
     }
 
+    lnav::perf::timer perf_timer(lnav::perf::phase_t::filter_eval);
+
     auto lf = (*ld)->get_file_ptr();
     char timestamp_buffer[64];
     shared_buffer_ref sbr, raw_sbr;
@@ -1529,6 +1700,44 @@ void logfile_sub_source::invalidate_sql_filter()
     }
 }
 
+/**
+ * Check a line against the mark expression and record the result in the
+ * line.
+ *
+ * @param use_cached If true and the line was already checked, the earlier
+ *   result is returned instead of evaluating the expression again.
+ * @return True if the line matched the expression.
+ */
+bool logfile_sub_source::update_expr_mark(iterator ld,
+                                          uint64_t line_number,
+                                          logfile::iterator ll,
+                                          bool use_cached)
+{
+    auto& checked = (*ld)->ld_filter_state.lfo_expr_checked;
+
+    if (use_cached && line_number < checked.size() && checked[line_number]) {
+        return ll->is_expr_marked();
+    }
+
+    auto eval_res = this->eval_sql_filter(this->lss_marker_stmt.in(), ld, ll);
+    auto matched = eval_res.isOk() && eval_res.unwrap();
+
+    ll->set_expr_mark(matched);
+    if (line_number >= checked.size()) {
+        checked.resize((*ld)->get_file_ptr()->size());
+    }
+    checked[line_number] = true;
+
+    return matched;
+}
+
+void logfile_sub_source::invalidate_expr_marks()
+{
+    for (auto& ld : *this) {
+        ld->ld_filter_state.lfo_expr_checked.clear();
+    }
+}
+
 void log_location_history::loc_history_append(vis_line_t top)
 {
     if (top >= vis_line_t(this->llh_log_source.text_line_count())) {
@@ -43,6 +43,7 @@
 
 #include "base/lnav_log.hh"
 #include "base/time_util.hh"
+#include "base/time_index.hh"
 #include "log_accel.hh"
 #include "strong_int.hh"
 #include "logfile.hh"
@@ -83,7 +84,9 @@ class pcre_filter
 public:
     pcre_filter(type_t type, const std::string& id, size_t index, pcre *code)
         : text_filter(type, filter_lang_t::REGEX, id, index),
-          pf_pcre(code) { };
+          pf_pcre(code) {
+        this->pf_pcre.set_pattern(id);
+    };
 
     ~pcre_filter() override = default;
 
@@ -94,6 +97,10 @@ public:
         return this->pf_pcre.match(pc, pi);
     };
 
+    bool is_thread_safe() const override {
+        return true;
+    };
+
     std::string to_command() override {
         return (this->lf_type == text_filter::INCLUDE ?
                 "filter-in " : "filter-out ") +
@@ -343,6 +350,21 @@ public:
         return this->lss_line_size_cache[index].second;
     };
 
+    bool text_line_continues(int row) {
+        if (row + 1 >= (int) this->lss_filtered_index.size()) {
+            return false;
+        }
+
+        content_line_t cl = this->at(vis_line_t(row));
+        content_line_t next_cl = this->at(vis_line_t(row + 1));
+
+        if (next_cl != cl + 1) {
+            return false;
+        }
+
+        return this->find_line(next_cl)->is_segment();
+    };
+
     void text_mark(bookmark_type_t *bm, vis_line_t line, bool added)
     {
         if (line >= (int) this->lss_index.size()) {
@@ -445,6 +467,15 @@ public:
 
     rebuild_result rebuild_index(nonstd::optional<ui_clock::time_point> deadline = nonstd::nullopt);
 
+    /**
+     * If lnav is over its RSS budget, page out the parts of the indexes
+     * that are not near the given rows or a user bookmark.  The kernel
+     * brings them back when they are accessed again.
+     *
+     * @return The number of bytes that were evicted.
+     */
+    size_t evict_cold_lines(vis_line_t top, vis_line_t bottom);
+
     void text_update_marks(vis_bookmarks &bm);
 
     void set_user_mark(bookmark_type_t *bm, content_line_t cl)
@@ -955,6 +986,13 @@ private:
         std::shared_ptr<logfile> lde_file;
     };
 
+    /**
+     * Find the first row in the filtered index whose time is not less than
+     * the given time.
+     */
+    std::vector<uint32_t>::const_iterator filtered_lower_bound(
+        const struct timeval &tv) const;
+
     void clear_line_size_cache() {
         this->lss_line_size_cache.fill(std::make_pair(0, 0));
         this->lss_line_size_cache[0].first = -1;
@@ -975,6 +1013,13 @@ private:
 
     bool check_extra_filters(iterator ld, logfile::iterator ll);
 
+    bool update_expr_mark(iterator ld,
+                          uint64_t line_number,
+                          logfile::iterator ll,
+                          bool use_cached);
+
+    void invalidate_expr_marks();
+
     size_t                    lss_basename_width = 0;
     size_t                    lss_filename_width = 0;
     unsigned long             lss_flags{0};
@@ -983,6 +1028,11 @@ private:
 
     big_array<indexed_content> lss_index;
     std::vector<uint32_t> lss_filtered_index;
+    /**
+     * A sample of the times of the rows in lss_filtered_index, it is filled
+     * in lazily by filtered_lower_bound().
+     */
+    mutable time_index lss_filtered_time_index;
     auto_mem<sqlite3_stmt> lss_preview_filter_stmt{sqlite3_finalize};
 
     bookmarks<content_line_t>::type lss_user_marks;
@@ -998,7 +1048,6 @@ private:
     std::vector<logline_value> lss_token_values;
     int lss_token_shift_start{0};
     int lss_token_shift_size{0};
-    shared_buffer     lss_share_manager;
     logfile::iterator lss_token_line;
     std::array<std::pair<int, size_t>, LINE_SIZE_CACHE_SIZE> lss_line_size_cache;
     log_level_t  lss_min_log_level{LEVEL_UNKNOWN};
@@ -1012,6 +1061,11 @@ private:
 
     bool lss_in_value_for_line{false};
     bool lss_line_meta_changed{false};
+    /**
+     * True if the mark expression only depends on the line, so the results
+     * can be kept until the line changes.
+     */
+    bool lss_marker_cacheable{false};
 };
 
 #endif
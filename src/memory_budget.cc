@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file memory_budget.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include "base/injector.hh"
+#include "base/lnav_log.hh"
+#include "base/math_util.hh"
+#include "logfile.cfg.hh"
+#include "memory_budget.hh"
+
+namespace lnav {
+namespace memory {
+
+static std::mutex SPILL_MUTEX;
+/** The spillable mappings keyed by their address. */
+static std::map<uintptr_t, size_t> SPILL_MAPPINGS;
+static bool SPILL_FAILED = false;
+
+#if defined(MADV_PAGEOUT) || defined(MADV_COLD)
+static const bool CAN_PAGE_OUT = true;
+#else
+// There is no way to push the pages out of memory without losing them.
+static const bool CAN_PAGE_OUT = false;
+#endif
+
+size_t resident_size()
+{
+#ifdef __APPLE__
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+    if (task_info(mach_task_self(),
+                  MACH_TASK_BASIC_INFO,
+                  (task_info_t) &info,
+                  &count) != KERN_SUCCESS) {
+        return 0;
+    }
+
+    return info.resident_size;
+#else
+    auto *statm = fopen("/proc/self/statm", "r");
+    unsigned long total_pages = 0, resident_pages = 0;
+
+    if (statm == nullptr) {
+        return 0;
+    }
+    if (fscanf(statm, "%lu %lu", &total_pages, &resident_pages) != 2) {
+        resident_pages = 0;
+    }
+    fclose(statm);
+
+    return resident_pages * getpagesize();
+#endif
+}
+
+/**
+ * @return The amount of swap space in bytes, or -1 if it cannot be
+ *   determined on this platform.
+ */
+static int64_t swap_size()
+{
+#ifdef __APPLE__
+    // Swap files are created as they are needed.
+    return -1;
+#else
+    auto *meminfo = fopen("/proc/meminfo", "r");
+    int64_t retval = -1;
+    char line[256];
+
+    if (meminfo == nullptr) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), meminfo) != nullptr) {
+        long long swap_kb;
+
+        if (sscanf(line, "SwapTotal: %lld kB", &swap_kb) == 1) {
+            retval = swap_kb * 1024;
+            break;
+        }
+    }
+    fclose(meminfo);
+
+    return retval;
+#endif
+}
+
+bool can_page_out()
+{
+    static const bool retval = []() {
+        if (!CAN_PAGE_OUT) {
+            return false;
+        }
+
+        auto swap = swap_size();
+
+        if (swap == 0) {
+            log_warning("there is no swap space, so the log indexes cannot "
+                        "be paged out and /tuning/logfile/rss-budget has "
+                        "no effect");
+            return false;
+        }
+
+        return true;
+    }();
+
+    return retval;
+}
+
+void *map_spillable(size_t size)
+{
+    if (injector::get<const lnav::logfile::config &>().lc_rss_budget <= 0 ||
+        !can_page_out()) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lg(SPILL_MUTEX);
+
+    if (SPILL_FAILED) {
+        return nullptr;
+    }
+
+    auto map_size = roundup_size(size, getpagesize());
+    // The mapping is private so that a forked child, like the grep_proc,
+    // keeps a copy-on-write snapshot of the index.
+    auto *retval = mmap(nullptr,
+                        map_size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS,
+                        -1,
+                        0);
+
+    if (retval == MAP_FAILED) {
+        log_error("unable to map index memory: %s", strerror(errno));
+        SPILL_FAILED = true;
+        return nullptr;
+    }
+
+    SPILL_MAPPINGS[(uintptr_t) retval] = map_size;
+
+    return retval;
+}
+
+bool unmap_spillable(void *mem, size_t size)
+{
+    size_t map_size;
+
+    {
+        std::lock_guard<std::mutex> lg(SPILL_MUTEX);
+        auto iter = SPILL_MAPPINGS.find((uintptr_t) mem);
+
+        if (iter == SPILL_MAPPINGS.end()) {
+            return false;
+        }
+        map_size = iter->second;
+        SPILL_MAPPINGS.erase(iter);
+    }
+
+    munmap(mem, map_size);
+
+    return true;
+}
+
+size_t evict(const void *begin, const void *end)
+{
+    std::lock_guard<std::mutex> lg(SPILL_MUTEX);
+    auto evict_begin = (uintptr_t) begin;
+    auto evict_end = (uintptr_t) end;
+    auto iter = SPILL_MAPPINGS.upper_bound(evict_begin);
+
+    if (iter == SPILL_MAPPINGS.begin()) {
+        return 0;
+    }
+    --iter;
+
+    auto map_end = iter->first + iter->second;
+
+    if (evict_begin >= map_end) {
+        return 0;
+    }
+
+    // Only whole pages can be dropped.
+    size_t page_size = getpagesize();
+
+    evict_end = std::min(evict_end, map_end);
+    if (evict_begin % page_size != 0) {
+        evict_begin += page_size - evict_begin % page_size;
+    }
+    evict_end -= evict_end % page_size;
+    if (evict_begin >= evict_end) {
+        return 0;
+    }
+
+    auto *evict_ptr = (void *) evict_begin;
+    auto evict_len = evict_end - evict_begin;
+    int rc = -1;
+
+    // The pages are anonymous, so they have to be paged out to swap, they
+    // cannot be dropped without losing their contents.
+#ifdef MADV_PAGEOUT
+    rc = madvise(evict_ptr, evict_len, MADV_PAGEOUT);
+#endif
+#ifdef MADV_COLD
+    if (rc == -1) {
+        rc = madvise(evict_ptr, evict_len, MADV_COLD);
+    }
+#endif
+    if (rc == -1) {
+        log_error("unable to evict index pages: %s", strerror(errno));
+        return 0;
+    }
+
+    return evict_len;
+}
+
+}
+}
@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file memory_budget.hh
+ */
+
+#ifndef lnav_memory_budget_hh
+#define lnav_memory_budget_hh
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace lnav {
+namespace memory {
+
+/**
+ * Allocations smaller than this are never made spillable.
+ */
+static const size_t MIN_SPILL_SIZE = 4 * 1024 * 1024;
+
+/**
+ * @return The resident set size of this process in bytes or zero if it
+ *   cannot be determined on this platform.
+ */
+size_t resident_size();
+
+/**
+ * @return True if the pages of spillable memory can be pushed out of memory.
+ *   The memory is anonymous, so this requires swap space.
+ */
+bool can_page_out();
+
+/**
+ * Map private, anonymous memory whose pages can be pushed out to swap by
+ * evict() when they are not being used.  The kernel brings them back when
+ * they are accessed, so the memory can be used like any other.  A forked
+ * child still gets a copy-on-write snapshot of the memory.  Spillable
+ * memory is only used when an RSS budget is configured.
+ *
+ * @param size The number of bytes to map.
+ * @return The mapped memory or nullptr if spilling is disabled, is not
+ *   supported on this platform, or failed, in which case the caller should
+ *   allocate the memory normally.
+ */
+void *map_spillable(size_t size);
+
+/**
+ * Unmap memory that was returned by map_spillable().
+ *
+ * @return False if the memory was not mapped by map_spillable().
+ */
+bool unmap_spillable(void *mem, size_t size);
+
+/**
+ * Ask the kernel to page out the pages in the given range if they are part
+ * of a spillable mapping.
+ *
+ * @return The number of bytes that were passed to the kernel.
+ */
+size_t evict(const void *begin, const void *end);
+
+/**
+ * Evict the segments of an array that do not contain any of the given
+ * elements.
+ *
+ * @param data The start of the array.
+ * @param count The number of elements in the array to consider.
+ * @param segment_size The number of elements in a segment.
+ * @param hot The sorted indexes of the elements that are still in use.
+ * @return The number of bytes that were evicted.
+ */
+template<typename T>
+size_t evict_segments(const T *data,
+                      size_t count,
+                      size_t segment_size,
+                      const std::vector<size_t> &hot)
+{
+    auto hot_iter = hot.begin();
+    size_t retval = 0;
+
+    for (size_t seg_start = 0; seg_start < count; seg_start += segment_size) {
+        auto seg_end = std::min(seg_start + segment_size, count);
+
+        while (hot_iter != hot.end() && *hot_iter < seg_start) {
+            ++hot_iter;
+        }
+        if (hot_iter != hot.end() && *hot_iter < seg_end) {
+            continue;
+        }
+
+        retval += evict(data + seg_start, data + seg_end);
+    }
+
+    return retval;
+}
+
+/**
+ * An allocator for large indexes that uses spillable memory for big
+ * allocations.
+ */
+template<typename T>
+struct spill_allocator {
+    using value_type = T;
+
+    spill_allocator() = default;
+
+    template<typename U>
+    spill_allocator(const spill_allocator<U> &other)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        if (n * sizeof(T) >= MIN_SPILL_SIZE) {
+            auto *retval = map_spillable(n * sizeof(T));
+
+            if (retval != nullptr) {
+                return (T *) retval;
+            }
+        }
+
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        if (n * sizeof(T) >= MIN_SPILL_SIZE &&
+            unmap_spillable(p, n * sizeof(T))) {
+            return;
+        }
+
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const spill_allocator<T> &, const spill_allocator<U> &)
+{
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const spill_allocator<T> &, const spill_allocator<U> &)
+{
+    return false;
+}
+
+}
+}
+
+#endif
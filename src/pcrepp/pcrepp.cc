@@ -31,6 +31,9 @@
 
 #include "config.h"
 
+#include <algorithm>
+#include <mutex>
+
 #include "pcrepp.hh"
 
 using namespace std;
@@ -86,6 +89,141 @@ Result<pcrepp, pcrepp::compile_error> pcrepp::from_str(std::string pattern, int
     return Ok(pcrepp(std::move(pattern), code));
 }
 
+bool pcrepp::parse_literal(const char *pattern, std::string &literal_out)
+{
+    literal_out.clear();
+    for (int lpc = 0; pattern[lpc]; lpc++) {
+        auto ch = (unsigned char) pattern[lpc];
+
+        switch (ch) {
+            case '^':
+            case '$':
+            case '.':
+            case '[':
+            case '|':
+            case '(':
+            case ')':
+            case '?':
+            case '*':
+            case '+':
+            case '{':
+                return false;
+            case '\\': {
+                auto next = (unsigned char) pattern[lpc + 1];
+
+                if (next == 'Q') {
+                    lpc += 2;
+                    while (pattern[lpc] &&
+                           !(pattern[lpc] == '\\' && pattern[lpc + 1] == 'E')) {
+                        literal_out.push_back(pattern[lpc]);
+                        lpc += 1;
+                    }
+                    if (!pattern[lpc]) {
+                        return !literal_out.empty();
+                    }
+                    lpc += 1;
+                } else if (next == '\0' || next & 0x80 || isalnum(next)) {
+                    // Escapes like \d, \b, and \x41 are not plain text.
+                    return false;
+                } else {
+                    literal_out.push_back(next);
+                    lpc += 1;
+                }
+                break;
+            }
+            default:
+                literal_out.push_back(ch);
+                break;
+        }
+    }
+
+    return !literal_out.empty();
+}
+
+void pcrepp::choose_engine()
+{
+    this->p_engine = engine_t::BACKTRACK;
+    this->p_literal.clear();
+    this->p_literal_caseless = false;
+
+    if (this->p_pattern.empty() ||
+        this->p_options & (PCRE_ANCHORED | PCRE_EXTENDED | PCRE_FIRSTLINE)) {
+        return;
+    }
+
+    std::string literal;
+
+    if (!parse_literal(this->p_pattern.c_str(), literal)) {
+        return;
+    }
+
+    if (this->p_options & PCRE_CASELESS) {
+        for (auto ch : literal) {
+            if (ch & 0x80) {
+                return;
+            }
+            // In UTF-8 mode, the Kelvin sign and long s are caseless
+            // matches for 'k' and 's', which a byte scan would miss.
+            if ((this->p_options & PCRE_UTF8) &&
+                strchr("kKsS", ch) != nullptr) {
+                return;
+            }
+        }
+        this->p_literal_caseless = true;
+        std::transform(literal.begin(), literal.end(), literal.begin(),
+                       [](char ch) {
+            return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+        });
+    }
+
+    this->p_engine = engine_t::LITERAL;
+    this->p_literal = std::move(literal);
+}
+
+int pcrepp::find_literal(const char *str, int length, int start) const
+{
+    const auto *lit = this->p_literal.c_str();
+    int lit_len = this->p_literal.length();
+    int last = length - lit_len;
+
+    if (!this->p_literal_caseless) {
+        for (int pos = start; pos <= last; pos++) {
+            const auto *hit = (const char *) memchr(&str[pos], lit[0],
+                                                    last - pos + 1);
+
+            if (hit == nullptr) {
+                break;
+            }
+            pos = hit - str;
+            if (memcmp(hit + 1, lit + 1, lit_len - 1) == 0) {
+                return pos;
+            }
+        }
+
+        return -1;
+    }
+
+    for (int pos = start; pos <= last; pos++) {
+        int lpc;
+
+        for (lpc = 0; lpc < lit_len; lpc++) {
+            auto ch = str[pos + lpc];
+
+            if (ch >= 'A' && ch <= 'Z') {
+                ch += 'a' - 'A';
+            }
+            if (ch != lit[lpc]) {
+                break;
+            }
+        }
+        if (lpc == lit_len) {
+            return pos;
+        }
+    }
+
+    return -1;
+}
+
 void pcrepp::find_captures(const char *pattern)
 {
     bool in_class = false, in_escape = false, in_literal = false;
@@ -189,8 +327,23 @@ bool pcrepp::match(pcre_context &pc, pcre_input &pi, int options) const
         startoffset = pi.pi_offset;
         length      = pi.pi_length;
     }
+
+    // A literal can only match where its text appears, so pcre_exec() is
+    // only needed to fill in the match when the text is found.  Partial
+    // matches can end in the middle of the text, so they are left alone.
+    if (this->p_engine == engine_t::LITERAL &&
+        !(filtered_options & PCRE_PARTIAL)) {
+        int found = this->find_literal(str, length, startoffset);
+
+        if (found == -1) {
+            pc.set_count(PCRE_ERROR_NOMATCH);
+            return false;
+        }
+        startoffset = found;
+    }
+
     rc = pcre_exec(this->p_code,
-                   this->p_code_extra.in(),
+                   this->extra(),
                    str,
                    length,
                    startoffset,
@@ -295,6 +448,48 @@ std::string pcrepp::replace(const char *str, const char *repl) const
 
 void pcrepp::study()
 {
+    // Studying, which includes the JIT compile, is the expensive part of
+    // setting up a regex, so it is put off until the first match.  Only
+    // the information that can be pulled from the compiled code is
+    // collected here.
+    this->p_code_extra.reset();
+    this->p_studied = false;
+    pcre_fullinfo(this->p_code,
+                  nullptr,
+                  PCRE_INFO_OPTIONS,
+                  &this->p_options);
+    pcre_fullinfo(this->p_code,
+                  nullptr,
+                  PCRE_INFO_CAPTURECOUNT,
+                  &this->p_capture_count);
+    pcre_fullinfo(this->p_code,
+                  nullptr,
+                  PCRE_INFO_NAMECOUNT,
+                  &this->p_named_count);
+    pcre_fullinfo(this->p_code,
+                  nullptr,
+                  PCRE_INFO_NAMEENTRYSIZE,
+                  &this->p_name_len);
+    pcre_fullinfo(this->p_code,
+                  nullptr,
+                  PCRE_INFO_NAMETABLE,
+                  &this->p_named_entries);
+    this->choose_engine();
+}
+
+pcre_extra *pcrepp::extra() const
+{
+    if (this->p_studied.load(std::memory_order_acquire)) {
+        return this->p_code_extra.in();
+    }
+
+    static std::mutex study_mutex;
+    std::lock_guard<std::mutex> lg(study_mutex);
+
+    if (this->p_studied.load(std::memory_order_relaxed)) {
+        return this->p_code_extra.in();
+    }
+
     const char *errptr;
 
     this->p_code_extra = pcre_study(this->p_code,
@@ -315,41 +510,40 @@ void pcrepp::study()
         extra->match_limit           = 10000;
         extra->match_limit_recursion = 500;
 #ifdef PCRE_STUDY_JIT_COMPILE
-        // pcre_assign_jit_stack(extra, nullptr, jit_stack());
+        pcre_assign_jit_stack(extra, jit_stack_for_thread, nullptr);
 #endif
     }
-    pcre_fullinfo(this->p_code,
-                  this->p_code_extra,
-                  PCRE_INFO_OPTIONS,
-                  &this->p_options);
-    pcre_fullinfo(this->p_code,
-                  this->p_code_extra,
-                  PCRE_INFO_CAPTURECOUNT,
-                  &this->p_capture_count);
-    pcre_fullinfo(this->p_code,
-                  this->p_code_extra,
-                  PCRE_INFO_NAMECOUNT,
-                  &this->p_named_count);
-    pcre_fullinfo(this->p_code,
-                  this->p_code_extra,
-                  PCRE_INFO_NAMEENTRYSIZE,
-                  &this->p_name_len);
-    pcre_fullinfo(this->p_code,
-                  this->p_code_extra,
-                  PCRE_INFO_NAMETABLE,
-                  &this->p_named_entries);
+    this->p_studied.store(true, std::memory_order_release);
+
+    return this->p_code_extra.in();
 }
 
 #ifdef PCRE_STUDY_JIT_COMPILE
 pcre_jit_stack *pcrepp::jit_stack()
 {
-    static pcre_jit_stack *retval = nullptr;
+    // A JIT stack can only be used by one match at a time, so each thread
+    // gets its own.
+    thread_local struct jit_stack_holder {
+        ~jit_stack_holder() {
+            if (this->jsh_stack != nullptr) {
+                pcre_jit_stack_free(this->jsh_stack);
+            }
+        }
+
+        pcre_jit_stack *jsh_stack{nullptr};
+    } holder;
 
-    if (retval == nullptr) {
-        retval = pcre_jit_stack_alloc(JIT_STACK_MIN_SIZE, JIT_STACK_MAX_SIZE);
+    if (holder.jsh_stack == nullptr) {
+        holder.jsh_stack = pcre_jit_stack_alloc(JIT_STACK_MIN_SIZE,
+                                                JIT_STACK_MAX_SIZE);
     }
 
-    return retval;
+    return holder.jsh_stack;
+}
+
+pcre_jit_stack *pcrepp::jit_stack_for_thread(void *)
+{
+    return jit_stack();
 }
 
 #else
@@ -49,6 +49,7 @@
 
 #include <string.h>
 
+#include <atomic>
 #include <cassert>
 #include <string>
 #include <memory>
@@ -392,6 +393,31 @@ public:
         int ce_offset;
     };
 
+    /**
+     * The strategy used to run a pattern, which is picked when the pattern
+     * is compiled.
+     */
+    enum class engine_t {
+        /** Every match goes straight to pcre_exec(). */
+        BACKTRACK,
+        /**
+         * The pattern is plain text, so subjects that do not contain the
+         * text are rejected with a scan before pcre_exec() is called to
+         * fill in the match.
+         */
+        LITERAL,
+    };
+
+    /**
+     * Check if a pattern only matches a fixed string.
+     *
+     * @param pattern The pattern to check.
+     * @param literal_out The string that the pattern matches.
+     * @return True if the pattern only contains plain characters, escaped
+     *   punctuation, and \Q...\E sequences.
+     */
+    static bool parse_literal(const char *pattern, std::string &literal_out);
+
     static Result<pcrepp, compile_error> from_str(std::string pattern, int options = 0);
 
     pcrepp(pcre *code) : p_code(code), p_code_extra(pcre_free_study)
@@ -465,12 +491,16 @@ public:
         : p_code(other.p_code),
           p_pattern(std::move(other.p_pattern)),
           p_code_extra(pcre_free_study),
+          p_studied(other.p_studied.load()),
           p_capture_count(other.p_capture_count),
           p_named_count(other.p_named_count),
           p_name_len(other.p_name_len),
           p_options(other.p_options),
           p_named_entries(other.p_named_entries),
-          p_captures(std::move(other.p_captures)) {
+          p_captures(std::move(other.p_captures)),
+          p_engine(other.p_engine),
+          p_literal(std::move(other.p_literal)),
+          p_literal_caseless(other.p_literal_caseless) {
         pcre_refcount(this->p_code, 1);
         this->p_code_extra = std::move(other.p_code_extra);
     }
@@ -489,12 +519,16 @@ public:
         pcre_refcount(this->p_code, 1);
         this->p_pattern = std::move(other.p_pattern);
         this->p_code_extra = std::move(other.p_code_extra);
+        this->p_studied = other.p_studied.load();
         this->p_capture_count = other.p_capture_count;
         this->p_named_count = other.p_named_count;
         this->p_name_len = other.p_name_len;
         this->p_options = other.p_options;
         this->p_named_entries = other.p_named_entries;
         this->p_captures = std::move(other.p_captures);
+        this->p_engine = other.p_engine;
+        this->p_literal = std::move(other.p_literal);
+        this->p_literal_caseless = other.p_literal_caseless;
 
         return *this;
     }
@@ -503,6 +537,15 @@ public:
         return this->p_pattern;
     }
 
+    /**
+     * Set the text of a pattern that was compiled by the caller, so that a
+     * faster engine can be picked for it.
+     */
+    void set_pattern(std::string pattern) {
+        this->p_pattern = std::move(pattern);
+        this->choose_engine();
+    }
+
     bool empty() const {
         return this->p_pattern.empty();
     }
@@ -514,12 +557,16 @@ public:
         }
         this->p_pattern.clear();
         this->p_code_extra.reset();
+        this->p_studied = false;
         this->p_capture_count = 0;
         this->p_named_count = 0;
         this->p_name_len = 0;
         this->p_options = 0;
         this->p_named_entries = nullptr;
         this->p_captures.clear();
+        this->p_engine = engine_t::BACKTRACK;
+        this->p_literal.clear();
+        this->p_literal_caseless = false;
     }
 
     pcre_named_capture::iterator named_begin() const {
@@ -575,6 +622,10 @@ public:
         return this->p_capture_count;
     };
 
+    engine_t get_engine() const {
+        return this->p_engine;
+    };
+
     bool match(pcre_context &pc, pcre_input &pi, int options = 0) const;
 
     template<size_t MATCH_COUNT>
@@ -596,7 +647,7 @@ public:
 
         do {
             rc = pcre_exec(this->p_code,
-                           this->p_code_extra.in(),
+                           this->extra(),
                            pi.get_string(),
                            length,
                            pi.pi_offset,
@@ -616,25 +667,51 @@ public:
 
 // #undef PCRE_STUDY_JIT_COMPILE
 #ifdef PCRE_STUDY_JIT_COMPILE
+    /** @return The JIT stack for the calling thread. */
     static pcre_jit_stack *jit_stack();
 
+    static pcre_jit_stack *jit_stack_for_thread(void *);
+
 #else
     static void pcre_free_study(pcre_extra *);
 #endif
 
     void study();
 
+    /**
+     * Pick the engine to use for this pattern based on the pattern text and
+     * the options it was compiled with.
+     */
+    void choose_engine();
+
+    /**
+     * @return The offset of the first occurrence of the literal in the given
+     *   string or -1 if it does not occur.
+     */
+    int find_literal(const char *str, int length, int start) const;
+
+    /**
+     * @return The result of studying the regex, which is done the first
+     *   time this method is called.  It is safe to call from more than one
+     *   thread, the compiled pattern does not change after that.
+     */
+    pcre_extra *extra() const;
+
     void find_captures(const char *pattern);
 
     pcre *p_code{nullptr};
     std::string p_pattern;
-    auto_mem<pcre_extra> p_code_extra;
+    mutable auto_mem<pcre_extra> p_code_extra;
+    mutable std::atomic<bool> p_studied{false};
     int p_capture_count{0};
     int p_named_count{0};
     int p_name_len{0};
     unsigned long p_options{0};
     pcre_named_capture *p_named_entries{nullptr};
     std::vector<pcre_context::capture> p_captures;
+    engine_t p_engine{engine_t::BACKTRACK};
+    std::string p_literal;
+    bool p_literal_caseless{false};
 };
 
 #endif
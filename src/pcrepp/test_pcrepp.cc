@@ -173,5 +173,58 @@ int main(int argc, char *argv[])
         assert(re.captures()[0].c_end == 11);
     }
 
+    {
+        std::string literal;
+
+        assert(pcrepp::parse_literal("foo bar", literal));
+        assert(literal == "foo bar");
+        assert(pcrepp::parse_literal("10\\.0\\.1", literal));
+        assert(literal == "10.0.1");
+        assert(pcrepp::parse_literal("a\\Q(b)\\Ec", literal));
+        assert(literal == "a(b)c");
+        assert(!pcrepp::parse_literal("foo.bar", literal));
+        assert(!pcrepp::parse_literal("foo\\d", literal));
+        assert(!pcrepp::parse_literal("^foo", literal));
+        assert(!pcrepp::parse_literal("", literal));
+    }
+
+    {
+        pcrepp re("timeout waiting");
+        pcre_input pi("one timeout waiting two timeout waiting");
+
+        assert(re.get_engine() == pcrepp::engine_t::LITERAL);
+        assert(re.match(context, pi));
+        assert(context.all()->c_begin == 4);
+        assert(context.all()->c_end == 19);
+        assert(re.match(context, pi));
+        assert(context.all()->c_begin == 24);
+        assert(!re.match(context, pi));
+    }
+
+    {
+        pcrepp re("ERROR", PCRE_CASELESS);
+        pcre_input pi("an error occurred");
+
+        assert(re.get_engine() == pcrepp::engine_t::LITERAL);
+        assert(re.match(context, pi));
+        assert(context.all()->c_begin == 3);
+    }
+
+    {
+        // The Kelvin sign matches 'k' without case in UTF-8 mode.
+        pcrepp re(std::string("kb"), PCRE_CASELESS);
+
+        assert(re.get_engine() == pcrepp::engine_t::BACKTRACK);
+    }
+
+    {
+        pcrepp re(std::string("abc"));
+        pcre_input pi("ab\xff abc");
+
+        // Invalid UTF-8 is not matched by the literal engine either.
+        assert(re.get_engine() == pcrepp::engine_t::LITERAL);
+        assert(!re.match(context, pi));
+    }
+
     return retval;
 }
@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include "base/perf_counters.hh"
+#include "base/injector.bind.hh"
+#include "vtab_module.hh"
+
+struct lnav_perf : public tvt_iterator_cursor<lnav_perf> {
+    using iterator = std::array<lnav::perf::summary,
+                                lnav::perf::PHASE_COUNT>::const_iterator;
+
+    static constexpr const char *NAME = "lnav_perf";
+    static constexpr const char *CREATE_STMT = R"(
+-- Access the timings for lnav's internal processing through this table.
+-- The regex_cache_hit, regex_cache_miss, and regex_cache_evict phases count
+-- the lookups in the cache of regular expressions used by SQL functions.
+CREATE TABLE lnav_perf (
+    phase TEXT,       -- The phase of processing.
+    calls INTEGER,    -- The number of times the phase was executed.
+    total_ms REAL,    -- The total time spent in the phase.
+    avg_us REAL,      -- The average time for a call.
+    max_us REAL,      -- The longest time for a call.
+    p50_us REAL,      -- The approximate median time for a call.
+    p90_us REAL,      -- The approximate 90th percentile time for a call.
+    p99_us REAL       -- The approximate 99th percentile time for a call.
+);
+)";
+
+    iterator begin() {
+        this->lp_summaries = lnav::perf::collect();
+
+        return this->lp_summaries.begin();
+    }
+
+    iterator end() {
+        return this->lp_summaries.end();
+    }
+
+    int get_column(cursor &vc, sqlite3_context *ctx, int col) {
+        auto phase = (lnav::perf::phase_t) std::distance(
+            this->lp_summaries.cbegin(), vc.iter);
+        const auto &sum = *vc.iter;
+
+        switch (col) {
+            case 0:
+                sqlite3_result_text(ctx,
+                                    lnav::perf::phase_name(phase), -1,
+                                    SQLITE_STATIC);
+                break;
+            case 1:
+                to_sqlite(ctx, (int64_t) sum.s_calls);
+                break;
+            case 2:
+                to_sqlite(ctx, (double) sum.s_total_ns / 1000000.0);
+                break;
+            case 3:
+                if (sum.s_calls == 0) {
+                    sqlite3_result_null(ctx);
+                } else {
+                    to_sqlite(ctx, (double) sum.s_total_ns / sum.s_calls /
+                                   1000.0);
+                }
+                break;
+            case 4:
+                to_sqlite(ctx, (double) sum.s_max_ns / 1000.0);
+                break;
+            case 5:
+                to_sqlite(ctx, (double) sum.percentile_ns(0.50) / 1000.0);
+                break;
+            case 6:
+                to_sqlite(ctx, (double) sum.percentile_ns(0.90) / 1000.0);
+                break;
+            case 7:
+                to_sqlite(ctx, (double) sum.percentile_ns(0.99) / 1000.0);
+                break;
+        }
+
+        return SQLITE_OK;
+    }
+
+    std::array<lnav::perf::summary, lnav::perf::PHASE_COUNT> lp_summaries;
+};
+
+static auto perf_binder = injector::bind_multiple<vtab_module_base>()
+    .add<vtab_module<tvt_no_update<lnav_perf>>>();
@@ -0,0 +1,366 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file pipe_buffer.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <string>
+
+#include "base/lnav_log.hh"
+#include "pipe_buffer.hh"
+
+static const char *STDIN_EOF_MSG = "---- END-OF-STDIN ----";
+
+static size_t format_timestamp(char *time_str, size_t len)
+{
+    struct timeval tv;
+    char           ms_str[10];
+
+    gettimeofday(&tv, nullptr);
+    strftime(time_str, len, "%FT%T", localtime(&tv.tv_sec));
+    snprintf(ms_str, sizeof(ms_str), ".%03d", (int)(tv.tv_usec / 1000));
+    strcat(time_str, ms_str);
+    strcat(time_str, "  ");
+
+    return strlen(time_str);
+}
+
+pipe_buffer::pipe_buffer(auto_fd pipefd, bool timestamp, auto_fd spillfd)
+    : pb_pipe_fd(std::move(pipefd)),
+      pb_spill_fd(std::move(spillfd)),
+      pb_timestamp(timestamp)
+{
+    require(this->pb_pipe_fd != -1);
+    require(this->pb_spill_fd != -1);
+
+    this->pb_pipe_fd.close_on_exec();
+    this->pb_spill_fd.close_on_exec();
+    log_perror(fcntl(this->pb_pipe_fd, F_SETFL, O_NONBLOCK));
+    this->pb_thread = std::thread(&pipe_buffer::run, this);
+}
+
+pipe_buffer::~pipe_buffer()
+{
+    this->stop();
+}
+
+void pipe_buffer::stop()
+{
+    this->pb_stop = true;
+    if (this->pb_thread.joinable()) {
+        this->pb_thread.join();
+    }
+}
+
+ssize_t pipe_buffer::read(char *buf, file_off_t off, size_t len)
+{
+    std::unique_lock<std::mutex> lk(this->pb_mutex);
+
+    require(off >= 0);
+
+    if (off >= this->pb_size) {
+        if (this->pb_closed) {
+            return 0;
+        }
+        errno = EAGAIN;
+        return -1;
+    }
+
+    len = std::min(len, (size_t) (this->pb_size - off));
+
+    auto spilled_end = (file_off_t) (this->pb_spilled_segments * SEGMENT_SIZE);
+    if (off < spilled_end) {
+        // The spilled data does not change, so it can be read without
+        // holding up the reader thread.
+        len = std::min(len, (size_t) (spilled_end - off));
+        lk.unlock();
+
+        return pread(this->pb_spill_fd, buf, len, off);
+    }
+
+    size_t retval = 0;
+
+    while (retval < len) {
+        auto seg_index = (off / SEGMENT_SIZE) - this->pb_spilled_segments;
+        auto seg_off = (size_t) (off % SEGMENT_SIZE);
+        auto amount = std::min(len - retval, SEGMENT_SIZE - seg_off);
+
+        memcpy(&buf[retval], &this->pb_segments[seg_index][seg_off], amount);
+        retval += amount;
+        off += amount;
+    }
+
+    return retval;
+}
+
+file_ssize_t pipe_buffer::get_size()
+{
+    std::lock_guard<std::mutex> lg(this->pb_mutex);
+
+    return this->pb_size;
+}
+
+bool pipe_buffer::is_closed()
+{
+    std::lock_guard<std::mutex> lg(this->pb_mutex);
+
+    return this->pb_closed;
+}
+
+bool pipe_buffer::spill_all()
+{
+    require(!this->pb_thread.joinable());
+
+    auto off = (file_off_t) (this->pb_spilled_segments * SEGMENT_SIZE);
+
+    for (const auto &seg : this->pb_segments) {
+        auto len = std::min((file_ssize_t) SEGMENT_SIZE, this->pb_size - off);
+
+        if (!this->write_segment(seg.get(), off, len)) {
+            return false;
+        }
+        off += len;
+    }
+
+    return true;
+}
+
+std::pair<char *, size_t> pipe_buffer::tail_space()
+{
+    auto seg_off = (size_t) (this->pb_size % SEGMENT_SIZE);
+
+    if (this->pb_size ==
+        (file_ssize_t) ((this->pb_spilled_segments + this->pb_segments.size()) *
+                        SEGMENT_SIZE)) {
+        if (this->pb_free_segments.empty()) {
+            this->pb_segments.emplace_back(new char[SEGMENT_SIZE]);
+        } else {
+            this->pb_segments.emplace_back(
+                std::move(this->pb_free_segments.back()));
+            this->pb_free_segments.pop_back();
+        }
+    }
+
+    return {&this->pb_segments.back()[seg_off], SEGMENT_SIZE - seg_off};
+}
+
+void pipe_buffer::append(const char *data, size_t len)
+{
+    std::lock_guard<std::mutex> lg(this->pb_mutex);
+
+    while (len > 0) {
+        auto space = this->tail_space();
+        auto amount = std::min(len, space.second);
+
+        memcpy(space.first, data, amount);
+        data += amount;
+        len -= amount;
+        this->pb_size += amount;
+    }
+}
+
+bool pipe_buffer::write_segment(const char *seg, file_off_t off, size_t len)
+{
+    while (len > 0) {
+        auto rc = pwrite(this->pb_spill_fd, seg, len, off);
+
+        if (rc == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error("unable to write to spill file -- %s", strerror(errno));
+            return false;
+        }
+        seg += rc;
+        off += rc;
+        len -= rc;
+    }
+
+    return true;
+}
+
+void pipe_buffer::spill_segments()
+{
+    static const size_t MAX_SEGMENTS = MAX_MEMORY_SIZE / SEGMENT_SIZE;
+
+    while (!this->pb_spill_failed) {
+        const char *seg;
+        file_off_t off;
+
+        {
+            std::lock_guard<std::mutex> lg(this->pb_mutex);
+
+            // The last segment is still being filled, so it is never
+            // spilled.
+            if (this->pb_segments.size() <= MAX_SEGMENTS ||
+                this->pb_segments.size() < 2) {
+                return;
+            }
+            if (this->pb_spilled_segments == 0) {
+                log_info("spilling piped data past %zu bytes of memory",
+                         MAX_MEMORY_SIZE);
+            }
+            seg = this->pb_segments.front().get();
+            off = this->pb_spilled_segments * SEGMENT_SIZE;
+        }
+
+        // Only this thread changes the segments, so the oldest one can be
+        // written out without holding the lock.
+        if (!this->write_segment(seg, off, SEGMENT_SIZE)) {
+            this->pb_spill_failed = true;
+            return;
+        }
+
+        std::lock_guard<std::mutex> lg(this->pb_mutex);
+
+        this->pb_free_segments.emplace_back(
+            std::move(this->pb_segments.front()));
+        this->pb_segments.pop_front();
+        this->pb_spilled_segments += 1;
+        // Keep one segment around for the next read and give the rest
+        // back.
+        if (this->pb_free_segments.size() > 1) {
+            this->pb_free_segments.pop_back();
+        }
+    }
+}
+
+void pipe_buffer::run()
+{
+    std::vector<char> inbuf;
+    std::string outbuf;
+    file_ssize_t last_size = 0;
+
+    if (this->pb_timestamp) {
+        inbuf.resize(SEGMENT_SIZE);
+    }
+
+    while (!this->pb_stop) {
+        struct pollfd pfd = {
+            this->pb_pipe_fd,
+            POLLIN,
+            0
+        };
+
+        if (poll(&pfd, 1, 100) == 0) {
+            continue;
+        }
+
+        ssize_t rc;
+
+        if (this->pb_timestamp) {
+            rc = ::read(this->pb_pipe_fd, inbuf.data(), inbuf.size());
+            if (rc > 0) {
+                outbuf.clear();
+                for (size_t off = 0; off < (size_t) rc; ) {
+                    if (this->pb_at_line_start) {
+                        char time_str[64];
+
+                        outbuf.append(time_str,
+                                      format_timestamp(time_str,
+                                                       sizeof(time_str)));
+                        this->pb_at_line_start = false;
+                    }
+
+                    auto *eol = (const char *) memchr(
+                        &inbuf[off], '\n', rc - off);
+                    size_t end = eol == nullptr ?
+                        (size_t) rc : (eol - inbuf.data()) + 1;
+
+                    outbuf.append(&inbuf[off], end - off);
+                    off = end;
+                    if (eol != nullptr) {
+                        this->pb_at_line_start = true;
+                    }
+                }
+                this->append(outbuf.data(), outbuf.size());
+            }
+        } else {
+            std::pair<char *, size_t> space;
+
+            {
+                std::lock_guard<std::mutex> lg(this->pb_mutex);
+
+                space = this->tail_space();
+            }
+
+            // Read straight into the tail segment.  Readers never look past
+            // pb_size, so this does not need the lock.
+            rc = ::read(this->pb_pipe_fd, space.first, space.second);
+            if (rc > 0) {
+                std::lock_guard<std::mutex> lg(this->pb_mutex);
+
+                this->pb_size += rc;
+            }
+        }
+
+        if (rc == -1) {
+            if (errno == EAGAIN || errno == EINTR) {
+                continue;
+            }
+            log_error("unable to read from pipe -- %s", strerror(errno));
+        }
+        if (rc <= 0) {
+            break;
+        }
+
+        this->spill_segments();
+
+        auto new_size = this->get_size();
+        if (new_size > last_size) {
+            log_perror(ftruncate(this->pb_spill_fd, new_size));
+            last_size = new_size;
+        }
+    }
+
+    if (this->pb_timestamp && !this->pb_stop) {
+        char time_str[64];
+        std::string eof_line;
+
+        eof_line.append(time_str, format_timestamp(time_str, sizeof(time_str)));
+        eof_line.append(STDIN_EOF_MSG);
+        this->append(eof_line.data(), eof_line.size());
+        log_perror(ftruncate(this->pb_spill_fd, this->get_size()));
+    }
+
+    std::lock_guard<std::mutex> lg(this->pb_mutex);
+
+    this->pb_closed = true;
+}
@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file pipe_buffer.hh
+ */
+
+#ifndef lnav_pipe_buffer_hh
+#define lnav_pipe_buffer_hh
+
+#include <stddef.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "auto_fd.hh"
+#include "base/file_range.hh"
+
+/**
+ * Reads data from a pipe on a background thread and keeps it in memory so a
+ * line_buffer can read it back without going through a file.  The data is
+ * kept in fixed-size segments.  Once more than MAX_MEMORY_SIZE bytes are
+ * buffered, the oldest segments are written out to a spill file at the same
+ * offsets and their memory is reused for new data.
+ *
+ * The spill file is truncated to the amount of data read so far so that an
+ * fstat() on it reports the size of the stream.  The parts that are still
+ * in memory are holes in the file until spill_all() is called.
+ */
+class pipe_buffer {
+public:
+    /** The size of a segment of buffered data. */
+    static const size_t SEGMENT_SIZE = 1024 * 1024;
+
+    /** The amount of data to keep in memory before spilling. */
+    static const size_t MAX_MEMORY_SIZE = 8 * 1024 * 1024;
+
+    /**
+     * Start a thread that reads data from the given pipe.
+     *
+     * @param pipefd The file descriptor to read the data from.
+     * @param timestamp True if an ISO 8601 timestamp should be prepended onto
+     *   the lines read from pipefd.
+     * @param spillfd The descriptor for the spill file.
+     */
+    pipe_buffer(auto_fd pipefd, bool timestamp, auto_fd spillfd);
+
+    /**
+     * Stops the reader thread.
+     */
+    ~pipe_buffer();
+
+    /**
+     * Copy data out of the buffer.
+     *
+     * @param buf The destination for the data.
+     * @param off The offset in the stream to start reading at.
+     * @param len The maximum number of bytes to copy.
+     * @return The number of bytes copied, zero if the pipe is closed and all
+     *   the data has been read, or -1 with errno set to EAGAIN if no data is
+     *   available yet.
+     */
+    ssize_t read(char *buf, file_off_t off, size_t len);
+
+    /** @return The amount of data read from the pipe so far. */
+    file_ssize_t get_size();
+
+    /** @return True if the end of the pipe has been reached. */
+    bool is_closed();
+
+    /**
+     * Stop reading from the pipe.  The data read so far is still available.
+     */
+    void stop();
+
+    /**
+     * Write the segments that are still in memory to the spill file so that
+     * it contains a complete copy of the stream.  The reader thread must be
+     * stopped first.
+     *
+     * @return False if the data could not be written.
+     */
+    bool spill_all();
+
+private:
+    void run();
+
+    void append(const char *data, size_t len);
+
+    std::pair<char *, size_t> tail_space();
+
+    void spill_segments();
+
+    bool write_segment(const char *seg, file_off_t off, size_t len);
+
+    auto_fd pb_pipe_fd;
+    auto_fd pb_spill_fd;
+    bool pb_timestamp;
+    bool pb_at_line_start{true};
+    std::atomic<bool> pb_stop{false};
+    std::thread pb_thread;
+
+    std::mutex pb_mutex;
+    /** The segments that are still in memory, oldest first. */
+    std::deque<std::unique_ptr<char[]>> pb_segments;
+    /** Segments that were spilled and can be reused. */
+    std::vector<std::unique_ptr<char[]>> pb_free_segments;
+    /** The number of segments that have been written to the spill file. */
+    size_t pb_spilled_segments{0};
+    file_ssize_t pb_size{0};
+    bool pb_closed{false};
+    bool pb_spill_failed{false};
+};
+
+#endif
@@ -41,29 +41,77 @@
 #include <unistd.h>
 #include <poll.h>
 
+#include <string>
+#include <vector>
+
 #include "base/lnav_log.hh"
 #include "piper_proc.hh"
 #include "line_buffer.hh"
 
 using namespace std;
 
-static const char *STDIN_EOF_MSG = "---- END-OF-STDIN ----";
-
-static ssize_t write_timestamp(int fd, off_t woff)
+/**
+ * Copy the contents of a pipe to the backing file in large chunks.  The
+ * line_buffer path holds on to partial lines and writes each line
+ * separately.  Here, the data is written as soon as it is read, so the
+ * main process can index it without waiting for a complete line.
+ *
+ * @return The offset in the file after the last byte written.
+ */
+static off_t copy_pipe(int infd, int outfd)
 {
-    char           time_str[64];
-    struct timeval tv;
-    char           ms_str[10];
-
-    gettimeofday(&tv, nullptr);
-    strftime(time_str, sizeof(time_str), "%FT%T", localtime(&tv.tv_sec));
-    snprintf(ms_str, sizeof(ms_str), ".%03d", (int)(tv.tv_usec / 1000));
-    strcat(time_str, ms_str);
-    strcat(time_str, "  ");
-    return pwrite(fd, time_str, strlen(time_str), woff);
+    static const size_t CHUNK_SIZE = 256 * 1024;
+
+    std::vector<char> inbuf(CHUNK_SIZE);
+    off_t woff = 0;
+
+    while (true) {
+        struct pollfd pfd = {
+            infd,
+            POLLIN,
+            0
+        };
+
+        poll(&pfd, 1, -1);
+
+        auto rc = read(infd, inbuf.data(), inbuf.size());
+        if (rc == 0) {
+            break;
+        }
+        if (rc == -1) {
+            if (errno == EAGAIN || errno == EINTR) {
+                continue;
+            }
+            perror("Unable to read from pipe");
+            break;
+        }
+
+        const char *data = inbuf.data();
+        size_t len = rc;
+
+        while (len > 0) {
+            /* Need to do pwrite here since the fd is used by the main
+             * lnav process as well.
+             */
+            auto wrc = pwrite(outfd, data, len, woff);
+
+            if (wrc == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("Unable to write to output file for stdin");
+                return woff;
+            }
+            data += wrc;
+            len -= wrc;
+            woff += wrc;
+        }
+    }
+
+    return woff;
 }
 
-piper_proc::piper_proc(int pipefd, bool timestamp, int filefd)
+piper_proc::piper_proc(int pipefd, int filefd)
     : pp_fd(filefd), pp_child(-1)
 {
     require(pipefd >= 0);
@@ -102,8 +150,12 @@ piper_proc::piper_proc(int pipefd, bool timestamp, int filefd)
             }
         }
         log_perror(fcntl(infd.get(), F_SETFL, O_NONBLOCK));
-        lb.set_fd(infd);
-        do {
+        if (lseek(infd.get(), 0, SEEK_CUR) == -1 && errno == ESPIPE) {
+            woff = copy_pipe(infd.get(), this->pp_fd.get());
+        } else {
+            lb.set_fd(infd);
+        }
+        while (lb.get_fd() != -1) {
             struct pollfd pfd = {
                     lb.get_fd(),
                     POLLIN,
@@ -139,14 +191,6 @@ piper_proc::piper_proc(int pipefd, bool timestamp, int filefd)
                 ssize_t wrc;
 
                 last_woff = woff;
-                if (timestamp) {
-                    wrc = write_timestamp(this->pp_fd, woff);
-                    if (wrc == -1) {
-                        perror("Unable to write to output file for stdin");
-                        break;
-                    }
-                    woff += wrc;
-                }
 
                 /* Need to do pwrite here since the fd is used by the main
                  * lnav process as well.
@@ -164,22 +208,7 @@ piper_proc::piper_proc(int pipefd, bool timestamp, int filefd)
                     woff = last_woff;
                 }
             }
-        } while (lb.is_pipe() && !lb.is_pipe_closed());
-
-        if (timestamp) {
-            ssize_t wrc;
-
-            wrc = write_timestamp(this->pp_fd, woff);
-            if (wrc == -1) {
-                perror("Unable to write to output file for stdin");
-                break;
-            }
-            woff += wrc;
-            wrc   = pwrite(this->pp_fd,
-                           STDIN_EOF_MSG, strlen(STDIN_EOF_MSG),
-                           woff);
-            if (wrc == -1) {
-                perror("Unable to write to output file for stdin");
+            if (!lb.is_pipe() || lb.is_pipe_closed()) {
                 break;
             }
         }
@@ -58,11 +58,9 @@ public:
      * and write it to a temporary file.
      *
      * @param pipefd The file descriptor to read the file contents from.
-     * @param timestamp True if an ISO 8601 timestamp should be prepended onto
-     *   the lines read from pipefd.
      * @param filefd The descriptor for the backing file.
      */
-    piper_proc(int pipefd, bool timestamp, int filefd);
+    piper_proc(int pipefd, int filefd);
 
     bool has_exited();
 
@@ -0,0 +1,255 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file pretty_text_source.cc
+ */
+
+#include "config.h"
+
+#include <algorithm>
+
+#include "pretty_text_source.hh"
+
+pretty_text_source::pretty_text_source(textview_curses *source_view,
+                                       vis_line_t row_count,
+                                       vis_line_t anchor_row,
+                                       message_start_func start_func,
+                                       layout_func layout)
+    : pts_source_view(source_view),
+      pts_row_count(row_count),
+      pts_anchor_row(anchor_row),
+      pts_message_start(std::move(start_func)),
+      pts_layout(std::move(layout))
+{
+    if (this->pts_anchor_row >= this->pts_row_count) {
+        this->pts_anchor_row = std::max(0_vl, this->pts_row_count - 1_vl);
+    }
+    if (this->pts_row_count > 0) {
+        this->pts_prev_row = this->pts_message_start(this->pts_anchor_row);
+    } else {
+        this->pts_prev_row = 0_vl;
+    }
+    this->pts_next_row = this->pts_prev_row;
+}
+
+std::deque<pretty_text_source::message_layout>::const_iterator
+pretty_text_source::find_message(int64_t line) const
+{
+    auto iter = std::upper_bound(this->pts_messages.begin(),
+                                 this->pts_messages.end(),
+                                 line,
+                                 [](int64_t lhs, const message_layout &rhs) {
+        return lhs < rhs.ml_line;
+    });
+
+    if (iter == this->pts_messages.begin()) {
+        return this->pts_messages.end();
+    }
+    return --iter;
+}
+
+vis_line_t pretty_text_source::source_row_for_line(vis_line_t line) const
+{
+    auto iter = this->find_message((int64_t) line - this->pts_lines_before);
+
+    if (iter == this->pts_messages.end()) {
+        return this->pts_anchor_row;
+    }
+    return iter->ml_row;
+}
+
+const attr_line_t &pretty_text_source::line_at(int line)
+{
+    static const attr_line_t EMPTY_LINE;
+
+    auto rel_line = line - this->pts_lines_before;
+    auto iter = this->find_message(rel_line);
+
+    if (iter == this->pts_messages.end()) {
+        return EMPTY_LINE;
+    }
+
+    auto row = iter->ml_row;
+    auto cached = this->pts_cache.get(row);
+    lines_ptr lines;
+
+    if (cached) {
+        lines = cached.value();
+    } else {
+        vis_line_t next_row;
+
+        lines = std::make_shared<std::vector<attr_line_t>>();
+        this->layout_message(row, *lines, next_row);
+        this->pts_cache.put(row, lines);
+    }
+
+    // The source can change underneath us if it is still being indexed, so
+    // the message might not have the same number of lines anymore.
+    auto index = rel_line - iter->ml_line;
+    if (index >= (int64_t) lines->size()) {
+        return EMPTY_LINE;
+    }
+
+    return (*lines)[index];
+}
+
+size_t pretty_text_source::layout_message(vis_line_t row,
+                                          std::vector<attr_line_t> &lines_out,
+                                          vis_line_t &next_row_out)
+{
+    next_row_out = row + 1_vl;
+    if (row < this->pts_row_count) {
+        next_row_out = std::max(next_row_out, this->pts_layout(row, lines_out));
+    }
+    for (const auto &al : lines_out) {
+        this->pts_longest_line = std::max(this->pts_longest_line,
+                                          (size_t) al.length());
+    }
+
+    return lines_out.size();
+}
+
+void pretty_text_source::layout_forward()
+{
+    std::vector<attr_line_t> lines;
+    auto row = this->pts_next_row;
+    auto count = this->layout_message(row, lines, this->pts_next_row);
+
+    this->pts_messages.push_back({row, this->pts_lines_after});
+    this->pts_lines_after += count;
+}
+
+void pretty_text_source::layout_backward()
+{
+    std::vector<attr_line_t> lines;
+    vis_line_t next_row;
+    auto row = this->pts_message_start(this->pts_prev_row - 1_vl);
+    auto count = this->layout_message(row, lines, next_row);
+
+    this->pts_pending.emplace_back(row, count);
+    this->pts_pending_lines += count;
+    this->pts_prev_row = row;
+}
+
+int64_t pretty_text_source::commit_pending()
+{
+    int64_t retval = this->pts_pending_lines;
+
+    for (const auto &pending : this->pts_pending) {
+        this->pts_lines_before += pending.second;
+        this->pts_messages.push_front({pending.first,
+                                       -this->pts_lines_before});
+    }
+    this->pts_pending.clear();
+    this->pts_pending_lines = 0;
+
+    return retval;
+}
+
+bool pretty_text_source::layout_step(textview_curses &tc,
+                                     ui_clock::time_point deadline)
+{
+    if (this->is_complete()) {
+        return false;
+    }
+
+    int64_t page_height = std::max(tc.get_dimensions().first, 1_vl);
+    int64_t nearby = page_height * PRE_LAYOUT_PAGES;
+    int64_t top = tc.get_top();
+    auto old_count = this->text_line_count();
+    bool forward_done = this->pts_next_row >= this->pts_row_count;
+    int64_t added_above = 0;
+
+    if (top < nearby) {
+        while (this->pts_prev_row > 0 &&
+               top + (int64_t) this->pts_pending_lines < nearby) {
+            this->layout_backward();
+        }
+        added_above += this->commit_pending();
+    }
+    while (this->pts_next_row < this->pts_row_count &&
+           (int64_t) this->text_line_count() < top + added_above +
+                                               page_height + nearby) {
+        this->layout_forward();
+    }
+
+    // Work through the rest of the file in the background, downwards first
+    // since those lines can be added without disturbing the view.
+    while (!this->is_complete() && ui_clock::now() < deadline) {
+        if (this->pts_next_row < this->pts_row_count) {
+            this->layout_forward();
+        } else if (this->pts_prev_row > 0) {
+            this->layout_backward();
+        } else {
+            break;
+        }
+    }
+    if (this->pts_prev_row == 0) {
+        added_above += this->commit_pending();
+    }
+
+    if (this->text_line_count() == old_count) {
+        return !this->pts_pending.empty();
+    }
+
+    tc.reload_data();
+    if (added_above > 0) {
+        auto delta = vis_line_t(added_above);
+
+        for (auto &bm_pair : tc.get_bookmarks()) {
+            for (auto &vl : bm_pair.second) {
+                vl += delta;
+            }
+        }
+        tc.set_top(tc.get_top() + delta);
+        if (tc.is_selectable()) {
+            tc.set_selection(tc.get_selection() + delta);
+        }
+    }
+
+    // The search runs over a copy of the lines that were available when it
+    // started, so it is restarted when lines are renumbered or when the
+    // remainder of the file has been laid out.
+    if (!tc.get_current_search().empty() &&
+        (added_above > 0 ||
+         (!forward_done && this->pts_next_row >= this->pts_row_count))) {
+        tc.redo_search();
+    }
+
+    return true;
+}
+
+bool pretty_text_source::layout_until(vis_line_t line)
+{
+    while (line >= (int64_t) this->text_line_count() &&
+           this->pts_next_row < this->pts_row_count) {
+        this->layout_forward();
+    }
+
+    return line < (int64_t) this->text_line_count();
+}
@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2022, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file pretty_text_source.hh
+ */
+
+#ifndef lnav_pretty_text_source_hh
+#define lnav_pretty_text_source_hh
+
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "attr_line.hh"
+#include "base/lrucache.hpp"
+#include "logfile_fwd.hh"
+#include "textview_curses.hh"
+
+/**
+ * A text source for the pretty-print view that covers all of the messages
+ * in another view.  Messages are pretty-printed on demand, starting from an
+ * anchor message and growing in both directions as the view is scrolled or
+ * as time allows in the main loop.  Only the row and line count of each
+ * laid-out message is kept, the text of recently displayed messages is kept
+ * in a small cache and is regenerated when it falls out.
+ */
+class pretty_text_source : public text_sub_source {
+public:
+    /**
+     * Returns the row in the source view where the message that contains
+     * the given row starts.
+     */
+    using message_start_func = std::function<vis_line_t(vis_line_t)>;
+
+    /**
+     * Pretty-print the message that starts at the given row in the source
+     * view and return the row after the end of the message.
+     */
+    using layout_func =
+        std::function<vis_line_t(vis_line_t, std::vector<attr_line_t> &)>;
+
+    static const size_t CACHED_MESSAGES = 256;
+
+    /** The number of pages to lay out above and below the visible area. */
+    static const int PRE_LAYOUT_PAGES = 2;
+
+    pretty_text_source(textview_curses *source_view,
+                       vis_line_t row_count,
+                       vis_line_t anchor_row,
+                       message_start_func start_func,
+                       layout_func layout);
+
+    textview_curses *get_source_view() const {
+        return this->pts_source_view;
+    };
+
+    vis_line_t get_anchor_row() const {
+        return this->pts_anchor_row;
+    };
+
+    vis_line_t get_row_count() const {
+        return this->pts_row_count;
+    };
+
+    bool is_complete() const {
+        return this->pts_prev_row == 0 && this->pts_pending.empty() &&
+               this->pts_next_row >= this->pts_row_count;
+    };
+
+    /**
+     * Lay out the messages near the visible part of the view and then
+     * continue with the rest of the file until the deadline passes.  The
+     * view is adjusted when lines are added above the top.
+     *
+     * @param tc The pretty-print view.
+     * @param deadline The time to stop laying out messages in the background.
+     * @return True if the layout changed.
+     */
+    bool layout_step(textview_curses &tc, ui_clock::time_point deadline);
+
+    /**
+     * Lay out the messages below the ones that are already laid out until
+     * the given line is available.  This is for printing the view when
+     * there is no main loop to call layout_step(), like in headless mode.
+     * The lines that are already laid out are not renumbered.
+     *
+     * @param line The line that is needed.
+     * @return True if the line is available.
+     */
+    bool layout_until(vis_line_t line);
+
+    /**
+     * @param line A line in this source.
+     * @return The row in the source view of the message that produced the
+     *   line.
+     */
+    vis_line_t source_row_for_line(vis_line_t line) const;
+
+    size_t text_line_count() override {
+        return this->pts_lines_before + this->pts_lines_after;
+    };
+
+    size_t text_line_width(textview_curses &curses) override {
+        return this->pts_longest_line;
+    };
+
+    void text_value_for_line(textview_curses &tc,
+                             int row,
+                             std::string &value_out,
+                             line_flags_t flags) override {
+        value_out = this->line_at(row).get_string();
+    };
+
+    void text_attrs_for_line(textview_curses &tc, int line,
+                             string_attrs_t &value_out) override {
+        value_out = this->line_at(line).get_attrs();
+    };
+
+    size_t text_size_for_line(textview_curses &tc, int row,
+                              line_flags_t flags) override {
+        return this->line_at(row).length();
+    };
+
+private:
+    struct message_layout {
+        vis_line_t ml_row;
+        /** The first line of the message, relative to the anchor message. */
+        int64_t ml_line;
+    };
+
+    using lines_ptr = std::shared_ptr<std::vector<attr_line_t>>;
+
+    std::deque<message_layout>::const_iterator find_message(int64_t line) const;
+
+    const attr_line_t &line_at(int line);
+
+    size_t layout_message(vis_line_t row,
+                          std::vector<attr_line_t> &lines_out,
+                          vis_line_t &next_row_out);
+
+    void layout_forward();
+
+    void layout_backward();
+
+    int64_t commit_pending();
+
+    textview_curses *pts_source_view;
+    vis_line_t pts_row_count;
+    vis_line_t pts_anchor_row;
+    message_start_func pts_message_start;
+    layout_func pts_layout;
+
+    std::deque<message_layout> pts_messages;
+    /**
+     * Messages above the committed ones that have been laid out in the
+     * background.  They are added in one step to limit the number of times
+     * the lines in the view have to be renumbered.
+     */
+    std::vector<std::pair<vis_line_t, size_t>> pts_pending;
+    size_t pts_pending_lines{0};
+    int64_t pts_lines_before{0};
+    int64_t pts_lines_after{0};
+    vis_line_t pts_prev_row;
+    vis_line_t pts_next_row;
+    size_t pts_longest_line{0};
+    cache::lru_cache<int, lines_ptr> pts_cache{CACHED_MESSAGES};
+};
+
+#endif
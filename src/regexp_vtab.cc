@@ -68,7 +68,7 @@ CREATE TABLE regexp_capture (
 
     struct cursor {
         sqlite3_vtab_cursor base;
-        pcrepp c_pattern;
+        shared_ptr<pcrepp> c_pattern;
         pcre_context_static<30> c_context;
         unique_ptr<pcre_input> c_input;
         string c_content;
@@ -95,12 +95,12 @@ CREATE TABLE regexp_capture (
         int next() {
             if (this->c_index >= (this->c_context.get_count() - 1)) {
                 this->c_input->pi_offset = this->c_input->pi_next_offset;
-                this->c_matched = this->c_pattern.match(this->c_context, *(this->c_input));
+                this->c_matched = this->c_pattern->match(this->c_context, *(this->c_input));
                 this->c_index = -1;
                 this->c_match_index += 1;
             }
 
-            if (this->c_pattern.empty() || !this->c_matched) {
+            if (this->c_pattern == nullptr || !this->c_matched) {
                 return SQLITE_OK;
             }
 
@@ -110,7 +110,7 @@ CREATE TABLE regexp_capture (
         };
 
         int eof() {
-            return this->c_pattern.empty() || !this->c_matched;
+            return this->c_pattern == nullptr || !this->c_matched;
         };
 
         int get_rowid(sqlite3_int64 &rowid_out) {
@@ -134,7 +134,7 @@ CREATE TABLE regexp_capture (
                 if (vc.c_index == 0) {
                     sqlite3_result_null(ctx);
                 } else {
-                    sqlite3_result_text(ctx, vc.c_pattern.name_for_capture(
+                    sqlite3_result_text(ctx, vc.c_pattern->name_for_capture(
                         vc.c_index - 1), -1, SQLITE_TRANSIENT);
                 }
                 break;
@@ -171,7 +171,7 @@ CREATE TABLE regexp_capture (
                 }
                 break;
             case RC_COL_PATTERN: {
-                auto str = vc.c_pattern.get_pattern();
+                auto str = vc.c_pattern->get_pattern();
 
                 sqlite3_result_text(ctx, str.c_str(), str.length(),
                                     SQLITE_TRANSIENT);
@@ -213,7 +213,7 @@ static int rcFilter(sqlite3_vtab_cursor *pVtabCursor,
 
     if (argc != 2) {
         pCur->c_content.clear();
-        pCur->c_pattern.clear();
+        pCur->c_pattern.reset();
         return SQLITE_OK;
     }
 
@@ -223,21 +223,22 @@ static int rcFilter(sqlite3_vtab_cursor *pVtabCursor,
     pCur->c_content_as_blob = (sqlite3_value_type(argv[0]) == SQLITE_BLOB);
     pCur->c_content.assign(blob, byte_count);
 
-    const char *pattern = (const char *) sqlite3_value_text(argv[1]);
-    auto re_res = pcrepp::from_str(pattern);
-    if (re_res.isErr()) {
+    auto *pattern = (const char *) sqlite3_value_text(argv[1]);
+    auto pattern_len = sqlite3_value_bytes(argv[1]);
+    try {
+        pCur->c_pattern = sql_find_re(string_fragment(pattern, 0, pattern_len));
+    } catch (const pcrepp::error &e) {
+        pCur->c_pattern.reset();
         pVtabCursor->pVtab->zErrMsg = sqlite3_mprintf(
-            "Invalid regular expression: %s", re_res.unwrapErr().ce_msg);
+            "Invalid regular expression: %s", e.what());
         return SQLITE_ERROR;
     }
 
-    pCur->c_pattern = re_res.unwrap();
-
     pCur->c_index = 0;
     pCur->c_context.set_count(0);
 
     pCur->c_input = make_unique<pcre_input>(pCur->c_content);
-    pCur->c_matched = pCur->c_pattern.match(pCur->c_context, *(pCur->c_input));
+    pCur->c_matched = pCur->c_pattern->match(pCur->c_context, *(pCur->c_input));
 
     log_debug("matched %d", pCur->c_matched);
 
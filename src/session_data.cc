@@ -70,6 +70,7 @@ CREATE TABLE IF NOT EXISTS bookmarks (
     access_time datetime DEFAULT CURRENT_TIMESTAMP,
     comment text DEFAULT '',
     tags text DEFAULT '',
+    log_offset integer DEFAULT NULL,
 
     PRIMARY KEY (log_time, log_format, log_hash, session_time)
 );
@@ -108,6 +109,7 @@ static const char *NETLOC_LRU_STMT =
 static const char *UPGRADE_STMTS[] = {
     R"(ALTER TABLE bookmarks ADD COLUMN comment text DEFAULT '';)",
     R"(ALTER TABLE bookmarks ADD COLUMN tags text DEFAULT '';)",
+    R"(ALTER TABLE bookmarks ADD COLUMN log_offset integer DEFAULT NULL;)",
 };
 
 static const size_t MAX_SESSIONS           = 8;
@@ -164,6 +166,83 @@ int bind_values(sqlite3_stmt *stmt, Args ... args) {
     return bind_values_helper(stmt, std::make_index_sequence<sizeof...(Args)>(), args...);
 }
 
+/**
+ * Compute the identity of a line from the data that was captured when the
+ * file was indexed.  The content ID is derived from the first message in the
+ * file, so the identity stays the same across runs without having to read
+ * and hash the text of the line.
+ */
+static std::string line_identity(const logfile &lf, const logline &ll)
+{
+    return hasher()
+        .update(lf.get_content_id())
+        .update(ll.get_offset())
+        .update(ll.get_sub_offset())
+        .to_string();
+}
+
+/**
+ * A bookmark that was saved by an older version with a hash of the line's
+ * content and that was matched to a line when loading.
+ */
+struct legacy_bookmark {
+    std::string lb_log_time;
+    std::string lb_log_hash;
+    int64_t lb_session_time;
+    logfile::const_iterator lb_line;
+};
+
+/**
+ * Rewrite bookmarks that were saved with a hash of the line's content to use
+ * the line's identity and offset, so that later saves of the session, which
+ * only know the new identity, replace or delete them.
+ */
+static void migrate_legacy_bookmarks(sqlite3 *db,
+                                     const logfile &lf,
+                                     const std::vector<legacy_bookmark> &marks)
+{
+    auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
+
+    if (marks.empty()) {
+        return;
+    }
+
+    if (sqlite3_prepare_v2(db,
+                           "UPDATE OR REPLACE bookmarks SET log_hash = ?, log_offset = ?"
+                           " WHERE log_time = ? and log_format = ? and log_hash = ?"
+                           " and session_time = ?",
+                           -1,
+                           stmt.out(),
+                           nullptr) != SQLITE_OK) {
+        log_error("could not prepare bookmark migrate statement -- %s",
+                  sqlite3_errmsg(db));
+        return;
+    }
+
+    for (const auto &mark : marks) {
+        if (bind_values(stmt.in(),
+                        line_identity(lf, *mark.lb_line),
+                        (int64_t) mark.lb_line->get_offset(),
+                        mark.lb_log_time,
+                        lf.get_format()->get_name(),
+                        mark.lb_log_hash,
+                        mark.lb_session_time) != SQLITE_OK) {
+            return;
+        }
+
+        if (sqlite3_step(stmt.in()) != SQLITE_DONE) {
+            log_error("could not execute bookmark migrate statement -- %s",
+                      sqlite3_errmsg(db));
+            return;
+        }
+
+        sqlite3_reset(stmt.in());
+    }
+    log_info("%s: migrated %d bookmarks to offset identities",
+             lf.get_filename().c_str(),
+             (int) marks.size());
+}
+
 static bool bind_line(sqlite3 *db,
                       sqlite3_stmt *stmt,
                       content_line_t cl,
@@ -181,26 +260,32 @@ static bool bind_line(sqlite3 *db,
     sqlite3_clear_bindings(stmt);
 
     auto line_iter = lf->begin() + cl;
-    auto read_result = lf->read_line(line_iter);
-
-    if (read_result.isErr()) {
-        return false;
-    }
-
-    auto line_hash = read_result.map([cl](auto sbr) {
-        return hasher()
-            .update(sbr.get_data(), sbr.length())
-            .update(cl)
-            .to_string();
-    }).unwrap();
 
     return bind_values(stmt,
                        lf->original_line_time(line_iter),
                        lf->get_format()->get_name(),
-                       line_hash,
+                       line_identity(*lf, *line_iter),
                        session_time) == SQLITE_OK;
 }
 
+/**
+ * Bind the offset of the line in its file so that the line can be found
+ * again with a single pass over the file's index when the session is loaded.
+ */
+static bool bind_line_offset(sqlite3_stmt *stmt, int index, content_line_t cl)
+{
+    auto lf = lnav_data.ld_log_source.find(cl);
+
+    if (lf == nullptr) {
+        return false;
+    }
+
+    auto line_iter = lf->begin() + cl;
+
+    return bind_to_sqlite(stmt, index, (int64_t) line_iter->get_offset()) ==
+           SQLITE_OK;
+}
+
 struct session_file_info {
     session_file_info(int timestamp,
                       string id,
@@ -447,9 +532,9 @@ void load_time_bookmarks()
 
     if (sqlite3_prepare_v2(db.in(),
                            "SELECT log_time, log_format, log_hash, session_time, part_name, access_time, comment,"
-                           " tags, session_time=? as same_session FROM bookmarks WHERE "
+                           " tags, log_offset, session_time=? as same_session FROM bookmarks WHERE "
                            " log_time between ? and ? and log_format = ? "
-                           " ORDER BY same_session DESC, session_time DESC",
+                           " ORDER BY same_session DESC, session_time DESC, log_offset",
                            -1,
                            stmt.out(),
                            nullptr) != SQLITE_OK) {
@@ -488,6 +573,8 @@ void load_time_bookmarks()
         bool done = false;
         string line;
         int64_t last_mark_time = -1;
+        auto offset_iter = lf->begin();
+        std::vector<legacy_bookmark> legacy_marks;
 
         while (!done) {
             int rc = sqlite3_step(stmt.in());
@@ -520,10 +607,80 @@ void load_time_bookmarks()
                     continue;
                 }
 
+                auto apply_mark = [&](content_line_t line_cl) {
+                    bool meta = false;
+
+                    if (part_name != nullptr && part_name[0] != '\0') {
+                        lss.set_user_mark(&textview_curses::BM_META, line_cl);
+                        bm_meta[line_cl].bm_name = part_name;
+                        meta = true;
+                    }
+                    if (comment != nullptr && comment[0] != '\0') {
+                        lss.set_user_mark(&textview_curses::BM_META,
+                                          line_cl);
+                        bm_meta[line_cl].bm_comment = comment;
+                        meta = true;
+                    }
+                    if (tags != nullptr && tags[0] != '\0') {
+                        auto_mem<yajl_val_s> tag_list(yajl_tree_free);
+                        char error_buffer[1024];
+
+                        tag_list = yajl_tree_parse(tags, error_buffer, sizeof(error_buffer));
+                        if (!YAJL_IS_ARRAY(tag_list.in())) {
+                            log_error("invalid tags column: %s", tags);
+                        } else {
+                            lss.set_user_mark(&textview_curses::BM_META,
+                                              line_cl);
+                            for (size_t lpc = 0; lpc < tag_list.in()->u.array.len; lpc++) {
+                                yajl_val elem = tag_list.in()->u.array.values[lpc];
+
+                                if (!YAJL_IS_STRING(elem)) {
+                                    continue;
+                                }
+                                bookmark_metadata::KNOWN_TAGS.insert(elem->u.string);
+                                bm_meta[line_cl].add_tag(elem->u.string);
+                            }
+                        }
+                        meta = true;
+                    }
+                    if (!meta) {
+                        marked_session_lines.push_back(line_cl);
+                        lss.set_user_mark(&textview_curses::BM_USER,
+                                          line_cl);
+                    }
+                    reload_needed = true;
+                };
+
+                if (sqlite3_column_type(stmt.in(), 8) != SQLITE_NULL) {
+                    // The rows for a session are sorted by offset, so the
+                    // lines can be found with a single pass over the file.
+                    file_off_t log_offset = sqlite3_column_int64(stmt.in(), 8);
+
+                    offset_iter = lower_bound(
+                        offset_iter, lf->end(), log_offset,
+                        [](const logline &ll, file_off_t off) {
+                            return ll.get_offset() < off;
+                        });
+                    for (auto line_iter = offset_iter;
+                         line_iter != lf->end() &&
+                         line_iter->get_offset() == log_offset;
+                         ++line_iter) {
+                        if (line_identity(*lf, *line_iter) == log_hash) {
+                            apply_mark(content_line_t(
+                                base_content_line +
+                                std::distance(lf->begin(), line_iter)));
+                            break;
+                        }
+                    }
+                    break;
+                }
+
                 if (!dts.scan(log_time, strlen(log_time), NULL, &log_tm, log_tv)) {
                     continue;
                 }
 
+                // Bookmarks saved by older versions are identified by a hash
+                // of the line's content, so they need to be read in.
                 auto line_iter = lower_bound(lf->begin(), lf->end(), log_tv);
                 while (line_iter != lf->end()) {
                     struct timeval line_tv = line_iter->get_timeval();
@@ -548,49 +705,10 @@ void load_time_bookmarks()
                         .to_string();
 
                     if (line_hash == log_hash) {
-                        content_line_t line_cl = content_line_t(
-                            base_content_line + std::distance(lf->begin(), line_iter));
-                        bool meta = false;
-
-                        if (part_name != nullptr && part_name[0] != '\0') {
-                            lss.set_user_mark(&textview_curses::BM_META, line_cl);
-                            bm_meta[line_cl].bm_name = part_name;
-                            meta = true;
-                        }
-                        if (comment != nullptr && comment[0] != '\0') {
-                            lss.set_user_mark(&textview_curses::BM_META,
-                                              line_cl);
-                            bm_meta[line_cl].bm_comment = comment;
-                            meta = true;
-                        }
-                        if (tags != nullptr && tags[0] != '\0') {
-                            auto_mem<yajl_val_s> tag_list(yajl_tree_free);
-                            char error_buffer[1024];
-
-                            tag_list = yajl_tree_parse(tags, error_buffer, sizeof(error_buffer));
-                            if (!YAJL_IS_ARRAY(tag_list.in())) {
-                                log_error("invalid tags column: %s", tags);
-                            } else {
-                                lss.set_user_mark(&textview_curses::BM_META,
-                                                  line_cl);
-                                for (size_t lpc = 0; lpc < tag_list.in()->u.array.len; lpc++) {
-                                    yajl_val elem = tag_list.in()->u.array.values[lpc];
-
-                                    if (!YAJL_IS_STRING(elem)) {
-                                        continue;
-                                    }
-                                    bookmark_metadata::KNOWN_TAGS.insert(elem->u.string);
-                                    bm_meta[line_cl].add_tag(elem->u.string);
-                                }
-                            }
-                            meta = true;
-                        }
-                        if (!meta) {
-                            marked_session_lines.push_back(line_cl);
-                            lss.set_user_mark(&textview_curses::BM_USER,
-                                              line_cl);
-                        }
-                        reload_needed = true;
+                        apply_mark(content_line_t(
+                            base_content_line + std::distance(lf->begin(), line_iter)));
+                        legacy_marks.push_back(
+                            {log_time, log_hash, mark_time, line_iter});
                     }
 
                     ++line_iter;
@@ -614,6 +732,7 @@ void load_time_bookmarks()
         }
 
         sqlite3_reset(stmt.in());
+        migrate_legacy_bookmarks(db.in(), *lf, legacy_marks);
     }
 
     if (sqlite3_prepare_v2(db.in(),
@@ -974,7 +1093,8 @@ static void save_user_bookmarks(
 
         meta_iter = bm_meta.find(cl);
 
-        if (!bind_line(db, stmt, cl, lnav_data.ld_session_time)) {
+        if (!bind_line(db, stmt, cl, lnav_data.ld_session_time) ||
+            !bind_line_offset(stmt, 8, cl)) {
             continue;
         }
 
@@ -1145,8 +1265,8 @@ static void save_time_bookmarks()
 
     if (sqlite3_prepare_v2(db.in(),
                            "REPLACE INTO bookmarks"
-                           " (log_time, log_format, log_hash, session_time, part_name, comment, tags)"
-                           " VALUES (?, ?, ?, ?, ?, ?, ?)",
+                           " (log_time, log_format, log_hash, session_time, part_name, comment, tags, log_offset)"
+                           " VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
                            -1,
                            stmt.out(),
                            nullptr) != SQLITE_OK) {
@@ -1174,7 +1294,8 @@ static void save_time_bookmarks()
                 base_content_line + lf->size() - 1);
 
             if (!bind_line(db.in(), stmt.in(), base_content_line,
-                           lnav_data.ld_session_time)) {
+                           lnav_data.ld_session_time) ||
+                !bind_line_offset(stmt.in(), 8, base_content_line)) {
                 continue;
             }
 
@@ -1303,12 +1424,6 @@ static void save_time_bookmarks()
         line_iter = lf->begin() + lf->get_time_offset_line();
         struct timeval offset = lf->get_time_offset();
 
-        auto read_result = lf->read_line(line_iter);
-
-        if (read_result.isErr()) {
-            return;
-        }
-
         bind_values(stmt.in(),
                     lf->original_line_time(line_iter),
                     lf->get_format()->get_name(),
@@ -31,32 +31,28 @@
 
 #include "config.h"
 
-#ifdef HAVE_EXECINFO_H
-#include <execinfo.h>
-#endif
+#include "shared_buffer.hh"
 
-#include <algorithm>
+static std::shared_ptr<shared_buffer_chunk> chunk_for(char *data)
+{
+    auto retval = std::make_shared<shared_buffer_chunk>();
 
-#include "shared_buffer.hh"
+    retval->sbc_memory = std::shared_ptr<void>(data, free);
 
-static const bool DEBUG_TRACE = false;
+    return retval;
+}
 
-void shared_buffer_ref::share(shared_buffer &sb, char *data, size_t len)
+shared_buffer_ref::shared_buffer_ref(char *data, size_t len)
+    : sb_data(data), sb_length(len)
 {
-#ifdef HAVE_EXECINFO_H
-    if (DEBUG_TRACE) {
-        void *frames[128];
-        int rc;
-
-        rc = backtrace(frames, 128);
-        this->sb_backtrace.reset(backtrace_symbols(frames, rc));
+    if (data != nullptr) {
+        this->sb_chunk = chunk_for(data);
     }
-#endif
-
-    this->disown();
+}
 
-    sb.add_ref(*this);
-    this->sb_owner = &sb;
+void shared_buffer_ref::share(shared_buffer &sb, char *data, size_t len)
+{
+    this->sb_chunk = sb.get_chunk();
     this->sb_data = data;
     this->sb_length = len;
 
@@ -68,91 +64,53 @@ bool shared_buffer_ref::subset(shared_buffer_ref &other, off_t offset, size_t le
     this->disown();
 
     if (offset != -1) {
-        this->sb_owner = other.sb_owner;
+        this->sb_chunk = other.sb_chunk;
+        this->sb_data = &other.sb_data[offset];
         this->sb_length = len;
-        if (this->sb_owner == nullptr) {
-            if ((this->sb_data = (char *)malloc(this->sb_length)) == nullptr) {
-                return false;
-            }
-
-            memcpy(this->sb_data, &other.sb_data[offset], len);
-        } else {
-            this->sb_owner->add_ref(*this);
-            this->sb_data = &other.sb_data[offset];
-        }
     }
     return true;
 }
 
-shared_buffer_ref::shared_buffer_ref(shared_buffer_ref &&other) noexcept
+bool shared_buffer_ref::take_ownership()
 {
-    if (other.sb_data == nullptr) {
-        this->sb_owner = nullptr;
-        this->sb_data = nullptr;
-        this->sb_length = 0;
-    } else if (other.sb_owner != nullptr) {
-        other.sb_owner->add_ref(*this);
-        this->sb_owner = other.sb_owner;
-        this->sb_data = other.sb_data;
-        this->sb_length = other.sb_length;
-        other.disown();
-    } else {
-        this->sb_owner = nullptr;
-        this->sb_data = other.sb_data;
-        this->sb_length = other.sb_length;
-        other.sb_data = nullptr;
-        other.sb_length = 0;
+    if (this->sb_data == nullptr) {
+        return true;
     }
-}
 
-bool shared_buffer_ref::take_ownership()
-{
-    if (this->sb_owner != nullptr && this->sb_data != nullptr) {
-        char *new_data;
-
-        if ((new_data = (char *)malloc(this->sb_length)) == nullptr) {
-            return false;
-        }
-
-        memcpy(new_data, this->sb_data, this->sb_length);
-        this->sb_data = new_data;
-        this->sb_owner->sb_refs.erase(find(this->sb_owner->sb_refs.begin(),
-                                           this->sb_owner->sb_refs.end(),
-                                           this));
-        this->sb_owner = nullptr;
+    if (this->sb_chunk.use_count() == 1 && this->sb_chunk->sbc_memory) {
+        return true;
+    }
+
+    char *new_data;
+
+    if ((new_data = (char *)malloc(this->sb_length)) == nullptr) {
+        return false;
     }
+
+    memcpy(new_data, this->sb_data, this->sb_length);
+    this->sb_chunk = chunk_for(new_data);
+    this->sb_data = new_data;
+
     return true;
 }
 
 void shared_buffer_ref::disown()
 {
-    if (this->sb_owner == nullptr) {
-        if (this->sb_data != nullptr) {
-            free(this->sb_data);
-        }
-    } else {
-        this->sb_owner->sb_refs.erase(find(this->sb_owner->sb_refs.begin(),
-                                           this->sb_owner->sb_refs.end(),
-                                           this));
-    }
-    this->sb_owner = nullptr;
+    this->sb_chunk.reset();
     this->sb_data = nullptr;
     this->sb_length = 0;
 }
 
-void shared_buffer_ref::copy_ref(const shared_buffer_ref &other)
+tmp_shared_buffer::tmp_shared_buffer(const char *str, size_t len)
 {
-    if (other.sb_data == nullptr) {
-        this->sb_owner = nullptr;
-        this->sb_data = nullptr;
-        this->sb_length = 0;
+    if (len == (size_t)-1) {
+        len = strlen(str);
     }
-    else if (other.sb_owner != nullptr) {
-        this->share(*other.sb_owner, other.sb_data, other.sb_length);
-    } else {
-        this->sb_owner = nullptr;
-        this->sb_data = (char *)malloc(other.sb_length);
-        memcpy(this->sb_data, other.sb_data, other.sb_length);
-        this->sb_length = other.sb_length;
+
+    char *copy = (char *) malloc(len);
+
+    if (copy != nullptr) {
+        memcpy(copy, str, len);
+        this->tsb_ref = shared_buffer_ref(copy, len);
     }
 }
@@ -36,38 +36,52 @@
 #include <string.h>
 #include <sys/types.h>
 
+#include <memory>
 #include <string>
-#include <vector>
+#include <utility>
 
 #include "auto_mem.hh"
 #include "base/lnav_log.hh"
 
 class shared_buffer;
 
+/**
+ * Keeps the memory that shared_buffer_refs point into alive.  While the
+ * memory is still in use by whoever shared it, sbc_memory is empty.  Once
+ * it is handed off, the chunk owns the memory and it is freed along with
+ * the last ref.
+ */
+struct shared_buffer_chunk {
+    std::shared_ptr<void> sbc_memory;
+};
+
 struct shared_buffer_ref {
 public:
-    shared_buffer_ref(char *data = nullptr, size_t len = 0)
-        : sb_owner(nullptr), sb_data(data), sb_length(len) {
-    };
+    shared_buffer_ref(char *data = nullptr, size_t len = 0);
 
     ~shared_buffer_ref() {
         this->disown();
     };
 
-    shared_buffer_ref(const shared_buffer_ref &other) {
-        this->sb_owner = nullptr;
-        this->sb_data = nullptr;
-        this->sb_length = 0;
-
-        this->copy_ref(other);
+    shared_buffer_ref(const shared_buffer_ref &other)
+        : sb_chunk(other.sb_chunk),
+          sb_data(other.sb_data),
+          sb_length(other.sb_length) {
     };
 
-    shared_buffer_ref(shared_buffer_ref &&other) noexcept;
+    shared_buffer_ref(shared_buffer_ref &&other) noexcept
+        : sb_chunk(std::move(other.sb_chunk)),
+          sb_data(other.sb_data),
+          sb_length(other.sb_length) {
+        other.sb_data = nullptr;
+        other.sb_length = 0;
+    };
 
     shared_buffer_ref &operator=(const shared_buffer_ref &other) {
         if (this != &other) {
-            this->disown();
-            this->copy_ref(other);
+            this->sb_chunk = other.sb_chunk;
+            this->sb_data = other.sb_data;
+            this->sb_length = other.sb_length;
         }
 
         return *this;
@@ -111,54 +125,86 @@ public:
 
     bool subset(shared_buffer_ref &other, off_t offset, size_t len);
 
+    /**
+     * Make sure this ref is the only one pointing to its data, copying the
+     * data if needed, so that it can be modified.
+     */
     bool take_ownership();
 
     void disown();
 
 private:
-    void copy_ref(const shared_buffer_ref &other);
-
-    auto_mem<char *> sb_backtrace;
-    shared_buffer *sb_owner;
+    std::shared_ptr<shared_buffer_chunk> sb_chunk;
     char *sb_data;
     size_t sb_length;
 };
 
+/**
+ * Hands out refs to a buffer without copying its contents.  The refs do not
+ * need to be tracked individually, they all share a reference-counted
+ * shared_buffer_chunk.  Before the owner of the buffer changes or frees any
+ * data that has been shared, it needs to call hand_off() and, if that
+ * returns true, switch to a new buffer.
+ */
 class shared_buffer {
 public:
-    ~shared_buffer() {
-        this->invalidate_refs();
-    }
+    shared_buffer() = default;
+
+    /* A copy of the owner of a buffer has its own buffer and refs. */
+    shared_buffer(const shared_buffer &) {
+    };
 
-    void add_ref(shared_buffer_ref &ref) {
-        this->sb_refs.push_back(&ref);
+    shared_buffer(shared_buffer &&other) noexcept = default;
+
+    shared_buffer &operator=(const shared_buffer &) {
+        this->sb_chunk.reset();
+        return *this;
     };
 
-    bool invalidate_refs() {
-        bool retval = true;
+    shared_buffer &operator=(shared_buffer &&other) noexcept = default;
 
-        while (!this->sb_refs.empty()) {
-            auto iter = this->sb_refs.begin();
+    /** @return True if there are refs to the buffer. */
+    bool has_refs() const {
+        return this->sb_chunk.use_count() > 1;
+    };
 
-            retval = retval && (*iter)->take_ownership();
+    /**
+     * Give the memory for the buffer to any outstanding refs.
+     *
+     * @param memory The memory that backs the buffer.
+     * @return True if there were refs and they now own the memory, in which
+     *   case the caller must not modify or free it.
+     */
+    bool hand_off(std::shared_ptr<void> memory) {
+        bool retval = false;
+
+        if (this->has_refs()) {
+            this->sb_chunk->sbc_memory = std::move(memory);
+            retval = true;
         }
+        this->sb_chunk.reset();
 
         return retval;
     };
 
-    std::vector<shared_buffer_ref*> sb_refs;
-};
-
-struct tmp_shared_buffer {
-    explicit tmp_shared_buffer(const char *str, size_t len = -1) {
-        if (len == (size_t)-1) {
-            len = strlen(str);
+    std::shared_ptr<shared_buffer_chunk> get_chunk() {
+        if (!this->sb_chunk) {
+            this->sb_chunk = std::make_shared<shared_buffer_chunk>();
         }
 
-        this->tsb_ref.share(this->tsb_manager, (char *)str, len);
+        return this->sb_chunk;
     };
 
-    shared_buffer tsb_manager;
+private:
+    std::shared_ptr<shared_buffer_chunk> sb_chunk;
+};
+
+/**
+ * A ref that owns a copy of a temporary string.
+ */
+struct tmp_shared_buffer {
+    explicit tmp_shared_buffer(const char *str, size_t len = -1);
+
     shared_buffer_ref tsb_ref;
 };
 
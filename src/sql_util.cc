@@ -37,6 +37,9 @@
 
 #include <regex>
 #include <algorithm>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include "auto_mem.hh"
@@ -44,6 +47,7 @@
 #include "base/injector.hh"
 #include "base/string_util.hh"
 #include "base/lnav_log.hh"
+#include "base/perf_counters.hh"
 #include "base/time_util.hh"
 #include "pcrepp/pcrepp.hh"
 #include "readline_curses.hh"
@@ -1072,3 +1076,84 @@ vector<const help_text *> find_sql_help_for_line(const attr_line_t &al, size_t x
 
     return retval;
 }
+
+static const size_t MAX_REGEX_CACHE_SIZE = 256;
+
+namespace {
+
+struct regex_cache {
+    using entry_list = list<pair<string, shared_ptr<pcrepp>>>;
+
+    mutex rc_mutex;
+    /** The most recently used entries are at the front. */
+    entry_list rc_entries;
+    unordered_map<string, entry_list::iterator> rc_index;
+};
+
+regex_cache &get_regex_cache()
+{
+    static regex_cache retval;
+
+    return retval;
+}
+
+}
+
+shared_ptr<pcrepp> sql_find_re(const string_fragment &re)
+{
+    /*
+     * The same pattern is usually used over and over again by a statement,
+     * so the last pattern found by this thread is checked first, without
+     * taking the lock.
+     */
+    thread_local struct {
+        string l_pattern;
+        shared_ptr<pcrepp> l_re;
+    } last;
+    auto &rc = get_regex_cache();
+
+    if (last.l_re != nullptr && re == last.l_pattern) {
+        lnav::perf::record(lnav::perf::phase_t::regex_cache_hit, 0);
+        return last.l_re;
+    }
+
+    string re_str = re.to_string();
+    shared_ptr<pcrepp> retval;
+
+    {
+        lock_guard<mutex> lg(rc.rc_mutex);
+        auto iter = rc.rc_index.find(re_str);
+
+        if (iter != rc.rc_index.end()) {
+            lnav::perf::record(lnav::perf::phase_t::regex_cache_hit, 0);
+            rc.rc_entries.splice(rc.rc_entries.begin(),
+                                 rc.rc_entries,
+                                 iter->second);
+            retval = iter->second->second;
+        }
+    }
+
+    if (retval == nullptr) {
+        lnav::perf::timer perf_timer(lnav::perf::phase_t::regex_cache_miss);
+
+        // Compile outside of the lock, a bad pattern will throw here.
+        retval = make_shared<pcrepp>(re_str);
+
+        lock_guard<mutex> lg(rc.rc_mutex);
+
+        if (rc.rc_index.find(re_str) == rc.rc_index.end()) {
+            rc.rc_entries.emplace_front(re_str, retval);
+            rc.rc_index[re_str] = rc.rc_entries.begin();
+            while (rc.rc_entries.size() > MAX_REGEX_CACHE_SIZE) {
+                rc.rc_index.erase(rc.rc_entries.back().first);
+                rc.rc_entries.pop_back();
+                lnav::perf::record(lnav::perf::phase_t::regex_cache_evict, 0);
+            }
+        }
+    }
+
+    last.l_pattern = std::move(re_str);
+    last.l_re = retval;
+
+    return retval;
+}
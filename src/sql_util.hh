@@ -38,6 +38,7 @@
 #include <sqlite3.h>
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -125,4 +126,17 @@ extern std::multimap<std::string, help_text *> sqlite_function_help;
 std::string sql_keyword_re();
 std::vector<const help_text *> find_sql_help_for_line(const attr_line_t &al, size_t x);
 
+class pcrepp;
+
+/**
+ * Find the compiled version of a regular expression that was passed to a
+ * SQL function.  Compiled patterns are kept in a bounded LRU cache that is
+ * shared by all statements.
+ *
+ * @param re The regular expression to compile.
+ * @return The compiled regular expression.
+ * @throws pcrepp::error if the regular expression is not valid.
+ */
+std::shared_ptr<pcrepp> sql_find_re(const string_fragment &re);
+
 #endif
@@ -17,8 +17,6 @@
 #include <string.h>
 #include <sqlite3.h>
 
-#include <unordered_map>
-
 #include "pcrepp/pcrepp.hh"
 
 #include "base/humanize.hh"
@@ -30,12 +28,12 @@
 #include "column_namer.hh"
 #include "yajl/api/yajl_gen.h"
 #include "sqlite-extension-func.hh"
+#include "sql_util.hh"
 #include "data_scanner.hh"
 #include "data_parser.hh"
 #include "elem_to_json.hh"
 #include "vtab_module.hh"
 #include "vtab_module_json.hh"
-#include "safe/safe.h"
 #include "spookyhash/SpookyV2.h"
 
 #include "optional.hpp"
@@ -44,48 +42,52 @@
 using namespace std;
 using namespace mapbox;
 
-typedef struct {
-    shared_ptr<pcrepp> re2;
-} cache_entry;
-
-static cache_entry *find_re(const char *re)
-{
-    using safe_cache = safe::Safe<unordered_map<string, cache_entry>>;
-    static safe_cache CACHE;
-
-    safe::WriteAccess<safe_cache> wcache(CACHE);
-    string re_str = re;
-    auto iter = wcache->find(re_str);
+/**
+ * Regular expression arguments are compiled once per statement and kept in
+ * the statement's auxdata, so evaluating a function over many rows does not
+ * need to look up the pattern again.
+ */
+template<>
+struct from_sqlite_context<shared_ptr<pcrepp>> {
+    shared_ptr<pcrepp> operator()(sqlite3_context *context,
+                                  int argc,
+                                  sqlite3_value **val,
+                                  int argi) {
+        auto *cached = (shared_ptr<pcrepp> *) sqlite3_get_auxdata(context,
+                                                                  argi);
+
+        if (cached != nullptr) {
+            return *cached;
+        }
 
-    if (iter == wcache->end()) {
-        cache_entry c;
+        auto *re = (const char *) sqlite3_value_text(val[argi]);
+        auto re_len = sqlite3_value_bytes(val[argi]);
+        auto retval = sql_find_re(string_fragment(re, 0, re_len));
 
-        c.re2 = make_shared<pcrepp>(re_str);
-        auto pair = wcache->insert(std::make_pair(re_str, c));
+        sqlite3_set_auxdata(context, argi, new shared_ptr<pcrepp>(retval),
+                            [](void *mem) {
+                                delete (shared_ptr<pcrepp> *) mem;
+                            });
 
-        iter = pair.first;
+        return retval;
     }
+};
 
-    return &iter->second;
-}
-
-static bool regexp(const char *re, const char *str)
+static bool regexp(shared_ptr<pcrepp> re, const char *str)
 {
-    cache_entry *reobj = find_re(re);
     pcre_context_static<30> pc;
     pcre_input pi(str);
 
-    return reobj->re2->match(pc, pi);
+    return re->match(pc, pi);
 }
 
 static
 util::variant<int64_t, double, const char*, string_fragment, json_string>
-regexp_match(const char *re, const char *str)
+regexp_match(shared_ptr<pcrepp> re, const char *str)
 {
-    cache_entry *reobj = find_re(re);
     pcre_context_static<30> pc;
     pcre_input pi(str);
-    pcrepp &extractor = *reobj->re2;
+    pcrepp &extractor = *re;
 
     if (extractor.get_capture_count() == 0) {
         throw pcrepp::error("regular expression does not have any captures");
@@ -255,11 +257,10 @@ json_string logfmt2json(string_fragment line)
 }
 
 static
-string regexp_replace(const char *str, const char *re, const char *repl)
+string regexp_replace(const char *str, shared_ptr<pcrepp> re,
+                      const char *repl)
 {
-    cache_entry *reobj = find_re(re);
-
-    return reobj->re2->replace(str, repl);
+    return re->replace(str, repl);
 }
 
 static
@@ -83,12 +83,31 @@ size_t textfile_sub_source::text_size_for_line(textview_curses &tc, int line,
     if (!this->tss_files.empty()) {
         std::shared_ptr<logfile> lf = this->current_file();
         auto *lfo = (line_filter_observer *) lf->get_logline_observer();
-        retval = lf->line_length(lf->begin() + lfo->lfo_filter_state.tfs_index[line]);
+        retval = lf->line_length(
+            lf->begin() + lfo->lfo_filter_state.tfs_index[line], false);
     }
 
     return retval;
 }
 
+bool textfile_sub_source::text_line_continues(int line)
+{
+    if (this->tss_files.empty()) {
+        return false;
+    }
+
+    std::shared_ptr<logfile> lf = this->current_file();
+    auto *lfo = (line_filter_observer *) lf->get_logline_observer();
+    auto &tfs_index = lfo->lfo_filter_state.tfs_index;
+
+    if (line + 1 >= (int) tfs_index.size() ||
+        tfs_index[line + 1] != tfs_index[line] + 1) {
+        return false;
+    }
+
+    return (lf->begin() + tfs_index[line + 1])->is_segment();
+}
+
 void textfile_sub_source::to_front(const std::shared_ptr<logfile>& lf)
 {
     auto iter = std::find(this->tss_files.begin(),
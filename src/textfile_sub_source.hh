@@ -30,6 +30,7 @@
 #ifndef textfile_sub_source_hh
 #define textfile_sub_source_hh
 
+#include <algorithm>
 #include <deque>
 
 #include "logfile.hh"
@@ -70,6 +71,8 @@ public:
 
     size_t text_size_for_line(textview_curses &tc, int line, line_flags_t flags);
 
+    bool text_line_continues(int line);
+
     std::shared_ptr<logfile> current_file() const
     {
         if (this->tss_files.empty()) {
@@ -142,6 +145,17 @@ public:
 
                 this->get_filters().get_enabled_mask(filter_in_mask, filter_out_mask);
                 auto *lfo = (line_filter_observer *) lf->get_logline_observer();
+                if (lf->size() < old_size) {
+                    // Lines were dropped so they can be indexed again with
+                    // a format that was found later in the file.
+                    auto &tfs_index = lfo->lfo_filter_state.tfs_index;
+
+                    tfs_index.erase(std::lower_bound(tfs_index.begin(),
+                                                     tfs_index.end(),
+                                                     (uint32_t) lf->size()),
+                                    tfs_index.end());
+                    old_size = lf->size();
+                }
                 for (uint32_t lpc = old_size; lpc < lf->size(); lpc++) {
                     if (this->tss_apply_filters &&
                         lfo->excluded(filter_in_mask, filter_out_mask, lpc)) {
@@ -41,6 +41,7 @@
 #include "textview_curses.hh"
 #include "view_curses.hh"
 #include "lnav_config.hh"
+#include "lnav_util.hh"
 
 using namespace std;
 
@@ -75,8 +76,11 @@ text_filter::revert_to_last(logfile_filter_state &lfs, size_t rollback_size)
 
 void text_filter::add_line(
         logfile_filter_state &lfs, logfile::const_iterator ll, shared_buffer_ref &line) {
-    bool match_state = this->matches(*lfs.tfs_logfile, ll, line);
+    this->add_match(lfs, ll, this->matches(*lfs.tfs_logfile, ll, line));
+}
 
+void text_filter::add_match(
+        logfile_filter_state &lfs, logfile::const_iterator ll, bool match_state) {
     if (ll->is_message()) {
         this->end_of_message(lfs);
     }
@@ -133,6 +137,8 @@ void textview_curses::reload_config(error_reporter &reporter)
 {
     static auto DEFAULT_THEME_NAME = string("default");
 
+    this->invalidate_row_cache();
+
     for (auto iter = this->tc_highlights.begin();
          iter != this->tc_highlights.end();) {
         if (iter->first.first != highlight_source_t::THEME) {
@@ -314,6 +320,19 @@ void textview_curses::listview_value_for_rows(const listview_curses &lv,
         this->textview_value_for_row(row, al);
         ++row;
     }
+
+    // Only hold on to the rows that are on, or near, the screen.
+    auto top = this->get_top();
+    auto bottom = this->get_bottom();
+    auto margin = bottom - top + 1_vl;
+    if (this->tc_row_cache.size() > (size_t) margin * 4) {
+        this->tc_row_cache.erase(
+            this->tc_row_cache.begin(),
+            this->tc_row_cache.lower_bound(top - margin));
+        this->tc_row_cache.erase(
+            this->tc_row_cache.upper_bound(bottom + margin),
+            this->tc_row_cache.end());
+    }
 }
 
 bool textview_curses::handle_mouse(mouse_event &me)
@@ -409,57 +428,86 @@ void textview_curses::textview_value_for_row(vis_line_t row,
     this->tc_sub_source->text_value_for_line(*this, row, str);
     this->tc_sub_source->text_attrs_for_line(*this, row, sa);
 
-    scrub_ansi_string(str, sa);
+    // Scrubbing the escape sequences, highlighting, and hiding fields only
+    // depend on the text and attributes from the sub-source, so the result
+    // for a row can be reused as long as none of those change.
+    hasher row_hash;
+
+    row_hash.update(str)
+        .update((int) source_format)
+        .update(this->tc_hide_fields);
+    for (const auto &attr : sa) {
+        row_hash.update(attr.sa_range.lr_start)
+            .update(attr.sa_range.lr_end)
+            .update((uintptr_t) attr.sa_type)
+            .update(attr.sa_value.sav_int)
+            .update(attr.sa_str_value);
+    }
+
+    auto row_key = row_hash.to_string();
+    auto &cache_entry = this->tc_row_cache[row];
+    struct line_range orig_line;
+
+    if (cache_entry.rce_key == row_key) {
+        value_out = cache_entry.rce_value;
+        orig_line = cache_entry.rce_orig_line;
+    } else {
+        struct line_range body;
+
+        scrub_ansi_string(str, sa);
+
+        body = find_string_attr_range(sa, &SA_BODY);
+        if (body.lr_start == -1) {
+            body.lr_start = 0;
+            body.lr_end = str.size();
+        }
 
-    struct line_range body, orig_line;
+        orig_line = find_string_attr_range(sa, &SA_ORIGINAL_LINE);
+        if (!orig_line.is_valid()) {
+            orig_line.lr_start = 0;
+            orig_line.lr_end = str.size();
+        }
 
-    body = find_string_attr_range(sa, &SA_BODY);
-    if (body.lr_start == -1) {
-        body.lr_start = 0;
-        body.lr_end = str.size();
-    }
+        auto sa_iter = find_string_attr(sa, &SA_FORMAT);
+        if (sa_iter != sa.end()) {
+            format_name = sa_iter->to_string();
+        }
 
-    orig_line = find_string_attr_range(sa, &SA_ORIGINAL_LINE);
-    if (!orig_line.is_valid()) {
-        orig_line.lr_start = 0;
-        orig_line.lr_end = str.size();
-    }
+        for (auto &tc_highlight : this->tc_highlights) {
+            bool internal_hl =
+                tc_highlight.first.first == highlight_source_t::INTERNAL ||
+                tc_highlight.first.first == highlight_source_t::THEME;
 
-    auto sa_iter = find_string_attr(sa, &SA_FORMAT);
-    if (sa_iter != sa.end()) {
-        format_name = sa_iter->to_string();
-    }
+            if (!tc_highlight.second.h_text_formats.empty() &&
+                tc_highlight.second.h_text_formats.count(source_format) == 0) {
+                continue;
+            }
 
-    for (auto &tc_highlight : this->tc_highlights) {
-        bool internal_hl =
-            tc_highlight.first.first == highlight_source_t::INTERNAL ||
-            tc_highlight.first.first == highlight_source_t::THEME;
+            if (!tc_highlight.second.h_format_name.empty() &&
+                tc_highlight.second.h_format_name != format_name) {
+                continue;
+            }
 
-        if (!tc_highlight.second.h_text_formats.empty() &&
-            tc_highlight.second.h_text_formats.count(source_format) == 0) {
-            continue;
-        }
+            if (this->tc_disabled_highlights.count(tc_highlight.first.first)) {
+                continue;
+            }
 
-        if (!tc_highlight.second.h_format_name.empty() &&
-            tc_highlight.second.h_format_name != format_name) {
-            continue;
+            // Internal highlights should only apply to the log message body so
+            // that we don't start highlighting other fields.  User-provided
+            // highlights should apply only to the line itself and not any of
+            // the surrounding decorations that are added (for example, the
+            // file lines that are inserted at the beginning of the log view).
+            int start_pos = internal_hl ? body.lr_start : orig_line.lr_start;
+            tc_highlight.second.annotate(value_out, start_pos);
         }
 
-        if (this->tc_disabled_highlights.count(tc_highlight.first.first)) {
-            continue;
+        if (this->tc_hide_fields) {
+            value_out.apply_hide();
         }
 
-        // Internal highlights should only apply to the log message body so
-        // that we don't start highlighting other fields.  User-provided
-        // highlights should apply only to the line itself and not any of the
-        // surrounding decorations that are added (for example, the file lines
-        // that are inserted at the beginning of the log view).
-        int start_pos = internal_hl ? body.lr_start : orig_line.lr_start;
-        tc_highlight.second.annotate(value_out, start_pos);
-    }
-
-    if (this->tc_hide_fields) {
-        value_out.apply_hide();
+        cache_entry.rce_key = std::move(row_key);
+        cache_entry.rce_value = value_out;
+        cache_entry.rce_orig_line = orig_line;
     }
 
 #if 0
@@ -538,6 +586,7 @@ void textview_curses::execute_search(const std::string &regex_orig)
 
         this->tc_search_child.reset();
         this->tc_source_search_child.reset();
+        this->invalidate_row_cache();
 
         log_debug("start search for: '%s'", regex.c_str());
 
@@ -570,7 +619,7 @@ void textview_curses::execute_search(const std::string &regex_orig)
             highlight_map_t &hm = this->get_highlights();
             hm[{highlight_source_t::PREVIEW, "search"}] = hl;
 
-            unique_ptr<grep_proc<vis_line_t>> gp = make_unique<grep_proc<vis_line_t>>(code, *this);
+            unique_ptr<grep_proc<vis_line_t>> gp = make_unique<grep_proc<vis_line_t>>(code, *this, regex);
 
             gp->set_sink(this);
             auto top = this->get_top();
@@ -589,8 +638,8 @@ void textview_curses::execute_search(const std::string &regex_orig)
                 gp, highlight_source_t::PREVIEW, "search", hm);
 
             if (this->tc_sub_source != nullptr) {
-                this->tc_sub_source->get_grepper() | [this, code] (auto pair) {
-                    shared_ptr<grep_proc<vis_line_t>> sgp = make_shared<grep_proc<vis_line_t>>(code, *pair.first);
+                this->tc_sub_source->get_grepper() | [this, code, &regex] (auto pair) {
+                    shared_ptr<grep_proc<vis_line_t>> sgp = make_shared<grep_proc<vis_line_t>>(code, *pair.first, regex);
 
                     sgp->set_sink(pair.second);
                     sgp->queue_request(0_vl);
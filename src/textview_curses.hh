@@ -166,10 +166,22 @@ public:
 
     void add_line(logfile_filter_state &lfs, logfile::const_iterator ll, shared_buffer_ref &line);
 
+    /**
+     * Record the result of a match that was already done for the given
+     * line, this is the second half of add_line().
+     */
+    void add_match(logfile_filter_state &lfs, logfile::const_iterator ll, bool match_state);
+
     void end_of_message(logfile_filter_state &lfs);
 
     virtual bool matches(const logfile &lf, logfile::const_iterator ll, shared_buffer_ref &line) = 0;
 
+    /**
+     * @return True if matches() only looks at the line text and can be
+     *   called from more than one thread at a time.
+     */
+    virtual bool is_thread_safe() const { return false; };
+
     virtual std::string to_command() = 0;
 
     bool operator==(const std::string &rhs) {
@@ -443,6 +455,15 @@ public:
 
     virtual size_t text_size_for_line(textview_curses &tc, int line, line_flags_t raw = 0) = 0;
 
+    /**
+     * @param line The line to check.
+     * @return True if the line is a segment of a long line that continues
+     *   on the next line without a line ending.
+     */
+    virtual bool text_line_continues(int line) {
+        return false;
+    };
+
     /**
      * Inform the source that the given line has been marked/unmarked.  This
      * callback function can be used to translate between between visible line
@@ -615,6 +636,13 @@ public:
     static bookmark_type_t BM_SEARCH;
     static bookmark_type_t BM_META;
 
+    /**
+     * The number of bytes from the start of the next segment of a long line
+     * that are searched along with a segment, so that matches that cross
+     * into the next segment are found.
+     */
+    static const size_t GREP_SEGMENT_OVERLAP = 4 * 1024;
+
     textview_curses();
 
     ~textview_curses();
@@ -706,12 +734,26 @@ public:
                                                      line,
                                                      value_out,
                                                      text_sub_source::RF_RAW);
+            this->tc_grep_value_size = value_out.size();
+            if (this->tc_sub_source->text_line_continues(line)) {
+                std::string next_value;
+
+                this->tc_sub_source->text_value_for_line(
+                    *this, line + 1, next_value, text_sub_source::RF_RAW);
+                value_out.append(next_value, 0, GREP_SEGMENT_OVERLAP);
+            }
             retval = true;
         }
 
         return retval;
     };
 
+    size_t grep_value_limit(vis_line_t line,
+                            const std::string &value)
+    {
+        return this->tc_grep_value_size;
+    };
+
     void grep_begin(grep_proc<vis_line_t> &gp, vis_line_t start, vis_line_t stop);
     void grep_match(grep_proc<vis_line_t> &gp,
                     vis_line_t line,
@@ -745,14 +787,27 @@ public:
         }
     };
 
-    highlight_map_t &get_highlights() { return this->tc_highlights; };
+    highlight_map_t &get_highlights() {
+        this->invalidate_row_cache();
+        return this->tc_highlights;
+    };
 
     const highlight_map_t &get_highlights() const { return this->tc_highlights; };
 
     std::set<highlight_source_t> &get_disabled_highlights() {
+        this->invalidate_row_cache();
         return this->tc_disabled_highlights;
     }
 
+    /**
+     * Forget the rows that were rendered recently.  This is done
+     * automatically when the highlighters are accessed for modification or
+     * the configuration is reloaded.
+     */
+    void invalidate_row_cache() {
+        this->tc_row_cache.clear();
+    };
+
     bool handle_mouse(mouse_event &me);
 
     void reload_data();
@@ -888,6 +943,8 @@ protected:
     vis_bookmarks tc_bookmarks;
 
     int tc_searching{0};
+    /** The size of the last line from grep_value_for_line() by itself. */
+    size_t tc_grep_value_size{0};
     struct timeval tc_follow_deadline{0, 0};
     vis_line_t tc_follow_top{-1_vl};
     std::function<bool()> tc_follow_func;
@@ -896,6 +953,20 @@ protected:
     highlight_map_t tc_highlights;
     std::set<highlight_source_t> tc_disabled_highlights;
 
+    /**
+     * A row after the escape sequences were scrubbed, the highlighters were
+     * applied, and the fields were hidden, along with a hash of the text and
+     * attributes from the sub-source that it was produced from.  The row is
+     * only processed again when that hash changes.
+     */
+    struct row_cache_entry {
+        std::string rce_key;
+        attr_line_t rce_value;
+        struct line_range rce_orig_line;
+    };
+
+    std::map<vis_line_t, row_cache_entry> tc_row_cache;
+
     vis_line_t tc_selection_start{-1_vl};
     vis_line_t tc_selection_last{-1_vl};
     bool tc_selection_cleared{false};
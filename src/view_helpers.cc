@@ -32,6 +32,7 @@
 #include "lnav.hh"
 #include "sql_util.hh"
 #include "pretty_printer.hh"
+#include "pretty_text_source.hh"
 #include "environ_vtab.hh"
 #include "vtab_module.hh"
 #include "shlex.hh"
@@ -95,104 +96,220 @@ static void open_schema_view()
     schema_tc->redo_search();
 }
 
-static void open_pretty_view()
+/**
+ * Split the output of the pretty-printer into lines, dropping the empty
+ * line after the last newline.
+ */
+static void split_pretty_lines(const attr_line_t &pretty_al,
+                               const attr_line_t &prefix_al,
+                               vector<attr_line_t> &lines_out)
 {
-    static const char *NOTHING_MSG =
-        "Nothing to pretty-print";
+    pretty_al.split_lines(lines_out);
+    if (!lines_out.empty() && lines_out.back().empty()) {
+        lines_out.pop_back();
+    }
+    if (!prefix_al.empty()) {
+        for (auto &pretty_line : lines_out) {
+            pretty_line.insert(0, prefix_al);
+        }
+    }
+}
 
-    textview_curses *top_tc = *lnav_data.ld_view_stack.top();
-    textview_curses *pretty_tc = &lnav_data.ld_views[LNV_PRETTY];
+static pretty_text_source *create_log_pretty_source(vis_line_t anchor_row)
+{
     textview_curses *log_tc = &lnav_data.ld_views[LNV_LOG];
-    textview_curses *text_tc = &lnav_data.ld_views[LNV_TEXT];
-    attr_line_t full_text;
+    logfile_sub_source &lss = lnav_data.ld_log_source;
 
-    delete pretty_tc->get_sub_source();
-    pretty_tc->set_sub_source(nullptr);
-    if (top_tc->get_inner_height() == 0) {
-        pretty_tc->set_sub_source(new plain_text_source(NOTHING_MSG));
-        return;
-    }
+    auto message_start = [&lss](vis_line_t vl) {
+        if (vl >= vis_line_t(lss.text_line_count())) {
+            return vl;
+        }
 
-    if (top_tc == log_tc) {
-        logfile_sub_source &lss = lnav_data.ld_log_source;
-        bool first_line = true;
+        content_line_t cl = lss.at(vl);
+        auto lf = lss.find(cl);
+        auto ll = lf->begin() + cl;
+        auto ll_start = lf->message_start(ll);
+
+        return std::max(0_vl, vl - vis_line_t(distance(ll_start, ll)));
+    };
+    auto layout = [&lss, log_tc](vis_line_t vl, vector<attr_line_t> &lines_out) {
+        vis_line_t row_count(lss.text_line_count());
 
-        for (vis_line_t vl = log_tc->get_top(); vl <= log_tc->get_bottom(); ++vl) {
-            content_line_t cl = lss.at(vl);
-            shared_ptr<logfile> lf = lss.find(cl);
+        if (vl >= row_count) {
+            return vl + 1_vl;
+        }
+
+        attr_line_t al;
+
+        lss.text_value_for_line(*log_tc, vl, al.get_string(),
+                                text_sub_source::RF_FULL|
+                                text_sub_source::RF_REWRITE);
+        lss.text_attrs_for_line(*log_tc, vl, al.get_attrs());
+        if (log_tc->get_hide_fields()) {
+            al.apply_hide();
+        }
+
+        line_range orig_lr = find_string_attr_range(
+            al.get_attrs(), &SA_ORIGINAL_LINE);
+        attr_line_t orig_al = al.subline(orig_lr.lr_start, orig_lr.length());
+        attr_line_t prefix_al = al.subline(0, orig_lr.lr_start);
+
+        data_scanner ds(orig_al.get_string());
+        pretty_printer pp(&ds, orig_al.get_attrs());
+        attr_line_t pretty_al;
+
+        // TODO: dump more details of the line in the output.
+        pp.append_to(pretty_al);
+        split_pretty_lines(pretty_al, prefix_al, lines_out);
+
+        // Skip over the rest of the lines in this message.
+        auto retval = vl + 1_vl;
+        while (retval < row_count) {
+            content_line_t cl = lss.at(retval);
+            auto lf = lss.find(cl);
             auto ll = lf->begin() + cl;
-            shared_buffer_ref sbr;
 
-            if (!first_line && !ll->is_message()) {
-                continue;
-            }
-            auto ll_start = lf->message_start(ll);
-            attr_line_t al;
-
-            vl -= vis_line_t(distance(ll_start, ll));
-            lss.text_value_for_line(*log_tc, vl, al.get_string(),
-                                    text_sub_source::RF_FULL|
-                                    text_sub_source::RF_REWRITE);
-            lss.text_attrs_for_line(*log_tc, vl, al.get_attrs());
-            if (log_tc->get_hide_fields()) {
-                al.apply_hide();
+            if (ll->get_sub_offset() == 0 && ll->is_message()) {
+                break;
             }
+            ++retval;
+        }
 
-            line_range orig_lr = find_string_attr_range(
-                al.get_attrs(), &SA_ORIGINAL_LINE);
-            attr_line_t orig_al = al.subline(orig_lr.lr_start, orig_lr.length());
-            attr_line_t prefix_al = al.subline(0, orig_lr.lr_start);
+        return retval;
+    };
 
-            data_scanner ds(orig_al.get_string());
-            pretty_printer pp(&ds, orig_al.get_attrs());
-            attr_line_t pretty_al;
-            vector<attr_line_t> pretty_lines;
+    return new pretty_text_source(log_tc,
+                                  vis_line_t(lss.text_line_count()),
+                                  anchor_row,
+                                  message_start,
+                                  layout);
+}
+
+static pretty_text_source *create_text_pretty_source(vis_line_t anchor_row)
+{
+    textview_curses *text_tc = &lnav_data.ld_views[LNV_TEXT];
+    shared_ptr<logfile> lf = lnav_data.ld_text_source.current_file();
+
+    // The segments of a line that was too long for the line buffer are
+    // joined back together in blocks that fit in the line buffer, so the
+    // rest of the line is laid out after the first block.
+    auto message_start = [lf](vis_line_t vl) {
+        if (vl >= vis_line_t(lf->size())) {
+            return vl;
+        }
 
-            // TODO: dump more details of the line in the output.
-            pp.append_to(pretty_al);
-            pretty_al.split_lines(pretty_lines);
+        auto ll = lf->begin() + vl;
+        logfile::const_iterator block_start = lf->message_start(ll);
 
-            for (auto &pretty_line : pretty_lines) {
-                if (pretty_line.empty() && &pretty_line == &pretty_lines.back()) {
-                    break;
-                }
-                pretty_line.insert(0, prefix_al);
-                pretty_line.append("\n");
-                full_text.append(pretty_line);
-            }
+        while (true) {
+            auto block_end = block_start;
 
-            first_line = false;
+            lf->get_segments_range(block_start, block_end);
+            if (block_end > ll) {
+                break;
+            }
+            block_start = block_end;
         }
 
-        if (!full_text.empty()) {
-            full_text.erase(full_text.length() - 1, 1);
+        return vl - vis_line_t(distance(block_start, logfile::const_iterator(ll)));
+    };
+    auto layout = [lf](vis_line_t vl, vector<attr_line_t> &lines_out) {
+        auto retval = vl + 1_vl;
+
+        if (vl < vis_line_t(lf->size())) {
+            logfile::const_iterator ll = lf->begin() + vl;
+            auto block_end = ll;
+            auto read_result = lf->read_segments(ll, block_end);
+
+            retval = vl + vis_line_t(distance(ll, block_end));
+            if (read_result.isOk()) {
+                auto sbr = read_result.unwrap();
+                data_scanner ds(sbr);
+                string_attrs_t sa;
+                pretty_printer pp(&ds, sa);
+                attr_line_t pretty_al;
+
+                pp.append_to(pretty_al);
+                split_pretty_lines(pretty_al, attr_line_t(), lines_out);
+            }
         }
+
+        return retval;
+    };
+
+    return new pretty_text_source(text_tc,
+                                  vis_line_t(lf->size()),
+                                  anchor_row,
+                                  message_start,
+                                  layout);
+}
+
+static void open_pretty_view()
+{
+    static const char *NOTHING_MSG =
+        "Nothing to pretty-print";
+
+    textview_curses *top_tc = *lnav_data.ld_view_stack.top();
+    textview_curses *pretty_tc = &lnav_data.ld_views[LNV_PRETTY];
+    textview_curses *log_tc = &lnav_data.ld_views[LNV_LOG];
+    textview_curses *text_tc = &lnav_data.ld_views[LNV_TEXT];
+
+    if (top_tc->get_inner_height() == 0 ||
+        (top_tc != log_tc && top_tc != text_tc)) {
+        delete pretty_tc->get_sub_source();
+        pretty_tc->set_sub_source(new plain_text_source(NOTHING_MSG));
+        return;
     }
-    else if (top_tc == text_tc) {
-        shared_ptr<logfile> lf = lnav_data.ld_text_source.current_file();
 
-        for (vis_line_t vl = text_tc->get_top(); vl <= text_tc->get_bottom(); ++vl) {
-            auto ll = lf->begin() + vl;
-            shared_buffer_ref sbr;
+    // Keep the layout from the last time if nothing has moved underneath.
+    auto *old_pts = dynamic_cast<pretty_text_source *>(
+        pretty_tc->get_sub_source());
+    if (old_pts != nullptr &&
+        old_pts->get_source_view() == top_tc &&
+        old_pts->get_anchor_row() == top_tc->get_top() &&
+        old_pts->get_row_count() == top_tc->get_inner_height()) {
+        return;
+    }
 
-            lf->read_full_message(ll, sbr);
-            data_scanner ds(sbr);
-            string_attrs_t sa;
-            pretty_printer pp(&ds, sa);
+    delete pretty_tc->get_sub_source();
+    pretty_tc->set_sub_source(nullptr);
 
-            pp.append_to(full_text);
-        }
+    pretty_text_source *pts;
+    if (top_tc == log_tc) {
+        pts = create_log_pretty_source(log_tc->get_top());
+    } else {
+        pts = create_text_pretty_source(text_tc->get_top());
     }
-    auto *pts = new plain_text_source();
-    pts->replace_with(full_text);
     pretty_tc->set_sub_source(pts);
-    if (lnav_data.ld_last_pretty_print_top != log_tc->get_top()) {
-        pretty_tc->set_top(vis_line_t(0));
-    }
-    lnav_data.ld_last_pretty_print_top = log_tc->get_top();
+    pretty_tc->set_top(0_vl);
+    pts->layout_step(*pretty_tc, ui_clock::now());
     pretty_tc->redo_search();
 }
 
+/**
+ * Move the view that was pretty-printed to the message that is at the top
+ * of the pretty view, so scrolling in the pretty view is not lost when
+ * switching back.
+ */
+static void close_pretty_view()
+{
+    textview_curses *pretty_tc = &lnav_data.ld_views[LNV_PRETTY];
+    auto *pts = dynamic_cast<pretty_text_source *>(
+        pretty_tc->get_sub_source());
+
+    if (pts == nullptr) {
+        return;
+    }
+
+    auto *source_tc = pts->get_source_view();
+    auto row = pts->source_row_for_line(pretty_tc->get_top());
+
+    if (row != pts->get_anchor_row() &&
+        row < source_tc->get_inner_height()) {
+        source_tc->set_top(row);
+    }
+}
+
 static void build_all_help_text()
 {
     if (!lnav_data.ld_help_source.empty()) {
@@ -472,6 +589,9 @@ bool toggle_view(textview_curses *toggle_tc)
         if (lnav_data.ld_view_stack.size() == 1) {
             return false;
         }
+        if (tc == &lnav_data.ld_views[LNV_PRETTY]) {
+            close_pretty_view();
+        }
         lnav_data.ld_last_view = tc;
         lnav_data.ld_view_stack.pop_back();
     }
@@ -349,6 +349,21 @@ struct variadic_counter<Arg1, Args...> : variadic_counter<Args...> {
 };
 
 
+/**
+ * Converts a function argument when the conversion needs the function's
+ * context, for example, to keep a value in the statement's auxdata.  Types
+ * that do not need the context are converted with from_sqlite.
+ */
+template<typename T>
+struct from_sqlite_context {
+    inline decltype(auto) operator()(sqlite3_context *context,
+                                     int argc,
+                                     sqlite3_value **val,
+                                     int argi) {
+        return from_sqlite<T>()(argc, val, argi);
+    }
+};
+
 template<typename F, F f> struct sqlite_func_adapter;
 
 template<typename Return, typename ... Args, Return (*f)(Args...)>
@@ -362,7 +377,8 @@ struct sqlite_func_adapter<Return (*)(Args...), f> {
                       int argc, sqlite3_value **argv,
                       std::index_sequence<Idx...>) {
         try {
-            Return retval = f(from_sqlite<Args>()(argc, argv, Idx)...);
+            Return retval = f(
+                from_sqlite_context<Args>()(context, argc, argv, Idx)...);
 
             to_sqlite(context, retval);
         } catch (from_sqlite_conversion_error &e) {
@@ -0,0 +1,291 @@
+#! /bin/bash
+
+# Measure the throughput of lnav on large, generated log files.
+#
+# Usage: benchmark.sh [-b <lnav-binary>] [-l <lines>] [-k <kinds>]
+#                     [-o <results-file>] [-w <work-dir>]
+#
+#   -b  The lnav binary to run, defaults to the one in the build tree.
+#   -l  The number of lines to generate for each log, defaults to 1000000.
+#   -k  The kinds of logs to generate, separated by spaces.  The default is
+#       all of them: "syslog access_log json java".
+#   -o  The file to append the results to, defaults to the standard output.
+#   -w  The directory to write the generated logs to.  The logs are kept
+#       between runs, so the generation cost is only paid once.
+#
+# The logs are generated with a fixed seed so that the results from
+# different builds can be compared, as long as the same awk is used.  Each
+# kind of log is loaded by a separate lnav process for each measurement, so
+# the counters in the lnav_perf table only cover that measurement.  The
+# results are written as one JSON object per log kind:
+#
+#   kind, lines, bytes       -- The log that was generated.
+#   index_ms                 -- Wall-clock time to load and index the log.
+#   index_lines_per_sec      -- The lines indexed per second.
+#   max_rss_kb               -- Peak RSS while indexing, null if unknown.
+#   filter_ms                -- Additional time for a :filter-out.
+#   search_ms                -- Additional time for a search.
+#   sql_ms                   -- Additional time for an aggregate query.
+#   index_phases, ...        -- The lnav_perf rows from each run.
+#
+# The "additional time" measurements are the wall-clock time of the run
+# minus the time of the indexing run.
+
+lnav_bin="${lnav:-${top_builddir:-..}/src/lnav}"
+line_count=1000000
+kinds="syslog access_log json java"
+results_file=""
+work_dir="${builddir:-.}/bench-logs"
+
+while getopts "b:l:k:o:w:" opt; do
+    case "$opt" in
+    b) lnav_bin="$OPTARG" ;;
+    l) line_count="$OPTARG" ;;
+    k) kinds="$OPTARG" ;;
+    o) results_file="$OPTARG" ;;
+    w) work_dir="$OPTARG" ;;
+    *)
+        echo "usage: $0 [-b lnav] [-l lines] [-k kinds] [-o file] [-w dir]" >&2
+        exit 1
+        ;;
+    esac
+done
+
+if ! test -x "${lnav_bin}"; then
+    echo "error: lnav binary not found -- ${lnav_bin}" >&2
+    exit 1
+fi
+
+mkdir -p "${work_dir}/home"
+
+# Run with an empty configuration so the results do not depend on the
+# formats and settings of the user running the benchmark.
+HOME="${work_dir}/home"
+export HOME
+unset XDG_CONFIG_HOME
+
+now_ms() {
+    local ns
+
+    ns=`date +%s%N 2>/dev/null`
+    case "$ns" in
+    *N|"")
+        perl -MTime::HiRes=time -e 'printf("%d\n", time() * 1000)'
+        ;;
+    *)
+        echo $(( ns / 1000000 ))
+        ;;
+    esac
+}
+
+# The GNU and BSD versions of time(1) report the peak RSS differently.
+time_style=""
+if /usr/bin/time -f %M -o /dev/null true > /dev/null 2>&1; then
+    time_style="gnu"
+elif /usr/bin/time -l true > /dev/null 2>&1; then
+    time_style="bsd"
+fi
+
+# Generate a log with the given number of lines.  The timestamps advance
+# by 50ms per line and all of the variable parts come from a seeded
+# random number generator.
+generate_log() {
+    local kind=$1
+    local lines=$2
+    local out=$3
+
+    awk -v kind="$kind" -v lines="$lines" '
+function two(n) { return sprintf("%02d", n) }
+
+BEGIN {
+    srand(1234);
+    split("Jan Feb Mar Apr May Jun Jul Aug Sep Oct Nov Dec", months, " ");
+    split("sshd cron kernel dhclient systemd postfix", progs, " ");
+    split("GET GET GET POST PUT DELETE", methods, " ");
+    split("200 200 200 200 304 404 500", statuses, " ");
+    split("info info info info warn error debug", levels, " ");
+    split("6 6 6 6 4 3 7", priorities, " ");
+    split("opening connection to|closed connection from|received request for|timeout waiting on|failed to authenticate", phrases, "|");
+    split("31 28 31 30 31 30 31 31 30 31 30 31", mdays, " ");
+    base = 1641211200;
+    year = 2022;
+    mon = 1;
+    day = 3;
+    days = 0;
+
+    for (i = 0; i < lines; i++) {
+        ms = i * 50;
+        t = int(ms / 1000);
+        # Roll the date over by hand since not every awk has strftime().
+        while (int(t / 86400) > days) {
+            days++;
+            day++;
+            leap = (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0));
+            if (day > mdays[mon] + (mon == 2 && leap)) {
+                day = 1;
+                mon++;
+                if (mon > 12) {
+                    mon = 1;
+                    year++;
+                }
+            }
+        }
+        hh = int(t / 3600) % 24;
+        mm = int(t / 60) % 60;
+        ss = t % 60;
+        frac = sprintf("%03d", ms % 1000);
+        r = int(rand() * 1000000);
+        phrase = phrases[1 + r % 5];
+        host = "10.0." (r % 250) "." (int(r / 250) % 250);
+
+        if (kind == "syslog") {
+            printf("%s %2d %s:%s:%s bench%d %s[%d]: %s %s port %d\n",
+                   months[mon], day, two(hh), two(mm), two(ss), r % 4,
+                   progs[1 + r % 6], 1000 + r % 30000, phrase, host,
+                   1024 + r % 60000);
+        } else if (kind == "access_log") {
+            printf("%s - - [%s/%s/%d:%s:%s:%s +0000] \"%s /api/v1/item/%d HTTP/1.1\" %s %d \"-\" \"bench/1.0\"\n",
+                   host, two(day), months[mon], year, two(hh), two(mm), two(ss),
+                   methods[1 + r % 6], r % 5000, statuses[1 + r % 7],
+                   200 + r % 20000);
+        } else if (kind == "json") {
+            printf("{\"__REALTIME_TIMESTAMP\": \"%d%s000\", \"PRIORITY\": \"%s\", \"SYSLOG_IDENTIFIER\": \"%s\", \"_PID\": \"%d\", \"MESSAGE\": \"%s %s\"}\n",
+                   base + t, frac, priorities[1 + r % 7], progs[1 + r % 6],
+                   1000 + r % 30000, phrase, host);
+        } else if (kind == "java") {
+            level = levels[1 + r % 7];
+            printf("%d-%s-%s %s:%s:%s,%s [Worker-%d] %s com.example.bench.Service%d - %s %s\n",
+                   year, two(mon), two(day), two(hh), two(mm), two(ss), frac, r % 16,
+                   toupper(level), r % 20, phrase, host);
+            if (level == "error" && i + 2 < lines) {
+                # A stack trace that counts towards the line total.
+                depth = 2 + r % 6;
+                printf("java.lang.IllegalStateException: %s\n", phrase);
+                for (d = 0; d < depth && i + 1 < lines; d++) {
+                    printf("\tat com.example.bench.Service%d.call%d(Service.java:%d)\n",
+                           d, r % 10, 10 + d);
+                    i++;
+                }
+                i++;
+            }
+        }
+    }
+}' > "$out"
+}
+
+table_for_kind() {
+    case "$1" in
+    syslog) echo "syslog_log" ;;
+    access_log) echo "access_log" ;;
+    json) echo "journald_json_log" ;;
+    java) echo "java_log" ;;
+    esac
+}
+
+# Search patterns that match a small fraction of the lines.
+pattern_for_kind() {
+    case "$1" in
+    access_log) echo "item/42[0-9]" ;;
+    *) echo "timeout waiting on 10\.0\.1[0-9]\." ;;
+    esac
+}
+
+# Run lnav headless on a log and print the elapsed milliseconds.  The
+# lnav_perf table is saved to <perf-file> before lnav exits.
+#
+# Usage: run_lnav <log-file> <perf-file> <rss-file> [-c <cmd> ...]
+run_lnav() {
+    local log_file=$1
+    local perf_file=$2
+    local rss_file=$3
+    local start end
+
+    shift 3
+    rm -f "$perf_file" "$rss_file"
+    start=`now_ms`
+    case "$time_style" in
+    gnu)
+        /usr/bin/time -f %M -o "$rss_file" \
+            "$lnav_bin" -n "$@" \
+            -c ";SELECT * FROM lnav_perf WHERE calls > 0" \
+            -c ":write-json-to $perf_file" \
+            "$log_file" > /dev/null 2>&1
+        ;;
+    bsd)
+        /usr/bin/time -l \
+            "$lnav_bin" -n "$@" \
+            -c ";SELECT * FROM lnav_perf WHERE calls > 0" \
+            -c ":write-json-to $perf_file" \
+            "$log_file" 2>&1 > /dev/null | \
+            awk '/maximum resident set size/ { print int($1 / 1024) }' \
+            > "$rss_file"
+        ;;
+    *)
+        "$lnav_bin" -n "$@" \
+            -c ";SELECT * FROM lnav_perf WHERE calls > 0" \
+            -c ":write-json-to $perf_file" \
+            "$log_file" > /dev/null 2>&1
+        ;;
+    esac
+    end=`now_ms`
+
+    echo $(( end - start ))
+}
+
+# Print the contents of a JSON file on a single line, or null.
+json_or_null() {
+    if test -s "$1"; then
+        tr -d '\n' < "$1" | sed -e 's/  */ /g'
+    else
+        echo "null"
+    fi
+}
+
+emit() {
+    if test -n "$results_file"; then
+        echo "$1" >> "$results_file"
+    else
+        echo "$1"
+    fi
+}
+
+for kind in $kinds; do
+    log_file="${work_dir}/bench_${kind}.${line_count}.log"
+    table=`table_for_kind $kind`
+    pattern=`pattern_for_kind $kind`
+
+    if test -z "$table"; then
+        echo "error: unknown log kind -- $kind" >&2
+        exit 1
+    fi
+
+    if ! test -f "$log_file"; then
+        echo "generating ${line_count} lines of ${kind}..." >&2
+        generate_log "$kind" "$line_count" "${log_file}.tmp" && \
+            mv "${log_file}.tmp" "$log_file"
+    fi
+
+    bytes=`wc -c < "$log_file" | tr -d ' '`
+    echo "benchmarking ${kind}..." >&2
+
+    index_ms=`run_lnav "$log_file" "${work_dir}/index.json" \
+        "${work_dir}/index.rss"`
+    filter_ms=`run_lnav "$log_file" "${work_dir}/filter.json" \
+        "${work_dir}/filter.rss" -c ":filter-out ${pattern}"`
+    search_ms=`run_lnav "$log_file" "${work_dir}/search.json" \
+        "${work_dir}/search.rss" -c "/${pattern}"`
+    sql_ms=`run_lnav "$log_file" "${work_dir}/sql.json" \
+        "${work_dir}/sql.rss" \
+        -c ";SELECT log_level, count(*) FROM ${table} GROUP BY log_level"`
+
+    max_rss_kb=`cat "${work_dir}/index.rss" 2>/dev/null | tail -1`
+    if test -z "$max_rss_kb"; then
+        max_rss_kb="null"
+    fi
+    lines_per_sec=0
+    if test "$index_ms" -gt 0; then
+        lines_per_sec=$(( line_count * 1000 / index_ms ))
+    fi
+
+    emit "{\"kind\": \"${kind}\", \"lines\": ${line_count}, \"bytes\": ${bytes}, \"index_ms\": ${index_ms}, \"index_lines_per_sec\": ${lines_per_sec}, \"max_rss_kb\": ${max_rss_kb}, \"filter_ms\": $(( filter_ms - index_ms )), \"search_ms\": $(( search_ms - index_ms )), \"sql_ms\": $(( sql_ms - index_ms )), \"index_phases\": `json_or_null ${work_dir}/index.json`, \"filter_phases\": `json_or_null ${work_dir}/filter.json`, \"search_phases\": `json_or_null ${work_dir}/search.json`, \"sql_phases\": `json_or_null ${work_dir}/sql.json`}"
+done
@@ -155,7 +155,7 @@ int main(int argc, char *argv[])
 
                 auto &root_formats = log_format::get_root_formats();
                 vector<std::shared_ptr<log_format>>::iterator iter;
-                vector<logline> index;
+                logline_vector index;
 
                 if (is_log) {
                     for (iter = root_formats.begin();
@@ -36,6 +36,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
 
 #include <algorithm>
 
@@ -43,7 +44,9 @@
 #include "base/opt_util.hh"
 #include "logfile.hh"
 #include "log_format.hh"
+#include "log_format_ext.hh"
 #include "log_format_loader.hh"
+#include "lnav_util.hh"
 
 using namespace std;
 
@@ -53,6 +56,7 @@ typedef enum {
     MODE_LINE_COUNT,
     MODE_TIMES,
     MODE_LEVELS,
+    MODE_CAPTURES,
 } dl_mode_t;
 
 time_t time(time_t *_unused)
@@ -65,6 +69,7 @@ int main(int argc, char *argv[])
     int c, retval = EXIT_SUCCESS;
     dl_mode_t mode = MODE_NONE;
     string expected_format;
+    const char *append_path = nullptr;
 
     {
         static auto builtin_formats =
@@ -86,8 +91,14 @@ int main(int argc, char *argv[])
         load_formats(paths, errors);
     }
 
-    while ((c = getopt(argc, argv, "ef:ltv")) != -1) {
+    while ((c = getopt(argc, argv, "a:cef:ltv")) != -1) {
         switch (c) {
+            case 'a':
+                append_path = optarg;
+                break;
+            case 'c':
+                mode = MODE_CAPTURES;
+                break;
             case 'f':
                 expected_format = optarg;
                 break;
@@ -151,6 +162,19 @@ int main(int argc, char *argv[])
                 assert(lf->get_modified_time() == st.st_mtime);
             }
 
+            if (append_path != nullptr) {
+                // Add to the file after it was indexed to check that the
+                // lines that are scanned again are handled correctly.
+                auto content = read_file(append_path).unwrap();
+                auto_fd fd(open(argv[0], O_WRONLY | O_APPEND));
+
+                assert(fd.get() != -1);
+                auto rc = write(fd.get(), content.data(), content.size());
+                assert(rc == (ssize_t) content.size());
+                lf->rebuild_index();
+                assert(!lf->is_closed());
+            }
+
             switch (mode) {
                 case MODE_NONE:
                     break;
@@ -181,6 +205,39 @@ int main(int argc, char *argv[])
                         printf("%s -- %03d\n", buffer, iter.get_millis());
                     }
                     break;
+                case MODE_CAPTURES: {
+                    auto elf = std::dynamic_pointer_cast<external_log_format>(
+                        lf->get_format());
+
+                    assert(elf != nullptr);
+                    for (auto iter = lf->begin(); iter != lf->end(); ++iter) {
+                        if (iter->is_continued()) {
+                            continue;
+                        }
+
+                        uint64_t line_number = std::distance(lf->begin(), iter);
+                        auto sbr = lf->read_line(iter).unwrap();
+                        pcre_context_static<128> pc;
+                        string_attrs_t sa;
+                        vector<logline_value> values;
+                        bool cached = elf->cached_captures(
+                            line_number,
+                            elf->pattern_index_for_line(line_number),
+                            sbr.length(),
+                            pc);
+
+                        elf->annotate(line_number, sbr, sa, values);
+
+                        auto body = find_string_attr_range(sa, &SA_BODY);
+
+                        printf("%d %s %.*s\n",
+                               (int) line_number,
+                               cached ? "cached" : "not-cached",
+                               body.length(),
+                               &sbr.get_data()[body.lr_start]);
+                    }
+                    break;
+                }
                 case MODE_LEVELS:
                     for (auto & iter : *lf) {
                         log_level_t level = iter.get_level_and_flags();
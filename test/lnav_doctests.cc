@@ -29,11 +29,18 @@
 
 #include "config.h"
 
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest/doctest.h"
 
 #include "byte_array.hh"
+#include "db_sub_source.hh"
 #include "lnav_config.hh"
+#include "memory_budget.hh"
+#include "pretty_text_source.hh"
 #include "relative_time.hh"
 #include "unique_path.hh"
 #include "logfile.hh"
@@ -179,3 +186,208 @@ TEST_CASE("unique_path") {
     CHECK(log1->get_unique_path() == "[machine1]/syslog.log");
     CHECK(log2->get_unique_path() == "[machine2]/syslog.log");
 }
+
+TEST_CASE("db_result_store") {
+    db_result_store store;
+
+    store.add_column(false);
+    store.add_column(true);
+
+    store.push_row();
+    store.push_cell("abc");
+    store.push_cell("1.5");
+    store.push_row();
+    store.push_cell(nullptr);
+    store.push_cell("not a number");
+
+    CHECK(store.size() == 2);
+    CHECK(store.column_count() == 2);
+    CHECK(string(store[0][0]) == "abc");
+    CHECK(store.number(0, 1) == 1.5);
+    CHECK(store[1][0] == db_label_source::NULL_STR);
+    CHECK(isnan(store.number(1, 1)));
+    CHECK(isnan(store.number(0, 0)));
+
+    store.clear();
+    CHECK(store.empty());
+    CHECK(store.resident_size() == 0);
+}
+
+TEST_CASE("db_result_store spill") {
+    auto max_size = lnav_config.lc_db_sub_source.dsc_max_resident_size;
+    string big(db_result_store::BLOCK_SIZE / 4, 'x');
+    vector<const char *> stored;
+    db_result_store store;
+
+    lnav_config.lc_db_sub_source.dsc_max_resident_size =
+        2 * db_result_store::BLOCK_SIZE;
+    store.add_column(false);
+    for (int lpc = 0; lpc < 40; lpc++) {
+        string value = to_string(lpc) + big;
+
+        store.push_row();
+        stored.push_back(store.push_cell(value.c_str()));
+        CHECK(store.resident_size() <= 2 * db_result_store::BLOCK_SIZE);
+
+        // Rows are read while the query is still adding more.
+        CHECK(string(store[lpc][0]) == value);
+    }
+    for (int lpc = 0; lpc < 40; lpc++) {
+        string value = to_string(lpc) + big;
+
+        CHECK(string(store[lpc][0]) == value);
+        CHECK(stored[lpc] == store[lpc][0]);
+    }
+    lnav_config.lc_db_sub_source.dsc_max_resident_size = max_size;
+}
+
+TEST_CASE("pretty_text_source layout") {
+    textview_curses source_tc;
+    textview_curses tc;
+    int layout_count = 0;
+    auto message_start = [](vis_line_t vl) { return vl; };
+    auto layout = [&layout_count](vis_line_t vl,
+                                  vector<attr_line_t> &lines_out) {
+        layout_count += 1;
+        lines_out.emplace_back(fmt::format("row {} a", (int) vl));
+        lines_out.emplace_back(fmt::format("row {} b", (int) vl));
+
+        return vl + 1_vl;
+    };
+    pretty_text_source pts(&source_tc, 100_vl, 50_vl, message_start, layout);
+    string value;
+
+    tc.set_height(5_vl);
+    tc.set_sub_source(&pts);
+
+    // Only the messages around the anchor are laid out at first.
+    CHECK(pts.layout_step(tc, ui_clock::now()));
+    CHECK_FALSE(pts.is_complete());
+    CHECK(layout_count < 100);
+    CHECK(tc.get_top() > 0);
+    pts.text_value_for_line(tc, tc.get_top(), value, 0);
+    CHECK(value == "row 50 a");
+    CHECK(pts.source_row_for_line(tc.get_top()) == 50);
+
+    // The rest is added around it without moving the view off of the anchor.
+    auto top_before = tc.get_top();
+    CHECK(pts.layout_step(tc, ui_clock::time_point::max()));
+    CHECK(pts.is_complete());
+    CHECK(pts.text_line_count() == 200);
+    CHECK(tc.get_top() == 100);
+    CHECK(tc.get_top() >= top_before);
+    pts.text_value_for_line(tc, tc.get_top(), value, 0);
+    CHECK(value == "row 50 a");
+    pts.text_value_for_line(tc, 0, value, 0);
+    CHECK(value == "row 0 a");
+    CHECK_FALSE(pts.layout_step(tc, ui_clock::time_point::max()));
+
+    tc.set_sub_source(nullptr);
+}
+
+TEST_CASE("pretty_text_source layout_until") {
+    textview_curses source_tc;
+    auto message_start = [](vis_line_t vl) { return vl; };
+    auto layout = [](vis_line_t vl, vector<attr_line_t> &lines_out) {
+        lines_out.emplace_back(fmt::format("row {}", (int) vl));
+
+        return vl + 1_vl;
+    };
+    pretty_text_source pts(&source_tc, 10_vl, 0_vl, message_start, layout);
+    textview_curses tc;
+    string value;
+
+    CHECK(pts.text_line_count() == 0);
+    CHECK(pts.layout_until(3_vl));
+    CHECK(pts.text_line_count() == 4);
+    pts.text_value_for_line(tc, 3, value, 0);
+    CHECK(value == "row 3");
+    CHECK_FALSE(pts.layout_until(10_vl));
+    CHECK(pts.is_complete());
+}
+
+TEST_CASE("spill_allocator without a budget") {
+    using spill_vector =
+        vector<uint64_t, lnav::memory::spill_allocator<uint64_t>>;
+    auto budget = lnav_config.lc_logfile.lc_rss_budget;
+    size_t count = 2 * lnav::memory::MIN_SPILL_SIZE / sizeof(uint64_t);
+
+    lnav_config.lc_logfile.lc_rss_budget = 0;
+    CHECK(lnav::memory::map_spillable(lnav::memory::MIN_SPILL_SIZE) ==
+          nullptr);
+
+    spill_vector values(count, 1);
+
+    // The memory came from the normal allocator, so nothing is evicted.
+    CHECK(lnav::memory::evict(values.data(), values.data() + count) == 0);
+    CHECK(values[count - 1] == 1);
+    lnav_config.lc_logfile.lc_rss_budget = budget;
+}
+
+#if defined(MADV_PAGEOUT) || defined(MADV_COLD)
+TEST_CASE("evict_segments") {
+    using spill_vector =
+        vector<uint64_t, lnav::memory::spill_allocator<uint64_t>>;
+    auto budget = lnav_config.lc_logfile.lc_rss_budget;
+    size_t count = 2 * lnav::memory::MIN_SPILL_SIZE / sizeof(uint64_t);
+    size_t segment_size = count / 8;
+
+    CHECK(lnav::memory::resident_size() > 0);
+
+    lnav_config.lc_logfile.lc_rss_budget = 1;
+    {
+        spill_vector values(count);
+
+        for (size_t lpc = 0; lpc < count; lpc++) {
+            values[lpc] = lpc;
+        }
+
+        // Every segment but the one with the hot element is paged out.
+        vector<size_t> hot = {count / 2};
+        auto evicted = lnav::memory::evict_segments(
+            values.data(), count, segment_size, hot);
+
+        CHECK(evicted == 7 * segment_size * sizeof(uint64_t));
+
+        bool intact = true;
+        for (size_t lpc = 0; lpc < count; lpc++) {
+            if (values[lpc] != lpc) {
+                intact = false;
+            }
+        }
+        CHECK(intact);
+
+        // A forked child, like the grep_proc, keeps its snapshot of the
+        // values when the parent changes them after an eviction.
+        int sync_pipe[2];
+
+        REQUIRE(pipe(sync_pipe) == 0);
+
+        auto child = fork();
+
+        REQUIRE(child != -1);
+        if (child == 0) {
+            char ch;
+
+            close(sync_pipe[1]);
+            if (read(sync_pipe[0], &ch, 1) != 1) {
+                _exit(2);
+            }
+            _exit(values[0] == 0 && values[count - 1] == count - 1 ? 0 : 1);
+        }
+
+        int status = 0;
+
+        close(sync_pipe[0]);
+        lnav::memory::evict_segments(values.data(), count, segment_size, {});
+        values[0] = 100;
+        values[count - 1] = 100;
+        CHECK(write(sync_pipe[1], "x", 1) == 1);
+        close(sync_pipe[1]);
+        REQUIRE(waitpid(child, &status, 0) == child);
+        CHECK(WIFEXITED(status));
+        CHECK(WEXITSTATUS(status) == 0);
+    }
+    lnav_config.lc_logfile.lc_rss_budget = budget;
+}
+#endif
@@ -779,6 +779,70 @@ check_output "write-jsonlines-to is not working" <<EOF
 {"log_line":2,"log_part":null,"log_time":"2009-07-20 22:59:29.000","log_idle_msecs":0,"log_level":"info","log_mark":0,"log_comment":null,"log_tags":null,"log_filters":null,"c_ip":"192.168.202.254","cs_method":"GET","cs_referer":"-","cs_uri_query":null,"cs_uri_stem":"/vmw/vSphere/default/vmkernel.gz","cs_user_agent":"gPXE/0.9.7","cs_username":"-","cs_version":"HTTP/1.0","sc_bytes":78929,"sc_status":200,"cs_host":null}
 EOF
 
+run_test ${lnav_test} -n \
+    -c ";select log_line, log_level from access_log" \
+    -c ':write-arrow-to arrow.0.out' \
+    ${test_dir}/logfile_access_log.0
+
+check_output "write-arrow-to is not working" <<EOF
+EOF
+
+run_test od -A n -t x1 -N 4 arrow.0.out
+
+check_output "write-arrow-to did not write a continuation marker" <<EOF
+ ff ff ff ff
+EOF
+
+run_test sh -c "tail -c 8 arrow.0.out | od -A n -t x1"
+
+check_output "write-arrow-to did not write an end-of-stream marker" <<EOF
+ ff ff ff ff 00 00 00 00
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";SELECT 1 AS num, 'abc' AS str" \
+    -c ':write-arrow-to arrow.1.out' \
+    ${test_dir}/logfile_access_log.0
+
+check_output "write-arrow-to is not working for a single row" <<EOF
+EOF
+
+# The schema has an int64 "num" and a utf8 "str" column, followed by a
+# record batch with one row of 1 and "abc".
+run_test od -A n -t x1 -v arrow.1.out
+
+check_output "write-arrow-to did not write the expected stream" <<EOF
+ ff ff ff ff d0 00 00 00 14 00 00 00 0c 00 13 00
+ 10 00 12 00 0c 00 04 00 00 00 00 00 10 00 00 00
+ 00 00 00 00 00 00 00 00 14 00 00 00 04 00 01 00
+ 08 00 0a 00 08 00 04 00 00 00 00 00 0c 00 00 00
+ 08 00 00 00 00 00 00 00 02 00 00 00 18 00 00 00
+ 5c 00 00 00 10 00 12 00 04 00 10 00 11 00 08 00
+ 00 00 0c 00 10 00 00 00 10 00 00 00 20 00 00 00
+ 28 00 00 00 01 02 00 00 03 00 00 00 6e 75 6d 00
+ 08 00 09 00 04 00 08 00 00 00 00 00 0c 00 00 00
+ 40 00 00 00 01 00 00 00 00 00 00 00 10 00 12 00
+ 04 00 10 00 11 00 08 00 00 00 0c 00 10 00 00 00
+ 10 00 00 00 18 00 00 00 18 00 00 00 01 05 00 00
+ 03 00 00 00 73 74 72 00 04 00 04 00 04 00 00 00
+ 00 00 00 00 00 00 00 00 ff ff ff ff c8 00 00 00
+ 14 00 00 00 0c 00 13 00 10 00 12 00 0c 00 04 00
+ 00 00 00 00 10 00 00 00 18 00 00 00 00 00 00 00
+ 14 00 00 00 04 00 03 00 0a 00 14 00 04 00 0c 00
+ 10 00 00 00 0c 00 00 00 01 00 00 00 00 00 00 00
+ 0c 00 00 00 30 00 00 00 00 00 00 00 02 00 00 00
+ 01 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00
+ 01 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00
+ 00 00 00 00 05 00 00 00 00 00 00 00 00 00 00 00
+ 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00
+ 08 00 00 00 00 00 00 00 08 00 00 00 00 00 00 00
+ 00 00 00 00 00 00 00 00 08 00 00 00 00 00 00 00
+ 08 00 00 00 00 00 00 00 10 00 00 00 00 00 00 00
+ 03 00 00 00 00 00 00 00 01 00 00 00 00 00 00 00
+ 00 00 00 00 03 00 00 00 61 62 63 00 00 00 00 00
+ ff ff ff ff 00 00 00 00
+EOF
+
 # By setting the LNAVSECURE mode before executing the command, we will disable
 # the access to the write-json-to command and the output would just be the
 # actual display of select query rather than json output.
@@ -1097,6 +1161,48 @@ check_output "mark-expr is not working?" <<EOF
 EOF
 
 
+run_test ${lnav_test} -n \
+    -c ":mark-expr :cs_uri_stem LIKE '%vmk%'" \
+    -c ":filter-out vmkboot" \
+    -c ":write-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "mark-expr is not kept after a filter change?" <<EOF
+192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkernel.gz HTTP/1.0" 200 78929 "-" "gPXE/0.9.7"
+EOF
+
+
+run_test ${lnav_test} -n \
+    -c ";CREATE TABLE vmk_names (name TEXT)" \
+    -c ";INSERT INTO vmk_names VALUES ('%vmkboot%')" \
+    -c ":mark-expr :cs_uri_stem LIKE (SELECT name FROM vmk_names)" \
+    -c ";UPDATE vmk_names SET name = '%vmkernel%'" \
+    -c ":filter-out tramp" \
+    -c ":write-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "mark-expr with a subquery is not reevaluated?" <<EOF
+192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkernel.gz HTTP/1.0" 200 78929 "-" "gPXE/0.9.7"
+EOF
+
+
+# Enough lines for the new filters to be matched on several threads.
+awk 'BEGIN {
+    for (lpc = 1; lpc <= 300000; lpc++) {
+        printf("Jan  1 00:00:00 host proc[1]: seq=%d\n", lpc);
+    }
+}' > logfile_filter_threads.0
+
+run_test ${lnav_test} -n \
+    -c ":filter-in seq=[0-9]*777$" \
+    -c ":filter-out seq=1" \
+    logfile_filter_threads.0
+
+check_output "filters matched on several threads are not working?" <<EOF
+$(grep 'seq=[0-9]*777$' logfile_filter_threads.0 | grep -v 'seq=1')
+EOF
+
+
 run_test ${lnav_test} -n \
     -c ":goto 0" \
     -c ":mark" \
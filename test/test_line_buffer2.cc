@@ -92,6 +92,92 @@ int main(int argc, char *argv[])
         assert(result.isErr());
     }
 
+    {
+        char fn_template[] = "test_line_buffer.XXXXXX";
+
+        auto fd = auto_fd(mkstemp(fn_template));
+        remove(fn_template);
+        shared_buffer_ref first_sbr, second_sbr;
+
+        write(fd, TEST_DATA, strlen(TEST_DATA));
+        lseek(fd, SEEK_SET, 0);
+
+        {
+            line_buffer lb;
+
+            lb.set_fd(fd);
+            first_sbr = lb.read_range({0, 13}).unwrap();
+            assert(to_string(first_sbr) == "Hello, World!");
+
+            // Refs keep their data when the buffer is reused.
+            lb.clear();
+            second_sbr = lb.read_range({14, 15}).unwrap();
+            assert(to_string(second_sbr) == "Goodbye, World!");
+            assert(to_string(first_sbr) == "Hello, World!");
+        }
+
+        // ... and when the line_buffer is gone.
+        assert(to_string(first_sbr) == "Hello, World!");
+        assert(to_string(second_sbr) == "Goodbye, World!");
+    }
+
+    {
+        char fn_template[] = "test_line_buffer.XXXXXX";
+
+        auto fd = auto_fd(mkstemp(fn_template));
+        remove(fn_template);
+        string long_line;
+
+        // A line that is too long for the buffer is split into segments
+        // that end after a structural character, including the part after
+        // the first MAX_LINE_BUFFER_SIZE bytes.
+        while (long_line.size() < line_buffer::MAX_LINE_BUFFER_SIZE +
+                                  3 * line_buffer::MAX_LINE_SEGMENT_SIZE) {
+            long_line.append("{\"key\": [1, 2, 3], \"msg\": \"abcdefg\"}");
+        }
+        long_line.append("\n");
+
+        auto long_line_size = long_line.size();
+
+        long_line.append("short line\n");
+        write(fd, long_line.c_str(), long_line.size());
+        lseek(fd, SEEK_SET, 0);
+
+        line_buffer lb;
+        file_range last_range;
+        size_t segment_count = 0;
+
+        lb.set_fd(fd);
+        while (true) {
+            auto li = lb.load_next_line(last_range).unwrap();
+
+            if (li.li_file_range.empty()) {
+                break;
+            }
+            assert(!li.li_partial);
+            assert(li.li_file_range.fr_size <=
+                   line_buffer::MAX_LINE_SEGMENT_SIZE);
+            last_range = li.li_file_range;
+
+            auto sbr = lb.read_range(li.li_file_range).unwrap();
+
+            if (li.li_file_range.fr_offset < (file_off_t) long_line_size) {
+                assert(li.li_continued == (segment_count > 0));
+                segment_count += 1;
+            } else {
+                assert(!li.li_continued);
+                assert(to_string(sbr) == "short line\n");
+            }
+            if (sbr.get_data()[sbr.length() - 1] != '\n') {
+                assert(strchr(",]} ", sbr.get_data()[sbr.length() - 1]));
+            }
+        }
+
+        assert(segment_count > (size_t) (line_buffer::MAX_LINE_BUFFER_SIZE /
+                                          line_buffer::MAX_LINE_SEGMENT_SIZE));
+        assert(last_range.next_offset() == (file_off_t) long_line.size());
+    }
+
     {
         static string first = "Hello";
         static string second = ", World!";
@@ -29,6 +29,32 @@ check_output "piping to stdin is not working?" <<EOF
 2013-06-06T19:13:20.123  Hi
 EOF
 
+# Piped data past the memory limit is spilled to the capture file, the
+# results should be the same as reading the file directly.
+awk 'BEGIN {
+    for (i = 0; i < 250000; i++) {
+        printf("2021-01-01T00:%02d:%02d.%03d  line %d\n",
+               (i / 60000) % 60, (i / 1000) % 60, i % 1000, i);
+    }
+}' > logfile_spill.log
+
+run_test ${lnav_test} -n \
+    -c ";SELECT count(*), max(log_line), sum(length(log_text)) FROM generic_log" \
+    logfile_spill.log
+
+cp `test_filename` logfile_spill.expected
+
+cat logfile_spill.log | run_test ${lnav_test} -n -d logfile_spill.debug.log \
+    -c ";SELECT count(*), max(log_line), sum(length(log_text)) FROM generic_log"
+
+check_output "spilled stdin does not match the file?" \
+    < logfile_spill.expected
+
+if ! grep -q 'spilling piped data past' logfile_spill.debug.log; then
+    echo "piped data was not spilled"
+    exit 1
+fi
+
 
 cp ${srcdir}/logfile_syslog.0 truncfile.0
 chmod u+w truncfile.0
@@ -149,6 +175,32 @@ log       logfile_access_log.0       1
 log       logfile_access_log.1       1
 EOF
 
+    # Make it look like the last extraction was interrupted after the first
+    # member was unpacked.
+    rm -f tmp/*/archives/*-test-logs.tgz.done
+    rm -f tmp/*/archives/*-test-logs.tgz/test/logfile_access_log.1
+
+    run_test env TMPDIR=tmp ${lnav_test} -n -d test_logfile.partial.log \
+        -c ';SELECT view_name, basename(filepath), visible FROM lnav_view_files' \
+        test-logs.tgz
+
+    check_output "partially extracted archive not loaded correctly" <<EOF
+view_name  basename(filepath)  visible
+log       logfile_access_log.0       1
+log       logfile_access_log.1       1
+EOF
+
+    if ! grep -q 'logfile_access_log.0: member was already unpacked' \
+            test_logfile.partial.log; then
+        echo "unpacked member was extracted again"
+        exit 1
+    fi
+
+    if ! test -f tmp/*/archives/*-test-logs.tgz/test/logfile_access_log.1; then
+        echo "missing member was not extracted"
+        exit 1
+    fi
+
     run_test env TMPDIR=tmp ${lnav_test} -n \
         test-logs-trunc.tgz
 
@@ -159,6 +211,51 @@ EOF
 error: unable to open file: /test-logs-trunc.tgz -- failed to read file: /test-logs-trunc.tgz >> src/lnav -- truncated gzip input
 EOF
 
+    # The members that were streamed before the extraction failed have to
+    # be closed again.
+    env TMPDIR=tmp ${lnav_test} -n -d test_logfile.trunc.log \
+        test-logs-trunc.tgz 2> /dev/null
+
+    for member in logfile_access_log.0 logfile_access_log.1; do
+        if ! grep -q "closing streamed archive member: .*/${member}" \
+                test_logfile.trunc.log; then
+            echo "streamed member ${member} was not closed"
+            exit 1
+        fi
+    done
+
+    if test x"${ZIP_CMD}" != x""; then
+        rm -f test-logs.zip
+        (cd ${top_srcdir} && ${ZIP_CMD} -q ${builddir}/test-logs.zip \
+            test/logfile_access_log.0 \
+            test/logfile_access_log.1 \
+            test/logfile_empty.0)
+
+        run_test env TMPDIR=tmp ${lnav_test} -n -d test_logfile.zip.log \
+            -c ':config /tuning/archive-manager/extract-workers 3' \
+            test-logs.zip
+
+        check_output "zip members not unpacked by the workers" <<EOF
+192.168.202.254 - - [20/Jul/2009:22:59:26 +0000] "GET /vmw/cgi/tramp HTTP/1.0" 200 134 "-" "gPXE/0.9.7"
+192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkboot.gz HTTP/1.0" 404 46210 "-" "gPXE/0.9.7"
+192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkernel.gz HTTP/1.0" 200 78929 "-" "gPXE/0.9.7"
+10.112.81.15 - - [15/Feb/2013:06:00:31 +0000] "-" 400 0 "-" "-"
+EOF
+
+        if ! grep -q 'test-logs.zip .* using 3 worker(s)' \
+                test_logfile.zip.log; then
+            echo "zip members were not split across the workers"
+            exit 1
+        fi
+
+        for member in logfile_access_log.0 logfile_access_log.1 logfile_empty.0; do
+            if ! test -f tmp/*/archives/*-test-logs.zip/test/${member}; then
+                echo "zip member ${member} was not unpacked"
+                exit 1
+            fi
+        done
+    fi
+
     mkdir -p rotmp
     chmod ugo-w rotmp
     run_test env TMPDIR=rotmp ${lnav_test} -n test-logs.tgz
@@ -535,6 +632,17 @@ info 0x0
 error 0x0
 EOF
 
+printf 'Nov  3 09:23:38 veridian automount[7998]: lookup(file): lookup for foobar failed\nNov  3 09:23:38 veridian automount[16442]: attempting to mount' > logfile_captures.0
+printf ' entry /auto/opt\nNov  3 09:23:39 veridian automount[7999]: lookup(file): lookup for opt failed\n' > logfile_captures.1
+
+run_test ./drive_logfile -c -f syslog_log -a logfile_captures.1 logfile_captures.0
+
+check_output "capture cache not refreshed after a rescan?" <<EOF
+0 cached lookup(file): lookup for foobar failed
+1 cached attempting to mount entry /auto/opt
+2 cached lookup(file): lookup for opt failed
+EOF
+
 run_test ${lnav_test} -d /tmp/lnav.err -nt -w logfile_stdin.log <<EOF
 Hi
 EOF
@@ -632,3 +740,103 @@ EOF
 # 192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkboot.gz HTTP/1.0" 404 46210 "-" "gPXE/0.9.7"
 # 192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkernel.gz HTTP/1.0" 200 78929 "-" "gPXE/0.9.7"
 # EOF
+
+# Index a log in small chunks on several threads and check that the result
+# matches the serial scan.
+mkdir -p chunked-index/configs/test
+cat > chunked-index/configs/test/config.json <<EOF2
+{
+    "tuning": {
+        "logfile": {
+            "index-chunk-size": 4096
+        }
+    }
+}
+EOF2
+
+for i in `seq 1 2000`; do
+    # Go back in time once in a while to check the out-of-order handling.
+    if test $((i % 500)) -eq 0; then
+        t=$((i - 30))
+    else
+        t=$i
+    fi
+    printf "2022-01-03 10:%02d:%02d,%03d:INFO:message %d\n" \
+        $((t / 60 % 60)) $((t % 60)) $((i % 1000)) $i
+    if test $((i % 7)) -eq 0; then
+        printf "  continued %d\n" $i
+    fi
+done > logfile_chunked.log
+
+run_test ${lnav_test} -n \
+    -c ";SELECT log_line, log_time, log_level, log_text FROM generic_log" \
+    logfile_chunked.log
+
+cp `test_filename` logfile_chunked.serial
+
+run_test ${lnav_test} -n -I chunked-index -d logfile_chunked.debug.log \
+    -c ";SELECT log_line, log_time, log_level, log_text FROM generic_log" \
+    logfile_chunked.log
+
+check_output "chunked indexing does not match the serial scan?" \
+    < logfile_chunked.serial
+
+# The chunks are only scanned in parallel when there is more than one CPU.
+if test `getconf _NPROCESSORS_ONLN` -gt 1; then
+    if ! grep -q 'logfile_chunked.log: indexing [0-9]* bytes in [0-9]* chunks' \
+            logfile_chunked.debug.log; then
+        echo "log file was not indexed in chunks"
+        exit 1
+    fi
+fi
+
+# Files that do not match a format are remembered, so the lines that were
+# already checked are skipped the next time.
+for i in `seq 1 20`; do
+    echo "nothing to see here $i"
+done > logfile_plain_cached.txt
+
+${lnav_test} -n logfile_plain_cached.txt > /dev/null 2>&1
+run_test ${lnav_test} -n -d logfile_plain_cached.log \
+    -c ";SELECT count(*) AS total FROM lnav_file" \
+    -c ":write-csv-to -" \
+    logfile_plain_cached.txt
+
+check_output "plain file was not opened from the cache" <<EOF
+total
+1
+EOF
+
+if ! grep -q "logfile_plain_cached.txt: skipping format detection" \
+        logfile_plain_cached.log; then
+    echo "unrecognized content cache was not used"
+    exit 1
+fi
+
+# A log that starts with more unrecognized lines than detection looks at
+# is found by sampling the rest of the file.
+mkdir -p sample-formats/configs/test
+cat > sample-formats/configs/test/config.json <<EOF2
+{
+    "tuning": {
+        "logfile": {
+            "max-unrecognized-lines": 10
+        }
+    }
+}
+EOF2
+
+for i in `seq 1 40`; do
+    echo "preamble line $i"
+done > logfile_preamble.log
+cat ${test_dir}/logfile_syslog.0 >> logfile_preamble.log
+
+run_test ${lnav_test} -n -I sample-formats \
+    -c ";SELECT basename(filepath) AS name, format FROM lnav_file" \
+    -c ":write-csv-to -" \
+    logfile_preamble.log
+
+check_output "format after a long preamble was not found by sampling" <<EOF
+name,format
+logfile_preamble.log,syslog_log
+EOF
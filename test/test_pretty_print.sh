@@ -77,3 +77,11 @@ Hello
 World
 
 EOF
+
+seq 1 300 | sed -e 's/^/line /' > test_pretty_in.4
+
+run_test ${lnav_test} -n -c ":switch-to-view pretty" test_pretty_in.4
+
+check_output "pretty view is not laid out while it is printed?" <<EOF
+$(seq 1 300 | sed -e 's/^/line /')
+EOF
@@ -38,6 +38,18 @@ run_test ${lnav_test} -nq \
 check_output "setting log_mark is not working" <<EOF
 EOF
 
+run_test ${lnav_test} -n \
+    -c ";ATTACH DATABASE 'sessions/.lnav/log_metadata.db' AS meta" \
+    -c ";SELECT log_offset, part_name != '' AS named FROM meta.bookmarks WHERE part_name IS NOT NULL AND session_time = (SELECT max(session_time) FROM meta.bookmarks) ORDER BY log_offset" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "bookmarks are not saved with their offset" <<EOF
+log_offset,named
+104,1
+227,0
+EOF
+
 run_test ${lnav_test} -n \
     -c ":load-session" \
     -c ':write-to -' \
@@ -91,6 +103,59 @@ check_output "adjust time is not saved in session" <<EOF
 EOF
 
 
+# Bookmarks saved by older versions are identified by a hash of the line's
+# content and the line number.
+rm -rf ./sessions
+mkdir -p $HOME/.lnav
+run_test ${lnav_test} -nq \
+    -c ";ATTACH DATABASE 'sessions/.lnav/log_metadata.db' AS meta" \
+    -c ";CREATE TABLE meta.bookmarks (log_time datetime, log_format varchar(64), log_hash varchar(128), session_time integer, part_name text, access_time datetime DEFAULT CURRENT_TIMESTAMP, comment text DEFAULT '', tags text DEFAULT '', PRIMARY KEY (log_time, log_format, log_hash, session_time))" \
+    -c ";INSERT INTO meta.bookmarks (log_time, log_format, log_hash, session_time, part_name) VALUES ('2009-07-20T22:59:29.000', 'access_log', 'b05c1bdfe75cde41e151c89087e31951', 1000, '')" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "legacy bookmark could not be created" <<EOF
+EOF
+
+run_test ${lnav_test} -n \
+    -c ":load-session" \
+    -c ":write-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "legacy bookmark was not loaded" <<EOF
+192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkernel.gz HTTP/1.0" 200 78929 "-" "gPXE/0.9.7"
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";ATTACH DATABASE 'sessions/.lnav/log_metadata.db' AS meta" \
+    -c ";SELECT log_hash = 'b05c1bdfe75cde41e151c89087e31951' AS legacy, log_offset FROM meta.bookmarks WHERE session_time = 1000" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "legacy bookmark was not migrated" <<EOF
+legacy,log_offset
+0,227
+EOF
+
+run_test ${lnav_test} -nq \
+    -c ":load-session" \
+    -c ";UPDATE access_log SET log_mark = 0" \
+    -c ":save-session" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "unmarking a legacy bookmark failed" <<EOF
+EOF
+
+run_test ${lnav_test} -n \
+    -c ":load-session" \
+    -c ";SELECT count(*) AS marked FROM access_log WHERE log_mark = 1" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "unmarked legacy bookmark came back" <<EOF
+marked
+0
+EOF
+
 rm -rf ./sessions
 mkdir -p $HOME
 run_test ${lnav_test} -nq -d /tmp/lnav.err \
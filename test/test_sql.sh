@@ -21,6 +21,31 @@ log_line,log_body
 1, attempting to mount entry /auto/opt
 EOF
 
+run_test ${lnav_test} -n -d test_sql.stream.log \
+    -c ";SELECT log_line, log_pid, NULL AS nothing, 'a,b' AS quoted FROM syslog_log LIMIT 2" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_syslog.0
+
+check_output "streamed headless CSV output is not correct?" <<EOF
+log_line,log_pid,nothing,quoted
+0,7998,<NULL>,"a,b"
+1,16442,<NULL>,"a,b"
+EOF
+
+if ! grep -q "streaming the query results to the output" test_sql.stream.log; then
+    echo "headless query results were not streamed"
+    exit 1
+fi
+
+run_test ${lnav_test} -n \
+    -c ";SELECT log_line FROM syslog_log WHERE log_line > 100" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_syslog.0
+
+check_error_output "streaming an empty result did not report an error?" <<EOF
+command-option:2: error: no query result to write, use ';' to execute a query
+EOF
+
 
 run_test ${lnav_test} -n \
     -c ";SELECT replicate('foobar', 120)" \
@@ -179,6 +204,88 @@ name,content,length(content)
 logfile_empty.0,,0
 EOF
 
+run_test ${lnav_test} -n \
+    -c ";SELECT phase, calls > 0 AS called FROM lnav_perf WHERE phase IN ('format_scan', 'timestamp_parse', 'kmerge')" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "lnav_perf does not have timings?" <<EOF
+phase,called
+format_scan,1
+timestamp_parse,1
+kmerge,1
+EOF
+
+run_test ${lnav_test} -n \
+    -c ":perf reset" \
+    -c ";SELECT calls FROM lnav_perf WHERE phase = 'format_scan'" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "perf reset does not clear the counters?" <<EOF
+calls
+0
+EOF
+
+run_test ${lnav_test} -n \
+    -c ":perf reset" \
+    -c ";SELECT regexp_match('(vmk)', cs_uri_stem) FROM access_log" \
+    -c ";SELECT regexp_match('(vmk)', cs_uri_stem) FROM access_log" \
+    -c ";SELECT regexp_match('(cgi)', cs_uri_stem) FROM access_log" \
+    -c ";SELECT phase, calls > 0 AS called FROM lnav_perf WHERE phase IN ('regex_cache_hit', 'regex_cache_miss', 'regex_cache_evict')" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "lnav_perf does not count regex cache lookups?" <<EOF
+phase,called
+regex_cache_hit,1
+regex_cache_miss,1
+regex_cache_evict,0
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";SELECT cs_user_agent, sc_bytes FROM access_log" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "projecting the trailing value columns does not work?" <<EOF
+cs_user_agent,sc_bytes
+gPXE/0.9.7,134
+gPXE/0.9.7,46210
+gPXE/0.9.7,78929
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";SELECT log_line, cs_uri_stem FROM access_log WHERE sc_status = 404" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "filtering on a column that is not selected does not work?" <<EOF
+log_line,cs_uri_stem
+1,/vmw/vSphere/default/vmkboot.gz
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";SELECT sc_bytes FROM access_log WHERE log_line > 0 AND sc_status = 200" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "a projection with an index constraint does not work?" <<EOF
+sc_bytes
+78929
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";CREATE TABLE full_extract AS SELECT * FROM access_log" \
+    -c ";SELECT count(*) AS differences FROM (SELECT log_line, c_ip, cs_uri_stem, sc_bytes FROM access_log WHERE sc_status != 404 EXCEPT SELECT log_line, c_ip, cs_uri_stem, sc_bytes FROM full_extract WHERE sc_status != 404)" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "a projected query does not match the full extraction?" <<EOF
+differences
+0
+EOF
+
 run_test ${lnav_test} -n \
     -c ";SELECT distinct xp.node_text FROM lnav_file, xpath('//author', content) as xp" \
     -c ":write-csv-to -" \
@@ -1522,3 +1629,37 @@ content
 1.0
 1.0
 EOF
+
+# Aggregates over the index columns are run on ranges of lines in parallel
+# and have to give the same results as a query that can only run serially.
+awk 'BEGIN {
+    for (i = 0; i < 40000; i++) {
+        level = (i % 7 == 0) ? "ERROR" : ((i % 3 == 0) ? "WARNING" : "INFO");
+        printf "2022-01-03 %02d:%02d:%02d,%03d:%s:message %d\n",
+            int(i / 3600), int(i / 60) % 60, i % 60, i % 1000, level, i;
+    }
+}' > logfile_partitioned.log
+
+run_test ${lnav_test} -n \
+    -c ";SELECT log_level, count(*), min(log_line), max(log_line), avg(log_idle_msecs) FROM (SELECT log_level, log_line, log_idle_msecs FROM all_logs) GROUP BY log_level ORDER BY log_level" \
+    -c ":write-csv-to -" \
+    logfile_partitioned.log
+
+cp `test_filename` logfile_partitioned.serial
+
+run_test ${lnav_test} -n -d logfile_partitioned.debug.log \
+    -c ";SELECT log_level, count(*), min(log_line), max(log_line), avg(log_idle_msecs) FROM all_logs GROUP BY log_level ORDER BY log_level" \
+    -c ":write-csv-to -" \
+    logfile_partitioned.log
+
+check_output "partitioned aggregate does not match the serial query?" \
+    < logfile_partitioned.serial
+
+# The query is only partitioned when there is more than one CPU.
+if test `getconf _NPROCESSORS_ONLN` -gt 1; then
+    if ! grep -q 'all_logs: running the query on [0-9]* partitions' \
+            logfile_partitioned.debug.log; then
+        echo "aggregate query was not partitioned"
+        exit 1
+    fi
+fi
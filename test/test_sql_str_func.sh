@@ -123,6 +123,17 @@ Row 0:
   Column       repl: test{ }1{ }2{ }3
 EOF
 
+run_test ./drive_sql "select regexp_replace('test 1', column1, 'N') as repl from (values ('\\d+'), ('\\s+'), ('\\d+'))"
+
+check_output "regexp_replace() did not use the pattern for each row" <<EOF
+Row 0:
+  Column       repl: test N
+Row 1:
+  Column       repl: testN1
+Row 2:
+  Column       repl: test N
+EOF
+
 run_test ./drive_sql "select regexp_replace('test 1 2 3', '\\w*', '{\\0}') as repl"
 
 check_output "" <<EOF